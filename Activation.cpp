@@ -0,0 +1,414 @@
+/*
+ * Author: Shuhao Lai
+ * Date: 10/17/2026
+ * Activation.cpp
+ */
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <vector>
+#include "Activation.h"
+#include "Kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define ACTIVATION_X86
+#include <immintrin.h>
+#endif
+
+/*
+ * Range reduction for exp(x) = exp(r) * 2^n with n = round(x / ln 2). ln 2 is split in a high part
+ * with trailing zero bits, so n * LN2_HI is exact, and the remainder LN2_LO.
+ */
+static const double LOG2E = 1.4426950408889634074;
+static const double LN2_HI = 6.93147180369123816490e-01;
+static const double LN2_LO = 1.90821492927058770002e-10;
+static const float LOG2E_FLOAT = 1.44269504f;
+static const float LN2_HI_FLOAT = 0.693359375f;
+static const float LN2_LO_FLOAT = -2.12194440e-4f;
+
+//Inputs are clamped so 2^n stays a normal number. Past these, sigmoid is 0 or 1 to the last bit anyway.
+static const double EXP_MIN = -708;
+static const double EXP_MAX = 709;
+static const float EXP_MIN_FLOAT = -87;
+static const float EXP_MAX_FLOAT = 88;
+
+//1 / k! for the Taylor series of exp(r). Double uses every term and float the first 8.
+static const double EXP_TERMS[14] = { 1.0, 1.0, 1.0 / 2, 1.0 / 6, 1.0 / 24, 1.0 / 120, 1.0 / 720, 1.0 / 5040,
+		1.0 / 40320, 1.0 / 362880, 1.0 / 3628800, 1.0 / 39916800, 1.0 / 479001600, 1.0 / 6227020800 };
+static const int DOUBLE_DEGREE = 13;
+static const int FLOAT_DEGREE = 7;
+
+//Sigmoid table: TABLE_STEPS entries per unit over [-TABLE_RANGE, TABLE_RANGE].
+static const int TABLE_RANGE = 16;
+static const int TABLE_STEPS = 64;
+static const int TABLE_SIZE = 2 * TABLE_RANGE * TABLE_STEPS + 1;
+
+static std::atomic<SigmoidMode> & activeMode()
+{
+	static std::atomic<SigmoidMode> mode(SIGMOID_FAST);
+	return mode;
+}
+
+SigmoidMode sigmoidMode()
+{
+	return activeMode().load(std::memory_order_relaxed);
+}
+
+void setSigmoidMode(SigmoidMode mode)
+{
+	activeMode().store(mode, std::memory_order_relaxed);
+}
+
+//On the scalar path std::exp is already faster than evaluating the polynomial one value at a time.
+template<bool Sigmoid, typename T>
+static void expArrayScalar(const T * x, T * y, std::size_t count)
+{
+	for (std::size_t i = 0; i < count; i++)
+		y[i] = Sigmoid ? 1 / (1 + std::exp(-x[i])) : std::exp(x[i]);
+}
+
+#ifdef ACTIVATION_X86
+
+/*
+ * AVX2 has no instruction for 2^n, so n is rounded by adding 1.5 * 2^52, which leaves n in the low
+ * mantissa bits of the sum, and those bits are shifted into the exponent field. min and max return
+ * their second operand when either is NaN, so x goes second in the clamps to let NaN through.
+ */
+__attribute__((target("avx2,fma")))
+static inline __m256d expAvx2(__m256d x)
+{
+	const __m256d shifter = _mm256_set1_pd(6755399441055744.0);
+	x = _mm256_min_pd(_mm256_set1_pd(EXP_MAX), _mm256_max_pd(_mm256_set1_pd(EXP_MIN), x));
+	__m256d shifted = _mm256_fmadd_pd(x, _mm256_set1_pd(LOG2E), shifter);
+	__m256d n = _mm256_sub_pd(shifted, shifter);
+	__m256d r = _mm256_fnmadd_pd(n, _mm256_set1_pd(LN2_HI), x);
+	r = _mm256_fnmadd_pd(n, _mm256_set1_pd(LN2_LO), r);
+	__m256d p = _mm256_set1_pd(EXP_TERMS[DOUBLE_DEGREE]);
+	for (int k = DOUBLE_DEGREE - 1; k >= 0; k--)
+		p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(EXP_TERMS[k]));
+	__m256i scale = _mm256_slli_epi64(_mm256_add_epi64(_mm256_castpd_si256(shifted), _mm256_set1_epi64x(1023)), 52);
+	return _mm256_mul_pd(p, _mm256_castsi256_pd(scale));
+}
+
+__attribute__((target("avx2,fma")))
+static inline __m256 expAvx2(__m256 x)
+{
+	x = _mm256_min_ps(_mm256_set1_ps(EXP_MAX_FLOAT), _mm256_max_ps(_mm256_set1_ps(EXP_MIN_FLOAT), x));
+	__m256 n = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(LOG2E_FLOAT)),
+			_MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	__m256 r = _mm256_fnmadd_ps(n, _mm256_set1_ps(LN2_HI_FLOAT), x);
+	r = _mm256_fnmadd_ps(n, _mm256_set1_ps(LN2_LO_FLOAT), r);
+	__m256 p = _mm256_set1_ps((float) EXP_TERMS[FLOAT_DEGREE]);
+	for (int k = FLOAT_DEGREE - 1; k >= 0; k--)
+		p = _mm256_fmadd_ps(p, r, _mm256_set1_ps((float) EXP_TERMS[k]));
+	__m256i scale = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+	return _mm256_mul_ps(p, _mm256_castsi256_ps(scale));
+}
+
+__attribute__((target("avx2,fma")))
+static inline __m256d expOrSigmoidAvx2(__m256d x, bool sigmoid)
+{
+	if (!sigmoid)
+		return expAvx2(x);
+	const __m256d one = _mm256_set1_pd(1);
+	return _mm256_div_pd(one, _mm256_add_pd(one, expAvx2(_mm256_sub_pd(_mm256_setzero_pd(), x))));
+}
+
+__attribute__((target("avx2,fma")))
+static inline __m256 expOrSigmoidAvx2(__m256 x, bool sigmoid)
+{
+	if (!sigmoid)
+		return expAvx2(x);
+	const __m256 one = _mm256_set1_ps(1);
+	return _mm256_div_ps(one, _mm256_add_ps(one, expAvx2(_mm256_sub_ps(_mm256_setzero_ps(), x))));
+}
+
+//The last partial vector goes through a zero padded copy.
+template<bool Sigmoid>
+__attribute__((target("avx2,fma")))
+static void expArrayAvx2(const double * x, double * y, std::size_t count)
+{
+	std::size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+		_mm256_storeu_pd(y + i, expOrSigmoidAvx2(_mm256_loadu_pd(x + i), Sigmoid));
+	if (i < count)
+	{
+		double tail[4] = {};
+		std::copy(x + i, x + count, tail);
+		_mm256_storeu_pd(tail, expOrSigmoidAvx2(_mm256_loadu_pd(tail), Sigmoid));
+		std::copy(tail, tail + (count - i), y + i);
+	}
+}
+
+template<bool Sigmoid>
+__attribute__((target("avx2,fma")))
+static void expArrayAvx2(const float * x, float * y, std::size_t count)
+{
+	std::size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+		_mm256_storeu_ps(y + i, expOrSigmoidAvx2(_mm256_loadu_ps(x + i), Sigmoid));
+	if (i < count)
+	{
+		float tail[8] = {};
+		std::copy(x + i, x + count, tail);
+		_mm256_storeu_ps(tail, expOrSigmoidAvx2(_mm256_loadu_ps(tail), Sigmoid));
+		std::copy(tail, tail + (count - i), y + i);
+	}
+}
+
+/*
+ * AVX-512 rounds with roundscale and applies 2^n with scalef, and masks the tail instead of copying it.
+ * GCC's headers build these intrinsics from a deliberately undefined source vector and then warn about
+ * it being uninitialized, so that warning is off for this section.
+ */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+__attribute__((target("avx512f")))
+static inline __m512d expAvx512(__m512d x)
+{
+	x = _mm512_min_pd(_mm512_set1_pd(EXP_MAX), _mm512_max_pd(_mm512_set1_pd(EXP_MIN), x));
+	__m512d n = _mm512_roundscale_pd(_mm512_mul_pd(x, _mm512_set1_pd(LOG2E)),
+			_MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	__m512d r = _mm512_fnmadd_pd(n, _mm512_set1_pd(LN2_HI), x);
+	r = _mm512_fnmadd_pd(n, _mm512_set1_pd(LN2_LO), r);
+	__m512d p = _mm512_set1_pd(EXP_TERMS[DOUBLE_DEGREE]);
+	for (int k = DOUBLE_DEGREE - 1; k >= 0; k--)
+		p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(EXP_TERMS[k]));
+	return _mm512_scalef_pd(p, n);
+}
+
+__attribute__((target("avx512f")))
+static inline __m512 expAvx512(__m512 x)
+{
+	x = _mm512_min_ps(_mm512_set1_ps(EXP_MAX_FLOAT), _mm512_max_ps(_mm512_set1_ps(EXP_MIN_FLOAT), x));
+	__m512 n = _mm512_roundscale_ps(_mm512_mul_ps(x, _mm512_set1_ps(LOG2E_FLOAT)),
+			_MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	__m512 r = _mm512_fnmadd_ps(n, _mm512_set1_ps(LN2_HI_FLOAT), x);
+	r = _mm512_fnmadd_ps(n, _mm512_set1_ps(LN2_LO_FLOAT), r);
+	__m512 p = _mm512_set1_ps((float) EXP_TERMS[FLOAT_DEGREE]);
+	for (int k = FLOAT_DEGREE - 1; k >= 0; k--)
+		p = _mm512_fmadd_ps(p, r, _mm512_set1_ps((float) EXP_TERMS[k]));
+	return _mm512_scalef_ps(p, n);
+}
+
+__attribute__((target("avx512f")))
+static inline __m512d expOrSigmoidAvx512(__m512d x, bool sigmoid)
+{
+	if (!sigmoid)
+		return expAvx512(x);
+	const __m512d one = _mm512_set1_pd(1);
+	return _mm512_div_pd(one, _mm512_add_pd(one, expAvx512(_mm512_sub_pd(_mm512_setzero_pd(), x))));
+}
+
+__attribute__((target("avx512f")))
+static inline __m512 expOrSigmoidAvx512(__m512 x, bool sigmoid)
+{
+	if (!sigmoid)
+		return expAvx512(x);
+	const __m512 one = _mm512_set1_ps(1);
+	return _mm512_div_ps(one, _mm512_add_ps(one, expAvx512(_mm512_sub_ps(_mm512_setzero_ps(), x))));
+}
+
+template<bool Sigmoid>
+__attribute__((target("avx512f")))
+static void expArrayAvx512(const double * x, double * y, std::size_t count)
+{
+	std::size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+		_mm512_storeu_pd(y + i, expOrSigmoidAvx512(_mm512_loadu_pd(x + i), Sigmoid));
+	if (i < count)
+	{
+		__mmask8 mask = (__mmask8) ((1u << (count - i)) - 1);
+		_mm512_mask_storeu_pd(y + i, mask, expOrSigmoidAvx512(_mm512_maskz_loadu_pd(mask, x + i), Sigmoid));
+	}
+}
+
+template<bool Sigmoid>
+__attribute__((target("avx512f")))
+static void expArrayAvx512(const float * x, float * y, std::size_t count)
+{
+	std::size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+		_mm512_storeu_ps(y + i, expOrSigmoidAvx512(_mm512_loadu_ps(x + i), Sigmoid));
+	if (i < count)
+	{
+		__mmask16 mask = (__mmask16) ((1u << (count - i)) - 1);
+		_mm512_mask_storeu_ps(y + i, mask, expOrSigmoidAvx512(_mm512_maskz_loadu_ps(mask, x + i), Sigmoid));
+	}
+}
+
+#pragma GCC diagnostic pop
+
+#endif
+
+//Runs the fast exp or sigmoid on the active kernel path.
+template<bool Sigmoid, typename T>
+static void expFast(const T * x, T * y, std::size_t count)
+{
+#ifdef ACTIVATION_X86
+	KernelPath path = kernelPath();
+	if (path == KERNEL_AVX512)
+		return expArrayAvx512<Sigmoid>(x, y, count);
+	if (path == KERNEL_AVX2)
+		return expArrayAvx2<Sigmoid>(x, y, count);
+#endif
+	expArrayScalar<Sigmoid>(x, y, count);
+}
+
+/*
+ * The table is built from std::exp in double the first time it is used.
+ * Values past either end are clamped to the end of the table.
+ */
+template<typename T>
+static const T * sigmoidTable()
+{
+	static const std::vector<T> table = []
+	{
+		std::vector<T> values(TABLE_SIZE + 1);
+		for (int i = 0; i < TABLE_SIZE; i++)
+			values[i] = (T) (1 / (1 + std::exp(-((double) i / TABLE_STEPS - TABLE_RANGE))));
+		//Lets the last entry interpolate without reading past the end.
+		values[TABLE_SIZE] = values[TABLE_SIZE - 1];
+		return values;
+	}();
+	return table.data();
+}
+
+template<typename T>
+static void sigmoidFromTable(const T * z, T * a, std::size_t count)
+{
+	const T * table = sigmoidTable<T>();
+	for (std::size_t i = 0; i < count; i++)
+	{
+		T position = (z[i] + TABLE_RANGE) * TABLE_STEPS;
+		//NaN would survive the clamp and can't be made an index, so it is passed through like the vector paths do.
+		if (std::isnan(position))
+		{
+			a[i] = position;
+			continue;
+		}
+		position = std::min(std::max(position, (T) 0), (T) (TABLE_SIZE - 1));
+		int index = (int) position;
+		T fraction = position - index;
+		a[i] = table[index] + fraction * (table[index + 1] - table[index]);
+	}
+}
+
+template<typename T>
+static void sigmoidImpl(const T * z, T * a, std::size_t count)
+{
+	switch (sigmoidMode())
+	{
+	case SIGMOID_EXACT:
+		for (std::size_t i = 0; i < count; i++)
+			a[i] = 1 / (1 + std::exp(-z[i]));
+		break;
+	case SIGMOID_TABLE:
+		sigmoidFromTable(z, a, count);
+		break;
+	default:
+		expFast<true>(z, a, count);
+	}
+}
+
+/*
+ * Row by row: the row's maximum is subtracted before exp, so every exp is at most 1 and the sum is
+ * at least 1. SIGMOID_EXACT uses std::exp here too; the other modes use the fast exp.
+ */
+template<typename T>
+static void softmaxImpl(const T * z, T * a, int rows, int cols)
+{
+	bool exact = sigmoidMode() == SIGMOID_EXACT;
+	for (int r = 0; r < rows; r++)
+	{
+		const T * in = z + (std::size_t) r * cols;
+		T * out = a + (std::size_t) r * cols;
+		T largest = *std::max_element(in, in + cols);
+		for (int c = 0; c < cols; c++)
+			out[c] = in[c] - largest;
+		if (exact)
+			for (int c = 0; c < cols; c++)
+				out[c] = std::exp(out[c]);
+		else
+			expFast<false>(out, out, cols);
+		T sum = 0;
+		for (int c = 0; c < cols; c++)
+			sum += out[c];
+		T scale = 1 / sum;
+		for (int c = 0; c < cols; c++)
+			out[c] *= scale;
+	}
+}
+
+template<typename T>
+static double logSumExpImpl(const T * z, int count)
+{
+	double largest = *std::max_element(z, z + count), sum = 0;
+	for (int i = 0; i < count; i++)
+		sum += std::exp(z[i] - largest);
+	return largest + std::log(sum);
+}
+
+void applySoftmax(const double * z, double * a, int rows, int cols)
+{
+	softmaxImpl(z, a, rows, cols);
+}
+
+void applySoftmax(const float * z, float * a, int rows, int cols)
+{
+	softmaxImpl(z, a, rows, cols);
+}
+
+double logSumExp(const double * z, int count)
+{
+	return logSumExpImpl(z, count);
+}
+
+double logSumExp(const float * z, int count)
+{
+	return logSumExpImpl(z, count);
+}
+
+void vectorExp(const double * x, double * y, std::size_t count)
+{
+	expFast<false>(x, y, count);
+}
+
+void vectorExp(const float * x, float * y, std::size_t count)
+{
+	expFast<false>(x, y, count);
+}
+
+void applySigmoid(const double * z, double * a, std::size_t count)
+{
+	sigmoidImpl(z, a, count);
+}
+
+void applySigmoid(const float * z, float * a, std::size_t count)
+{
+	sigmoidImpl(z, a, count);
+}
+
+void sigmoidDerivative(const double * a, double * derivative, std::size_t count)
+{
+	for (std::size_t i = 0; i < count; i++)
+		derivative[i] = a[i] * (1 - a[i]);
+}
+
+void sigmoidDerivative(const float * a, float * derivative, std::size_t count)
+{
+	for (std::size_t i = 0; i < count; i++)
+		derivative[i] = a[i] * (1 - a[i]);
+}
+
+void scaleBySigmoidDerivative(const double * a, double * error, std::size_t count)
+{
+	for (std::size_t i = 0; i < count; i++)
+		error[i] *= a[i] * (1 - a[i]);
+}
+
+void scaleBySigmoidDerivative(const float * a, float * error, std::size_t count)
+{
+	for (std::size_t i = 0; i < count; i++)
+		error[i] *= a[i] * (1 - a[i]);
+}
@@ -0,0 +1,156 @@
+/*
+ * Author: Shuhao Lai
+ * Date: 10/17/2026
+ * AllReduce.cpp
+ */
+
+#include <cmath>
+#include <cstring>
+#include "AllReduce.h"
+
+std::uint16_t toHalf(float value)
+{
+	std::uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	std::uint16_t sign = (bits >> 16) & 0x8000;
+	std::uint32_t magnitude = bits & 0x7fffffff;
+	if (magnitude > 0x7f800000)
+		return sign | 0x7e00; //NaN
+	//65520 and above round past the largest half, 65504, to infinity.
+	if (magnitude >= 0x477ff000)
+		return sign | 0x7c00;
+	//Below 2^-14 halves are subnormal, a whole number of 2^-24. Scaling by 2^24 is exact.
+	if (magnitude < 0x38800000)
+		return sign | (std::uint16_t) std::nearbyint(std::fabs(value) * 16777216.0f);
+	//Rebiases the exponent from 127 to 15 and keeps the top 10 bits of the mantissa. A carry out of
+	//the mantissa correctly moves to the next exponent.
+	std::uint32_t half = (magnitude - 0x38000000) >> 13;
+	std::uint32_t rest = magnitude & 0x1fff;
+	if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+		half++;
+	return sign | half;
+}
+
+float fromHalf(std::uint16_t half)
+{
+	std::uint32_t sign = (std::uint32_t) (half & 0x8000) << 16;
+	std::uint32_t exponent = (half >> 10) & 0x1f, mantissa = half & 0x3ff;
+	if (exponent == 0)
+	{
+		float magnitude = std::ldexp((float) mantissa, -24);
+		return sign ? -magnitude : magnitude;
+	}
+	std::uint32_t bits = sign | (exponent == 31 ? 0x7f800000 : (exponent + 112) << 23) | mantissa << 13;
+	float value;
+	std::memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+//First value of chunk of a ring of size ranks. Chunk size is one past the end.
+static std::size_t chunkStart(std::size_t count, int chunk, int size)
+{
+	return count * chunk / size;
+}
+
+//Writes count values to the wire buffer, as they are or as halves.
+template<typename T>
+static void pack(const T * values, std::size_t count, bool compress, unsigned char * wire)
+{
+	if (!compress)
+	{
+		std::memcpy(wire, values, count * sizeof(T));
+		return;
+	}
+	std::uint16_t * halves = reinterpret_cast<std::uint16_t *>(wire);
+	for (std::size_t i = 0; i < count; i++)
+		halves[i] = toHalf(values[i]);
+}
+
+//Adds the wire buffer's values to values, or replaces values with them.
+template<typename T>
+static void unpack(const unsigned char * wire, std::size_t count, bool compress, bool add, T * values)
+{
+	const T * raw = reinterpret_cast<const T *>(wire);
+	const std::uint16_t * halves = reinterpret_cast<const std::uint16_t *>(wire);
+	for (std::size_t i = 0; i < count; i++)
+	{
+		T value = compress ? fromHalf(halves[i]) : raw[i];
+		values[i] = add ? values[i] + value : value;
+	}
+}
+
+template<typename T>
+static bool allReduce(RingTransport & ring, T * values, std::size_t count, bool compress,
+		std::vector<unsigned char> & scratch)
+{
+	int size = ring.size(), rank = ring.rank();
+	if (size == 1)
+		return true;
+	std::size_t wireSize = compress ? sizeof(std::uint16_t) : sizeof(T);
+	std::size_t largest = (count + size - 1) / size;
+	scratch.resize(2 * largest * wireSize);
+	unsigned char * out = scratch.data(), * in = scratch.data() + largest * wireSize;
+
+	//Step s of a pass sends chunk rank + shift - s and receives the chunk before it.
+	for (int pass = 0; pass < 2; pass++)
+	{
+		bool reducing = pass == 0;
+		int shift = reducing ? 0 : 1;
+		for (int step = 0; step < size - 1; step++)
+		{
+			int send = ((rank + shift - step) % size + size) % size;
+			int receive = (send + size - 1) % size;
+			std::size_t sendBegin = chunkStart(count, send, size), sendCount = chunkStart(count, send + 1, size) - sendBegin;
+			std::size_t receiveBegin = chunkStart(count, receive, size);
+			std::size_t receiveCount = chunkStart(count, receive + 1, size) - receiveBegin;
+			pack(values + sendBegin, sendCount, compress, out);
+			if (!ring.exchange(out, sendCount * wireSize, in, receiveCount * wireSize))
+				return false;
+			unpack(in, receiveCount, compress, reducing, values + receiveBegin);
+		}
+		//This rank now holds chunk rank + 1 complete. The others will only ever see it rounded.
+		if (reducing && compress)
+		{
+			int complete = (rank + 1) % size;
+			std::size_t begin = chunkStart(count, complete, size);
+			for (std::size_t i = begin; i < chunkStart(count, complete + 1, size); i++)
+				values[i] = fromHalf(toHalf(values[i]));
+		}
+	}
+	return true;
+}
+
+bool ringAllReduce(RingTransport & ring, double * values, std::size_t count, bool compress,
+		std::vector<unsigned char> & scratch)
+{
+	return allReduce(ring, values, count, compress, scratch);
+}
+
+bool ringAllReduce(RingTransport & ring, float * values, std::size_t count, bool compress,
+		std::vector<unsigned char> & scratch)
+{
+	return allReduce(ring, values, count, compress, scratch);
+}
+
+//Rank 0 sends, every other rank receives and passes the values on unless its next rank is rank 0.
+template<typename T>
+static bool broadcast(RingTransport & ring, T * values, std::size_t count)
+{
+	int size = ring.size(), rank = ring.rank();
+	std::size_t bytes = count * sizeof(T);
+	if (size == 1)
+		return true;
+	if (rank != 0 && !ring.exchange(nullptr, 0, values, bytes))
+		return false;
+	return rank == size - 1 || ring.exchange(values, bytes, nullptr, 0);
+}
+
+bool ringBroadcast(RingTransport & ring, double * values, std::size_t count)
+{
+	return broadcast(ring, values, count);
+}
+
+bool ringBroadcast(RingTransport & ring, float * values, std::size_t count)
+{
+	return broadcast(ring, values, count);
+}
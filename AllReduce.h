@@ -0,0 +1,43 @@
+/*
+ * Author: Shuhao Lai
+ * Date: 10/17/2026
+ * AllReduce.h
+ */
+
+#ifndef ALLREDUCE_H_
+#define ALLREDUCE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "RingTransport.h"
+
+/*
+ * Ring all-reduce. Every rank passes count values and gets back their sum over every rank, the same
+ * on all of them. The values are cut into one chunk per rank. In the first size - 1 steps each rank
+ * sends a chunk to the next rank and adds the one it receives to its own, so every chunk picks up
+ * each rank's values on its way round and ends complete on one rank. In the next size - 1 steps the
+ * complete chunks go round once more, replacing the partial ones. Every rank sends and receives
+ * 2 (size - 1) / size of the values however many ranks there are.
+ *
+ * With compress the values travel as IEEE half precision, a quarter of the bytes of double. The
+ * partial sums are rounded at every hop, and every rank rounds its complete chunk too, so all ranks
+ * still end with identical values. Half precision tops out at 65504 and loses values below about
+ * 6e-8, which suits gradients but not arbitrary data.
+ *
+ * scratch holds the chunks in flight and is reused between calls. Returns false if the transport failed.
+ */
+bool ringAllReduce(RingTransport & ring, double * values, std::size_t count, bool compress,
+		std::vector<unsigned char> & scratch);
+bool ringAllReduce(RingTransport & ring, float * values, std::size_t count, bool compress,
+		std::vector<unsigned char> & scratch);
+
+//Copies rank 0's count values to every other rank, exactly. Returns false if the transport failed.
+bool ringBroadcast(RingTransport & ring, double * values, std::size_t count);
+bool ringBroadcast(RingTransport & ring, float * values, std::size_t count);
+
+//IEEE half precision conversions, rounding to the nearest half and ties to even.
+std::uint16_t toHalf(float value);
+float fromHalf(std::uint16_t half);
+
+#endif /* ALLREDUCE_H_ */
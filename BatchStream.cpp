@@ -0,0 +1,257 @@
+/*
+ * Author: Shuhao Lai
+ * Date: 10/17/2026
+ * BatchStream.cpp
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <fcntl.h>
+#include <unistd.h>
+#include "BatchStream.h"
+#include "Dataset.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+
+//Large reads keep the disk streaming while the producer decodes.
+static const std::size_t CSV_READ_BUFFER = 1 << 20;
+
+template<typename T>
+BasicBatchStream<T>::BasicBatchStream(const string & path, int miniBatchSize, int epochs, std::size_t shuffleWindow,
+		int buffers, int classes) :
+		open(false), binary(false), miniBatchSize(miniBatchSize), epochs(epochs),
+		windowSize(std::max<std::size_t>(shuffleWindow, 1)), pixelsPerImage(0), classes(classes), fd(-1), count(0), pixelOffset(0),
+		labelOffset(0), path(path), lineNumber(0), current(nullptr), stopping(false)
+{
+	if (Dataset::isDatasetFile(path))
+	{
+		DatasetHeader header;
+		fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0 || pread(fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header)
+				|| header.version != DATASET_VERSION)
+		{
+			cout << "Dataset file could not be read: " << path << endl;
+			return;
+		}
+		binary = true;
+		count = header.count;
+		pixelsPerImage = header.rows * header.cols;
+		pixelOffset = header.pixelOffset;
+		labelOffset = header.labelOffset;
+		//Every window is read front to back, even though the windows are visited out of order.
+		posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	}
+	else
+	{
+		std::ifstream first(path);
+		string line;
+		if (!first.is_open() || !getline(first, line))
+		{
+			cout << "file could not be opened" << endl;
+			return;
+		}
+		pixelsPerImage = std::count(line.begin(), line.end(), ',');
+		csvBuffer.resize(CSV_READ_BUFFER);
+	}
+
+	windowPixels.resize(windowSize * pixelsPerImage);
+	windowLabels.resize(windowSize);
+	slots.resize(std::max(buffers, 2));
+	for (Slot & slot : slots)
+	{
+		slot.inputs.resize(miniBatchSize, pixelsPerImage);
+		slot.labels.resize(miniBatchSize);
+		slot.rows = 0;
+		freeSlots.push_back(&slot);
+	}
+	open = true;
+	producer = std::thread(&BasicBatchStream::produce, this);
+}
+
+template<typename T>
+BasicBatchStream<T>::~BasicBatchStream()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+	changed.notify_all();
+	if (producer.joinable())
+		producer.join();
+	if (fd >= 0)
+		close(fd);
+}
+
+template<typename T>
+bool BasicBatchStream<T>::next(MatrixView<const T> & inputs, const int * & labels)
+{
+	std::unique_lock<std::mutex> guard(lock);
+	if (current != nullptr)
+	{
+		freeSlots.push_back(current);
+		current = nullptr;
+		changed.notify_all();
+	}
+	changed.wait(guard, [this] { return !readySlots.empty() || stopping; });
+	if (readySlots.empty())
+		return false;
+	Slot * slot = readySlots.front();
+	readySlots.pop_front();
+	if (slot->rows == 0)
+	{
+		freeSlots.push_back(slot);
+		changed.notify_all();
+		return false;
+	}
+	current = slot;
+	inputs = slot->inputs.view().rowRange(0, slot->rows);
+	labels = slot->labels.data();
+	return true;
+}
+
+template<typename T>
+typename BasicBatchStream<T>::Slot * BasicBatchStream<T>::takeFreeSlot()
+{
+	std::unique_lock<std::mutex> guard(lock);
+	changed.wait(guard, [this] { return !freeSlots.empty() || stopping; });
+	if (stopping)
+		return nullptr;
+	Slot * slot = freeSlots.front();
+	freeSlots.pop_front();
+	return slot;
+}
+
+template<typename T>
+void BasicBatchStream<T>::publish(Slot * slot)
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		readySlots.push_back(slot);
+	}
+	changed.notify_all();
+}
+
+template<typename T>
+bool BasicBatchStream<T>::readWindow(std::size_t window, std::size_t & kept)
+{
+	std::size_t first = window * windowSize;
+	std::size_t images = std::min(windowSize, count - first);
+	std::size_t pixelBytes = images * pixelsPerImage;
+	if (pread(fd, windowPixels.data(), pixelBytes, pixelOffset + first * pixelsPerImage) != (ssize_t) pixelBytes
+			|| pread(fd, windowLabels.data(), images, labelOffset + first) != (ssize_t) images)
+	{
+		cout << "Dataset file is truncated: " << path << endl;
+		return false;
+	}
+	kept = 0;
+	for (std::size_t i = 0; i < images; i++)
+	{
+		if (windowLabels[i] >= classes)
+		{
+			cout << "Dataset file has label " << (int) windowLabels[i] << " for image " << first + i << ": " << path
+					<< endl;
+			continue;
+		}
+		if (kept != i)
+		{
+			std::memmove(windowPixels.data() + kept * pixelsPerImage, windowPixels.data() + i * pixelsPerImage,
+					pixelsPerImage);
+			windowLabels[kept] = windowLabels[i];
+		}
+		++kept;
+	}
+	return true;
+}
+
+template<typename T>
+std::size_t BasicBatchStream<T>::readCsvWindow()
+{
+	std::size_t images = 0;
+	string line;
+	while (images < windowSize && getline(csv, line))
+	{
+		++lineNumber;
+		std::size_t length = line.size();
+		if (length > 0 && line[length - 1] == '\r')
+			--length;
+		if (length == 0)
+			continue;
+		string reason = Dataset::parseCsvRow(line.data(), line.data() + length, pixelsPerImage,
+				windowLabels[images], windowPixels.data() + images * pixelsPerImage, classes);
+		if (reason.empty())
+			++images;
+		else
+			cout << "Malformed row in " << path << ", line " << lineNumber << ": " << reason << endl;
+	}
+	return images;
+}
+
+template<typename T>
+void BasicBatchStream<T>::produce()
+{
+	unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
+	std::default_random_engine e(seed);
+	std::vector<std::size_t> windowOrder, imageOrder;
+	for (int epoch = 0; epoch < epochs; epoch++)
+	{
+		std::size_t windows = binary ? (count + windowSize - 1) / windowSize : 0;
+		windowOrder.resize(windows);
+		for (std::size_t w = 0; w < windows; w++)
+			windowOrder[w] = w;
+		std::shuffle(windowOrder.begin(), windowOrder.end(), e);
+		if (!binary)
+		{
+			csv.close();
+			csv.clear();
+			csv.rdbuf()->pubsetbuf(csvBuffer.data(), csvBuffer.size());
+			csv.open(path);
+			lineNumber = 0;
+		}
+
+		Slot * slot = nullptr;
+		for (std::size_t w = 0; binary ? w < windows : true; w++)
+		{
+			std::size_t images;
+			if (binary ? !readWindow(windowOrder[w], images) : (images = readCsvWindow()) == 0)
+				break;
+			imageOrder.resize(images);
+			for (std::size_t i = 0; i < images; i++)
+				imageOrder[i] = i;
+			std::shuffle(imageOrder.begin(), imageOrder.end(), e);
+			for (std::size_t i = 0; i < images; i++)
+			{
+				if (slot == nullptr)
+				{
+					if ((slot = takeFreeSlot()) == nullptr)
+						return;
+					slot->rows = 0;
+				}
+				const std::uint8_t * pixels = windowPixels.data() + imageOrder[i] * pixelsPerImage;
+				T * row = slot->inputs[slot->rows];
+				for (int p = 0; p < pixelsPerImage; p++)
+					row[p] = pixels[p] / (T) 255; //Dividing by 255 normalizes the data. CRUCIAL TO NORMALIZE TO PREVENT NAN.
+				slot->labels[slot->rows++] = windowLabels[imageOrder[i]];
+				if (slot->rows == miniBatchSize)
+				{
+					publish(slot);
+					slot = nullptr;
+				}
+			}
+		}
+		if (slot != nullptr)
+			publish(slot);
+
+		//An empty slot tells the consumer the epoch is over.
+		if ((slot = takeFreeSlot()) == nullptr)
+			return;
+		slot->rows = 0;
+		publish(slot);
+	}
+}
+
+template class BasicBatchStream<float>;
+template class BasicBatchStream<double>;
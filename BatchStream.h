@@ -0,0 +1,124 @@
+/*
+ * Author: Shuhao Lai
+ * Date: 10/17/2026
+ * BatchStream.h
+ */
+
+#ifndef BATCHSTREAM_H_
+#define BATCHSTREAM_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Dataset.h"
+#include "Matrix.h"
+
+/*
+ * Streams minibatches from a dataset file without loading the whole file. A producer thread reads
+ * and decodes images into a window, shuffles the window and copies it into a small ring of
+ * preallocated minibatch buffers while the trainer works on the previous ones. Memory use depends
+ * only on the window size and the number of buffers, never on the size of the file.
+ *
+ * Binary dataset files are read one window at a time in a random window order. CSV files can only
+ * be read front to back, so they are shuffled within each window only.
+ * T is the scalar type the batches are decoded into, matching the network being trained.
+ */
+template<typename T>
+class BasicBatchStream
+{
+public:
+	/*
+	 * path is a CSV file or a binary dataset. The stream produces epochs passes over the file.
+	 * shuffleWindow images are shuffled together and buffers minibatches are prepared ahead.
+	 * Images labeled classes or more are reported and left out.
+	 */
+	BasicBatchStream(const std::string & path, int miniBatchSize, int epochs, std::size_t shuffleWindow = 8192,
+			int buffers = 3, int classes = DATASET_CLASSES);
+
+	//Stops the producer, even in the middle of an epoch.
+	~BasicBatchStream();
+
+	BasicBatchStream(const BasicBatchStream &) = delete;
+	BasicBatchStream & operator=(const BasicBatchStream &) = delete;
+
+	bool isOpen() const
+	{
+		return open;
+	}
+
+	int imageSize() const
+	{
+		return pixelsPerImage;
+	}
+
+	/*
+	 * Waits for the next minibatch of the current epoch. Returns false once the epoch is done, after
+	 * which the next call starts the following epoch. The batch stays valid until the next call.
+	 */
+	bool next(MatrixView<const T> & inputs, const int * & labels);
+
+private:
+	//One preallocated minibatch. rows == 0 marks the end of an epoch.
+	struct Slot
+	{
+		Matrix<T> inputs;
+		std::vector<int> labels;
+		int rows;
+	};
+
+	void produce();
+
+	/*
+	 * Read a window of raw images and leave out the ones with bad labels. readWindow sets how many
+	 * were kept and returns false if the file is truncated. readCsvWindow returns how many it read,
+	 * 0 at the end of the file.
+	 */
+	bool readWindow(std::size_t window, std::size_t & kept);
+	std::size_t readCsvWindow();
+
+	//Hands a slot to the consumer, waiting for a free one first. Returns false when stopping.
+	Slot * takeFreeSlot();
+	void publish(Slot * slot);
+
+	bool open;
+	bool binary;
+	int miniBatchSize;
+	int epochs;
+	std::size_t windowSize;
+	int pixelsPerImage;
+	int classes;
+
+	//Binary files
+	int fd;
+	std::size_t count;
+	std::uint64_t pixelOffset;
+	std::uint64_t labelOffset;
+
+	//CSV files
+	std::string path;
+	std::ifstream csv;
+	std::vector<char> csvBuffer;
+	long lineNumber;
+
+	//The window being shuffled, in raw uint8 form.
+	std::vector<std::uint8_t> windowPixels;
+	std::vector<std::uint8_t> windowLabels;
+
+	std::vector<Slot> slots;
+	std::deque<Slot *> freeSlots;
+	std::deque<Slot *> readySlots;
+	Slot * current;
+	std::mutex lock;
+	std::condition_variable changed;
+	bool stopping;
+	std::thread producer;
+};
+
+typedef BasicBatchStream<double> BatchStream;
+
+#endif /* BATCHSTREAM_H_ */
@@ -0,0 +1,524 @@
+/*
+ * Author: Shuhao Lai
+ * Date: 10/17/2026
+ * Benchmark.cpp
+ *
+ * Times the hot paths of a 784-30-10 network on synthetic MNIST shaped data, so nothing has to be
+ * downloaded, and writes the results as JSON for tracking regressions between releases. All times
+ * are wall clock. Each benchmark reports the median of several samples.
+ * It also trains the network with each optimizer, and with each output layer, from the same starting
+ * weights, one epoch at a time, and reports the epochs and training time each needs to reach a target
+ * accuracy on held out images. Last it prunes a trained network to several sparsities, fine-tunes
+ * each for an epoch and reports the accuracy and the classify latency with dense and sparse weights.
+ *   benchmark [--quick] [--threads n] [--out results.json]
+ * Without --out the JSON goes to stdout. A readable summary always goes to stderr.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "DigitClassifier.h"
+#include "Kernels.h"
+#include "SyntheticData.h"
+
+//Samples taken of every benchmark. The median is reported.
+static const int SAMPLES = 5;
+
+//Batch used by the batched classify benchmark and minibatch used by the training ones.
+static const int CLASSIFY_BATCH = 256;
+static const int MINIBATCH = 20;
+
+struct BenchmarkResult
+{
+	std::string name;
+	long iterations;
+	double nsPerOp;
+	//Zero when the benchmark does not process images or the FLOP count is not meaningful.
+	double imagesPerOp;
+	double flopsPerOp;
+};
+
+/*
+ * The library reports progress on cout, which would end up in the middle of the JSON.
+ * Output is thrown away while one of these exists.
+ */
+class QuietCout
+{
+public:
+	QuietCout() : saved(std::cout.rdbuf(nullptr)) {}
+
+	~QuietCout()
+	{
+		std::cout.rdbuf(saved);
+		std::cout.clear();
+	}
+
+private:
+	std::streambuf * saved;
+};
+
+template<typename Op>
+static double secondsFor(long iterations, Op & op)
+{
+	auto begin = std::chrono::steady_clock::now();
+	for (long i = 0; i < iterations; i++)
+		op();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+/*
+ * Doubles the iteration count until one sample takes at least minSeconds, then takes SAMPLES
+ * samples of that many iterations.
+ */
+template<typename Op>
+static BenchmarkResult measure(const std::string & name, double imagesPerOp, double flopsPerOp, double minSeconds,
+		Op op)
+{
+	QuietCout quiet;
+	long iterations = 1;
+	while (secondsFor(iterations, op) < minSeconds)
+		iterations *= 2;
+	std::vector<double> samples;
+	for (int s = 0; s < SAMPLES; s++)
+		samples.push_back(secondsFor(iterations, op) * 1e9 / iterations);
+	std::sort(samples.begin(), samples.end());
+	return BenchmarkResult{ name, iterations, samples[SAMPLES / 2], imagesPerOp, flopsPerOp };
+}
+
+//Multiply adds of one image through every layer, counted as two FLOPs each.
+static double forwardFlops(const std::vector<int> & structure)
+{
+	double flops = 0;
+	for (std::size_t layer = 0; layer + 1 < structure.size(); layer++)
+		flops += 2.0 * structure[layer] * structure[layer + 1];
+	return flops;
+}
+
+/*
+ * Training one image is the forward pass, the errors sent back through every layer but the first
+ * and the weight gradients of every layer.
+ */
+static double trainingFlops(const std::vector<int> & structure)
+{
+	return 3 * forwardFlops(structure) - 2.0 * structure[0] * structure[1];
+}
+
+/*
+ * Test accuracy the optimizers and the output layers train towards, on images noisier than the other
+ * benchmarks use, where a 784-30-10 network levels off around 96-97%.
+ */
+static const double OPTIMIZER_TARGET = 90;
+static const double OUTPUT_LAYER_TARGET = 95;
+static const double ACCURACY_NOISE = 110;
+
+struct AccuracyResult
+{
+	OptimizerKind optimizer;
+	DigitClassifier::OutputLayer outputLayer;
+	double eta;
+	double target;
+	int epochs;
+	//Training time only. Evaluating after every epoch is not counted.
+	double seconds;
+	double accuracy;
+	bool reached;
+};
+
+/*
+ * Trains a copy of start with the given optimizer and output layer until it classifies target percent
+ * of tests correctly or maxEpochs epochs have passed.
+ */
+static AccuracyResult timeToAccuracy(const DigitClassifier & start, OptimizerKind kind,
+		DigitClassifier::OutputLayer outputLayer, double eta, double target, const Dataset & training,
+		const Dataset & tests, int maxEpochs, int threads)
+{
+	QuietCout quiet;
+	DigitClassifier network(start);
+	Optimizer optimizer;
+	optimizer.kind = kind;
+	network.setOptimizer(optimizer);
+	network.setOutputLayer(outputLayer);
+	AccuracyResult result{ kind, outputLayer, eta, target, 0, 0, 0, false };
+	while (!result.reached && result.epochs < maxEpochs)
+	{
+		auto begin = std::chrono::steady_clock::now();
+		network.SGD(training, 1, MINIBATCH, eta, threads);
+		result.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+		result.epochs++;
+		result.accuracy = network.evaluate(tests, threads).accuracy();
+		result.reached = result.accuracy >= target;
+	}
+	return result;
+}
+
+static const char * outputLayerName(DigitClassifier::OutputLayer layer)
+{
+	return layer == DigitClassifier::SOFTMAX_OUTPUT ? "softmaxCrossEntropy" : "sigmoidQuadratic";
+}
+
+//Fraction of each layer's weights pruned, from the trained network, by the pruning benchmarks.
+static const double SPARSITIES[] = { 0, 0.5, 0.7, 0.8, 0.9, 0.95 };
+
+struct PruningResult
+{
+	double sparsity;
+	double prunedAccuracy;
+	//After an epoch of SGD with the pruned weights held at zero.
+	double tunedAccuracy;
+	//Nanoseconds to classify one image and CLASSIFY_BATCH images.
+	double denseNs;
+	double sparseNs;
+	double denseBatchNs;
+	double sparseBatchNs;
+	//Whether the default densities pick sparse weights for every layer, for one image and for a batch.
+	bool sparseSingleByDefault;
+	bool sparseBatchByDefault;
+};
+
+/*
+ * Prunes the smallest weights into each neuron of a copy of trained until sparsity of every layer's
+ * weights are zero, fine-tunes it and times classify with every layer dense and every layer sparse.
+ */
+static PruningResult pruneAndMeasure(const DigitClassifier & trained, double sparsity, const Dataset & training,
+		const Dataset & tests, const Matrix<double> & batch, double minSeconds, int threads)
+{
+	DigitClassifier network(trained);
+	PruningResult result{ sparsity, 0, 0, 0, 0, 0, 0, true, true };
+	const std::vector<int> & structure = network.getStructure();
+	{
+		QuietCout quiet;
+		for (int layer = 0; layer + 1 < (int) structure.size(); layer++)
+			network.pruneTopK(structure[layer] - (int) (sparsity * structure[layer] + 0.5), layer);
+		result.prunedAccuracy = network.evaluate(tests, threads).accuracy();
+		network.SGD(training, 1, MINIBATCH, 3, threads);
+		result.tunedAccuracy = network.evaluate(tests, threads).accuracy();
+	}
+	for (int layer = 0; layer + 1 < (int) structure.size(); layer++)
+	{
+		result.sparseSingleByDefault = result.sparseSingleByDefault && network.isSparseLayer(layer, 1);
+		result.sparseBatchByDefault = result.sparseBatchByDefault && network.isSparseLayer(layer, batch.rows());
+	}
+
+	DigitClassifier::Workspace workspace;
+	std::vector<int> labels(batch.rows());
+	std::size_t next = 0;
+	auto single = [&]
+	{
+		int label;
+		network.classify(batch[next++ % batch.rows()], batch.cols(), workspace, label);
+	};
+	auto many = [&]
+	{
+		network.classifyMany(batch.view(), workspace, labels.data());
+	};
+	network.clearSparseLayers();
+	result.denseNs = measure("", 1, 0, minSeconds, single).nsPerOp;
+	result.denseBatchNs = measure("", batch.rows(), 0, minSeconds, many).nsPerOp;
+	network.updateSparseLayers(1, 1);
+	result.sparseNs = measure("", 1, 0, minSeconds, single).nsPerOp;
+	result.sparseBatchNs = measure("", batch.rows(), 0, minSeconds, many).nsPerOp;
+	return result;
+}
+
+//Writes results, which all share one target, as a JSON object.
+static void writeJson(std::ostream & out, const std::vector<AccuracyResult> & results)
+{
+	out << "{\"target\": " << (results.empty() ? 0 : results[0].target) << ", \"results\": [\n";
+	for (std::size_t i = 0; i < results.size(); i++)
+	{
+		const AccuracyResult & r = results[i];
+		out << "    {\"optimizer\": \"" << optimizerName(r.optimizer) << "\", \"outputLayer\": \""
+				<< outputLayerName(r.outputLayer) << "\", \"eta\": " << r.eta << ", \"epochs\": " << r.epochs
+				<< ", \"seconds\": " << r.seconds << ", \"accuracy\": " << r.accuracy << ", \"reached\": "
+				<< (r.reached ? "true" : "false") << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	out << "  ]}";
+}
+
+static void writeJson(std::ostream & out, const std::vector<PruningResult> & results)
+{
+	out << "[\n";
+	for (std::size_t i = 0; i < results.size(); i++)
+	{
+		const PruningResult & r = results[i];
+		out << "    {\"sparsity\": " << r.sparsity << ", \"prunedAccuracy\": " << r.prunedAccuracy
+				<< ", \"tunedAccuracy\": " << r.tunedAccuracy << ", \"denseNs\": " << r.denseNs << ", \"sparseNs\": "
+				<< r.sparseNs << ", \"denseBatchNs\": " << r.denseBatchNs << ", \"sparseBatchNs\": " << r.sparseBatchNs
+				<< ", \"sparseSingleByDefault\": " << (r.sparseSingleByDefault ? "true" : "false")
+				<< ", \"sparseBatchByDefault\": " << (r.sparseBatchByDefault ? "true" : "false") << "}"
+				<< (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	out << "  ]";
+}
+
+static void writeJson(std::ostream & out, const std::vector<BenchmarkResult> & results,
+		const std::vector<AccuracyResult> & optimizers, const std::vector<AccuracyResult> & outputLayers,
+		const std::vector<PruningResult> & pruning, const std::vector<int> & structure, int threads, std::size_t epochImages)
+{
+	char timestamp[32];
+	std::time_t now = std::time(nullptr);
+	std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+	out.precision(9);
+	out << "{\n  \"timestamp\": \"" << timestamp << "\",\n";
+	out << "  \"compiler\": \"" << __VERSION__ << "\",\n";
+	out << "  \"kernelPath\": \"" << kernelPathName(kernelPath()) << "\",\n";
+	out << "  \"threads\": " << threads << ",\n  \"structure\": [";
+	for (std::size_t i = 0; i < structure.size(); i++)
+		out << (i ? ", " : "") << structure[i];
+	out << "],\n  \"epochImages\": " << epochImages << ",\n  \"benchmarks\": [\n";
+	for (std::size_t i = 0; i < results.size(); i++)
+	{
+		const BenchmarkResult & r = results[i];
+		out << "    {\"name\": \"" << r.name << "\", \"iterations\": " << r.iterations << ", \"nsPerOp\": " << r.nsPerOp;
+		out << ", \"imagesPerSecond\": ";
+		if (r.imagesPerOp > 0)
+			out << r.imagesPerOp * 1e9 / r.nsPerOp;
+		else
+			out << "null";
+		out << ", \"gflops\": ";
+		if (r.flopsPerOp > 0)
+			out << r.flopsPerOp / r.nsPerOp;
+		else
+			out << "null";
+		out << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	out << "  ],\n  \"timeToAccuracy\": ";
+	writeJson(out, optimizers);
+	out << ",\n  \"outputLayers\": ";
+	writeJson(out, outputLayers);
+	out << ",\n  \"pruning\": ";
+	writeJson(out, pruning);
+	out << "\n}\n";
+}
+
+static void printSummary(std::ostream & out, const std::vector<BenchmarkResult> & results)
+{
+	char line[160];
+	std::snprintf(line, sizeof(line), "%-22s %14s %14s %10s", "benchmark", "ns/op", "images/s", "GFLOP/s");
+	out << line << std::endl;
+	for (const BenchmarkResult & r : results)
+	{
+		std::snprintf(line, sizeof(line), "%-22s %14.1f %14.0f %10.2f", r.name.c_str(), r.nsPerOp,
+				r.imagesPerOp > 0 ? r.imagesPerOp * 1e9 / r.nsPerOp : 0, r.flopsPerOp / r.nsPerOp);
+		out << line << std::endl;
+	}
+}
+
+static void printSummary(std::ostream & out, const std::vector<AccuracyResult> & results)
+{
+	char line[160];
+	std::snprintf(line, sizeof(line), "%-10s %-20s %8s %8s %10s %10s", "optimizer", "output layer", "eta", "epochs",
+			"seconds", "accuracy");
+	out << line << std::endl;
+	for (const AccuracyResult & r : results)
+	{
+		std::snprintf(line, sizeof(line), "%-10s %-20s %8g %8d %10.3f %9.2f%%%s", optimizerName(r.optimizer),
+				outputLayerName(r.outputLayer), r.eta, r.epochs, r.seconds, r.accuracy,
+				r.reached ? "" : " (target not reached)");
+		out << line << std::endl;
+	}
+}
+
+static void printSummary(std::ostream & out, const std::vector<PruningResult> & results)
+{
+	char line[160];
+	std::snprintf(line, sizeof(line), "%-9s %9s %9s %10s %10s %12s %12s", "sparsity", "pruned", "tuned", "dense ns",
+			"sparse ns", "dense/256", "sparse/256");
+	out << line << std::endl;
+	for (const PruningResult & r : results)
+	{
+		std::snprintf(line, sizeof(line), "%-9g %8.2f%% %8.2f%% %10.1f %10.1f %12.1f %12.1f%s", r.sparsity,
+				r.prunedAccuracy, r.tunedAccuracy, r.denseNs, r.sparseNs, r.denseBatchNs, r.sparseBatchNs,
+				r.sparseSingleByDefault ? " (sparse by default)"
+						: r.sparseBatchByDefault ? " (sparse batches by default)" : "");
+		out << line << std::endl;
+	}
+}
+
+int main(int argc, char ** argv)
+{
+	bool quick = false;
+	int threads = 1;
+	std::string outPath;
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--quick") == 0)
+			quick = true;
+		else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			threads = std::max(std::atoi(argv[++i]), 1);
+		else if (std::strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+			outPath = argv[++i];
+		else
+		{
+			std::cerr << "Usage: " << argv[0] << " [--quick] [--threads n] [--out results.json]" << std::endl;
+			return 1;
+		}
+	}
+	//--quick is a smoke test: small data and short samples.
+	double minSeconds = quick ? 0.002 : 0.05;
+	std::size_t epochImages = quick ? 1000 : 20000;
+	std::size_t parseImages = quick ? 200 : 2000;
+	std::size_t testImages = quick ? 200 : 5000;
+	int maxEpochs = quick ? 2 : 15;
+
+	char directory[] = "/tmp/digits-benchmark-XXXXXX";
+	if (mkdtemp(directory) == nullptr)
+	{
+		std::cerr << "Could not create a temporary directory" << std::endl;
+		return 1;
+	}
+	std::string dir = directory;
+	std::string csvPath = dir + "/train.csv", datasetPath = dir + "/train.dcds";
+	std::string noisyPath = dir + "/noisy.dcds", testPath = dir + "/test.dcds";
+	std::string textModel = dir + "/model.txt", binaryModel = dir + "/model.dcnn";
+
+	SyntheticImages synthetic = makeSyntheticImages(epochImages, 1);
+	SyntheticImages parsed = makeSyntheticImages(parseImages, 2);
+	std::vector<int> structure = { 784, 30, 10 };
+	std::srand(1);
+	DigitClassifier network(structure);
+	DigitClassifier start(network);
+	bool written = writeSyntheticDataset(datasetPath, synthetic) && writeSyntheticCsv(csvPath, parsed)
+			&& writeSyntheticDataset(noisyPath, makeSyntheticImages(epochImages, 3, ACCURACY_NOISE))
+			&& writeSyntheticDataset(testPath, makeSyntheticImages(testImages, 4, ACCURACY_NOISE))
+			&& network.save(binaryModel);
+	network.toString(textModel);
+	Dataset dataset = Dataset::load(datasetPath);
+	Dataset noisy = Dataset::load(noisyPath);
+	Dataset tests = Dataset::load(testPath);
+	if (!written || !dataset.isOpen() || !noisy.isOpen() || !tests.isOpen())
+	{
+		std::cerr << "Could not write the synthetic data to " << dir << std::endl;
+		return 1;
+	}
+
+	DigitClassifier::labeledImages images;
+	for (std::size_t i = 0; i < CLASSIFY_BATCH; i++)
+	{
+		std::vector<double> pixels(dataset.imageSize());
+		for (int p = 0; p < dataset.imageSize(); p++)
+			pixels[p] = dataset.pixels(i)[p] / 255.0;
+		images.push_back(std::make_pair(dataset.label(i), pixels));
+	}
+	Matrix<double> batch(CLASSIFY_BATCH, dataset.imageSize());
+	for (int r = 0; r < batch.rows(); r++)
+		std::copy(images[r].second.begin(), images[r].second.end(), batch[r]);
+	std::vector<int> labels(CLASSIFY_BATCH);
+	DigitClassifier::Workspace workspace;
+	DigitClassifier::TrainingWorkspace trainingWorkspace;
+	DigitClassifier::labeledImages mini(images.begin(), images.begin() + MINIBATCH);
+	std::vector<int> miniLabels(MINIBATCH);
+	for (int i = 0; i < MINIBATCH; i++)
+		miniLabels[i] = images[i].first;
+
+	double forward = forwardFlops(structure), training = trainingFlops(structure);
+	std::vector<BenchmarkResult> results;
+	std::size_t next = 0;
+	results.push_back(measure("feedForwardOnce", 1, 2.0 * structure[0] * structure[1], minSeconds, [&]
+	{
+		network.feedForwardOnce(images[next++ % CLASSIFY_BATCH].second, 1);
+	}));
+	results.push_back(measure("classify", 1, forward, minSeconds, [&]
+	{
+		network.classify(images[next++ % CLASSIFY_BATCH].second);
+	}));
+	results.push_back(measure("classifyWorkspace", 1, forward, minSeconds, [&]
+	{
+		int label;
+		network.classify(batch[next++ % CLASSIFY_BATCH], batch.cols(), workspace, label);
+	}));
+	results.push_back(measure("classifyMany256", CLASSIFY_BATCH, CLASSIFY_BATCH * forward, minSeconds, [&]
+	{
+		network.classifyMany(batch.view(), workspace, labels.data());
+	}));
+	//A tiny eta keeps the network from drifting far over millions of updates.
+	results.push_back(measure("updateSystem", MINIBATCH, MINIBATCH * training, minSeconds, [&]
+	{
+		network.updateSystem(mini, 1e-6);
+	}));
+	results.push_back(measure("updateSystemBatch", MINIBATCH, MINIBATCH * training, minSeconds, [&]
+	{
+		network.updateSystemBatch(batch.view().rowRange(0, MINIBATCH), miniLabels.data(), 1e-6, trainingWorkspace);
+	}));
+	results.push_back(measure("getImages", parseImages, 0, minSeconds, [&]
+	{
+		network.getImages(csvPath);
+	}));
+	results.push_back(measure("datasetFromCsv", parseImages, 0, minSeconds, [&]
+	{
+		Dataset::fromCsv(csvPath, threads);
+	}));
+	results.push_back(measure("readInText", 0, 0, minSeconds, [&]
+	{
+		DigitClassifier loaded(textModel);
+	}));
+	results.push_back(measure("readInBinary", 0, 0, minSeconds, [&]
+	{
+		DigitClassifier loaded(binaryModel);
+	}));
+	results.push_back(measure("epoch", epochImages, epochImages * training, minSeconds, [&]
+	{
+		network.SGD(dataset, 1, MINIBATCH, 3, threads);
+	}));
+
+	//Learning rates that did best in a short sweep on this network and data.
+	const DigitClassifier::OutputLayer SIGMOID = DigitClassifier::SIGMOID_OUTPUT;
+	const DigitClassifier::OutputLayer SOFTMAX = DigitClassifier::SOFTMAX_OUTPUT;
+	std::vector<AccuracyResult> optimizers, outputLayers;
+	optimizers.push_back(timeToAccuracy(start, OPTIMIZER_SGD, SIGMOID, 3, OPTIMIZER_TARGET, noisy, tests, maxEpochs,
+			threads));
+	optimizers.push_back(timeToAccuracy(start, OPTIMIZER_MOMENTUM, SIGMOID, 0.3, OPTIMIZER_TARGET, noisy, tests,
+			maxEpochs, threads));
+	optimizers.push_back(timeToAccuracy(start, OPTIMIZER_NESTEROV, SIGMOID, 0.3, OPTIMIZER_TARGET, noisy, tests,
+			maxEpochs, threads));
+	optimizers.push_back(timeToAccuracy(start, OPTIMIZER_ADAM, SIGMOID, 0.003, OPTIMIZER_TARGET, noisy, tests,
+			maxEpochs, threads));
+	//Plain SGD, so only the cost differs. The cross-entropy's gradient is larger, so it needs a smaller eta.
+	outputLayers.push_back(timeToAccuracy(start, OPTIMIZER_SGD, SIGMOID, 3, OUTPUT_LAYER_TARGET, noisy, tests,
+			maxEpochs, threads));
+	outputLayers.push_back(timeToAccuracy(start, OPTIMIZER_SGD, SOFTMAX, 0.3, OUTPUT_LAYER_TARGET, noisy, tests,
+			maxEpochs, threads));
+
+	//Every sparsity is pruned from the same trained weights.
+	DigitClassifier trained(start);
+	{
+		QuietCout quiet;
+		trained.SGD(noisy, quick ? 1 : 5, MINIBATCH, 3, threads);
+	}
+	std::vector<PruningResult> pruning;
+	for (double sparsity : SPARSITIES)
+		pruning.push_back(pruneAndMeasure(trained, sparsity, noisy, tests, batch, minSeconds, threads));
+
+	unlink(csvPath.c_str());
+	unlink(datasetPath.c_str());
+	unlink(noisyPath.c_str());
+	unlink(testPath.c_str());
+	unlink(textModel.c_str());
+	unlink(binaryModel.c_str());
+	rmdir(directory);
+
+	printSummary(std::cerr, results);
+	printSummary(std::cerr, optimizers);
+	printSummary(std::cerr, outputLayers);
+	printSummary(std::cerr, pruning);
+	if (outPath.empty())
+	{
+		writeJson(std::cout, results, optimizers, outputLayers, pruning, structure, threads, epochImages);
+		return 0;
+	}
+	std::ofstream out(outPath);
+	writeJson(out, results, optimizers, outputLayers, pruning, structure, threads, epochImages);
+	if (!out)
+	{
+		std::cerr << "Could not write " << outPath << std::endl;
+		return 1;
+	}
+	return 0;
+}
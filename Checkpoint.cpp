@@ -0,0 +1,174 @@
+/*
+ * Author: Shuhao Lai
+ * Date: 10/17/2026
+ * Checkpoint.cpp
+ */
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <unistd.h>
+#include "Checkpoint.h"
+#include "ModelFile.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+
+static std::atomic<bool> stopRequested(false);
+
+void requestTrainingStop()
+{
+	stopRequested.store(true, std::memory_order_relaxed);
+}
+
+bool takeTrainingStopRequest()
+{
+	return stopRequested.load(std::memory_order_relaxed) && stopRequested.exchange(false);
+}
+
+void clearTrainingStopRequest()
+{
+	stopRequested.store(false, std::memory_order_relaxed);
+}
+
+//Writes a section, a uint64 byte count then the bytes, and adds both to the checksum.
+static bool writeSection(std::FILE * out, const void * bytes, std::uint64_t size, std::uint64_t & hash)
+{
+	hash = fnv1a(bytes, size, fnv1a(&size, sizeof(size), hash));
+	return std::fwrite(&size, sizeof(size), 1, out) == 1 && (size == 0 || std::fwrite(bytes, size, 1, out) == 1);
+}
+
+bool writeCheckpoint(const string & path, const Checkpoint & checkpoint)
+{
+	string temporary = path + ".tmp";
+	std::FILE * out = std::fopen(temporary.c_str(), "wb");
+	if (out == nullptr)
+	{
+		cout << "Checkpoint could not be written: " << temporary << endl;
+		return false;
+	}
+
+	std::vector<std::int32_t> layers(checkpoint.structure.begin(), checkpoint.structure.end());
+	std::vector<std::int32_t> order(checkpoint.order.begin(), checkpoint.order.end());
+	CheckpointHeader header = checkpoint.header;
+	std::memcpy(header.magic, CHECKPOINT_MAGIC, 4);
+	header.version = CHECKPOINT_VERSION;
+	header.checksum = 0;
+
+	//The header goes first with no checksum, and again once the sections have been hashed.
+	std::uint64_t hash = fnv1a(nullptr, 0);
+	bool written = std::fwrite(&header, sizeof(header), 1, out) == 1
+			&& writeSection(out, layers.data(), layers.size() * sizeof(std::int32_t), hash)
+			&& writeSection(out, checkpoint.parameters.data(), checkpoint.parameters.size(), hash)
+			&& writeSection(out, order.data(), order.size() * sizeof(std::int32_t), hash)
+			&& writeSection(out, checkpoint.engine.data(), checkpoint.engine.size(), hash)
+			&& writeSection(out, checkpoint.datasetPath.data(), checkpoint.datasetPath.size(), hash)
+			&& writeSection(out, checkpoint.optimizerState.data(), checkpoint.optimizerState.size(), hash)
+			&& writeSection(out, &checkpoint.minibatches, sizeof(checkpoint.minibatches), hash);
+	header.checksum = hash;
+	written = written && std::fseek(out, 0, SEEK_SET) == 0 && std::fwrite(&header, sizeof(header), 1, out) == 1
+			&& std::fflush(out) == 0;
+	written = std::fclose(out) == 0 && written;
+	if (!written || !replaceFile(temporary, path))
+	{
+		cout << "Checkpoint could not be written: " << path << endl;
+		unlink(temporary.c_str());
+		return false;
+	}
+	return true;
+}
+
+//Reads a section written by writeSection into bytes, which is resized to fit.
+template<typename Bytes>
+static bool readSection(std::FILE * in, Bytes & bytes, std::uint64_t & hash)
+{
+	std::uint64_t size;
+	if (std::fread(&size, sizeof(size), 1, in) != 1 || size % sizeof(bytes[0]) != 0)
+		return false;
+	//Guards against resizing to a corrupt size larger than the file.
+	long here = std::ftell(in);
+	if (std::fseek(in, 0, SEEK_END) != 0 || (std::uint64_t) (std::ftell(in) - here) < size
+			|| std::fseek(in, here, SEEK_SET) != 0)
+		return false;
+	bytes.resize(size / sizeof(bytes[0]));
+	if (size != 0 && std::fread(bytes.data(), size, 1, in) != 1)
+		return false;
+	hash = fnv1a(bytes.data(), size, fnv1a(&size, sizeof(size), hash));
+	return true;
+}
+
+bool readCheckpoint(const string & path, Checkpoint & checkpoint)
+{
+	std::FILE * in = std::fopen(path.c_str(), "rb");
+	if (in == nullptr)
+	{
+		cout << "Checkpoint could not be opened: " << path << endl;
+		return false;
+	}
+	std::vector<std::int32_t> layers, order;
+	std::vector<std::int64_t> minibatches(1, 0);
+	std::uint64_t hash = fnv1a(nullptr, 0);
+	CheckpointHeader & header = checkpoint.header;
+	bool valid = std::fread(&header, sizeof(header), 1, in) == 1 && std::memcmp(header.magic, CHECKPOINT_MAGIC, 4) == 0
+			&& (header.version == 1 || header.version == CHECKPOINT_VERSION) && readSection(in, layers, hash)
+			&& readSection(in, checkpoint.parameters, hash) && readSection(in, order, hash)
+			&& readSection(in, checkpoint.engine, hash) && readSection(in, checkpoint.datasetPath, hash)
+			&& readSection(in, checkpoint.optimizerState, hash)
+			&& (header.version == 1 || (readSection(in, minibatches, hash) && minibatches.size() == 1))
+			&& hash == header.checksum;
+	std::fclose(in);
+	if (!valid)
+	{
+		cout << "Not a valid checkpoint: " << path << endl;
+		return false;
+	}
+	checkpoint.structure.assign(layers.begin(), layers.end());
+	checkpoint.order.assign(order.begin(), order.end());
+	checkpoint.minibatches = minibatches[0];
+	return true;
+}
+
+CheckpointWriter::CheckpointWriter(const string & path) :
+		filePath(path), spare(0), pending(false), writing(false), stopping(false)
+{
+	writer = std::thread(&CheckpointWriter::work, this);
+}
+
+CheckpointWriter::~CheckpointWriter()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+	changed.notify_all();
+	writer.join();
+}
+
+void CheckpointWriter::flush()
+{
+	std::unique_lock<std::mutex> guard(lock);
+	changed.wait(guard, [this] { return !pending && !writing; });
+}
+
+void CheckpointWriter::work()
+{
+	std::unique_lock<std::mutex> guard(lock);
+	while (true)
+	{
+		changed.wait(guard, [this] { return pending || stopping; });
+		if (!pending)
+			return;
+		//The spare becomes the buffer being written, and the one just written becomes the spare.
+		int current = spare;
+		spare = 1 - spare;
+		pending = false;
+		writing = true;
+		guard.unlock();
+		writeCheckpoint(filePath, buffers[current]);
+		guard.lock();
+		writing = false;
+		changed.notify_all();
+	}
+}
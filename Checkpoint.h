@@ -0,0 +1,143 @@
+/*
+ * Author: Shuhao Lai
+ * Date: 10/17/2026
+ * Checkpoint.h
+ */
+
+#ifndef CHECKPOINT_H_
+#define CHECKPOINT_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Checkpoint file, all integers little endian:
+ *   bytes 0-63   CheckpointHeader
+ *   64           seven sections, each a uint64 byte count followed by that many bytes:
+ *                  the structure, int32 per layer
+ *                  the parameters, laid out exactly like the network's, scalarSize bytes each
+ *                  the current epoch's shuffled image order, int32 per image
+ *                  the random engine's state as text
+ *                  the path of the dataset being trained on, empty if it was not loaded from a file
+ *                  the optimizer: its Optimizer settings as in memory, the int64 number of updates
+ *                  made and its optimizerBuffers state buffers, each laid out like the parameters
+ *                  the int64 number of minibatches trained since the run started, which minibatch
+ *                  checkpoints are counted in. Version 1 files end before this section.
+ * Files are written to a temporary name, synced and renamed over the old checkpoint, so a checkpoint
+ * on disk is always complete even if the process is killed while writing.
+ */
+struct CheckpointHeader
+{
+	char magic[4];
+	std::uint32_t version;
+	std::uint32_t scalarSize;
+	//Epoch in progress, counting from 0. Equal to epochs once the run is finished.
+	std::uint32_t epoch;
+	std::uint32_t epochs;
+	std::uint32_t miniBatchSize;
+	std::uint32_t threads;
+	std::uint16_t mode;
+	//0 for sigmoid outputs, 1 for softmax. Checkpoints from before softmax existed have 0 here.
+	std::uint16_t outputLayer;
+	//How often the run checkpoints, 0 meaning never.
+	std::uint32_t checkpointEpochs;
+	std::uint32_t checkpointMinibatches;
+	//Position in the image order of the next minibatch of the epoch in progress.
+	std::uint64_t nextImage;
+	double eta;
+	//FNV-1a hash of everything after the header.
+	std::uint64_t checksum;
+};
+
+static_assert(sizeof(CheckpointHeader) == 64, "CheckpointHeader must stay 64 bytes");
+
+const char CHECKPOINT_MAGIC[4] = { 'D', 'C', 'K', 'P' };
+const std::uint32_t CHECKPOINT_VERSION = 2;
+
+//Everything needed to continue a run of SGD.
+struct Checkpoint
+{
+	CheckpointHeader header;
+	std::vector<int> structure;
+	std::vector<unsigned char> parameters;
+	std::vector<int> order;
+	std::string engine;
+	std::string datasetPath;
+	std::vector<unsigned char> optimizerState;
+	std::int64_t minibatches;
+};
+
+//Writes checkpoint to path atomically. Returns false, leaving any old file in place, on failure.
+bool writeCheckpoint(const std::string & path, const Checkpoint & checkpoint);
+
+//Returns false, printing why, if path is not a complete checkpoint.
+bool readCheckpoint(const std::string & path, Checkpoint & checkpoint);
+
+/*
+ * Asks the run of SGD in progress to stop after its current minibatch, or its current epoch in
+ * HOGWILD mode, write a checkpoint if it has a checkpoint path and return. Only sets a flag, so it
+ * is safe to call from a signal handler.
+ */
+void requestTrainingStop();
+
+//True if a stop was requested, and clears the request. Used by the training loop.
+bool takeTrainingStopRequest();
+
+//Drops a request no run took, so that it cannot stop the next run. Called as every run returns.
+void clearTrainingStopRequest();
+
+/*
+ * Writes checkpoints to one path on a background thread, so training only waits for a copy in
+ * memory. There are two buffers: the one being written and a spare the next checkpoint is copied
+ * into. If checkpoints come faster than the disk takes them, a spare that has not been written yet
+ * is replaced by the newer one. The destructor writes whatever is pending before it returns.
+ */
+class CheckpointWriter
+{
+public:
+	explicit CheckpointWriter(const std::string & path);
+	~CheckpointWriter();
+
+	CheckpointWriter(const CheckpointWriter &) = delete;
+	CheckpointWriter & operator=(const CheckpointWriter &) = delete;
+
+	//Calls fill on the spare buffer, which keeps its memory between checkpoints, and queues it.
+	template<typename Fill>
+	void submit(Fill fill)
+	{
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			fill(buffers[spare]);
+			pending = true;
+		}
+		changed.notify_all();
+	}
+
+	//Waits until every submitted checkpoint is on disk.
+	void flush();
+
+	const std::string & path() const
+	{
+		return filePath;
+	}
+
+private:
+	void work();
+
+	std::string filePath;
+	Checkpoint buffers[2];
+	//Index of the buffer submit fills. The other one belongs to the writing thread.
+	int spare;
+	bool pending;
+	bool writing;
+	bool stopping;
+	std::mutex lock;
+	std::condition_variable changed;
+	std::thread writer;
+};
+
+#endif /* CHECKPOINT_H_ */
@@ -0,0 +1,32 @@
+/*
+ * Author: Shuhao Lai
+ * Date: 10/17/2026
+ * ConvertDataset.cpp
+ *
+ * Converts MNIST data into the binary dataset format once, so training and evaluation can map it
+ * instead of parsing text on every run.
+ *   ConvertDataset mnist_train.csv mnist_train.dcds
+ *   ConvertDataset train-images-idx3-ubyte train-labels-idx1-ubyte mnist_train.dcds
+ */
+#include <iostream>
+#include "Dataset.h"
+
+int main(int argc, char ** argv)
+{
+	bool converted;
+	if (argc == 3)
+		converted = Dataset::convertCsv(argv[1], argv[2]);
+	else if (argc == 4)
+		converted = Dataset::convertIdx(argv[1], argv[2], argv[3]);
+	else
+	{
+		std::cout << "Usage: " << argv[0] << " images.csv output.dcds" << std::endl;
+		std::cout << "       " << argv[0] << " images-idx3-ubyte labels-idx1-ubyte output.dcds" << std::endl;
+		return 1;
+	}
+	if (!converted)
+		return 1;
+	Dataset check(argc == 3 ? argv[2] : argv[3]);
+	std::cout << "Wrote " << check.size() << " images of " << check.imageSize() << " pixels" << std::endl;
+	return 0;
+}
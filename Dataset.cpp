@@ -0,0 +1,385 @@
+/*
+ * Author: Shuhao Lai
+ * Date: 10/17/2026
+ * Dataset.cpp
+ */
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <charconv>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Dataset.h"
+#include "ThreadPool.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+
+static std::uint64_t roundUp64(std::uint64_t bytes)
+{
+	return (bytes + 63) / 64 * 64;
+}
+
+Dataset::Dataset() :
+		open(false), mapping(nullptr), mappingSize(0), count(0), pixelsPerImage(0), pixelData(nullptr), labelData(nullptr)
+{
+}
+
+Dataset::Dataset(const string & path, int classes) : Dataset()
+{
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		cout << "Dataset file could not be opened: " << path << endl;
+		return;
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size < (off_t) sizeof(DatasetHeader))
+	{
+		cout << "Dataset file is too small: " << path << endl;
+		close(fd);
+		return;
+	}
+	void * mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mapped == MAP_FAILED)
+	{
+		cout << "Dataset file could not be mapped: " << path << endl;
+		return;
+	}
+
+	DatasetHeader header;
+	std::memcpy(&header, mapped, sizeof(header));
+	std::uint64_t pixelBytes = header.count * header.rows * header.cols;
+	if (std::memcmp(header.magic, DATASET_MAGIC, 4) != 0 || header.version != DATASET_VERSION
+			|| header.pixelOffset + pixelBytes > (std::uint64_t) info.st_size
+			|| header.labelOffset + header.count > (std::uint64_t) info.st_size)
+	{
+		cout << "Not a valid dataset file: " << path << endl;
+		munmap(mapped, info.st_size);
+		return;
+	}
+	//A mapped file can't leave rows out, so one bad label rejects the whole file.
+	const std::uint8_t * labels = static_cast<const std::uint8_t *>(mapped) + header.labelOffset;
+	const std::uint8_t * bad = std::find_if(labels, labels + header.count, [classes](std::uint8_t label)
+	{
+		return label >= classes;
+	});
+	if (bad != labels + header.count)
+	{
+		cout << "Dataset file has label " << (int) *bad << " for image " << bad - labels << " but only " << classes
+				<< " classes: " << path << endl;
+		munmap(mapped, info.st_size);
+		return;
+	}
+	//Training reads the images in shuffled order.
+	madvise(mapped, info.st_size, MADV_RANDOM);
+
+	open = true;
+	mapping = mapped;
+	mappingSize = info.st_size;
+	count = header.count;
+	pixelsPerImage = header.rows * header.cols;
+	pixelData = static_cast<const std::uint8_t *>(mapped) + header.pixelOffset;
+	labelData = static_cast<const std::uint8_t *>(mapped) + header.labelOffset;
+}
+
+Dataset::~Dataset()
+{
+	unmap();
+}
+
+Dataset::Dataset(Dataset && other) noexcept : Dataset()
+{
+	*this = std::move(other);
+}
+
+Dataset & Dataset::operator=(Dataset && other) noexcept
+{
+	if (this != &other)
+	{
+		unmap();
+		open = other.open;
+		mapping = other.mapping;
+		mappingSize = other.mappingSize;
+		count = other.count;
+		pixelsPerImage = other.pixelsPerImage;
+		pixelData = other.pixelData;
+		labelData = other.labelData;
+		//Moving a vector keeps its buffer, so pixelData and labelData stay valid.
+		ownedPixels = std::move(other.ownedPixels);
+		ownedLabels = std::move(other.ownedLabels);
+		rowErrors = std::move(other.rowErrors);
+		other.open = false;
+		other.mapping = nullptr;
+		other.mappingSize = 0;
+		other.count = 0;
+		other.pixelData = nullptr;
+		other.labelData = nullptr;
+	}
+	return *this;
+}
+
+void Dataset::unmap()
+{
+	if (mapping != nullptr)
+		munmap(mapping, mappingSize);
+	mapping = nullptr;
+}
+
+bool Dataset::isDatasetFile(const string & path)
+{
+	std::ifstream in(path, std::ios::binary);
+	char magic[4];
+	return in.read(magic, 4) && std::memcmp(magic, DATASET_MAGIC, 4) == 0;
+}
+
+bool Dataset::write(const string & path, std::size_t count, int rows, int cols, const std::uint8_t * pixels,
+		const std::uint8_t * labels)
+{
+	DatasetHeader header = DatasetHeader();
+	std::memcpy(header.magic, DATASET_MAGIC, 4);
+	header.version = DATASET_VERSION;
+	header.count = count;
+	header.rows = rows;
+	header.cols = cols;
+	header.pixelOffset = sizeof(DatasetHeader);
+	std::uint64_t pixelBytes = (std::uint64_t) count * rows * cols;
+	header.labelOffset = roundUp64(header.pixelOffset + pixelBytes);
+
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out.is_open())
+	{
+		cout << "Dataset file could not be written: " << path << endl;
+		return false;
+	}
+	static const char padding[64] = {};
+	out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+	out.write(reinterpret_cast<const char *>(pixels), pixelBytes);
+	out.write(padding, header.labelOffset - header.pixelOffset - pixelBytes);
+	out.write(reinterpret_cast<const char *>(labels), count);
+	return (bool) out;
+}
+
+//Pixels must be integers from 0 to 255 and labels from 0 to classes - 1.
+string Dataset::parseCsvRow(const char * p, const char * end, int imageSize, std::uint8_t & label,
+		std::uint8_t * pixels, int classes)
+{
+	for (int value = -1; value < imageSize; value++)
+	{
+		if (value >= 0)
+		{
+			if (p == end || *p != ',')
+				return "expected " + std::to_string(imageSize) + " pixels but found " + std::to_string(value);
+			++p;
+		}
+		unsigned number;
+		std::from_chars_result result = std::from_chars(p, end, number);
+		if (result.ec != std::errc() || number > 255)
+			return "value " + std::to_string(value + 2) + " is not an integer from 0 to 255";
+		p = result.ptr;
+		if (value < 0)
+			label = number;
+		else
+			pixels[value] = number;
+	}
+	if (p != end)
+		return "expected " + std::to_string(imageSize) + " pixels but found more";
+	if (label >= classes)
+		return "label " + std::to_string(label) + " is not from 0 to " + std::to_string(classes - 1);
+	return "";
+}
+
+//Returns the end of the line starting at p, not counting a trailing carriage return.
+static const char * lineEnd(const char * p, const char * end, const char * & next)
+{
+	const char * newline = static_cast<const char *>(std::memchr(p, '\n', end - p));
+	next = newline ? newline + 1 : end;
+	const char * last = newline ? newline : end;
+	if (last > p && last[-1] == '\r')
+		--last;
+	return last;
+}
+
+/*
+ * Three passes over the mapped file: count the lines of every chunk, which gives each chunk its first
+ * line number and first row, then parse every chunk into its rows of the preallocated buffers, and
+ * finally squeeze out the rows that were blank or malformed.
+ */
+Dataset Dataset::fromCsv(const string & path, int threads, int classes)
+{
+	Dataset data;
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		cout << "file could not be opened" << endl;
+		return data;
+	}
+	struct stat info;
+	fstat(fd, &info);
+	std::size_t size = info.st_size;
+	if (size == 0)
+	{
+		close(fd);
+		data.open = true;
+		return data;
+	}
+	void * mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapped == MAP_FAILED)
+	{
+		cout << "file could not be mapped" << endl;
+		return data;
+	}
+	madvise(mapped, size, MADV_SEQUENTIAL);
+	const char * text = static_cast<const char *>(mapped), * textEnd = text + size;
+
+	//The first line decides how many pixels every image has.
+	const char * next;
+	const char * firstEnd = lineEnd(text, textEnd, next);
+	int imageSize = std::count(text, firstEnd, ',');
+
+	if (threads <= 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	ThreadPool pool(threads);
+	int chunks = std::max<std::size_t>(1, std::min<std::size_t>(threads * 8, size / 4096));
+	vector<const char *> starts(chunks + 1, textEnd);
+	starts[0] = text;
+	for (int c = 1; c < chunks; c++)
+	{
+		const char * guess = std::max(starts[c - 1], text + size * c / chunks);
+		const char * newline = static_cast<const char *>(std::memchr(guess, '\n', textEnd - guess));
+		starts[c] = newline ? newline + 1 : textEnd;
+	}
+
+	vector<std::size_t> firstRow(chunks + 1, 0);
+	pool.run(chunks, [&](int c)
+	{
+		std::size_t lines = 0;
+		for (const char * p = starts[c]; p < starts[c + 1]; lines++)
+			lineEnd(p, starts[c + 1], p);
+		firstRow[c + 1] = lines;
+	});
+	for (int c = 0; c < chunks; c++)
+		firstRow[c + 1] += firstRow[c];
+
+	std::size_t rows = firstRow[chunks];
+	data.ownedPixels.resize(rows * imageSize);
+	data.ownedLabels.resize(rows);
+	vector<char> valid(rows, 0);
+	vector<vector<string>> chunkErrors(chunks);
+	pool.run(chunks, [&](int c)
+	{
+		std::size_t row = firstRow[c];
+		for (const char * p = starts[c]; p < starts[c + 1]; row++)
+		{
+			const char * begin = p;
+			const char * end = lineEnd(begin, starts[c + 1], p);
+			if (begin == end)
+				continue;
+			string reason = parseCsvRow(begin, end, imageSize, data.ownedLabels[row],
+					data.ownedPixels.data() + row * imageSize, classes);
+			if (reason.empty())
+				valid[row] = 1;
+			else
+				chunkErrors[c].push_back("line " + std::to_string(row + 1) + ": " + reason);
+		}
+	});
+	munmap(mapped, size);
+
+	std::size_t kept = 0;
+	for (std::size_t row = 0; row < rows; row++)
+		if (valid[row])
+		{
+			if (kept != row)
+			{
+				std::memmove(data.ownedPixels.data() + kept * imageSize, data.ownedPixels.data() + row * imageSize,
+						imageSize);
+				data.ownedLabels[kept] = data.ownedLabels[row];
+			}
+			++kept;
+		}
+	data.ownedPixels.resize(kept * imageSize);
+	data.ownedLabels.resize(kept);
+	for (const vector<string> & errors : chunkErrors)
+		for (const string & error : errors)
+		{
+			cout << "Malformed row in " << path << ", " << error << endl;
+			data.rowErrors.push_back(error);
+		}
+
+	data.open = true;
+	data.count = kept;
+	data.pixelsPerImage = imageSize;
+	data.pixelData = data.ownedPixels.data();
+	data.labelData = data.ownedLabels.data();
+	return data;
+}
+
+Dataset Dataset::load(const string & path, int classes)
+{
+	if (isDatasetFile(path))
+		return Dataset(path, classes);
+	return fromCsv(path, 0, classes);
+}
+
+bool Dataset::convertCsv(const string & csvPath, const string & outPath)
+{
+	Dataset data = fromCsv(csvPath);
+	if (!data.isOpen())
+		return false;
+	if (!data.errors().empty())
+	{
+		cout << data.errors().size() << " malformed rows, nothing was written" << endl;
+		return false;
+	}
+	//MNIST images are 28 x 28. Anything else is stored as a single row.
+	int rows = data.imageSize() == 784 ? 28 : 1, cols = data.imageSize() / rows;
+	return write(outPath, data.size(), rows, cols, data.pixelData, data.labelData);
+}
+
+static std::uint32_t readBigEndian(std::ifstream & in)
+{
+	unsigned char bytes[4] = {};
+	in.read(reinterpret_cast<char *>(bytes), 4);
+	return (std::uint32_t) bytes[0] << 24 | bytes[1] << 16 | bytes[2] << 8 | bytes[3];
+}
+
+bool Dataset::convertIdx(const string & imagesPath, const string & labelsPath, const string & outPath)
+{
+	std::ifstream images(imagesPath, std::ios::binary), labels(labelsPath, std::ios::binary);
+	if (!images.is_open() || !labels.is_open())
+	{
+		cout << "IDX files could not be opened" << endl;
+		return false;
+	}
+	//IDX magic numbers: 0x00000803 is a 3D array of unsigned bytes, 0x00000801 a 1D one.
+	if (readBigEndian(images) != 0x803 || readBigEndian(labels) != 0x801)
+	{
+		cout << "Not MNIST IDX files: " << imagesPath << ", " << labelsPath << endl;
+		return false;
+	}
+	std::uint32_t count = readBigEndian(images), rows = readBigEndian(images), cols = readBigEndian(images);
+	if (readBigEndian(labels) != count)
+	{
+		cout << "IDX image and label counts differ" << endl;
+		return false;
+	}
+	vector<std::uint8_t> pixels((std::size_t) count * rows * cols), labelBytes(count);
+	images.read(reinterpret_cast<char *>(pixels.data()), pixels.size());
+	labels.read(reinterpret_cast<char *>(labelBytes.data()), labelBytes.size());
+	if (!images || !labels)
+	{
+		cout << "IDX files are truncated" << endl;
+		return false;
+	}
+	return write(outPath, count, rows, cols, pixels.data(), labelBytes.data());
+}
@@ -0,0 +1,155 @@
+/*
+ * Author: Shuhao Lai
+ * Date: 10/17/2026
+ * Dataset.h
+ */
+
+#ifndef DATASET_H_
+#define DATASET_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * Binary dataset file, all integers little endian:
+ *   bytes 0-63    DatasetHeader
+ *   pixelOffset   count * rows * cols uint8 pixels, one image after another, row major
+ *   labelOffset   count uint8 labels
+ * Both blocks start on a 64 byte boundary. Pixels keep their raw 0-255 values.
+ */
+struct DatasetHeader
+{
+	char magic[4];
+	std::uint32_t version;
+	std::uint64_t count;
+	std::uint32_t rows;
+	std::uint32_t cols;
+	std::uint64_t pixelOffset;
+	std::uint64_t labelOffset;
+	std::uint8_t reserved[24];
+};
+
+static_assert(sizeof(DatasetHeader) == 64, "DatasetHeader must stay 64 bytes");
+
+const char DATASET_MAGIC[4] = { 'D', 'C', 'D', 'S' };
+const std::uint32_t DATASET_VERSION = 1;
+
+//Labels are digits unless a loader is told otherwise. Labels from the class count up are rejected.
+const int DATASET_CLASSES = 10;
+
+//One image inside a Dataset. pixels points straight into the dataset's memory.
+struct ImageView
+{
+	int label;
+	const std::uint8_t * pixels;
+	int size;
+};
+
+/*
+ * A read only set of images with contiguous uint8 pixels. Binary dataset files are memory mapped,
+ * so images are never copied and every process that maps the same file shares its pages through
+ * the page cache. CSV files are parsed in parallel into one buffer owned by the Dataset.
+ */
+class Dataset
+{
+public:
+	Dataset();
+
+	//Maps the binary dataset at path. Check isOpen() to see if it worked.
+	explicit Dataset(const std::string & path, int classes = DATASET_CLASSES);
+
+	~Dataset();
+
+	Dataset(Dataset && other) noexcept;
+	Dataset & operator=(Dataset && other) noexcept;
+	Dataset(const Dataset &) = delete;
+	Dataset & operator=(const Dataset &) = delete;
+
+	bool isOpen() const
+	{
+		return open;
+	}
+
+	std::size_t size() const
+	{
+		return count;
+	}
+
+	//Number of pixels in every image.
+	int imageSize() const
+	{
+		return pixelsPerImage;
+	}
+
+	int label(std::size_t i) const
+	{
+		return labelData[i];
+	}
+
+	const std::uint8_t * pixels(std::size_t i) const
+	{
+		return pixelData + i * pixelsPerImage;
+	}
+
+	ImageView operator[](std::size_t i) const
+	{
+		return ImageView{ label(i), pixels(i), pixelsPerImage };
+	}
+
+	//True if the file at path starts with the binary dataset magic number.
+	static bool isDatasetFile(const std::string & path);
+
+	/*
+	 * Parses a label,pixel,pixel,... CSV file such as mnist_train.csv. The file is mapped, split into
+	 * line aligned ranges and parsed by threads threads (0 means one per core) straight into the pixel
+	 * buffer. Malformed rows, including labels of classes or more, are reported with their line
+	 * numbers and left out.
+	 */
+	static Dataset fromCsv(const std::string & path, int threads = 0, int classes = DATASET_CLASSES);
+
+	//Loads either format, deciding by the magic number.
+	static Dataset load(const std::string & path, int classes = DATASET_CLASSES);
+
+	/*
+	 * Parses one CSV row in [begin, end), without its line ending, into label and imageSize pixels.
+	 * Returns an empty string on success and the reason the row is malformed otherwise.
+	 */
+	static std::string parseCsvRow(const char * begin, const char * end, int imageSize, std::uint8_t & label,
+			std::uint8_t * pixels, int classes = DATASET_CLASSES);
+
+	//Rows fromCsv found malformed, as "line N: reason".
+	const std::vector<std::string> & errors() const
+	{
+		return rowErrors;
+	}
+
+	//Writes count images and labels in the binary format. Returns false if the file could not be written.
+	static bool write(const std::string & path, std::size_t count, int rows, int cols, const std::uint8_t * pixels,
+			const std::uint8_t * labels);
+
+	//Converts a label,pixel,pixel,... CSV file such as mnist_train.csv.
+	static bool convertCsv(const std::string & csvPath, const std::string & outPath);
+
+	//Converts the original MNIST IDX image and label files.
+	static bool convertIdx(const std::string & imagesPath, const std::string & labelsPath, const std::string & outPath);
+
+private:
+	void unmap();
+
+	bool open;
+	void * mapping;
+	std::size_t mappingSize;
+	std::size_t count;
+	int pixelsPerImage;
+	const std::uint8_t * pixelData;
+	const std::uint8_t * labelData;
+
+	//Storage for datasets parsed from CSV. Empty when the dataset is mapped.
+	std::vector<std::uint8_t> ownedPixels;
+	std::vector<std::uint8_t> ownedLabels;
+	std::vector<std::string> rowErrors;
+};
+
+#endif /* DATASET_H_ */
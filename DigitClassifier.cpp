@@ -8,10 +8,22 @@
 #include <algorithm>
 #include <random>
 #include <sstream>
+#include <cstdio>
 #include <cstdlib>
 #include <ctime>
 #include <chrono>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <cstring>
+#include <numeric>
 #include "DigitClassifier.h"
+#include "Checkpoint.h"
+#include "AllReduce.h"
+#include "Kernels.h"
+#include "ThreadPool.h"
+#include "BatchStream.h"
+#include "Metrics.h"
 
 using std::ifstream;
 using std::string;
@@ -22,36 +34,190 @@ using std::endl;
 using std::pair;
 using std::make_pair;
 
-typedef vector<pair<int, vector<double>>> labeledImages;
-typedef vector<vector<double>> twoDArray;
+/*
+ * Lets the batch code below read labeledImages of either precision and memory mapped Datasets the same way.
+ */
+template<typename T>
+static int imageLabel(const vector<pair<int, vector<T>>> & images, std::size_t i)
+{
+	return images[i].first;
+}
+
+static int imageLabel(const Dataset & images, std::size_t i)
+{
+	return images.label(i);
+}
+
+template<typename T>
+static int imageSize(const vector<pair<int, vector<T>>> & images)
+{
+	return images.empty() ? 0 : images[0].second.size();
+}
 
-void DigitClassifier::evaluate(std::string path)
+static int imageSize(const Dataset & images)
 {
-	labeledImages images = getImages(path);
-	int good = 0, curTotal = 0;
-	for (const pair<double, vector<double>> & img : images)
+	return images.imageSize();
+}
+
+template<typename T>
+static void copyPixels(const vector<pair<int, vector<T>>> & images, std::size_t i, T * row)
+{
+	std::copy(images[i].second.begin(), images[i].second.end(), row);
+}
+
+template<typename T>
+static void copyPixels(const Dataset & images, std::size_t i, T * row)
+{
+	const std::uint8_t * pixels = images.pixels(i);
+	for (int p = 0; p < images.imageSize(); p++)
+		row[p] = pixels[p] / (T) 255; //Dividing by 255 normalizes the data. CRUCIAL TO NORMALIZE TO PREVENT NAN.
+}
+
+/*
+ * Copies count images into the rows of inputs and their labels into labels. The images are
+ * order[first] ... order[first + count - 1], or first ... first + count - 1 when order is null.
+ */
+template<typename Images, typename T>
+static void fillBatch(const Images & images, const int * order, std::size_t first, int count,
+		Matrix<T> & inputs, vector<int> & labels)
+{
+	int cols = imageSize(images);
+	if (inputs.rows() != count || inputs.cols() != cols)
+		inputs.resize(count, cols);
+	labels.resize(count);
+	for (int r = 0; r < count; r++)
 	{
-		int result = classify(img.second);
-		if (result == img.first)
-			++good;
-		++curTotal;
-		//cout << "Accuracy: " << good << "/" << curTotal << endl;
+		std::size_t image = order ? order[first + r] : first + r;
+		labels[r] = imageLabel(images, image);
+		copyPixels(images, image, inputs[r]);
 	}
-	cout << "Final Accuracy: " << ((double)good/curTotal * 100) << "%" << endl;
+}
 
+/*
+ * Adds the cost and the number of correct answers of a batch to the training loss metrics. outputs
+ * holds the output activations and zVals the z values they came from. The cost is quadratic for
+ * sigmoid outputs. For softmax outputs it is the cross-entropy, -log(a) of the right label, taken as
+ * logSumExp(z) - z so that a probability too small for T does not make it infinite.
+ */
+template<typename T>
+static void recordTrainingLoss(const Matrix<T> & zVals, const Matrix<T> & outputs, const int * labels, bool softmax)
+{
+	double loss = 0;
+	long correct = 0;
+	for (int img = 0; img < outputs.rows(); img++)
+	{
+		const T * row = outputs[img];
+		if (softmax)
+			loss += logSumExp(zVals[img], zVals.cols()) - zVals[img][labels[img]];
+		else
+			for (int neuron = 0; neuron < outputs.cols(); neuron++)
+			{
+				double difference = row[neuron] - (neuron == labels[img] ? 1 : 0);
+				loss += difference * difference / 2;
+			}
+		correct += std::max_element(row, row + outputs.cols()) - row == labels[img];
+	}
+	addTrainingLoss(loss, correct, outputs.rows());
+}
+
+/*
+ * Records and prints the telemetry of the epoch that started at begin, when trainingLoss() was before.
+ */
+static void finishEpoch(int epoch, std::chrono::steady_clock::time_point begin, const TrainingLoss & before)
+{
+	TrainingLoss after = trainingLoss();
+	EpochMetrics metrics;
+	metrics.epoch = epoch;
+	metrics.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	metrics.images = after.images - before.images;
+	metrics.imagesPerSecond = metrics.seconds > 0 ? metrics.images / metrics.seconds : 0;
+	metrics.loss = metrics.images ? (after.loss - before.loss) / metrics.images : 0;
+	metrics.accuracy = metrics.images ? 100.0 * (after.correct - before.correct) / metrics.images : 0;
+	recordEpoch(metrics);
+	cout << "Finished epoch " << epoch << ": " << metrics.seconds << " s, " << metrics.imagesPerSecond
+			<< " images/s, loss " << metrics.loss << ", training accuracy " << metrics.accuracy << "%" << endl;
+}
+
+template<typename T>
+EvaluationReport BasicDigitClassifier<T>::evaluate(std::string path, int threads)
+{
+	Dataset images = Dataset::load(path, structure.back());
+	if (!images.isOpen() || !fitsInputLayer(images.imageSize()))
+		return EvaluationReport(structure.back());
+	return evaluate(images, threads);
+}
+
+template<typename T>
+EvaluationReport BasicDigitClassifier<T>::evaluate(const labeledImages & images, int threads)
+{
+	return runEvaluate(images, threads);
+}
+
+template<typename T>
+EvaluationReport BasicDigitClassifier<T>::evaluate(const Dataset & images, int threads)
+{
+	return runEvaluate(images, threads);
+}
+
+//Images classified together by one forward pass during evaluation.
+static const int EVALUATION_BATCH = 256;
+
+template<typename T>
+template<typename Images>
+EvaluationReport BasicDigitClassifier<T>::runEvaluate(const Images & images, int threads)
+{
+	if (images.size() > 0 && !fitsInputLayer(imageSize(images)))
+		return EvaluationReport(structure.back());
+	auto begin = std::chrono::steady_clock::now();
+	ThreadPool pool(threads);
+	int shards = pool.size();
+	vector<EvaluationReport> shardReports(shards, EvaluationReport(structure.back()));
+	pool.run(shards, [&](int shard)
+	{
+		long first = (long) images.size() * shard / shards, last = (long) images.size() * (shard + 1) / shards;
+		Matrix<T> inputs;
+		vector<int> labels, results(EVALUATION_BATCH);
+		Workspace workspace;
+		for (long start = first; start < last; start += EVALUATION_BATCH)
+		{
+			SCOPED_TIMER(TIMER_EVALUATION);
+			auto batchBegin = std::chrono::steady_clock::now();
+			fillBatch(images, nullptr, start, std::min<long>(EVALUATION_BATCH, last - start), inputs, labels);
+			COUNT_EVENTS(COUNTER_IMAGES_EVALUATED, inputs.rows());
+			//A batch that could not be classified leaves results stale, so it is not recorded.
+			if (classifyMany(inputs.view(), workspace, results.data()) != INFERENCE_OK)
+				continue;
+			//Every image in a batch is charged an equal share of the batch's time.
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - batchBegin).count()
+					/ inputs.rows();
+			for (int img = 0; img < inputs.rows(); img++)
+				shardReports[shard].record(labels[img], results[img], seconds);
+		}
+	});
+
+	EvaluationReport report(structure.back());
+	for (const EvaluationReport & shardReport : shardReports)
+		report.merge(shardReport);
+	report.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	cout << "Final Accuracy: " << report.accuracy() << "%" << endl;
+	return report;
 }
 
 /*
  * Returns what the neural network classifies the image as.
  */
-int DigitClassifier::classify(std::vector<double> inputs)
+template<typename T>
+int BasicDigitClassifier<T>::classify(std::vector<T> inputs)
 {
 	if (structure[0] != (int) inputs.size())
 		cout
 				<< "Program will continue but training images' size and input image size are different."
 				<< endl;
-	for (int i = 1; i < (int) structure.size(); i++)
+	for (int i = 1; i < (int) structure.size() - 1; i++)
 		inputs = activations(feedForwardOnce(inputs, i));
+	vector<T> zVals = feedForwardOnce(inputs, structure.size() - 1);
+	inputs.resize(zVals.size());
+	activateOutputs(zVals.data(), inputs.data(), 1);
 	int iOfHighestAct = 0;
 	for (int i = 1; i < (int) inputs.size(); i++)
 		if (inputs[i] > inputs[iOfHighestAct])
@@ -59,55 +225,203 @@ int DigitClassifier::classify(std::vector<double> inputs)
 	return iOfHighestAct;
 }
 
-labeledImages DigitClassifier::getImages(const std::string & path)
+template<typename T>
+InferenceStatus BasicDigitClassifier<T>::classify(const T * inputs, int size, Workspace & workspace, int & label) const
 {
-	labeledImages images;
-	ifstream imagesPath(path);
-	if (imagesPath.is_open())
+	if (size != structure[0])
+		return INFERENCE_SIZE_MISMATCH;
+	return classifyMany(MatrixView<const T>(inputs, 1, size), workspace, &label);
+}
+
+template<typename T>
+InferenceStatus BasicDigitClassifier<T>::classify(const T * inputs, int size, Workspace & workspace, T * outputs) const
+{
+	if (size != structure[0])
+		return INFERENCE_SIZE_MISMATCH;
+	if (outputs == nullptr)
+		return INFERENCE_BAD_ARGUMENT;
+	return classifyMany(MatrixView<const T>(inputs, 1, size), workspace, MatrixView<T>(outputs, 1, structure.back()));
+}
+
+template<typename T>
+InferenceStatus BasicDigitClassifier<T>::classifyProbabilities(const T * inputs, int size, Workspace & workspace,
+		T * probabilities) const
+{
+	InferenceStatus status = classify(inputs, size, workspace, probabilities);
+	if (status != INFERENCE_OK || outputLayer == SOFTMAX_OUTPUT)
+		return status;
+	T sum = 0;
+	for (int i = 0; i < structure.back(); i++)
+		sum += probabilities[i];
+	for (int i = 0; i < structure.back(); i++)
+		probabilities[i] /= sum;
+	return status;
+}
+
+template<typename T>
+InferenceStatus BasicDigitClassifier<T>::classifyTopK(const T * inputs, int size, int k, Workspace & workspace,
+		int * labels, T * scores) const
+{
+	if (size != structure[0])
+		return INFERENCE_SIZE_MISMATCH;
+	return classifyManyTopK(MatrixView<const T>(inputs, 1, size), k, workspace, labels, scores);
+}
+
+template<typename T>
+InferenceStatus BasicDigitClassifier<T>::classifyMany(MatrixView<const T> inputs, Workspace & workspace,
+		int * labels) const
+{
+	if (inputs.cols() != structure[0])
+		return INFERENCE_SIZE_MISMATCH;
+	if (inputs.data() == nullptr || labels == nullptr)
+		return INFERENCE_BAD_ARGUMENT;
+	int outputs = structure.back();
+	for (int first = 0; first < inputs.rows(); first += Workspace::INFERENCE_BATCH)
 	{
-		string line;
-		while (getline(imagesPath, line))
-		{
-			stringstream oneImage(line);
-			int label;
-			double onePixel;
-			vector<double> pixels;
-			char dummy;
-			oneImage >> label;
-			oneImage >> dummy; //To consume the commas.
-			while (oneImage >> onePixel)
-			{
-				pixels.push_back(onePixel/255); //Dividing by 255 normalizes the data. CRUCIAL TO NORMALIZE TO PREVENT NAN.
-				oneImage >> dummy; //To consume the commas.
-			}
-			pair<int, vector<double>> oneFormattedImage = make_pair(label,
-					pixels);
-			images.push_back(oneFormattedImage);
-		}
-		cout << "All images extracted" << endl;
-		return images;
+		int count = std::min(Workspace::INFERENCE_BATCH, inputs.rows() - first);
+		const T * acts = forward(inputs.rowRange(first, count), workspace);
+		for (int img = 0; img < count; img++, acts += outputs)
+			labels[first + img] = std::max_element(acts, acts + outputs) - acts;
+	}
+	return INFERENCE_OK;
+}
+
+template<typename T>
+InferenceStatus BasicDigitClassifier<T>::classifyMany(MatrixView<const T> inputs, Workspace & workspace,
+		MatrixView<T> outputs) const
+{
+	if (inputs.cols() != structure[0] || outputs.rows() != inputs.rows() || outputs.cols() != structure.back())
+		return INFERENCE_SIZE_MISMATCH;
+	if (inputs.data() == nullptr || outputs.data() == nullptr)
+		return INFERENCE_BAD_ARGUMENT;
+	for (int first = 0; first < inputs.rows(); first += Workspace::INFERENCE_BATCH)
+	{
+		int count = std::min(Workspace::INFERENCE_BATCH, inputs.rows() - first);
+		const T * acts = forward(inputs.rowRange(first, count), workspace);
+		std::copy(acts, acts + (std::size_t) count * outputs.cols(), outputs[first]);
+	}
+	return INFERENCE_OK;
+}
+
+/*
+ * Insertion sorts the indices of the k largest values into labels, largest first.
+ * Ties keep the lower index first, so k = 1 agrees with classify.
+ */
+template<typename T>
+static void topK(const T * values, int count, int k, int * labels, T * scores)
+{
+	for (int i = 0; i < count; i++)
+	{
+		int filled = std::min(i, k);
+		if (filled == k && values[i] <= values[labels[k - 1]])
+			continue;
+		int pos = filled == k ? k - 1 : filled;
+		for (; pos > 0 && values[labels[pos - 1]] < values[i]; pos--)
+			labels[pos] = labels[pos - 1];
+		labels[pos] = i;
 	}
+	if (scores != nullptr)
+		for (int j = 0; j < k; j++)
+			scores[j] = values[labels[j]];
+}
+
+template<typename T>
+InferenceStatus BasicDigitClassifier<T>::classifyManyTopK(MatrixView<const T> inputs, int k, Workspace & workspace,
+		int * labels, T * scores) const
+{
+	int outputs = structure.back();
+	if (inputs.cols() != structure[0])
+		return INFERENCE_SIZE_MISMATCH;
+	if (inputs.data() == nullptr || labels == nullptr || k < 1 || k > outputs)
+		return INFERENCE_BAD_ARGUMENT;
+	for (int first = 0; first < inputs.rows(); first += Workspace::INFERENCE_BATCH)
+	{
+		int count = std::min(Workspace::INFERENCE_BATCH, inputs.rows() - first);
+		const T * acts = forward(inputs.rowRange(first, count), workspace);
+		for (int img = first; img < first + count; img++, acts += outputs)
+			topK(acts, outputs, k, labels + (std::size_t) img * k,
+					scores == nullptr ? nullptr : scores + (std::size_t) img * k);
+	}
+	return INFERENCE_OK;
+}
+
+template<typename T>
+void BasicDigitClassifier<T>::multiplyWeights(int layer, MatrixView<const T> inputs, MatrixView<T> z) const
+{
+	const T * layerBiases = biases(layer);
+	for (int img = 0; img < inputs.rows(); img++)
+		std::copy(layerBiases, layerBiases + structure[layer + 1], z[img]);
+	if (isSparseLayer(layer, inputs.rows()))
+		csrGemm(sparseLayers[layer].weights, inputs, z);
+	else if (inputs.rows() == 1)
+		gemv(NO_TRANSPOSE, 1, weights(layer), inputs.data(), 1, z.data());
 	else
+		gemm(NO_TRANSPOSE, TRANSPOSE, 1, inputs, weights(layer), 1, z);
+}
+
+/*
+ * Same math as feedForwardBatch, but the layers ping pong between the workspace's two buffers
+ * and only the activations are kept. A single image uses gemv, which skips gemm's packing, and
+ * sparse layers use their CSR weights.
+ */
+template<typename T>
+const T * BasicDigitClassifier<T>::forward(MatrixView<const T> inputs, Workspace & workspace) const
+{
+	int batch = inputs.rows();
+	int widest = *std::max_element(structure.begin() + 1, structure.end());
+	workspace.reserve((std::size_t) Workspace::INFERENCE_BATCH * widest);
+	MatrixView<const T> preActs = inputs;
+	for (int layer = 1; layer < (int) structure.size(); layer++)
 	{
-		cout << "file could not be opened" << endl;
+		MatrixView<T> acts(workspace.buffer(layer), batch, structure[layer]);
+		multiplyWeights(layer - 1, preActs, acts);
+		if (layer + 1 < (int) structure.size())
+			applySigmoid(acts.data(), acts.data(), acts.size());
+		else
+			activateOutputs(acts.data(), acts.data(), batch);
+		preActs = acts;
+	}
+	return preActs.data();
+}
+
+/*
+ * The CSV is parsed in parallel by Dataset::fromCsv. Training and evaluation use the Dataset
+ * directly; this only spreads it out into one vector per image for callers that want labeledImages.
+ */
+template<typename T>
+typename BasicDigitClassifier<T>::labeledImages BasicDigitClassifier<T>::getImages(const std::string & path)
+{
+	labeledImages images;
+	Dataset data = Dataset::fromCsv(path, 0, structure.back());
+	if (!data.isOpen())
 		return images;
+	images.reserve(data.size());
+	for (std::size_t i = 0; i < data.size(); i++)
+	{
+		vector<T> pixels(data.imageSize());
+		copyPixels(data, i, pixels.data());
+		images.push_back(make_pair(data.label(i), std::move(pixels)));
 	}
+	cout << "All images extracted" << endl;
+	return images;
 }
 
 /*
  * Randomly fills weights and biases in neural network
  */
-void DigitClassifier::fillSystemRandomly()
+template<typename T>
+void BasicDigitClassifier<T>::fillSystemRandomly()
 {
 	/*Seeds the random number generator.
 	 *Only needs to do it once because it starts the random number
 	 *"booklet" at a random page.
 	 */
 	std::srand(std::time(0));
+	allocateParameters();
 	for (int layer = 1; layer < (int) structure.size(); layer++)
 	{
-		vector<double> oneLayerOfBiases;
-		twoDArray oneLayerOfWeights;
+		MatrixView<T> oneLayerOfWeights = weights(layer - 1);
+		T * oneLayerOfBiases = biases(layer - 1);
 		int rows = structure[layer], cols = structure[layer - 1];
 		for (int r = 0; r < rows; r++)
 		{
@@ -120,23 +434,50 @@ void DigitClassifier::fillSystemRandomly()
 			 * 					 fan-out is the number of outputs.
 			 */
 			double ranBias = 0;
-			oneLayerOfBiases.push_back(ranBias);
-			vector<double> oneVecOfWeights;
+			oneLayerOfBiases[r] = ranBias;
+			T * oneVecOfWeights = oneLayerOfWeights[r];
 			for (int c = 0; c < cols; c++)
 			{
 				double r = 4*sqrt(6.0/(structure[0]+structure.back()));
 				//double r = 1/sqrt((double)structure[0]);
 				double ranWeight = r*(((double)rand()/RAND_MAX)*2 - 1);
-				oneVecOfWeights.push_back(ranWeight);
+				oneVecOfWeights[c] = ranWeight;
 			}
-			oneLayerOfWeights.push_back(oneVecOfWeights);
 		}
-		biases.push_back(oneLayerOfBiases);
-		weights.push_back(oneLayerOfWeights);
 	}
 }
 
-void DigitClassifier::shuffleImages(labeledImages & images)
+/*
+ * Lays out one block per layer: the weight matrix followed by the biases,
+ * each rounded up to a cache line so the next block is aligned too.
+ */
+template<typename T>
+std::size_t BasicDigitClassifier<T>::layoutParameters()
+{
+	weightOffsets.clear();
+	biasOffsets.clear();
+	std::size_t total = 0;
+	for (int layer = 1; layer < (int) structure.size(); layer++)
+	{
+		std::size_t rows = structure[layer], cols = structure[layer - 1];
+		weightOffsets.push_back(total);
+		total += alignedCount<T>(rows * cols);
+		biasOffsets.push_back(total);
+		total += alignedCount<T>(rows);
+	}
+	return total;
+}
+
+template<typename T>
+void BasicDigitClassifier<T>::allocateParameters()
+{
+	parameters.resize(layoutParameters());
+	pruneMask.resize(0);
+	sparseLayers.clear();
+}
+
+template<typename T>
+void BasicDigitClassifier<T>::shuffleImages(labeledImages & images)
 {
 	labeledImages shuffled;
 	unsigned int size = images.size();
@@ -144,7 +485,7 @@ void DigitClassifier::shuffleImages(labeledImages & images)
 	while (size != 0)
 	{
 		int ran = rand() % size;
-		pair<double, vector<double>> oneImage = images[ran];
+		pair<double, vector<T>> oneImage = images[ran];
 		shuffled.push_back(oneImage);
 		images.erase(images.begin() + ran);
 		--size;
@@ -152,7 +493,8 @@ void DigitClassifier::shuffleImages(labeledImages & images)
 	images = shuffled;
 }
 
-void DigitClassifier::shuffleImagesImproved(labeledImages & images)
+template<typename T>
+void BasicDigitClassifier<T>::shuffleImagesImproved(labeledImages & images)
 {
 	unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
     std::default_random_engine e(seed);
@@ -162,207 +504,1017 @@ void DigitClassifier::shuffleImagesImproved(labeledImages & images)
 /*
  * return z values, not activation.
  */
-vector<double> DigitClassifier::feedForwardOnce(const vector<double> & inputs,
+template<typename T>
+vector<T> BasicDigitClassifier<T>::feedForwardOnce(const vector<T> & inputs,
 		int layer)
 {
-	vector<double> zVals;
-	for (int neuron = 0; neuron < structure[layer]; neuron++)
-	{
-		double z = 0; //double z; is wrong because z value is conserved.
-		for (int w = 0; w < structure[layer - 1]; w++)
-			z += weights[layer - 1][neuron][w] * inputs[w];
-		z += biases[layer - 1][neuron];
-		zVals.push_back(z);
-	}
+	vector<T> zVals(structure[layer]);
+	multiplyWeights(layer - 1, MatrixView<const T>(inputs.data(), 1, inputs.size()),
+			MatrixView<T>(zVals.data(), 1, zVals.size()));
 	return zVals;
 }
 
-void DigitClassifier::SGD(labeledImages images, int epoch, int miniBatchSize,
-		double eta)
+template<typename T>
+void BasicDigitClassifier<T>::train(std::string path, int epoch, int miniBatchSize, double eta, int threads,
+		TrainingMode mode)
+{
+	Dataset images = Dataset::load(path, structure.back());
+	if (!images.isOpen() || !fitsInputLayer(images.imageSize()))
+		return;
+	TrainingRun run = startRun(images.size(), epoch, miniBatchSize, eta, threads, mode);
+	run.datasetPath = path;
+	runSGD(images, run);
+}
+
+template<typename T>
+void BasicDigitClassifier<T>::trainStreaming(std::string path, int epoch, int miniBatchSize, double eta, int threads,
+		std::size_t shuffleWindow)
 {
+	BasicBatchStream<T> stream(path, miniBatchSize, epoch, shuffleWindow, 3, structure.back());
+	if (!stream.isOpen() || !fitsInputLayer(stream.imageSize()))
+		return;
+	ThreadPool pool(threads);
+	vector<TrainingWorkspace> workspaces(pool.size());
+	MatrixView<const T> inputs;
+	const int * labels;
 	for (int i = 0; i < epoch; i++)
 	{
 		cout << "Starting epoch: " << (i+1) << endl;
-		shuffleImagesImproved(images);
-		int startOfMini = 0;
-		for (int i = 0; i < ceil((double) images.size() / miniBatchSize); i++)
+		auto epochBegin = std::chrono::steady_clock::now();
+		TrainingLoss before = metricsEnabled() ? trainingLoss() : TrainingLoss();
+		//The stream does not know its size up front, so the schedule moves once per epoch.
+		double epochEta = scheduledEta(optimizer, eta, i, epoch);
+		while (true)
 		{
-			labeledImages::iterator begin = images.begin() + startOfMini, end;
-			if (startOfMini + miniBatchSize > (int) images.size())
-				end = images.end();
+			{
+				SCOPED_TIMER(TIMER_DATA_LOADING);
+				if (!stream.next(inputs, labels))
+					break;
+			}
+			if (pool.size() > 1)
+				updateSystemParallel(inputs, labels, epochEta, pool, workspaces);
 			else
-				end = images.begin() + startOfMini + miniBatchSize;
-			startOfMini = startOfMini + miniBatchSize;
-			//Note that the copy constructor is [begin, end).
-			labeledImages mini(begin, end);
-			updateSystem(mini, eta);
+				updateSystemBatch(inputs, labels, epochEta, workspaces[0]);
 		}
+		if (metricsEnabled())
+			finishEpoch(i + 1, epochBegin, before);
 	}
+	if (isPruned())
+		updateSparseLayers(sparseSingleDensity, sparseBatchDensity);
+}
+
+template<typename T>
+void BasicDigitClassifier<T>::SGD(const labeledImages & images, int epoch, int miniBatchSize,
+		double eta, int threads, TrainingMode mode)
+{
+	TrainingRun run = startRun(images.size(), epoch, miniBatchSize, eta, threads, mode);
+	runSGD(images, run);
+}
+
+template<typename T>
+void BasicDigitClassifier<T>::SGD(const Dataset & images, int epoch, int miniBatchSize,
+		double eta, int threads, TrainingMode mode)
+{
+	if (!fitsInputLayer(images.imageSize()))
+		return;
+	TrainingRun run = startRun(images.size(), epoch, miniBatchSize, eta, threads, mode);
+	runSGD(images, run);
+}
+
+//Wider images would be multiplied past the end of the first layer's weights and narrower ones short of it.
+template<typename T>
+bool BasicDigitClassifier<T>::fitsInputLayer(int size) const
+{
+	if (size == structure[0])
+		return true;
+	cout << "Images have " << size << " pixels but the network takes " << structure[0] << endl;
+	return false;
+}
+
+template<typename T>
+typename BasicDigitClassifier<T>::TrainingRun BasicDigitClassifier<T>::startRun(std::size_t images, int epoch,
+		int miniBatchSize, double eta, int threads, TrainingMode mode)
+{
+	TrainingRun run;
+	run.epoch = 0;
+	run.epochs = epoch;
+	run.miniBatchSize = miniBatchSize;
+	run.eta = eta;
+	run.threads = threads;
+	run.mode = mode;
+	run.nextImage = 0;
+	run.minibatches = 0;
+	run.order.resize(images);
+	for (int i = 0; i < (int) run.order.size(); i++)
+		run.order[i] = i;
+	run.engine.seed(std::chrono::system_clock::now().time_since_epoch().count());
+	return run;
 }
 
-void DigitClassifier::updateSystem(labeledImages mini, double eta)
+template<typename T>
+void BasicDigitClassifier<T>::enableCheckpoints(const string & path, int everyEpochs, int everyMinibatches)
 {
-	vector<twoDArray> weightGradients;
-	//Filling weightGradients with zeros.
-	for (const twoDArray & layer : weights)
+	checkpointPath = path;
+	checkpointEpochs = std::max(everyEpochs, 0);
+	checkpointMinibatches = std::max(everyMinibatches, 0);
+}
+
+template<typename T>
+void BasicDigitClassifier<T>::disableCheckpoints()
+{
+	enableCheckpoints("", 0, 0);
+}
+
+template<typename T>
+bool BasicDigitClassifier<T>::resume(const string & path)
+{
+	TrainingRun run;
+	if (!restoreRun(path, run))
+		return false;
+	if (run.datasetPath.empty())
 	{
-		twoDArray oneLayer;
-		for (const vector<double> & vec : layer)
-		{
-			vector<double> zeros(vec.size(), 0);
-			oneLayer.push_back(zeros);
-		}
-		weightGradients.push_back(oneLayer);
+		cout << "Checkpoint was not made by train, so its images must be passed to resume: " << path << endl;
+		return false;
 	}
+	Dataset images = Dataset::load(run.datasetPath, structure.back());
+	if (!images.isOpen())
+		return false;
+	return resumeRun(path, images);
+}
+
+template<typename T>
+bool BasicDigitClassifier<T>::resume(const string & path, const labeledImages & images)
+{
+	return resumeRun(path, images);
+}
 
-	twoDArray biasGradients;
-	//Filling biasGradients with zeros.
-	for (const vector<double> & vec : biases)
+template<typename T>
+bool BasicDigitClassifier<T>::resume(const string & path, const Dataset & images)
+{
+	return resumeRun(path, images);
+}
+
+template<typename T>
+template<typename Images>
+bool BasicDigitClassifier<T>::resumeRun(const string & path, const Images & images)
+{
+	TrainingRun run;
+	if (!restoreRun(path, run))
+		return false;
+	if (run.order.size() != images.size())
 	{
-		vector<double> zeros(vec.size(), 0);
-		biasGradients.push_back(zeros);
+		cout << "Checkpoint was made for " << run.order.size() << " images, not " << images.size() << ": " << path
+				<< endl;
+		return false;
 	}
+	runSGD(images, run);
+	return true;
+}
 
-	for (pair<double, vector<double>> img : mini)
+template<typename T>
+bool BasicDigitClassifier<T>::restoreRun(const string & path, TrainingRun & run)
+{
+	Checkpoint checkpoint;
+	if (!readCheckpoint(path, checkpoint))
+		return false;
+	const CheckpointHeader & header = checkpoint.header;
+	if (header.scalarSize != sizeof(T))
+	{
+		cout << "Checkpoint was made in the other precision: " << path << endl;
+		return false;
+	}
+	vector<int> current = structure;
+	structure = checkpoint.structure;
+	std::size_t count = layoutParameters();
+	const vector<unsigned char> & saved = checkpoint.optimizerState;
+	Optimizer settings;
+	if (saved.size() >= sizeof(settings))
+		std::memcpy(&settings, saved.data(), sizeof(settings));
+	std::size_t stateBytes = optimizerBuffers(settings.kind) * count * sizeof(T);
+	bool optimizerFits = saved.empty() || (saved.size() >= sizeof(settings) && settings.kind >= OPTIMIZER_SGD
+			&& settings.kind <= OPTIMIZER_ADAM && saved.size() == sizeof(settings) + sizeof(std::int64_t) + stateBytes);
+	if (count * sizeof(T) != checkpoint.parameters.size() || header.nextImage > checkpoint.order.size()
+			|| !optimizerFits)
+	{
+		cout << "Checkpoint does not match its structure: " << path << endl;
+		structure = current;
+		layoutParameters();
+		return false;
+	}
+	allocateParameters();
+	std::memcpy(parameters.data(), checkpoint.parameters.data(), checkpoint.parameters.size());
+	//Checkpoints without an optimizer section were made by plain SGD.
+	optimizer = settings;
+	optimizerState.resize(stateBytes / sizeof(T));
+	optimizerSteps = 0;
+	if (!saved.empty())
 	{
-		//Note that the vector at index 0 contains the z values for layer 1.
-		twoDArray zVals;
-		vector<double> inputs = img.second;
-		for (int layer = 1; layer < (int) structure.size(); layer++)
+		std::int64_t steps;
+		std::memcpy(&steps, saved.data() + sizeof(settings), sizeof(steps));
+		optimizerSteps = steps;
+		if (stateBytes)
+			std::memcpy(optimizerState.data(), saved.data() + sizeof(settings) + sizeof(steps), stateBytes);
+	}
+
+	run.epoch = header.epoch;
+	run.epochs = header.epochs;
+	run.miniBatchSize = header.miniBatchSize;
+	run.eta = header.eta;
+	run.threads = header.threads;
+	run.mode = (TrainingMode) header.mode;
+	outputLayer = header.outputLayer == SOFTMAX_OUTPUT ? SOFTMAX_OUTPUT : SIGMOID_OUTPUT;
+	run.nextImage = header.nextImage;
+	run.minibatches = checkpoint.minibatches;
+	run.order = std::move(checkpoint.order);
+	std::istringstream engine(checkpoint.engine);
+	engine >> run.engine;
+	run.datasetPath = checkpoint.datasetPath;
+	if (checkpointPath.empty())
+		enableCheckpoints(path, header.checkpointEpochs, header.checkpointMinibatches);
+	return true;
+}
+
+template<typename T>
+void BasicDigitClassifier<T>::saveCheckpoint(CheckpointWriter & writer, const TrainingRun & run) const
+{
+	writer.submit([&](Checkpoint & checkpoint)
+	{
+		CheckpointHeader & header = checkpoint.header;
+		std::memset(&header, 0, sizeof(header));
+		header.scalarSize = sizeof(T);
+		header.epoch = run.epoch;
+		header.epochs = run.epochs;
+		header.miniBatchSize = run.miniBatchSize;
+		header.threads = run.threads;
+		header.mode = run.mode;
+		header.outputLayer = outputLayer;
+		header.checkpointEpochs = checkpointEpochs;
+		header.checkpointMinibatches = checkpointMinibatches;
+		header.nextImage = run.nextImage;
+		header.eta = run.eta;
+		checkpoint.structure = structure;
+		const unsigned char * bytes = reinterpret_cast<const unsigned char *>(parameters.data());
+		checkpoint.parameters.assign(bytes, bytes + parameters.size() * sizeof(T));
+		checkpoint.order = run.order;
+		std::ostringstream engine;
+		engine << run.engine;
+		checkpoint.engine = engine.str();
+		checkpoint.datasetPath = run.datasetPath;
+		checkpoint.minibatches = run.minibatches;
+		std::int64_t steps = optimizerSteps;
+		const unsigned char * settings = reinterpret_cast<const unsigned char *>(&optimizer);
+		const unsigned char * state = reinterpret_cast<const unsigned char *>(optimizerState.data());
+		checkpoint.optimizerState.assign(settings, settings + sizeof(optimizer));
+		checkpoint.optimizerState.insert(checkpoint.optimizerState.end(), reinterpret_cast<unsigned char *>(&steps),
+				reinterpret_cast<unsigned char *>(&steps + 1));
+		checkpoint.optimizerState.insert(checkpoint.optimizerState.end(), state,
+				state + optimizerState.size() * sizeof(T));
+	});
+}
+
+/*
+ * Only an index order is shuffled, so the images themselves are never copied or moved. An epoch is
+ * only shuffled when it starts, so a resumed run picks up the same order it stopped in.
+ */
+template<typename T>
+template<typename Images>
+void BasicDigitClassifier<T>::runSGD(const Images & images, TrainingRun & run)
+{
+	ThreadPool pool(run.threads);
+	//Made once, so only the first minibatch of the first epoch allocates.
+	vector<TrainingWorkspace> workspaces(pool.size());
+	for (TrainingWorkspace & workspace : workspaces)
+		workspace.reserve(structure, run.miniBatchSize);
+	std::unique_ptr<CheckpointWriter> writer;
+	if (!checkpointPath.empty())
+		writer.reset(new CheckpointWriter(checkpointPath));
+
+	bool stopped = false, saved = false;
+	while (run.epoch < run.epochs && !stopped)
+	{
+		if (run.nextImage == 0)
 		{
-			vector<double> zValsForOneLayer = feedForwardOnce(inputs, layer);
-			zVals.push_back(zValsForOneLayer);
-			inputs = activations(zValsForOneLayer);
+			cout << "Starting epoch: " << (run.epoch + 1) << endl;
+			std::shuffle(run.order.begin(), run.order.end(), run.engine);
 		}
-		vector<int> label;
-		for (int i = 0; i < structure[structure.size() - 1]; i++)
+		else
+			cout << "Resuming epoch " << (run.epoch + 1) << " at image " << run.nextImage << endl;
+		auto epochBegin = std::chrono::steady_clock::now();
+		TrainingLoss before = metricsEnabled() ? trainingLoss() : TrainingLoss();
+		//A minibatch checkpoint that falls on the end of the epoch is written as the next epoch's start.
+		bool due = false;
+		if (run.mode == HOGWILD)
 		{
-			if (i == img.first)
-				label.push_back(1);
-			else
-				label.push_back(0);
+			hogwildEpoch(images, run.order, run.miniBatchSize, scheduledEta(optimizer, run.eta, run.epoch, run.epochs),
+					pool, workspaces);
+			run.nextImage = run.order.size();
+			stopped = takeTrainingStopRequest();
 		}
+		while (run.nextImage < run.order.size() && !stopped)
+		{
+			double eta = scheduledEta(optimizer, run.eta, run.epoch + (double) run.nextImage / run.order.size(),
+					run.epochs);
+			run.nextImage += trainMinibatch(images, run.order, run.nextImage, run.miniBatchSize, eta, pool,
+					workspaces);
+			saved = false;
+			stopped = takeTrainingStopRequest();
+			run.minibatches++;
+			due = checkpointMinibatches > 0 && run.minibatches % checkpointMinibatches == 0;
+			if (writer && due && !stopped && run.nextImage < run.order.size())
+			{
+				saveCheckpoint(*writer, run);
+				saved = true;
+			}
+		}
+		if (run.nextImage < run.order.size())
+			break;
+		if (metricsEnabled())
+			finishEpoch(run.epoch + 1, epochBegin, before);
+		run.epoch++;
+		run.nextImage = 0;
+		saved = false;
+		if (writer && !stopped && (due || (checkpointEpochs > 0 && run.epoch % checkpointEpochs == 0)))
+		{
+			saveCheckpoint(*writer, run);
+			saved = true;
+		}
+	}
+	if (writer && !saved)
+		saveCheckpoint(*writer, run);
+	if (isPruned())
+		updateSparseLayers(sparseSingleDensity, sparseBatchDensity);
+	clearTrainingStopRequest();
+	if (stopped && run.epoch < run.epochs)
+		cout << "Training stopped in epoch " << (run.epoch + 1) << " at image " << run.nextImage << endl;
+}
 
-		vector<double> ErrorForLastLayer = lastLayerError(zVals.back(), label);
-
-		twoDArray totalErrors;
-		//Note that totalErrors stores matrix of error for neural network in reverse layers.
-		//totalError[0] return vector of errors from last layer.
-		totalErrors.push_back(ErrorForLastLayer);
+template<typename T>
+bool BasicDigitClassifier<T>::trainDistributed(const labeledImages & images, RingTransport & ring, int epoch,
+		int miniBatchSize, double eta, bool compress, const string & checkpointPath)
+{
+	return runDistributed(images, ring, epoch, miniBatchSize, eta, compress, checkpointPath);
+}
 
-		//first parameter; minus 1 b/c last layer is accounted for, minus 1 b/c indexes start at 0,
-		//and minus 1 b/c first layer in structure has no error and weights does not account for first layer.
-		backpropagate(structure.size() - 3, ErrorForLastLayer, zVals, totalErrors);
+template<typename T>
+bool BasicDigitClassifier<T>::trainDistributed(const Dataset & images, RingTransport & ring, int epoch,
+		int miniBatchSize, double eta, bool compress, const string & checkpointPath)
+{
+	return runDistributed(images, ring, epoch, miniBatchSize, eta, compress, checkpointPath);
+}
 
-		//adding to weightGradient
-		for (int layer = 0; layer < (int) weights.size(); layer++)
-			for (int neuron = 0; neuron < (int) weights[layer].size(); neuron++)
-				for (int preNeuron = 0; preNeuron < (int) weights[layer][neuron].size();
-						preNeuron++)
-				{
-					int totalErrorIndex = totalErrors.size() - 1 - layer;
-					double preAct;
-					if(layer == 0)
-						preAct = img.second[preNeuron];
-					else
-						preAct = sigmoid(zVals[layer-1][preNeuron]);
-					weightGradients[layer][neuron][preNeuron] += totalErrors[totalErrorIndex][neuron] * preAct;
-				}
+/*
+ * The gradients carry one extra value past the parameters, set to 1 by a rank that was asked to
+ * stop. The all-reduce adds it up with the gradients, so every rank sees the request after the
+ * same minibatch without a message of its own.
+ */
+template<typename T>
+template<typename Images>
+bool BasicDigitClassifier<T>::runDistributed(const Images & images, RingTransport & ring, int epoch,
+		int miniBatchSize, double eta, bool compress, const string & checkpointPath)
+{
+	int ranks = ring.size(), rank = ring.rank();
+	std::size_t shard = images.size() / ranks;
+	int localBatch = std::max(1, miniBatchSize / ranks);
+	vector<int> order(shard);
+	for (std::size_t i = 0; i < shard; i++)
+		order[i] = rank + i * ranks;
+	std::default_random_engine engine(std::chrono::system_clock::now().time_since_epoch().count() + rank);
+	TrainingWorkspace workspace;
+	workspace.reserve(structure, localBatch);
+	AlignedBuffer<T> & gradients = workspace.gradients;
+	gradients.resize(parameters.size() + 1);
+	T & stopFlag = gradients[parameters.size()];
+	vector<unsigned char> scratch;
+	if (!ringBroadcast(ring, parameters.data(), parameters.size()))
+		return false;
 
-		//adding to biasGradients
-		for (int layer = 0; layer < (int) biases.size(); layer++)
-			for (int neuron = 0; neuron < (int) biases[layer].size(); neuron++)
+	bool stopped = false;
+	for (int i = 0; i < epoch && !stopped; i++)
+	{
+		cout << "Rank " << rank << " starting epoch: " << (i+1) << endl;
+		auto epochBegin = std::chrono::steady_clock::now();
+		TrainingLoss before = metricsEnabled() ? trainingLoss() : TrainingLoss();
+		std::shuffle(order.begin(), order.end(), engine);
+		for (std::size_t first = 0; first < shard && !stopped; first += localBatch)
+		{
+			int rows = std::min<std::size_t>(localBatch, shard - first);
 			{
-				int totalErrorIndex = totalErrors.size() - 1 - layer;
-				biasGradients[layer][neuron] += totalErrors[totalErrorIndex][neuron];
+				SCOPED_TIMER(TIMER_DATA_LOADING);
+				fillBatch(images, order.data(), first, rows, workspace.inputs, workspace.labels);
 			}
+			gradients.zero();
+			addGradients(workspace.inputs.view(), workspace.labels.data(), gradients, workspace);
+			stopFlag = takeTrainingStopRequest() ? 1 : 0;
+			{
+				SCOPED_TIMER(TIMER_ALL_REDUCE);
+				if (!ringAllReduce(ring, gradients.data(), gradients.size(), compress, scratch))
+					return false;
+			}
+			stopped = stopFlag > 0;
+			applyGradients(gradients, scheduledEta(optimizer, eta, i + (double) first / shard, epoch), rows * ranks);
+		}
+		if (metricsEnabled())
+			finishEpoch(i + 1, epochBegin, before);
+		if (rank == 0 && !checkpointPath.empty())
+			toString(checkpointPath);
+	}
+	clearTrainingStopRequest();
+	if (stopped)
+		cout << "Rank " << rank << " stopped training" << endl;
+	if (isPruned())
+		updateSparseLayers(sparseSingleDensity, sparseBatchDensity);
+	return true;
+}
 
+template<typename T>
+template<typename Images>
+void BasicDigitClassifier<T>::synchronousEpoch(const Images & images, const vector<int> & order, int miniBatchSize,
+		double eta, ThreadPool & pool, vector<TrainingWorkspace> & workspaces)
+{
+	workspaces.resize(pool.size());
+	for (TrainingWorkspace & workspace : workspaces)
+		workspace.reserve(structure, miniBatchSize);
+	for (std::size_t startOfMini = 0; startOfMini < order.size(); startOfMini += miniBatchSize)
+		trainMinibatch(images, order, startOfMini, miniBatchSize, eta, pool, workspaces);
+}
+
+template<typename T>
+template<typename Images>
+int BasicDigitClassifier<T>::trainMinibatch(const Images & images, const vector<int> & order, std::size_t first,
+		int miniBatchSize, double eta, ThreadPool & pool, vector<TrainingWorkspace> & workspaces)
+{
+	//The minibatch lives in the first workspace. The threads only read it.
+	Matrix<T> & inputs = workspaces[0].inputs;
+	vector<int> & labels = workspaces[0].labels;
+	int size = std::min<std::size_t>(miniBatchSize, order.size() - first);
+	{
+		SCOPED_TIMER(TIMER_DATA_LOADING);
+		fillBatch(images, order.data(), first, size, inputs, labels);
 	}
+	if (pool.size() > 1)
+		updateSystemParallel(inputs.view(), labels.data(), eta, pool, workspaces);
+	else
+		updateSystemBatch(inputs.view(), labels.data(), eta, workspaces[0]);
+	return size;
+}
+
+/*
+ * Relaxed atomic access to a weight other threads may be writing at the same time.
+ * Hogwild tolerates lost updates, but plain loads and stores would be a data race.
+ * On x86 both compile to ordinary moves.
+ */
+template<typename T>
+static inline T relaxedLoad(const T * p)
+{
+	T value;
+	__atomic_load(p, &value, __ATOMIC_RELAXED);
+	return value;
+}
 
-	int size = mini.size();
-	//Applying the change to weights
-	for (int layer = 0; layer < (int) weights.size(); layer++)
-		for (int neuron = 0; neuron < (int) weights[layer].size(); neuron++)
-			for (int preNeuron = 0; preNeuron < (int) weights[layer][neuron].size();
-					preNeuron++)
+template<typename T>
+static inline void relaxedStore(T * p, T value)
+{
+	__atomic_store(p, &value, __ATOMIC_RELAXED);
+}
+
+/*
+ * For every minibatch each thread copies the shared weights into its workspace's snapshot, computes
+ * gradients on the snapshot and writes its update straight into the shared weights with no locking.
+ * Updates from different threads can interleave or overwrite each other; with small minibatches that
+ * costs far less than synchronizing.
+ */
+template<typename T>
+template<typename Images>
+void BasicDigitClassifier<T>::hogwildEpoch(const Images & images, const vector<int> & order, int miniBatchSize,
+		double eta, ThreadPool & pool, vector<TrainingWorkspace> & workspaces)
+{
+	workspaces.resize(pool.size());
+	std::atomic<std::size_t> next(0);
+	pool.run(pool.size(), [&](int t)
+	{
+		TrainingWorkspace & workspace = workspaces[t];
+		AlignedBuffer<T> & gradients = workspace.gradients;
+		workspace.reserve(structure, miniBatchSize);
+		workspace.snapshot.resize(parameters.size());
+		gradients.resize(parameters.size());
+		T * shared = parameters.data();
+		T * local = workspace.snapshot.data();
+		while (true)
+		{
+			std::size_t begin = next.fetch_add(miniBatchSize, std::memory_order_relaxed);
+			if (begin >= order.size())
+				break;
+			int rows = std::min<std::size_t>(miniBatchSize, order.size() - begin);
 			{
-				double normalizedWeight =
-						weightGradients[layer][neuron][preNeuron] / size;
-				weights[layer][neuron][preNeuron] -= eta * normalizedWeight;
+				SCOPED_TIMER(TIMER_DATA_LOADING);
+				fillBatch(images, order.data(), begin, rows, workspace.inputs, workspace.labels);
 			}
 
-	//Applying the change to biases
-	for (int layer = 0; layer < (int) biases.size(); layer++)
-		for (int neuron = 0; neuron < (int) biases[layer].size(); neuron++)
-		{
-			double normalizedBias = biasGradients[layer][neuron] / size;
-			biases[layer][neuron] -= eta * normalizedBias;
+			for (std::size_t i = 0; i < parameters.size(); i++)
+				local[i] = relaxedLoad(shared + i);
+			gradients.zero();
+			addGradients(local, workspace.inputs.view(), workspace.labels.data(), gradients, workspace);
 
+			SCOPED_TIMER(TIMER_APPLY_GRADIENTS);
+			T step = eta / rows;
+			const T * grads = gradients.data();
+			for (std::size_t i = 0; i < parameters.size(); i++)
+				relaxedStore(shared + i, relaxedLoad(shared + i) - step * grads[i]);
+			COUNT_EVENTS(COUNTER_MINIBATCHES, 1);
 		}
+	});
+	//Pruned weights drift between minibatches, but every epoch ends with them at zero.
+	if (pruneMask.size() != 0)
+		applyPruneMask();
+	sparseLayers.clear();
+}
+
+template<typename T>
+void BasicDigitClassifier<T>::updateSystem(labeledImages mini, double eta)
+{
+	Matrix<T> inputs;
+	vector<int> labels;
+	fillBatch(mini, nullptr, 0, mini.size(), inputs, labels);
+	updateSystemBatch(inputs.view(), labels.data(), eta);
+}
+
+template<typename T>
+void BasicDigitClassifier<T>::updateSystemBatch(MatrixView<const T> inputs, const int * labels, double eta)
+{
+	TrainingWorkspace workspace;
+	updateSystemBatch(inputs, labels, eta, workspace);
+}
+
+template<typename T>
+void BasicDigitClassifier<T>::updateSystemBatch(MatrixView<const T> inputs, const int * labels, double eta,
+		TrainingWorkspace & workspace)
+{
+	if (inputs.rows() == 0)
+		return;
+	//Gradients share the layout of parameters so the update is one pass over a flat array.
+	workspace.gradients.resize(parameters.size());
+	addGradients(inputs, labels, workspace.gradients, workspace);
+	applyGradients(workspace.gradients, eta, inputs.rows());
+}
+
+template<typename T>
+void BasicDigitClassifier<T>::updateSystemParallel(MatrixView<const T> inputs, const int * labels, double eta,
+		ThreadPool & pool, vector<TrainingWorkspace> & workspaces)
+{
+	int batch = inputs.rows(), threads = pool.size();
+	if (batch == 0)
+		return;
+	workspaces.resize(threads);
+
+	//Thread t always gets the same contiguous slice of the minibatch.
+	pool.run(threads, [&](int t)
+	{
+		AlignedBuffer<T> & gradients = workspaces[t].gradients;
+		gradients.resize(parameters.size());
+		int first = (long) batch * t / threads, last = (long) batch * (t + 1) / threads;
+		if (last > first)
+			addGradients(inputs.rowRange(first, last - first), labels + first, gradients, workspaces[t]);
+	});
+
+	/*
+	 * Pairwise tree: 0 += 1, 2 += 3, ... then 0 += 2, ... until everything is in buffer 0.
+	 * The flat buffer is cut into one cache line aligned chunk per thread, and every chunk is
+	 * reduced with the same tree, so the order of additions never depends on scheduling.
+	 */
+	std::size_t chunk = alignedCount<T>((parameters.size() + threads - 1) / threads);
+	pool.run(threads, [&](int t)
+	{
+		SCOPED_TIMER(TIMER_GRADIENTS);
+		std::size_t begin = std::min(parameters.size(), chunk * t);
+		std::size_t end = std::min(parameters.size(), begin + chunk);
+		for (int stride = 1; stride < threads; stride *= 2)
+			for (int into = 0; into + stride < threads; into += 2 * stride)
+			{
+				T * sum = workspaces[into].gradients.data();
+				const T * other = workspaces[into + stride].gradients.data();
+				for (std::size_t i = begin; i < end; i++)
+					sum[i] += other[i];
+			}
+	});
+	applyGradients(workspaces[0].gradients, eta, batch);
+}
+
+/*
+ * The whole batch goes forward as one matrix and the errors come back as matrices,
+ * so each layer's weight gradient is a single matrix-matrix product.
+ */
+template<typename T>
+void BasicDigitClassifier<T>::addGradients(MatrixView<const T> inputs, const int * labels,
+		AlignedBuffer<T> & gradients)
+{
+	TrainingWorkspace workspace;
+	addGradients(inputs, labels, gradients, workspace);
+}
+
+template<typename T>
+void BasicDigitClassifier<T>::addGradients(MatrixView<const T> inputs, const int * labels,
+		AlignedBuffer<T> & gradients, TrainingWorkspace & workspace) const
+{
+	addGradients(parameters.data(), inputs, labels, gradients, workspace);
+}
+
+template<typename T>
+void BasicDigitClassifier<T>::addGradients(const T * params, MatrixView<const T> inputs, const int * labels,
+		AlignedBuffer<T> & gradients, TrainingWorkspace & workspace) const
+{
+	const vector<Matrix<T>> & acts = workspace.acts, & errors = workspace.errors;
+	feedForwardBatch(params, inputs, workspace.zVals, workspace.acts);
+	if (metricsEnabled())
+		recordTrainingLoss(workspace.zVals.back(), acts.back(), labels, outputLayer == SOFTMAX_OUTPUT);
+	backpropagateBatch(params, acts, labels, workspace.errors);
+
+	SCOPED_TIMER(TIMER_GRADIENTS);
+	COUNT_EVENTS(COUNTER_IMAGES_TRAINED, inputs.rows());
+	for (int layer = 0; layer < (int) structure.size() - 1; layer++)
+	{
+		MatrixView<const T> preActs = layer == 0 ? inputs : acts[layer - 1].view();
+		const Matrix<T> & error = errors[layer];
+
+		//adding to weightGradient
+		gemm(TRANSPOSE, NO_TRANSPOSE, 1, error.view(), preActs, 1, weightsIn(gradients, layer));
+
+		//adding to biasGradients
+		T * biasGradients = gradients.data() + biasOffsets[layer];
+		for (int img = 0; img < error.rows(); img++)
+			for (int neuron = 0; neuron < error.cols(); neuron++)
+				biasGradients[neuron] += error[img][neuron];
+	}
+}
+
+template<typename T>
+void BasicDigitClassifier<T>::applyGradients(const AlignedBuffer<T> & gradients, double eta, int batchSize)
+{
+	SCOPED_TIMER(TIMER_APPLY_GRADIENTS);
+	COUNT_EVENTS(COUNTER_MINIBATCHES, 1);
+	//A new structure or kind of optimizer starts from fresh state. resize zeroes it.
+	std::size_t stateSize = optimizerBuffers(optimizer.kind) * parameters.size();
+	if (optimizerState.size() != stateSize)
+	{
+		optimizerState.resize(stateSize);
+		optimizerSteps = 0;
+	}
+	//Padding is zero in the gradients, so it stays zero in the parameters and the state.
+	applyOptimizer(optimizer, eta, batchSize, ++optimizerSteps, parameters.data(), gradients.data(),
+			optimizerState.data(), parameters.size());
+	if (pruneMask.size() != 0)
+		applyPruneMask();
+	sparseLayers.clear();
 
 	//cout << "weights and biases have been updated" << endl;
 }
 
-void DigitClassifier::backpropagate(int layer, const vector<double> & preError,
+template<typename T>
+void BasicDigitClassifier<T>::setOptimizer(const Optimizer & optimizer)
+{
+	if (optimizer.kind != this->optimizer.kind)
+		resetOptimizerState();
+	this->optimizer = optimizer;
+}
+
+template<typename T>
+void BasicDigitClassifier<T>::resetOptimizerState()
+{
+	optimizerState.resize(optimizerState.size());
+	optimizerSteps = 0;
+}
+
+template<typename T>
+void BasicDigitClassifier<T>::startPruning()
+{
+	if (pruneMask.size() == parameters.size())
+		return;
+	pruneMask.resize(parameters.size());
+	std::fill(pruneMask.data(), pruneMask.data() + pruneMask.size(), 1);
+}
+
+template<typename T>
+double BasicDigitClassifier<T>::finishPruning()
+{
+	updateSparseLayers(sparseSingleDensity, sparseBatchDensity);
+	std::size_t zeros = 0, total = 0;
+	for (int layer = 0; layer < (int) structure.size() - 1; layer++)
+	{
+		MatrixView<const T> w = weights(layer);
+		zeros += std::count(w.data(), w.data() + w.size(), (T) 0);
+		total += w.size();
+	}
+	return total ? (double) zeros / total : 0;
+}
+
+template<typename T>
+double BasicDigitClassifier<T>::pruneBelow(double threshold, int layer)
+{
+	startPruning();
+	int first = layer < 0 ? 0 : layer, last = layer < 0 ? (int) structure.size() - 2 : layer;
+	for (int l = first; l <= last; l++)
+	{
+		MatrixView<T> w = weights(l);
+		T * mask = pruneMask.data() + weightOffsets[l];
+		for (std::size_t i = 0; i < w.size(); i++)
+			if (std::abs(w.data()[i]) <= threshold)
+				w.data()[i] = mask[i] = 0;
+	}
+	return finishPruning();
+}
+
+template<typename T>
+double BasicDigitClassifier<T>::pruneTopK(int k, int layer)
+{
+	startPruning();
+	int first = layer < 0 ? 0 : layer, last = layer < 0 ? (int) structure.size() - 2 : layer;
+	vector<int> columns;
+	for (int l = first; l <= last; l++)
+	{
+		MatrixView<T> w = weights(l);
+		if (k >= w.cols())
+			continue;
+		columns.resize(w.cols());
+		for (int r = 0; r < w.rows(); r++)
+		{
+			T * row = w[r];
+			T * mask = pruneMask.data() + weightOffsets[l] + (std::size_t) r * w.cols();
+			std::iota(columns.begin(), columns.end(), 0);
+			//Puts the k largest magnitudes first, so everything after them is pruned.
+			std::nth_element(columns.begin(), columns.begin() + std::max(k, 0), columns.end(), [&](int a, int b)
+			{
+				return std::abs(row[a]) > std::abs(row[b]);
+			});
+			for (auto c = columns.begin() + std::max(k, 0); c != columns.end(); ++c)
+				row[*c] = mask[*c] = 0;
+		}
+	}
+	return finishPruning();
+}
+
+template<typename T>
+void BasicDigitClassifier<T>::clearPruneMask()
+{
+	pruneMask.resize(0);
+}
+
+template<typename T>
+void BasicDigitClassifier<T>::applyPruneMask()
+{
+	T * params = parameters.data();
+	const T * mask = pruneMask.data();
+	for (std::size_t i = 0; i < parameters.size(); i++)
+		params[i] *= mask[i];
+}
+
+template<typename T>
+double BasicDigitClassifier<T>::density(int layer) const
+{
+	MatrixView<const T> w = weights(layer);
+	return w.size() ? 1 - (double) std::count(w.data(), w.data() + w.size(), (T) 0) / w.size() : 0;
+}
+
+template<typename T>
+void BasicDigitClassifier<T>::updateSparseLayers(double maxSingleDensity, double maxBatchDensity)
+{
+	sparseSingleDensity = maxSingleDensity;
+	sparseBatchDensity = maxBatchDensity;
+	int layers = structure.size() - 1;
+	bool sparse = false;
+	sparseLayers.resize(layers);
+	for (int layer = 0; layer < layers; layer++)
+	{
+		SparseLayer & sparseLayer = sparseLayers[layer];
+		double fraction = density(layer);
+		sparseLayer.single = fraction <= maxSingleDensity;
+		sparseLayer.batch = fraction <= maxBatchDensity;
+		if (sparseLayer.single || sparseLayer.batch)
+		{
+			sparseLayer.weights.assign(weights(layer));
+			sparse = true;
+		}
+		else
+			sparseLayer.weights = CsrMatrix<T>();
+	}
+	if (!sparse)
+		sparseLayers.clear();
+}
+
+template<typename T>
+void BasicDigitClassifier<T>::feedForwardBatch(MatrixView<const T> inputs, vector<Matrix<T>> & zVals,
+		vector<Matrix<T>> & acts) const
+{
+	feedForwardBatch(parameters.data(), inputs, zVals, acts);
+}
+
+template<typename T>
+void BasicDigitClassifier<T>::feedForwardBatch(const T * params, MatrixView<const T> inputs,
+		vector<Matrix<T>> & zVals, vector<Matrix<T>> & acts) const
+{
+	SCOPED_TIMER(TIMER_FORWARD);
+	int batch = inputs.rows();
+	zVals.resize(structure.size() - 1);
+	acts.resize(structure.size() - 1);
+	for (int layer = 1; layer < (int) structure.size(); layer++)
+	{
+		Matrix<T> & z = zVals[layer - 1], & a = acts[layer - 1];
+		z.resize(batch, structure[layer]);
+		a.resize(batch, structure[layer]);
+		MatrixView<const T> preActs = layer == 1 ? inputs : acts[layer - 2].view();
+		gemm(NO_TRANSPOSE, TRANSPOSE, 1, preActs, weightsIn(params, layer - 1), 0, z.view());
+		const T * layerBiases = params + biasOffsets[layer - 1];
+		for (int img = 0; img < batch; img++)
+			for (int neuron = 0; neuron < structure[layer]; neuron++)
+				z[img][neuron] += layerBiases[neuron];
+		if (layer + 1 < (int) structure.size())
+			applySigmoid(z.data(), a.data(), z.size());
+		else
+			activateOutputs(z.data(), a.data(), batch);
+	}
+}
+
+/*
+ * Same math as lastLayerError and backpropagate, but every image in the batch is a row.
+ */
+template<typename T>
+void BasicDigitClassifier<T>::backpropagateBatch(const vector<Matrix<T>> & /*zVals*/,
+		const vector<Matrix<T>> & acts, const int * labels, vector<Matrix<T>> & errors)
+{
+	backpropagateBatch(parameters.data(), acts, labels, errors);
+}
+
+//The derivatives come from the activations, so the z values are not needed.
+template<typename T>
+void BasicDigitClassifier<T>::backpropagateBatch(const T * params, const vector<Matrix<T>> & acts,
+		const int * labels, vector<Matrix<T>> & errors) const
+{
+	SCOPED_TIMER(TIMER_BACKPROPAGATION);
+	int layers = structure.size() - 1;
+	int batch = acts[0].rows();
+	errors.resize(layers);
+
+	Matrix<T> & last = errors[layers - 1];
+	last.resize(batch, structure.back());
+	for (int img = 0; img < batch; img++)
+		for (int neuron = 0; neuron < structure.back(); neuron++)
+			last[img][neuron] = acts[layers - 1][img][neuron] - (neuron == labels[img] ? 1 : 0);
+	//The cross-entropy's derivative cancels the softmax's, leaving a - y.
+	if (outputLayer == SIGMOID_OUTPUT)
+		scaleBySigmoidDerivative(acts[layers - 1].data(), last.data(), last.size());
+
+	for (int layer = layers - 2; layer >= 0; layer--)
+	{
+		Matrix<T> & error = errors[layer];
+		error.resize(batch, structure[layer + 1]);
+		gemmSigmoidBackward(errors[layer + 1].view(), weightsIn(params, layer + 1), acts[layer].data(), error.view());
+	}
+}
+
+/*
+ * One pass per layer from layer down to 0. Every error vector is sized before the loop, so the only
+ * allocations are those vectors and one buffer for the activations.
+ */
+template<typename T>
+void BasicDigitClassifier<T>::backpropagate(int layer, const vector<T> & preError,
 		const twoDArray & zVals, twoDArray & totalErrors)
 {
-	if (layer == -1)
+	if (layer < 0)
 		return;
-	vector<double> sigmoidPrimeVector = sigmoidPrimeVec(zVals[layer]);
-	twoDArray transposedWeights = transpose(weights[layer + 1]);
-	twoDArray preErrorInTwoD;
-	preErrorInTwoD.push_back(preError);
-	preErrorInTwoD = transpose(preErrorInTwoD); //preError was a row vector before.
-	vector<double> weightsTimesError = transpose(
-			multiplyMatrices(transposedWeights, preErrorInTwoD))[0];
-	vector<double> error = hadamard(weightsTimesError, sigmoidPrimeVector);
-	totalErrors.push_back(error);
-	backpropagate(layer - 1, error, zVals, totalErrors);
-}
-
-vector<double> DigitClassifier::lastLayerError(vector<double> zVals,
+	//Taken before totalErrors grows, since preError may be one of its elements. The data does not move.
+	const T * nextError = preError.data();
+	std::size_t first = totalErrors.size();
+	totalErrors.resize(first + layer + 1);
+	vector<T> acts(*std::max_element(structure.begin() + 1, structure.begin() + layer + 2));
+	for (std::size_t i = first; layer >= 0; layer--, i++)
+	{
+		int neurons = structure[layer + 1];
+		applySigmoid(zVals[layer].data(), acts.data(), neurons);
+		vector<T> & error = totalErrors[i];
+		error.resize(neurons);
+		MatrixView<const T> next(nextError, 1, structure[layer + 2]);
+		MatrixView<T> row(error.data(), 1, neurons);
+		gemmSigmoidBackward(next, weightsIn(parameters.data(), layer + 1), acts.data(), row);
+		nextError = error.data();
+	}
+}
+
+template<typename T>
+vector<T> BasicDigitClassifier<T>::lastLayerError(vector<T> zVals,
 		vector<int> y)
 {
-	vector<double> acts = activations(zVals);
-	vector<double> gradRespectToAct;
+	vector<T> acts(zVals.size());
+	activateOutputs(zVals.data(), acts.data(), 1);
+	vector<T> error(acts.size());
 	for (int i = 0; i < (int) acts.size(); i++)
-		gradRespectToAct.push_back(acts[i] - y[i]);
-	vector<double> sigmoidPrimeVector = sigmoidPrimeVec(zVals);
-	return hadamard(gradRespectToAct, sigmoidPrimeVector);
+		error[i] = acts[i] - y[i];
+	//The derivative comes from the activations just computed rather than from z again.
+	if (outputLayer == SIGMOID_OUTPUT)
+		scaleBySigmoidDerivative(acts.data(), error.data(), error.size());
+	return error;
 }
 
-void DigitClassifier::toString(string path)
+template<typename T>
+void BasicDigitClassifier<T>::toString(string path)
 {
-	std::ofstream out(path);
+	string temporary = path + ".tmp";
+	std::ofstream out(temporary);
+	//Enough digits that reading the file back gives exactly the same doubles.
+	out.precision(std::numeric_limits<T>::max_digits10);
 	out << structure.size() << endl;
 	for (int i = 0; i < (int) structure.size(); i++)
 		out << structure[i] << " ";
 	out << endl;
 	out << "Biases" << endl;
-	out << biases.size() << endl;
-	for (const vector<double> & vec : biases)
+	out << structure.size() - 1 << endl;
+	for (int layer = 0; layer < (int) structure.size() - 1; layer++)
 	{
-		for (const double & bias : vec)
-			out << bias << " ";
+		const T * vec = biases(layer);
+		for (int i = 0; i < structure[layer + 1]; i++)
+			out << vec[i] << " ";
 		out << endl;
 	}
 
 	out << "Weights" << endl;
-	out << weights.size() << endl;
-	for (vector<vector<double>> twoD : weights)
+	out << structure.size() - 1 << endl;
+	for (int layer = 0; layer < (int) structure.size() - 1; layer++)
 	{
-		out << twoD.size() << endl;
-		for (const vector<double> vec : twoD)
+		MatrixView<const T> twoD = weights(layer);
+		out << twoD.rows() << endl;
+		for (int r = 0; r < twoD.rows(); r++)
 		{
-			for (const double & weights : vec)
-				out << weights << " ";
+			for (int c = 0; c < twoD.cols(); c++)
+				out << twoD[r][c] << " ";
 			out << endl;
 		}
 	}
+	//Left out for sigmoid outputs, so those files read the same as before softmax existed.
+	if (outputLayer == SOFTMAX_OUTPUT)
+		out << "Output softmax" << endl;
+	//Written aside and renamed over path, since this network's parameters may be mapped from path.
+	out.close();
+	if (!out || !replaceFile(temporary, path))
+	{
+		cout << "Model could not be written: " << path << endl;
+		std::remove(temporary.c_str());
+	}
 }
 
-void DigitClassifier::readIn(string path)
+/*
+ * Copies one line of a saved model into the parameters, complaining if it does not match the structure.
+ */
+template<typename T>
+static void copyRow(const vector<T> & values, T * row, int expected, const char * what)
 {
+	if ((int) values.size() != expected)
+		cout << "ReadIn found " << values.size() << " " << what << " where " << expected
+				<< " were expected." << endl;
+	std::copy(values.begin(), values.begin() + std::min((int) values.size(), expected), row);
+}
+
+template<typename T>
+bool BasicDigitClassifier<T>::save(string path) const
+{
+	return writeModelFile(path, structure, parameters.data(), parameters.size(), outputLayer);
+}
+
+template<typename T>
+void BasicDigitClassifier<T>::loadModel(const string & path)
+{
+	if (modelScalarSize(path) != sizeof(T))
+	{
+		if (modelScalarSize(path) == sizeof(float))
+			convertFrom(BasicDigitClassifier<float>(path));
+		else if (modelScalarSize(path) == sizeof(double))
+			convertFrom(BasicDigitClassifier<double>(path));
+		else
+			cout << "Not a valid model file: " << path << endl;
+		return;
+	}
+	ParameterStorage<T> mapped;
+	vector<int> layers;
+	if (!mapped.map(path, layers))
+		return;
+	outputLayer = modelOutputLayer(path) == SOFTMAX_OUTPUT ? SOFTMAX_OUTPUT : SIGMOID_OUTPUT;
+	structure = layers;
+	if (layoutParameters() != mapped.size())
+	{
+		cout << "Model file does not match its structure: " << path << endl;
+		structure.clear();
+		layoutParameters();
+		return;
+	}
+	parameters = std::move(mapped);
+}
+
+template<typename T>
+void BasicDigitClassifier<T>::readIn(string path)
+{
+	pruneMask.resize(0);
+	sparseLayers.clear();
+	if (isModelFile(path))
+	{
+		loadModel(path);
+		return;
+	}
 	ifstream in(path);
 	if (in.is_open())
 	{
@@ -378,6 +1530,7 @@ void DigitClassifier::readIn(string path)
 			structure.push_back((int) num);
 		}
 		getline(in, line); //consumes whitespace
+		allocateParameters();
 
 		//Fills biases
 		getline(in, line); //Reads header
@@ -386,7 +1539,7 @@ void DigitClassifier::readIn(string path)
 		for (int i = 0; i < size; i++)
 		{
 			getline(in, line);
-			biases.push_back(extractDoubles(line));
+			copyRow(extractDoubles(line), biases(i), structure[i + 1], "biases");
 		}
 
 		//Fills weights
@@ -397,16 +1550,20 @@ void DigitClassifier::readIn(string path)
 		getline(in, line); //consumes newline.
 		for (int i = 0; i < numOfMatrices; i++)
 		{
-			twoDArray twoD;
+			MatrixView<T> twoD = weights(i);
 			for (int ii = 0; ii < size; ii++)
 			{
 				getline(in, line);
-				twoD.push_back(extractDoubles(line));
+				copyRow(extractDoubles(line), twoD[ii], twoD.cols(), "weights");
 			}
-			weights.push_back(twoD);
 			in >> size;
 			getline(in, line); //to consume newline.
 		}
+
+		//After the last matrix the read of the next size stops at the optional output line, if any.
+		in.clear();
+		string word, name;
+		outputLayer = in >> word >> name && word == "Output" && name == "softmax" ? SOFTMAX_OUTPUT : SIGMOID_OUTPUT;
 	}
 	else
 	{
@@ -414,22 +1571,25 @@ void DigitClassifier::readIn(string path)
 	}
 }
 
-vector<double> DigitClassifier::extractDoubles(string line)
+template<typename T>
+vector<T> BasicDigitClassifier<T>::extractDoubles(string line)
 {
-	vector<double> nums;
+	vector<T> nums;
 	stringstream ss(line);
+	//Read as double so values a float cannot represent round instead of failing.
 	double oneDouble;
 	while (ss >> oneDouble)
 		nums.push_back(oneDouble);
 	return nums;
 }
 
-twoDArray DigitClassifier::transpose(twoDArray twoD)
+template<typename T>
+typename BasicDigitClassifier<T>::twoDArray BasicDigitClassifier<T>::transpose(twoDArray twoD)
 {
 	twoDArray transposed;
 	for (int c = 0; c < (int) twoD[0].size(); c++)
 	{
-		vector<double> oneR;
+		vector<T> oneR;
 		for (int r = 0; r < (int) twoD.size(); r++)
 			oneR.push_back(twoD[r][c]);
 		transposed.push_back(oneR);
@@ -437,21 +1597,37 @@ twoDArray DigitClassifier::transpose(twoDArray twoD)
 	return transposed;
 }
 
-twoDArray DigitClassifier::multiplyMatrices(twoDArray a, twoDArray b)
+template<typename T>
+typename BasicDigitClassifier<T>::twoDArray BasicDigitClassifier<T>::multiplyMatrices(const twoDArray & a, const twoDArray & b)
 {
+	Matrix<T> left(a.size(), a[0].size()), right(b.size(), b[0].size());
+	for (int r = 0; r < left.rows(); r++)
+		std::copy(a[r].begin(), a[r].end(), left[r]);
+	for (int r = 0; r < right.rows(); r++)
+		std::copy(b[r].begin(), b[r].end(), right[r]);
+	Matrix<T> product(left.rows(), right.cols());
+	gemm(NO_TRANSPOSE, NO_TRANSPOSE, 1, left.view(), right.view(), 0, product.view());
 	twoDArray mult;
-	for (int i = 0; i < (int) a.size(); ++i)
-	{
-		vector<double> oneR;
-		for (int j = 0; j < (int) b[0].size(); ++j)
-		{
-			double total = 0;
-			for (int k = 0; k < (int) a[0].size(); ++k)
-				total += a[i][k] * b[k][j];
-			oneR.push_back(total);
-		}
-		mult.push_back(oneR);
-	}
+	for (int r = 0; r < product.rows(); r++)
+		mult.push_back(vector<T>(product[r], product[r] + product.cols()));
 	return mult;
 }
 
+template class BasicDigitClassifier<float>;
+template class BasicDigitClassifier<double>;
+template void BasicDigitClassifier<float>::synchronousEpoch(const labeledImages & images, const vector<int> & order,
+		int miniBatchSize, double eta, ThreadPool & pool, vector<TrainingWorkspace> & workspaces);
+template void BasicDigitClassifier<float>::synchronousEpoch(const Dataset & images, const vector<int> & order,
+		int miniBatchSize, double eta, ThreadPool & pool, vector<TrainingWorkspace> & workspaces);
+template void BasicDigitClassifier<float>::hogwildEpoch(const labeledImages & images, const vector<int> & order,
+		int miniBatchSize, double eta, ThreadPool & pool, vector<TrainingWorkspace> & workspaces);
+template void BasicDigitClassifier<float>::hogwildEpoch(const Dataset & images, const vector<int> & order,
+		int miniBatchSize, double eta, ThreadPool & pool, vector<TrainingWorkspace> & workspaces);
+template void BasicDigitClassifier<double>::synchronousEpoch(const labeledImages & images, const vector<int> & order,
+		int miniBatchSize, double eta, ThreadPool & pool, vector<TrainingWorkspace> & workspaces);
+template void BasicDigitClassifier<double>::synchronousEpoch(const Dataset & images, const vector<int> & order,
+		int miniBatchSize, double eta, ThreadPool & pool, vector<TrainingWorkspace> & workspaces);
+template void BasicDigitClassifier<double>::hogwildEpoch(const labeledImages & images, const vector<int> & order,
+		int miniBatchSize, double eta, ThreadPool & pool, vector<TrainingWorkspace> & workspaces);
+template void BasicDigitClassifier<double>::hogwildEpoch(const Dataset & images, const vector<int> & order,
+		int miniBatchSize, double eta, ThreadPool & pool, vector<TrainingWorkspace> & workspaces);
@@ -7,48 +7,144 @@
 #ifndef DIGITCLASSIFIER_H_
 #define DIGITCLASSIFIER_H_
 
+#include <algorithm>
 #include <utility>
 #include <string>
-#include <math.h>
+#include <cmath>
+#include <random>
 #include <vector>
+#include "Matrix.h"
+#include "EvaluationReport.h"
+#include "Dataset.h"
+#include "ModelFile.h"
+#include "Inference.h"
+#include "TrainingWorkspace.h"
+#include "Activation.h"
+#include "Optimizer.h"
+
+class ThreadPool;
+class CheckpointWriter;
+class RingTransport;
 
-class DigitClassifier
+/*
+ * T is the scalar type of the weights, biases and activations, either double or float.
+ * float halves the memory traffic and doubles the SIMD width of every kernel.
+ */
+template<typename T>
+class BasicDigitClassifier
 {
 public:
-	typedef std::vector<std::pair<int, std::vector<double>>>labeledImages;
-	typedef std::vector<std::vector<double>> twoDArray;
+	typedef std::vector<std::pair<int, std::vector<T>>>labeledImages;
+	typedef std::vector<std::vector<T>> twoDArray;
+
+	/*
+	 * SYNCHRONOUS splits each minibatch across the threads and applies one combined update.
+	 * HOGWILD lets every thread take its own minibatches and update the shared weights without locks.
+	 */
+	enum TrainingMode
+	{
+		SYNCHRONOUS, HOGWILD
+	};
+
+	/*
+	 * SIGMOID_OUTPUT trains sigmoid outputs on the quadratic cost. Its output error is
+	 * (a - y) * a * (1 - a), which vanishes when an output saturates at the wrong answer.
+	 * SOFTMAX_OUTPUT trains softmax outputs, a probability per label, on the cross-entropy cost,
+	 * whose output error is just a - y. Hidden layers are sigmoid either way.
+	 */
+	enum OutputLayer
+	{
+		SIGMOID_OUTPUT, SOFTMAX_OUTPUT
+	};
 
 	/*
 	 * Each element in structure represents a layer in the neural network
 	 * such that each value is the number of neurons in that layer.
 	 */
-	DigitClassifier(const std::vector<int> & structure)
+	BasicDigitClassifier(const std::vector<int> & structure)
 	{
 		this->structure = structure;
 		fillSystemRandomly();
 	}
 
 	/*
-	 * Used when weights and biases have been predetermined.
+	 * Used when weights and biases have been predetermined. path is a text file made by toString
+	 * or a binary model made by save, in either precision.
 	 */
-	DigitClassifier(const std::string & path)
+	BasicDigitClassifier(const std::string & path)
 	{
 		readIn(path);
 	}
 
+	//Copies a network of another precision, rounding every weight and bias to T.
+	template<typename U>
+	explicit BasicDigitClassifier(const BasicDigitClassifier<U> & other)
+	{
+		convertFrom(other);
+	}
+
 	/*
-	 * Determines how accurate the neural network is for test samples.
+	 * Determines how accurate the neural network is for test samples. The test set is split
+	 * into one shard per thread and every shard is classified in batches.
 	 */
-	void evaluate(std::string path);
+	EvaluationReport evaluate(std::string path, int threads = 1);
+
+	//Same as above for images that are already loaded.
+	EvaluationReport evaluate(const labeledImages & images, int threads = 1);
+	EvaluationReport evaluate(const Dataset & images, int threads = 1);
 
 	//Used for testing or actual classification. Image parameter should have same dimensions as images we trained on.
-	int classify(std::vector<double> inputs);
+	int classify(std::vector<T> inputs);
 
-	//Trains neural network
-	void train(std::string path, int epoch, int miniBatchSize, double eta)
-	{
-		SGD(getImages(path), epoch, miniBatchSize, eta);
-	}
+	typedef BasicInferenceWorkspace<T> Workspace;
+
+	/*
+	 * Allocation free versions of classify for serving. inputs points at size pixels and all scratch
+	 * memory comes from workspace, which can be reused across calls but not shared between threads.
+	 * Nothing is printed; problems are returned as an InferenceStatus. These only read the network,
+	 * so any number of threads may classify at once as long as none of them trains.
+	 */
+	//Writes the index of the highest output activation to label.
+	InferenceStatus classify(const T * inputs, int size, Workspace & workspace, int & label) const;
+
+	//Writes all structure.back() output activations to outputs.
+	InferenceStatus classify(const T * inputs, int size, Workspace & workspace, T * outputs) const;
+
+	/*
+	 * Writes the probability of every label to probabilities, which sum to 1. These are the outputs of
+	 * a SOFTMAX_OUTPUT network. A SIGMOID_OUTPUT network's outputs are only divided by their sum,
+	 * which ranks the labels the same way but is not calibrated.
+	 */
+	InferenceStatus classifyProbabilities(const T * inputs, int size, Workspace & workspace, T * probabilities) const;
+
+	//Writes the k most likely labels to labels, best first, and their activations to scores unless it is null.
+	InferenceStatus classifyTopK(const T * inputs, int size, int k, Workspace & workspace, int * labels,
+			T * scores = nullptr) const;
+
+	//Batch versions of the above, with one image per row of inputs. labels holds one label per image.
+	InferenceStatus classifyMany(MatrixView<const T> inputs, Workspace & workspace, int * labels) const;
+
+	//outputs must have one row per image and structure.back() columns.
+	InferenceStatus classifyMany(MatrixView<const T> inputs, Workspace & workspace, MatrixView<T> outputs) const;
+
+	//labels and scores hold k values per image, so image i's results start at i * k.
+	InferenceStatus classifyManyTopK(MatrixView<const T> inputs, int k, Workspace & workspace, int * labels,
+			T * scores = nullptr) const;
+
+	/*
+	 * Trains neural network. With more than one thread every minibatch is split across the threads.
+	 * path can be a CSV file, which is parsed in parallel, or a binary dataset made by Dataset::convertCsv,
+	 * which is mapped instead of parsed.
+	 */
+	void train(std::string path, int epoch, int miniBatchSize, double eta, int threads = 1,
+			TrainingMode mode = SYNCHRONOUS);
+
+	/*
+	 * Same as train, but a BatchStream reads the minibatches from disk on a background thread, so the
+	 * dataset never has to fit in memory. Images are only shuffled within windows of shuffleWindow images.
+	 */
+	void trainStreaming(std::string path, int epoch, int miniBatchSize, double eta, int threads = 1,
+			std::size_t shuffleWindow = 8192);
 
 	//In the return type, each pair contains a label and a vector of the pixels for the image.
 	labeledImages getImages(const std::string & path);
@@ -65,68 +161,289 @@ public:
 	void shuffleImagesImproved(labeledImages & images);
 
 	//Feeds inputs into one layer and returns z values. Layer parameter should account for input layer.
-	std::vector<double> feedForwardOnce(const std::vector<double> & inputs, int layers);
+	std::vector<T> feedForwardOnce(const std::vector<T> & inputs, int layers);
 
 	//Trains neural network using stochastic gradient descent.
-	void SGD(labeledImages images, int epoch, int miniBatchSize, double eta);
+	void SGD(const labeledImages & images, int epoch, int miniBatchSize, double eta, int threads = 1,
+			TrainingMode mode = SYNCHRONOUS);
+
+	//Same as above but pixels are read straight out of the dataset's memory.
+	void SGD(const Dataset & images, int epoch, int miniBatchSize, double eta, int threads = 1,
+			TrainingMode mode = SYNCHRONOUS);
+
+	/*
+	 * Chooses how minibatch gradients move the weights and how eta changes over a run; see Optimizer.h.
+	 * The schedule is followed by SGD, train, resume and trainStreaming. HOGWILD threads update the
+	 * shared weights without locks, so they always take plain SGD steps, at the scheduled eta.
+	 * Changing the kind of optimizer clears its state.
+	 */
+	void setOptimizer(const Optimizer & optimizer);
+
+	const Optimizer & getOptimizer() const
+	{
+		return optimizer;
+	}
+
+	//Forgets every velocity and moment, as if no update had been made.
+	void resetOptimizerState();
+
+	/*
+	 * Makes SGD and train write a checkpoint to path every everyEpochs epochs and every
+	 * everyMinibatches minibatches, 0 meaning never, and once more when the run finishes or is stopped
+	 * by requestTrainingStop. Checkpoints are written on a background thread; see Checkpoint.h.
+	 * HOGWILD runs only checkpoint between epochs.
+	 */
+	void enableCheckpoints(const std::string & path, int everyEpochs, int everyMinibatches = 0);
+	void disableCheckpoints();
+
+	/*
+	 * Continues the run saved in the checkpoint at path from where it stopped, with the same weights,
+	 * image order and random engine, so a SYNCHRONOUS run ends bit for bit where it would have
+	 * without the interruption. The network takes the checkpoint's structure. The first version
+	 * reloads the dataset given to train; runs started with SGD must be given the same images again.
+	 * Checkpointing continues to path unless enableCheckpoints was called. Returns false if the
+	 * checkpoint is invalid or does not fit the images.
+	 */
+	bool resume(const std::string & path);
+	bool resume(const std::string & path, const labeledImages & images);
+	bool resume(const std::string & path, const Dataset & images);
+
+	/*
+	 * Data parallel SGD across the processes of ring, which must all call this with the same images,
+	 * arguments and structure. Rank r trains on every ring.size()-th image starting at image r, as many
+	 * on every rank. Each rank computes the gradients of miniBatchSize / ring.size() of its images,
+	 * and a ring all-reduce sums them into the gradients of the whole minibatch, so every rank makes
+	 * the same update and the weights stay identical. Rank 0's weights are broadcast first. With
+	 * compress the gradients travel as half precision; see AllReduce.h. Rank 0 writes the network with
+	 * toString to checkpointPath after every epoch and when the run stops, unless it is empty.
+	 * requestTrainingStop on any rank stops every rank after the same minibatch.
+	 * Returns false if the transport failed.
+	 */
+	bool trainDistributed(const labeledImages & images, RingTransport & ring, int epoch, int miniBatchSize,
+			double eta, bool compress = false, const std::string & checkpointPath = "");
+	bool trainDistributed(const Dataset & images, RingTransport & ring, int epoch, int miniBatchSize,
+			double eta, bool compress = false, const std::string & checkpointPath = "");
+
+	typedef BasicTrainingWorkspace<T> TrainingWorkspace;
+
+	/*
+	 * One epoch of minibatch SGD over images in the given order, as SGD does in SYNCHRONOUS mode.
+	 * workspaces is resized to one per thread in pool. Once they have seen a minibatch of this size,
+	 * an epoch makes no heap allocations. Images is labeledImages or Dataset.
+	 */
+	template<typename Images>
+	void synchronousEpoch(const Images & images, const std::vector<int> & order, int miniBatchSize, double eta,
+			ThreadPool & pool, std::vector<TrainingWorkspace> & workspaces);
+
+	/*
+	 * One epoch of lock free asynchronous SGD. Every thread pulls minibatches from order and updates
+	 * the weights directly, using its own workspace from workspaces.
+	 */
+	template<typename Images>
+	void hogwildEpoch(const Images & images, const std::vector<int> & order, int miniBatchSize, double eta,
+			ThreadPool & pool, std::vector<TrainingWorkspace> & workspaces);
 
 	//Updates weights and biases once using a minibatch.
 	void updateSystem(labeledImages mini, double eta);
 
-	//Finds error in all layers.
-	void backpropagate(int layer, const std::vector<double> & preError, const twoDArray & zVals, twoDArray & totalErrors);
+	//Updates weights and biases once using a minibatch stored as a matrix with one image per row.
+	void updateSystemBatch(MatrixView<const T> inputs, const int * labels, double eta);
+
+	//Same as above with every scratch buffer taken from workspace.
+	void updateSystemBatch(MatrixView<const T> inputs, const int * labels, double eta, TrainingWorkspace & workspace);
+
+	/*
+	 * Same as updateSystemBatch, but the minibatch is split evenly across the pool and thread t works in
+	 * workspaces[t]. The gradients are summed with a tree in a fixed order, so for a given number of
+	 * threads the result is always bit for bit the same.
+	 */
+	void updateSystemParallel(MatrixView<const T> inputs, const int * labels, double eta, ThreadPool & pool,
+			std::vector<TrainingWorkspace> & workspaces);
+
+	//Adds the gradients of every image in the batch to gradients, which must be laid out like the parameters.
+	void addGradients(MatrixView<const T> inputs, const int * labels, AlignedBuffer<T> & gradients);
+
+	//Same as above with the activations and errors kept in workspace.
+	void addGradients(MatrixView<const T> inputs, const int * labels, AlignedBuffer<T> & gradients,
+			TrainingWorkspace & workspace) const;
+
+	//Moves the parameters against the summed gradients of batchSize images with the optimizer.
+	void applyGradients(const AlignedBuffer<T> & gradients, double eta, int batchSize);
+
+	//Feeds a batch with one image per row through every layer. zVals[i] and acts[i] hold layer i + 1.
+	void feedForwardBatch(MatrixView<const T> inputs, std::vector<Matrix<T>> & zVals,
+			std::vector<Matrix<T>> & acts) const;
+
+	//Finds the error in all layers for a batch. errors[i] holds layer i + 1 with one row per image.
+	void backpropagateBatch(const std::vector<Matrix<T>> & zVals, const std::vector<Matrix<T>> & acts,
+			const int * labels, std::vector<Matrix<T>> & errors);
+
+	/*
+	 * Finds error in all layers. preError is the error of layer + 2 and zVals[i] holds the z values of
+	 * layer i + 1. The errors of layer + 1 down to layer 1 are appended to totalErrors in that order.
+	 */
+	void backpropagate(int layer, const std::vector<T> & preError, const twoDArray & zVals, twoDArray & totalErrors);
+
+	//Computes the error for the last layer of the neural network with the cost of its output layer.
+	std::vector<T> lastLayerError(std::vector<T> zVals, std::vector<int> y);
+
+	/*
+	 * Magnitude pruning, usually of a trained network. pruneBelow zeroes every weight whose magnitude
+	 * is at most threshold, so pruneBelow(0) masks the zeros of a pruned model read back from a file.
+	 * pruneTopK keeps only the k largest magnitude weights into each neuron.
+	 * layer picks one weight matrix, numbered as in weights(layer), or -1 prunes all of them. Biases
+	 * are never pruned. The pruned weights go into a mask that keeps them at zero through any later
+	 * training, so the network can be fine-tuned with SGD, and updateSparseLayers is called. Both
+	 * return the fraction of all weights that are zero afterwards.
+	 */
+	double pruneBelow(double threshold, int layer = -1);
+	double pruneTopK(int k, int layer = -1);
+
+	//Lets training change every weight again. The weights stay as they are.
+	void clearPruneMask();
+
+	bool isPruned() const
+	{
+		return pruneMask.size() != 0;
+	}
 
-	//Computes the error for the last layer of the neural network.
-	std::vector<double> lastLayerError(std::vector<double> zVals, std::vector<int> y);
+	/*
+	 * Picks dense or sparse inference per layer and batch size. A layer with at most maxSingleDensity
+	 * of its weights nonzero multiplies single images through a CSR copy of them, and one with at most
+	 * maxBatchDensity does the same for batches. feedForwardOnce, classify and the workspace classify
+	 * functions use the copies. Any update to the weights drops them, and a training run over a pruned
+	 * network rebuilds them when it finishes. Weights written through weights() need another call.
+	 */
+	void updateSparseLayers(double maxSingleDensity = SPARSE_SINGLE_DENSITY,
+			double maxBatchDensity = SPARSE_BATCH_DENSITY);
+
+	//Goes back to dense inference for every layer.
+	void clearSparseLayers()
+	{
+		sparseLayers.clear();
+	}
+
+	//Whether multiplying images images through layer uses its CSR copy.
+	bool isSparseLayer(int layer, int images) const
+	{
+		return layer < (int) sparseLayers.size() && (images == 1 ? sparseLayers[layer].single : sparseLayers[layer].batch);
+	}
+
+	//Fraction of the weights between layer and layer + 1 that are not zero.
+	double density(int layer) const;
+
+	/*
+	 * Default densities for updateSparseLayers. On a 784-30-10 network in double, csrGemv beats gemv
+	 * for a single image below about 20% density, and csrGemm beats gemm for a batch below about 40%.
+	 */
+	static constexpr double SPARSE_SINGLE_DENSITY = 0.2;
+	static constexpr double SPARSE_BATCH_DENSITY = 0.4;
+
+	//Takes effect from the next update or classification. Saved with the model.
+	void setOutputLayer(OutputLayer layer)
+	{
+		outputLayer = layer;
+	}
+
+	OutputLayer getOutputLayer() const
+	{
+		return outputLayer;
+	}
 
 	//Prints out weights and biases to a text file.
 	void toString(std::string path);
 
-	//Sets weights and biases manually.
+	//Writes weights and biases to a binary model file, described in ModelFile.h. Returns false on failure.
+	bool save(std::string path) const;
+
+	/*
+	 * Sets weights and biases manually. Binary models are mapped rather than read, so the weights are
+	 * used straight from the file's pages until training first writes to them.
+	 */
 	void readIn(std::string path);
 
-	//Extracts doubles from a string where the delimiters are spaces.
-	std::vector<double> extractDoubles(std::string line);
+	//True if the parameters are still the pages of a mapped model file.
+	bool isMapped() const
+	{
+		return parameters.isMapped();
+	}
+
+	//Extracts numbers from a string where the delimiters are spaces.
+	std::vector<T> extractDoubles(std::string line);
 
 	//Transposes a matrix
 	twoDArray transpose(twoDArray twoD);
 
 	//multiplies two matrices together and returns the resulting matrix.
-	twoDArray multiplyMatrices(twoDArray a, twoDArray b);
+	twoDArray multiplyMatrices(const twoDArray & a, const twoDArray & b);
 
 	//Multiplies two vectors using hadamard product. The vectors must be row vectors with same and one dimension.
-	std::vector<double> hadamard(std::vector<double> a, std::vector<double> b)
+	std::vector<T> hadamard(std::vector<T> a, std::vector<T> b)
 	{
-		std::vector<double> product;
+		std::vector<T> product;
 		for(int i = 0; i < (int)a.size(); i ++)
 			product.push_back(a[i]*b[i]);
 		return product;
 	}
 
 	//Returns vector of activations given a vector of z values.
-	std::vector<double> activations(std::vector<double> zVals)
+	std::vector<T> activations(std::vector<T> zVals)
 	{
-		for(double & zVal : zVals )
-			zVal = sigmoid(zVal);
+		applySigmoid(zVals.data(), zVals.data(), zVals.size());
 		return zVals;
 	}
 
 	//Computes sigmoidPrime for each z value in zVals.
-	std::vector<double> sigmoidPrimeVec(std::vector<double> zVals)
+	std::vector<T> sigmoidPrimeVec(std::vector<T> zVals)
 	{
-		for(double & zVal : zVals )
-			zVal = sigmoidPrime(zVal);
+		applySigmoid(zVals.data(), zVals.data(), zVals.size());
+		sigmoidDerivative(zVals.data(), zVals.data(), zVals.size());
 		return zVals;
 	}
 
-	double sigmoid(double z)
+	T sigmoid(T z) const
 	{
-		return (double) 1 / (1 + exp(-z));
+		return (T) 1 / (1 + std::exp(-z));
 	}
 
-	double sigmoidPrime(double z)
+	T sigmoidPrime(T z)
 	{
-		return exp(z) / pow((exp(z) + 1), 2);
+		T a = sigmoid(z);
+		return a * (1 - a);
+	}
+
+	//Weights between layer and layer + 1 where layer 0 is the input layer. view[1][2] gets the weight
+	//from neuron 2 (in layer) to neuron 1 (in layer + 1).
+	MatrixView<T> weights(int layer)
+	{
+		return MatrixView<T>(parameters.data() + weightOffsets[layer], structure[layer + 1], structure[layer]);
+	}
+
+	MatrixView<const T> weights(int layer) const
+	{
+		return MatrixView<const T>(parameters.data() + weightOffsets[layer], structure[layer + 1], structure[layer]);
+	}
+
+	//Biases of layer + 1, indexed the same way as weights.
+	T * biases(int layer)
+	{
+		return parameters.data() + biasOffsets[layer];
+	}
+
+	const T * biases(int layer) const
+	{
+		return parameters.data() + biasOffsets[layer];
+	}
+
+	const std::vector<int> & getStructure() const
+	{
+		return structure;
+	}
+
+	//Size of the flat buffer holding every weight and bias, including alignment padding.
+	std::size_t parameterCount() const
+	{
+		return parameters.size();
 	}
 
 private:
@@ -137,18 +454,180 @@ private:
 	 */
 	std::vector<int> structure;
 
-	/*a 2D vector storing the weights between two layers is stored inside a vector.
-	 *The weights are stored in the conventional structure; weights[#][1][2] gets the
-	 *weights from neuron 1 (in # layer) and neuron 2 (in #-1 layer).
+	/*
+	 * All weights and biases of the system live in this one buffer. Each layer stores its weight
+	 * matrix row major, followed by its biases, and every block starts on a 64 byte boundary.
+	 * The padding between blocks is always zero, so the buffer can be updated as one flat array.
+	 * The same layout is stored in binary model files, so the buffer can also be a mapped file.
+	 */
+	ParameterStorage<T> parameters;
+
+	//Where each layer's weight matrix and bias vector start inside parameters.
+	std::vector<std::size_t> weightOffsets;
+	std::vector<std::size_t> biasOffsets;
+
+	OutputLayer outputLayer = SIGMOID_OUTPUT;
+
+	Optimizer optimizer;
+
+	/*
+	 * The optimizer's velocity or moments: optimizerBuffers(optimizer.kind) blocks laid out like
+	 * parameters, one after another, so an update is one pass over three flat arrays.
+	 */
+	AlignedBuffer<T> optimizerState;
+
+	//Updates made since optimizerState was last cleared, for Adam's bias correction.
+	long optimizerSteps = 0;
+
+	//0 for pruned weights and 1 for everything else, laid out like parameters. Empty if nothing is pruned.
+	AlignedBuffer<T> pruneMask;
+
+	//A layer's CSR weights and the batch sizes that use them. A layer used by neither has no copy.
+	struct SparseLayer
+	{
+		CsrMatrix<T> weights;
+		bool single = false;
+		bool batch = false;
+	};
+	std::vector<SparseLayer> sparseLayers;
+
+	//The last densities given to updateSparseLayers, used again after training.
+	double sparseSingleDensity = SPARSE_SINGLE_DENSITY;
+	double sparseBatchDensity = SPARSE_BATCH_DENSITY;
+
+	//Makes pruneMask all ones if nothing was pruned yet.
+	void startPruning();
+
+	//Rebuilds the sparse layers and returns the fraction of weights that are zero.
+	double finishPruning();
+
+	//Re-zeroes pruned weights after an update that did not go through applyGradients.
+	void applyPruneMask();
+
+	//z = the layer's biases plus its weights times every row of inputs, sparse or dense.
+	void multiplyWeights(int layer, MatrixView<const T> inputs, MatrixView<T> z) const;
+
+	//Sizes parameters for the current structure and sets every weight and bias to zero.
+	void allocateParameters();
+
+	//Fills weightOffsets and biasOffsets for the current structure and returns the total size.
+	std::size_t layoutParameters();
+
+	//Maps a binary model made by save. Models saved in the other precision are converted instead.
+	void loadModel(const std::string & path);
+
+	//Turns the last layer's z values, rows images of structure.back() each, into output activations.
+	void activateOutputs(const T * z, T * a, int rows) const
+	{
+		if (outputLayer == SOFTMAX_OUTPUT)
+			applySoftmax(z, a, rows, structure.back());
+		else
+			applySigmoid(z, a, (std::size_t) rows * structure.back());
+	}
+
+	template<typename U>
+	void convertFrom(const BasicDigitClassifier<U> & other)
+	{
+		structure = other.getStructure();
+		outputLayer = (OutputLayer) other.getOutputLayer();
+		allocateParameters();
+		for (int layer = 0; layer < (int) structure.size() - 1; layer++)
+		{
+			MatrixView<const U> from = other.weights(layer);
+			std::copy(from.data(), from.data() + from.size(), weights(layer).data());
+			std::copy(other.biases(layer), other.biases(layer) + structure[layer + 1], biases(layer));
+		}
+	}
+
+	/*
+	 * Feeds at most Workspace::INFERENCE_BATCH images through every layer using only the workspace.
+	 * Returns the output activations, one row per image.
+	 */
+	const T * forward(MatrixView<const T> inputs, Workspace & workspace) const;
+
+	//Where a run of SGD is. Checkpoints save it and resume restores it.
+	struct TrainingRun
+	{
+		//Epoch in progress, counting from 0.
+		int epoch;
+		int epochs;
+		int miniBatchSize;
+		double eta;
+		int threads;
+		TrainingMode mode;
+		//Position in order of the next minibatch of the epoch in progress.
+		std::size_t nextImage;
+		//Minibatches trained since the run started, which minibatch checkpoints are counted in.
+		long minibatches;
+		std::vector<int> order;
+		std::default_random_engine engine;
+		//Empty unless the run was started by train.
+		std::string datasetPath;
+	};
+
+	//Where and how often runs checkpoint. An empty path means never.
+	std::string checkpointPath;
+	int checkpointEpochs = 0;
+	int checkpointMinibatches = 0;
+
+	TrainingRun startRun(std::size_t images, int epoch, int miniBatchSize, double eta, int threads, TrainingMode mode);
+
+	//Loads the checkpoint's weights into the network and its progress into run.
+	bool restoreRun(const std::string & path, TrainingRun & run);
+
+	//Copies the network and run into writer's spare buffer.
+	void saveCheckpoint(CheckpointWriter & writer, const TrainingRun & run) const;
+
+	//Shared by the labeledImages and Dataset versions of SGD, resume and evaluate.
+	template<typename Images>
+	void runSGD(const Images & images, TrainingRun & run);
+
+	template<typename Images>
+	bool resumeRun(const std::string & path, const Images & images);
+
+	template<typename Images>
+	bool runDistributed(const Images & images, RingTransport & ring, int epoch, int miniBatchSize, double eta,
+			bool compress, const std::string & checkpointPath);
+
+	/*
+	 * Trains on the minibatch of at most miniBatchSize images starting at order[first], as
+	 * synchronousEpoch does, and returns its size. workspaces must already hold one per thread.
 	 */
-	std::vector<twoDArray> weights;
+	template<typename Images>
+	int trainMinibatch(const Images & images, const std::vector<int> & order, std::size_t first, int miniBatchSize,
+			double eta, ThreadPool & pool, std::vector<TrainingWorkspace> & workspaces);
+
+	template<typename Images>
+	EvaluationReport runEvaluate(const Images & images, int threads);
+
+	//Prints why and returns false if images of size pixels can't be fed to the first layer.
+	bool fitsInputLayer(int size) const;
+
+	//Same as weights(layer) but for a buffer laid out like parameters, such as the gradients.
+	MatrixView<T> weightsIn(AlignedBuffer<T> & buffer, int layer) const
+	{
+		return MatrixView<T>(buffer.data() + weightOffsets[layer], structure[layer + 1], structure[layer]);
+	}
+
+	MatrixView<const T> weightsIn(const T * params, int layer) const
+	{
+		return MatrixView<const T>(params + weightOffsets[layer], structure[layer + 1], structure[layer]);
+	}
 
 	/*
-	 * Two vector storing the biases of the system.
-	 * To access a specific bias; [layer][neuron number]
+	 * The training passes, run against params rather than the network's own parameters so that
+	 * hogwild threads can train on a snapshot. params must be laid out like parameters.
 	 */
-	twoDArray biases;
+	void feedForwardBatch(const T * params, MatrixView<const T> inputs, std::vector<Matrix<T>> & zVals,
+			std::vector<Matrix<T>> & acts) const;
+	void backpropagateBatch(const T * params, const std::vector<Matrix<T>> & acts, const int * labels,
+			std::vector<Matrix<T>> & errors) const;
+	void addGradients(const T * params, MatrixView<const T> inputs, const int * labels, AlignedBuffer<T> & gradients,
+			TrainingWorkspace & workspace) const;
 
 };
 
+typedef BasicDigitClassifier<double> DigitClassifier;
+typedef BasicDigitClassifier<float> FloatDigitClassifier;
+
 #endif /* DIGITCLASSIFIER_H_ */
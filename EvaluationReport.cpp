@@ -0,0 +1,99 @@
+/*
+ * Author: Shuhao Lai
+ * Date: 10/17/2026
+ * EvaluationReport.cpp
+ */
+#include <iomanip>
+#include "EvaluationReport.h"
+
+EvaluationReport::EvaluationReport(int classes) :
+		wallSeconds(0), confusion(classes, std::vector<long>(classes, 0)), classSeconds(classes, 0)
+{
+}
+
+void EvaluationReport::record(int actual, int predicted, double seconds)
+{
+	if (actual < 0 || actual >= classes())
+		return;
+	++confusion[actual][predicted];
+	classSeconds[actual] += seconds;
+}
+
+void EvaluationReport::merge(const EvaluationReport & other)
+{
+	for (int actual = 0; actual < classes(); actual++)
+	{
+		for (int predicted = 0; predicted < classes(); predicted++)
+			confusion[actual][predicted] += other.confusion[actual][predicted];
+		classSeconds[actual] += other.classSeconds[actual];
+	}
+}
+
+long EvaluationReport::total() const
+{
+	long sum = 0;
+	for (const std::vector<long> & row : confusion)
+		for (long count : row)
+			sum += count;
+	return sum;
+}
+
+long EvaluationReport::correct() const
+{
+	long sum = 0;
+	for (int digit = 0; digit < classes(); digit++)
+		sum += confusion[digit][digit];
+	return sum;
+}
+
+double EvaluationReport::accuracy() const
+{
+	long all = total();
+	return all == 0 ? 0 : (double) correct() / all * 100;
+}
+
+double EvaluationReport::precision(int digit) const
+{
+	long predicted = 0;
+	for (int actual = 0; actual < classes(); actual++)
+		predicted += confusion[actual][digit];
+	return predicted == 0 ? 0 : (double) confusion[digit][digit] / predicted;
+}
+
+double EvaluationReport::recall(int digit) const
+{
+	long actual = 0;
+	for (long count : confusion[digit])
+		actual += count;
+	return actual == 0 ? 0 : (double) confusion[digit][digit] / actual;
+}
+
+double EvaluationReport::meanLatency(int digit) const
+{
+	long actual = 0;
+	for (long count : confusion[digit])
+		actual += count;
+	return actual == 0 ? 0 : classSeconds[digit] / actual;
+}
+
+void EvaluationReport::print(std::ostream & out) const
+{
+	out << "Accuracy: " << accuracy() << "% (" << correct() << "/" << total() << ")" << std::endl;
+	out << "Wall time: " << wallSeconds << " s, " << imagesPerSecond() << " images/s" << std::endl;
+	out << "Confusion matrix (rows are actual, columns are predicted):" << std::endl;
+	for (const std::vector<long> & row : confusion)
+	{
+		for (long count : row)
+			out << std::setw(6) << count;
+		out << std::endl;
+	}
+	out << "Digit  Precision  Recall  Latency(us)" << std::endl;
+	std::ios_base::fmtflags flags = out.flags();
+	std::streamsize precisionDigits = out.precision(4);
+	out << std::fixed;
+	for (int digit = 0; digit < classes(); digit++)
+		out << std::setw(5) << digit << std::setw(11) << precision(digit) << std::setw(8) << recall(digit)
+				<< std::setw(13) << meanLatency(digit) * 1e6 << std::endl;
+	out.flags(flags);
+	out.precision(precisionDigits);
+}
@@ -0,0 +1,69 @@
+/*
+ * Author: Shuhao Lai
+ * Date: 10/17/2026
+ * EvaluationReport.h
+ */
+
+#ifndef EVALUATIONREPORT_H_
+#define EVALUATIONREPORT_H_
+
+#include <ostream>
+#include <vector>
+
+/*
+ * Everything evaluate() measures for one pass over a test set.
+ */
+class EvaluationReport
+{
+public:
+	explicit EvaluationReport(int classes = 10);
+
+	//Counts one image of class actual that was classified as predicted. seconds is its share of the batch time.
+	void record(int actual, int predicted, double seconds);
+
+	//Adds another report's counts, used to combine the shards of a parallel evaluation.
+	void merge(const EvaluationReport & other);
+
+	int classes() const
+	{
+		return confusion.size();
+	}
+
+	//confusion[actual][predicted] is how many images of class actual were classified as predicted.
+	const std::vector<std::vector<long>> & confusionMatrix() const
+	{
+		return confusion;
+	}
+
+	long total() const;
+	long correct() const;
+
+	//Percent of images classified correctly.
+	double accuracy() const;
+
+	//Of the images classified as digit, the fraction that really were digit.
+	double precision(int digit) const;
+
+	//Of the images that really were digit, the fraction classified as digit.
+	double recall(int digit) const;
+
+	//Average time spent classifying one image of class digit, in seconds.
+	double meanLatency(int digit) const;
+
+	//Wall time of the whole evaluation including every thread, in seconds.
+	double wallSeconds;
+
+	double imagesPerSecond() const
+	{
+		return wallSeconds > 0 ? total() / wallSeconds : 0;
+	}
+
+	//Prints the accuracy, throughput, confusion matrix and per class statistics.
+	void print(std::ostream & out) const;
+
+private:
+	std::vector<std::vector<long>> confusion;
+	std::vector<double> classSeconds;
+};
+
+#endif /* EVALUATIONREPORT_H_ */
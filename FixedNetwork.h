@@ -0,0 +1,231 @@
+/*
+ * Author: Shuhao Lai
+ * Date: 10/17/2026
+ * FixedNetwork.h
+ */
+
+#ifndef FIXEDNETWORK_H_
+#define FIXEDNETWORK_H_
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include "DigitClassifier.h"
+#include "Kernels.h"
+#include "Activation.h"
+
+/*
+ * A network whose layer sizes are template arguments, for inference on a topology known at compile
+ * time such as FixedNetwork<784, 30, 10>. Every loop bound is a constant, so the compiler unrolls and
+ * vectorizes the loops, and the activations live in std::arrays on the stack: classify never touches
+ * the heap.
+ *
+ * Each layer's weights are stored transposed, one row per input neuron, with the outputs padded to a
+ * cache line. A layer is then a sum of input-weighted rows, and the inner loop runs over contiguous
+ * outputs with no horizontal reduction, which the compiler can vectorize without reordering any sums.
+ *
+ * The layers are compiled once per kernel path, so with constant bounds the same loops become AVX2 or
+ * AVX-512 code, and classify picks the version matching kernelPath().
+ *
+ * The parameters are held inline, so a FixedNetwork<784, 30, 10> is about 200 KB. Make it static or
+ * allocate it rather than putting it on the stack.
+ */
+template<typename T, int ... Sizes>
+class BasicFixedNetwork
+{
+	static_assert(sizeof...(Sizes) >= 2, "A network needs at least an input and an output layer");
+
+public:
+	static constexpr int LAYERS = sizeof...(Sizes);
+	static constexpr std::array<int, LAYERS> STRUCTURE = { Sizes... };
+
+	BasicFixedNetwork() : softmax(false), parameters() {}
+
+	/*
+	 * Copies the weights and biases of network. Returns false, leaving this network unchanged,
+	 * if network's structure is not the same as this one's.
+	 */
+	bool fromClassifier(const BasicDigitClassifier<T> & network)
+	{
+		const std::vector<int> & structure = network.getStructure();
+		if (!std::equal(structure.begin(), structure.end(), STRUCTURE.begin(), STRUCTURE.end()))
+		{
+			std::cout << "Network structure does not match the fixed topology." << std::endl;
+			return false;
+		}
+		for (int layer = 0; layer < LAYERS - 1; layer++)
+		{
+			MatrixView<const T> w = network.weights(layer);
+			T * transposed = parameters.data() + weightOffset(layer);
+			int rows = paddedSize(layer + 1);
+			for (int r = 0; r < w.rows(); r++)
+				for (int c = 0; c < w.cols(); c++)
+					transposed[(std::size_t) c * rows + r] = w[r][c];
+			std::copy(network.biases(layer), network.biases(layer) + w.rows(), parameters.data() + biasOffset(layer));
+		}
+		softmax = network.getOutputLayer() == BasicDigitClassifier<T>::SOFTMAX_OUTPUT;
+		return true;
+	}
+
+	//Loads a model file in any format DigitClassifier reads. Returns false if it does not fit.
+	bool readIn(const std::string & path)
+	{
+		BasicDigitClassifier<T> network(path);
+		return fromClassifier(network);
+	}
+
+	//Returns the digit the image is classified as. inputs holds STRUCTURE[0] values.
+	int classify(const T * inputs) const
+	{
+		return feedForward(inputs, nullptr);
+	}
+
+	//Same as classify, but also writes the STRUCTURE.back() output activations to outputs.
+	int feedForward(const T * inputs, T * outputs) const
+	{
+#if defined(__x86_64__) || defined(__i386__)
+		KernelPath path = kernelPath();
+		if (path == KERNEL_AVX512)
+			return feedForwardAvx512(inputs, outputs);
+		if (path == KERNEL_AVX2)
+			return feedForwardAvx2(inputs, outputs);
+#endif
+		return feedForwardScalar(inputs, outputs);
+	}
+
+private:
+	//Outputs of layer rounded up to a whole number of cache lines.
+	static constexpr int paddedSize(int layer)
+	{
+		return (int) alignedCount<T>(STRUCTURE[layer]);
+	}
+
+	static constexpr std::size_t weightOffset(int layer)
+	{
+		std::size_t offset = 0;
+		for (int i = 0; i < layer; i++)
+			offset += (std::size_t) (STRUCTURE[i] + 1) * paddedSize(i + 1);
+		return offset;
+	}
+
+	static constexpr std::size_t biasOffset(int layer)
+	{
+		return weightOffset(layer) + (std::size_t) STRUCTURE[layer] * paddedSize(layer + 1);
+	}
+
+	static constexpr int maxPadded()
+	{
+		int largest = 0;
+		for (int layer = 1; layer < LAYERS; layer++)
+			largest = paddedSize(layer) > largest ? paddedSize(layer) : largest;
+		return largest;
+	}
+
+	//One cache line of values. Blocks of parameters start on cache lines, so they can be read as Lines.
+	static constexpr int LANES = MATRIX_ALIGNMENT / sizeof(T);
+	typedef T Line __attribute__((vector_size(MATRIX_ALIGNMENT)));
+
+	static constexpr std::size_t PARAMETERS = weightOffset(LAYERS - 1);
+	static constexpr int MAX_PADDED = maxPadded();
+
+	int feedForwardScalar(const T * inputs, T * outputs) const
+	{
+		std::array<T, MAX_PADDED> first, second;
+		return run<0>(inputs, first.data(), second.data(), outputs);
+	}
+
+#if defined(__x86_64__) || defined(__i386__)
+	__attribute__((target("avx2,fma")))
+	int feedForwardAvx2(const T * inputs, T * outputs) const
+	{
+		std::array<T, MAX_PADDED> first, second;
+		return run<0>(inputs, first.data(), second.data(), outputs);
+	}
+
+	__attribute__((target("avx512f")))
+	int feedForwardAvx512(const T * inputs, T * outputs) const
+	{
+		std::array<T, MAX_PADDED> first, second;
+		return run<0>(inputs, first.data(), second.data(), outputs);
+	}
+#endif
+
+	/*
+	 * Feeds inputs through layer Layer + 1 into outputs, then recurses with the two workspaces swapped.
+	 * Always inlined, so it is compiled for the instruction set of whichever feedForward version calls it.
+	 */
+	template<int Layer>
+	__attribute__((always_inline))
+	int run(const T * inputs, T * outputs, T * spare, T * finalOutputs) const
+	{
+		constexpr int cols = STRUCTURE[Layer], rows = STRUCTURE[Layer + 1], padded = paddedSize(Layer + 1);
+		/*
+		 * The accumulators are cache line sized vectors held in registers for the whole layer: local
+		 * values cannot alias the weights, and there are few enough of them to unroll completely.
+		 * Even and odd inputs use separate accumulators so two chains of multiply-adds are in flight.
+		 */
+		constexpr int lines = padded / LANES;
+		Line even[lines], odd[lines];
+		const Line * lineBiases = reinterpret_cast<const Line *>(parameters.data() + biasOffset(Layer));
+#pragma GCC unroll 16
+		for (int l = 0; l < lines; l++)
+		{
+			even[l] = lineBiases[l];
+			odd[l] = Line{};
+		}
+		const Line * weightLines = reinterpret_cast<const Line *>(parameters.data() + weightOffset(Layer));
+		for (int c = 0; c + 1 < cols; c += 2, weightLines += 2 * lines)
+		{
+			T input = inputs[c], next = inputs[c + 1];
+#pragma GCC unroll 16
+			for (int l = 0; l < lines; l++)
+			{
+				even[l] += weightLines[l] * input;
+				odd[l] += weightLines[l + lines] * next;
+			}
+		}
+		if constexpr (cols % 2 == 1)
+#pragma GCC unroll 16
+			for (int l = 0; l < lines; l++)
+				even[l] += weightLines[l] * inputs[cols - 1];
+		for (int l = 0; l < lines; l++)
+			even[l] += odd[l];
+		applySigmoid(reinterpret_cast<const T *>(even), outputs, rows);
+
+		if constexpr (Layer + 2 == LAYERS)
+		{
+			/*
+			 * The last layer goes through the sigmoid like the others. Both it and the softmax keep the
+			 * order of the z values, so the label is the same, and only reported outputs are redone.
+			 */
+			if (finalOutputs != nullptr && softmax)
+				applySoftmax(reinterpret_cast<const T *>(even), finalOutputs, 1, rows);
+			else if (finalOutputs != nullptr)
+				std::copy(outputs, outputs + rows, finalOutputs);
+			int best = 0;
+			for (int r = 1; r < rows; r++)
+				if (outputs[r] > outputs[best])
+					best = r;
+			return best;
+		}
+		else
+			return run<Layer + 1>(outputs, spare, outputs, finalOutputs);
+	}
+
+	//True if the network being copied had softmax outputs.
+	bool softmax;
+
+	//Every layer's transposed weights followed by its biases, each padded as described above.
+	alignas(64) std::array<T, PARAMETERS> parameters;
+};
+
+template<int ... Sizes>
+using FixedNetwork = BasicFixedNetwork<double, Sizes...>;
+
+template<int ... Sizes>
+using FloatFixedNetwork = BasicFixedNetwork<float, Sizes...>;
+
+#endif /* FIXEDNETWORK_H_ */
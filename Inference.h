@@ -0,0 +1,69 @@
+/*
+ * Author: Shuhao Lai
+ * Date: 10/17/2026
+ * Inference.h
+ */
+
+#ifndef INFERENCE_H_
+#define INFERENCE_H_
+
+#include <algorithm>
+#include <cstddef>
+#include "Matrix.h"
+
+/*
+ * Returned by the workspace versions of classify and classifyMany instead of printing to cout,
+ * so request handlers can check the result without any I/O.
+ */
+enum InferenceStatus
+{
+	INFERENCE_OK,
+	INFERENCE_SIZE_MISMATCH, //Input or output dimensions do not match the network's structure.
+	INFERENCE_BAD_ARGUMENT //A null buffer or a k outside 1 to the number of outputs.
+};
+
+/*
+ * Scratch memory for the allocation free classify API. Holds the activations of two layers at a
+ * time for up to INFERENCE_BATCH images. Buffers only ever grow, so after the first call with a
+ * given network nothing is allocated again. Not thread safe: use one workspace per thread.
+ */
+template<typename T>
+class BasicInferenceWorkspace
+{
+public:
+	//Images pushed through the network together by classifyMany. Larger batches are split.
+	static constexpr int INFERENCE_BATCH = 256;
+
+	BasicInferenceWorkspace() : capacity(0) {}
+
+	//Makes sure each buffer holds at least count values.
+	void reserve(std::size_t count)
+	{
+		if (count <= capacity)
+			return;
+		front.resize(count);
+		back.resize(count);
+		capacity = count;
+	}
+
+	//The two buffers alternate as the input and output of each layer.
+	T * buffer(int which)
+	{
+		return which % 2 == 0 ? front.data() : back.data();
+	}
+
+	std::size_t size() const
+	{
+		return capacity;
+	}
+
+private:
+	AlignedBuffer<T> front;
+	AlignedBuffer<T> back;
+	std::size_t capacity;
+};
+
+typedef BasicInferenceWorkspace<double> InferenceWorkspace;
+typedef BasicInferenceWorkspace<float> FloatInferenceWorkspace;
+
+#endif /* INFERENCE_H_ */
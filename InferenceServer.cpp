@@ -0,0 +1,404 @@
+/*
+ * Author: Shuhao Lai
+ * Date: 10/17/2026
+ * InferenceServer.cpp
+ */
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "InferenceServer.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+
+//Connections waiting to be accepted.
+static const int LISTEN_BACKLOG = 128;
+
+//Spare pixel buffers kept for reuse. More than this are freed.
+static const std::size_t MAX_SPARE_BUFFERS = 1024;
+
+static bool isPort(const string & address)
+{
+	return !address.empty()
+			&& std::all_of(address.begin(), address.end(), [](char c) { return std::isdigit((unsigned char) c); });
+}
+
+static sockaddr_in loopbackAddress(const string & port)
+{
+	sockaddr_in address;
+	std::memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_port = htons(std::stoi(port));
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	return address;
+}
+
+//False if path does not fit in sockaddr_un.
+static bool unixAddress(const string & path, sockaddr_un & address)
+{
+	std::memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(address.sun_path))
+		return false;
+	std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+	return true;
+}
+
+int connectToServer(const string & address)
+{
+	int fd = socket(isPort(address) ? AF_INET : AF_UNIX, SOCK_STREAM, 0);
+	int connected = -1;
+	if (fd >= 0 && isPort(address))
+	{
+		sockaddr_in inet = loopbackAddress(address);
+		connected = connect(fd, (sockaddr *) &inet, sizeof(inet));
+		int on = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+	}
+	else if (fd >= 0)
+	{
+		sockaddr_un local;
+		if (unixAddress(address, local))
+			connected = connect(fd, (sockaddr *) &local, sizeof(local));
+	}
+	if (connected != 0)
+	{
+		cout << "Could not connect to " << address << ": " << std::strerror(errno) << endl;
+		if (fd >= 0)
+			close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+bool readFully(int fd, void * data, std::size_t size)
+{
+	char * bytes = static_cast<char *>(data);
+	while (size > 0)
+	{
+		ssize_t got = recv(fd, bytes, size, 0);
+		if (got < 0 && errno == EINTR)
+			continue;
+		if (got <= 0)
+			return false;
+		bytes += got;
+		size -= got;
+	}
+	return true;
+}
+
+bool writeFully(int fd, const void * data, std::size_t size)
+{
+	const char * bytes = static_cast<const char *>(data);
+	while (size > 0)
+	{
+		//MSG_NOSIGNAL turns a closed peer into an error instead of SIGPIPE.
+		ssize_t sent = send(fd, bytes, size, MSG_NOSIGNAL);
+		if (sent < 0 && errno == EINTR)
+			continue;
+		if (sent <= 0)
+			return false;
+		bytes += sent;
+		size -= sent;
+	}
+	return true;
+}
+
+InferenceServer::Connection::~Connection()
+{
+	close(fd);
+}
+
+InferenceServer::InferenceServer(const DigitClassifier & network, int workers, int maxBatch, int maxWaitMicros) :
+		network(network), maxBatch(std::max(maxBatch, 1)), maxWait(std::max(maxWaitMicros, 0)), listenFd(-1),
+		stopping(false), closing(false), requests(0), batches(0), started(std::chrono::steady_clock::now())
+{
+	for (int i = 0; i < std::max(workers, 1); i++)
+		workerThreads.emplace_back(&InferenceServer::work, this);
+}
+
+InferenceServer::~InferenceServer()
+{
+	stop();
+}
+
+bool InferenceServer::listen(const string & address)
+{
+	listenFd = socket(isPort(address) ? AF_INET : AF_UNIX, SOCK_STREAM, 0);
+	int bound = -1;
+	if (listenFd >= 0 && isPort(address))
+	{
+		int on = 1;
+		setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+		sockaddr_in inet = loopbackAddress(address);
+		bound = bind(listenFd, (sockaddr *) &inet, sizeof(inet));
+	}
+	else if (listenFd >= 0)
+	{
+		sockaddr_un local;
+		if (unixAddress(address, local))
+		{
+			//A socket file left behind by an earlier run would make bind fail.
+			unlink(address.c_str());
+			bound = bind(listenFd, (sockaddr *) &local, sizeof(local));
+			unixPath = address;
+		}
+	}
+	if (bound != 0 || ::listen(listenFd, LISTEN_BACKLOG) != 0)
+	{
+		cout << "Could not listen on " << address << ": " << std::strerror(errno) << endl;
+		if (listenFd >= 0)
+			close(listenFd);
+		listenFd = -1;
+		return false;
+	}
+	return true;
+}
+
+void InferenceServer::serve()
+{
+	while (true)
+	{
+		int fd = accept(listenFd, nullptr, nullptr);
+		if (fd < 0 && errno == EINTR)
+			continue;
+		//stop shuts the listening socket down, which makes accept fail.
+		if (fd < 0)
+			return;
+		int on = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+		std::shared_ptr<Connection> connection = std::make_shared<Connection>(fd);
+		std::lock_guard<std::mutex> guard(connectionLock);
+		if (closing)
+			return;
+		reapReaders();
+		connections.push_back(connection);
+		readers.emplace_back([this, connection]
+		{
+			readRequests(connection);
+			std::lock_guard<std::mutex> guard(connectionLock);
+			finishedReaders.push_back(std::this_thread::get_id());
+		});
+	}
+}
+
+void InferenceServer::reapReaders()
+{
+	for (std::thread::id id : finishedReaders)
+		for (std::size_t i = 0; i < readers.size(); i++)
+			if (readers[i].get_id() == id)
+			{
+				//The reader is past its last use of connectionLock, so this only waits for it to exit.
+				readers[i].join();
+				readers[i] = std::move(readers.back());
+				readers.pop_back();
+				break;
+			}
+	finishedReaders.clear();
+	connections.erase(std::remove_if(connections.begin(), connections.end(), [](const std::weak_ptr<Connection> & weak)
+	{
+		return weak.expired();
+	}), connections.end());
+}
+
+void InferenceServer::stop()
+{
+	std::vector<std::thread> finishing;
+	{
+		std::lock_guard<std::mutex> guard(connectionLock);
+		if (closing)
+			return;
+		closing = true;
+		if (listenFd >= 0)
+			shutdown(listenFd, SHUT_RDWR);
+		//Wakes every reader blocked in recv. Responses can still be written.
+		for (std::weak_ptr<Connection> & weak : connections)
+			if (std::shared_ptr<Connection> connection = weak.lock())
+				shutdown(connection->fd, SHUT_RD);
+		finishing.swap(readers);
+	}
+	for (std::thread & reader : finishing)
+		reader.join();
+
+	{
+		std::lock_guard<std::mutex> guard(queueLock);
+		stopping = true;
+	}
+	queued.notify_all();
+	for (std::thread & worker : workerThreads)
+		worker.join();
+	workerThreads.clear();
+
+	if (listenFd >= 0)
+		close(listenFd);
+	listenFd = -1;
+	if (!unixPath.empty())
+		unlink(unixPath.c_str());
+}
+
+std::size_t InferenceServer::readerCount()
+{
+	std::lock_guard<std::mutex> guard(connectionLock);
+	return readers.size();
+}
+
+ServerStats InferenceServer::stats()
+{
+	std::lock_guard<std::mutex> guard(statsLock);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+	ServerStats current;
+	current.requests = requests;
+	current.batches = batches;
+	current.p50Micros = latency.percentile(50);
+	current.p99Micros = latency.percentile(99);
+	current.requestsPerSecond = seconds > 0 ? requests / seconds : 0;
+	current.meanBatch = batches == 0 ? 0 : (double) requests / batches;
+	return current;
+}
+
+void InferenceServer::readRequests(std::shared_ptr<Connection> connection)
+{
+	RequestHeader header;
+	while (readFully(connection->fd, &header, sizeof(header)))
+	{
+		if (header.type == REQUEST_STATS)
+		{
+			struct
+			{
+				ResponseHeader header;
+				ServerStats stats;
+			} reply = { { header.id, INFERENCE_OK, -1, sizeof(ServerStats) }, stats() };
+			std::lock_guard<std::mutex> guard(connection->writeLock);
+			if (!writeFully(connection->fd, &reply, sizeof(reply)))
+				return;
+			continue;
+		}
+		//Anything else means the stream is out of sync, so the connection cannot be trusted.
+		if (header.type != REQUEST_CLASSIFY || header.size > MAX_REQUEST_PIXELS)
+			return;
+
+		Request request;
+		request.connection = connection;
+		request.id = header.id;
+		{
+			std::lock_guard<std::mutex> guard(queueLock);
+			if (!spareBuffers.empty())
+			{
+				request.pixels.swap(spareBuffers.back());
+				spareBuffers.pop_back();
+			}
+		}
+		request.pixels.resize(header.size);
+		if (!readFully(connection->fd, request.pixels.data(), header.size))
+			return;
+		request.arrival = std::chrono::steady_clock::now();
+
+		std::size_t waiting;
+		{
+			std::lock_guard<std::mutex> guard(queueLock);
+			pending.push_back(std::move(request));
+			waiting = pending.size();
+		}
+		//Only a new oldest request or a full batch changes what a worker is waiting for.
+		if (waiting == 1 || waiting >= (std::size_t) maxBatch)
+			queued.notify_one();
+	}
+}
+
+void InferenceServer::work()
+{
+	int imageSize = network.getStructure()[0];
+	Matrix<double> inputs(maxBatch, imageSize);
+	std::vector<int> labels(maxBatch);
+	std::vector<ResponseHeader> responses(maxBatch);
+	std::vector<Request> batch;
+	batch.reserve(maxBatch);
+	InferenceWorkspace workspace;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> guard(queueLock);
+			queued.wait(guard, [this] { return !pending.empty() || stopping; });
+			if (pending.empty())
+				return;
+			//Dynamic batching: wait for a full batch, but never keep the oldest request past maxWait.
+			queued.wait_until(guard, pending.front().arrival + maxWait,
+					[this] { return pending.size() >= (std::size_t) maxBatch || stopping; });
+			//Another worker may have taken the batch while this one waited.
+			if (pending.empty())
+				continue;
+			std::size_t count = std::min(pending.size(), (std::size_t) maxBatch);
+			for (std::size_t i = 0; i < count; i++)
+			{
+				batch.push_back(std::move(pending.front()));
+				pending.pop_front();
+			}
+			if (!pending.empty())
+				queued.notify_one();
+		}
+		process(batch, inputs, labels, workspace, responses);
+	}
+}
+
+void InferenceServer::process(std::vector<Request> & batch, Matrix<double> & inputs, std::vector<int> & labels,
+		InferenceWorkspace & workspace, std::vector<ResponseHeader> & responses)
+{
+	//Grouping by connection lets each connection's responses go out in one send.
+	std::sort(batch.begin(), batch.end(),
+			[](const Request & a, const Request & b) { return a.connection.get() < b.connection.get(); });
+
+	int imageSize = inputs.cols(), rows = 0;
+	for (std::size_t i = 0; i < batch.size(); i++)
+	{
+		responses[i] = { batch[i].id, INFERENCE_OK, -1, 0 };
+		if (batch[i].pixels.size() != (std::size_t) imageSize)
+		{
+			responses[i].status = INFERENCE_SIZE_MISMATCH;
+			continue;
+		}
+		double * row = inputs[rows++];
+		for (int p = 0; p < imageSize; p++)
+			row[p] = batch[i].pixels[p] / 255.0;
+	}
+	network.classifyMany(inputs.view().rowRange(0, rows), workspace, labels.data());
+	for (std::size_t i = 0, row = 0; i < batch.size(); i++)
+		if (responses[i].status == INFERENCE_OK)
+			responses[i].label = labels[row++];
+
+	//Counted before sending, so a client that reads its answers and then asks for stats sees them.
+	auto answered = std::chrono::steady_clock::now();
+	{
+		std::lock_guard<std::mutex> guard(statsLock);
+		for (const Request & request : batch)
+			latency.record(std::chrono::duration<double, std::micro>(answered - request.arrival).count());
+		requests += batch.size();
+		++batches;
+	}
+
+	for (std::size_t first = 0, last; first < batch.size(); first = last)
+	{
+		Connection * connection = batch[first].connection.get();
+		for (last = first + 1; last < batch.size() && batch[last].connection.get() == connection; last++)
+			;
+		std::lock_guard<std::mutex> guard(connection->writeLock);
+		//A client that hung up just loses its answers.
+		writeFully(connection->fd, &responses[first], (last - first) * sizeof(ResponseHeader));
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(queueLock);
+		for (Request & request : batch)
+			if (spareBuffers.size() < MAX_SPARE_BUFFERS)
+				spareBuffers.push_back(std::move(request.pixels));
+	}
+	batch.clear();
+}
@@ -0,0 +1,167 @@
+/*
+ * Author: Shuhao Lai
+ * Date: 10/17/2026
+ * InferenceServer.h
+ */
+
+#ifndef INFERENCESERVER_H_
+#define INFERENCESERVER_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "DigitClassifier.h"
+#include "LatencyHistogram.h"
+
+/*
+ * Wire protocol. Every message is a fixed size header in the machine's own byte order, since the
+ * server only listens on a Unix socket or loopback. A client may send many requests before reading
+ * any responses; responses carry the request's id and can come back in any order.
+ *
+ * REQUEST_CLASSIFY is followed by size bytes of 0-255 pixels and is answered with a ResponseHeader
+ * holding the label. REQUEST_STATS has no payload and is answered with a ResponseHeader followed by
+ * a ServerStats. status is an InferenceStatus.
+ */
+enum RequestType
+{
+	REQUEST_CLASSIFY = 1, REQUEST_STATS = 2
+};
+
+struct RequestHeader
+{
+	std::uint32_t type;
+	std::uint32_t id;
+	std::uint32_t size;
+	std::uint32_t reserved;
+};
+
+struct ResponseHeader
+{
+	std::uint32_t id;
+	std::int32_t status;
+	std::int32_t label;
+	//Bytes of payload that follow the header.
+	std::uint32_t size;
+};
+
+//Counters since the server started. Latency is from a request being read to its answer being ready to send.
+struct ServerStats
+{
+	std::uint64_t requests;
+	std::uint64_t batches;
+	double p50Micros;
+	double p99Micros;
+	double requestsPerSecond;
+	double meanBatch;
+};
+
+//Largest classify payload the server accepts. Anything larger closes the connection.
+static const std::uint32_t MAX_REQUEST_PIXELS = 1 << 20;
+
+/*
+ * address is a loopback TCP port number, such as "5555", or a Unix socket path, such as "/tmp/digits.sock".
+ * Returns a connected socket, or -1 after printing why it failed.
+ */
+int connectToServer(const std::string & address);
+
+//Loops until all size bytes are read or written. False if the socket closed or failed first.
+bool readFully(int fd, void * data, std::size_t size);
+bool writeFully(int fd, const void * data, std::size_t size);
+
+/*
+ * Serves a trained network over a socket with dynamic batching. Reader threads, one per connection,
+ * queue requests as they arrive. A worker waits until maxBatch requests are queued or the oldest
+ * has waited maxWaitMicros, then classifies them with one classifyMany call and writes each
+ * connection's responses with a single send. Under light load requests go out almost alone and fast;
+ * under heavy load batches fill up and throughput rises.
+ */
+class InferenceServer
+{
+public:
+	InferenceServer(const DigitClassifier & network, int workers = 1, int maxBatch = 64, int maxWaitMicros = 200);
+
+	//Stops the server if it is still running.
+	~InferenceServer();
+
+	InferenceServer(const InferenceServer &) = delete;
+	InferenceServer & operator=(const InferenceServer &) = delete;
+
+	//Binds to address, which has the same form as in connectToServer. Returns false after printing why it failed.
+	bool listen(const std::string & address);
+
+	//Accepts connections until stop is called. Call listen first.
+	void serve();
+
+	//Stops accepting, closes every connection and waits for queued requests to be answered.
+	void stop();
+
+	ServerStats stats();
+
+	//Reader threads not yet joined. Finished readers are joined as new clients connect.
+	std::size_t readerCount();
+
+private:
+	//Closes the socket once no reader or queued request uses it.
+	struct Connection
+	{
+		explicit Connection(int fd) : fd(fd) {}
+		~Connection();
+		int fd;
+		//Responses from different workers must not interleave.
+		std::mutex writeLock;
+	};
+
+	struct Request
+	{
+		std::shared_ptr<Connection> connection;
+		std::uint32_t id;
+		std::chrono::steady_clock::time_point arrival;
+		std::vector<std::uint8_t> pixels;
+	};
+
+	void readRequests(std::shared_ptr<Connection> connection);
+
+	//Joins finished readers and forgets closed connections, so neither grows with every client served.
+	//Call with connectionLock held.
+	void reapReaders();
+	void work();
+
+	//Classifies batch and sends every response.
+	void process(std::vector<Request> & batch, Matrix<double> & inputs, std::vector<int> & labels,
+			InferenceWorkspace & workspace, std::vector<ResponseHeader> & responses);
+
+	const DigitClassifier & network;
+	int maxBatch;
+	std::chrono::microseconds maxWait;
+	int listenFd;
+	std::string unixPath;
+
+	std::mutex queueLock;
+	std::condition_variable queued;
+	std::deque<Request> pending;
+	//Pixel buffers of answered requests, reused so steady traffic does not allocate.
+	std::vector<std::vector<std::uint8_t>> spareBuffers;
+	bool stopping;
+
+	std::mutex connectionLock;
+	bool closing;
+	std::vector<std::weak_ptr<Connection>> connections;
+	std::vector<std::thread> readers;
+	//Readers that have returned and only need joining. Guarded by connectionLock.
+	std::vector<std::thread::id> finishedReaders;
+	std::vector<std::thread> workerThreads;
+
+	std::mutex statsLock;
+	LatencyHistogram latency;
+	std::uint64_t requests;
+	std::uint64_t batches;
+	std::chrono::steady_clock::time_point started;
+};
+
+#endif /* INFERENCESERVER_H_ */
@@ -0,0 +1,1382 @@
+/*
+ * Author: Shuhao Lai
+ * Date: 10/17/2026
+ * Kernels.cpp
+ */
+#include <algorithm>
+#include "Kernels.h"
+#include "Activation.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define KERNELS_X86
+#include <immintrin.h>
+#endif
+
+/*
+ * gemm follows the usual blocked layout: op(b) is packed into KC x NC panels that stay in L2,
+ * op(a) into MC x KC panels that stay in L1/L2, and a register tiled micro kernel computes
+ * MR x NR tiles of c from the packed panels. Packing is also where transposes are absorbed.
+ */
+static const int KC = 256;
+static const int MC = 128;
+static const int NC = 1024;
+
+//Largest micro tile of any path in bytes (8 x 16 doubles or 8 x 32 floats), used to size the scratch tile for edges.
+static const int MAX_TILE_BYTES = 1024;
+
+template<typename T>
+struct KernelSet
+{
+	//c[MR x NR] += alpha * a * b where a is a packed kc x MR panel and b a packed kc x NR panel.
+	typedef void (*MicroKernel)(int kc, const T * a, const T * b, T * c, std::size_t ldc, T alpha);
+
+	//y += alpha * op(a) * x
+	typedef void (*GemvKernel)(T alpha, MatrixView<const T> a, const T * x, T * y);
+
+	KernelPath path;
+	int mr;
+	int nr;
+	MicroKernel micro;
+	GemvKernel gemvN;
+	GemvKernel gemvT;
+};
+
+/*
+ * Portable kernels. These are also the reference the SIMD paths are tested against.
+ */
+template<typename T>
+static void microKernelScalar(int kc, const T * a, const T * b, T * c, std::size_t ldc, T alpha)
+{
+	T acc[4][4] = {};
+	for (int p = 0; p < kc; p++, a += 4, b += 4)
+		for (int i = 0; i < 4; i++)
+			for (int j = 0; j < 4; j++)
+				acc[i][j] += a[i] * b[j];
+	for (int i = 0; i < 4; i++)
+		for (int j = 0; j < 4; j++)
+			c[i * ldc + j] += alpha * acc[i][j];
+}
+
+template<typename T>
+static void gemvNScalar(T alpha, MatrixView<const T> a, const T * x, T * y)
+{
+	for (int r = 0; r < a.rows(); r++)
+	{
+		const T * row = a[r];
+		T total = 0;
+		for (int c = 0; c < a.cols(); c++)
+			total += row[c] * x[c];
+		y[r] += alpha * total;
+	}
+}
+
+template<typename T>
+static void gemvTScalar(T alpha, MatrixView<const T> a, const T * x, T * y)
+{
+	for (int r = 0; r < a.rows(); r++)
+	{
+		const T * row = a[r];
+		T scale = alpha * x[r];
+		for (int c = 0; c < a.cols(); c++)
+			y[c] += scale * row[c];
+	}
+}
+
+#ifdef KERNELS_X86
+
+/*
+ * AVX2 + FMA kernels. The micro kernel keeps a 4 x 8 tile of c in eight ymm registers.
+ */
+__attribute__((target("avx2,fma")))
+static inline double sumAvx2(__m256d v)
+{
+	__m128d low = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+	return _mm_cvtsd_f64(_mm_add_sd(low, _mm_unpackhi_pd(low, low)));
+}
+
+__attribute__((target("avx2,fma")))
+static void microKernelAvx2(int kc, const double * a, const double * b, double * c, std::size_t ldc,
+		double alpha)
+{
+	__m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd();
+	__m256d c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+	__m256d c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd();
+	__m256d c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd();
+	for (int p = 0; p < kc; p++, a += 4, b += 8)
+	{
+		__m256d b0 = _mm256_load_pd(b), b1 = _mm256_load_pd(b + 4);
+		__m256d ai = _mm256_broadcast_sd(a);
+		c00 = _mm256_fmadd_pd(ai, b0, c00);
+		c01 = _mm256_fmadd_pd(ai, b1, c01);
+		ai = _mm256_broadcast_sd(a + 1);
+		c10 = _mm256_fmadd_pd(ai, b0, c10);
+		c11 = _mm256_fmadd_pd(ai, b1, c11);
+		ai = _mm256_broadcast_sd(a + 2);
+		c20 = _mm256_fmadd_pd(ai, b0, c20);
+		c21 = _mm256_fmadd_pd(ai, b1, c21);
+		ai = _mm256_broadcast_sd(a + 3);
+		c30 = _mm256_fmadd_pd(ai, b0, c30);
+		c31 = _mm256_fmadd_pd(ai, b1, c31);
+	}
+	__m256d scale = _mm256_set1_pd(alpha);
+	double * row = c;
+	_mm256_storeu_pd(row, _mm256_fmadd_pd(scale, c00, _mm256_loadu_pd(row)));
+	_mm256_storeu_pd(row + 4, _mm256_fmadd_pd(scale, c01, _mm256_loadu_pd(row + 4)));
+	row += ldc;
+	_mm256_storeu_pd(row, _mm256_fmadd_pd(scale, c10, _mm256_loadu_pd(row)));
+	_mm256_storeu_pd(row + 4, _mm256_fmadd_pd(scale, c11, _mm256_loadu_pd(row + 4)));
+	row += ldc;
+	_mm256_storeu_pd(row, _mm256_fmadd_pd(scale, c20, _mm256_loadu_pd(row)));
+	_mm256_storeu_pd(row + 4, _mm256_fmadd_pd(scale, c21, _mm256_loadu_pd(row + 4)));
+	row += ldc;
+	_mm256_storeu_pd(row, _mm256_fmadd_pd(scale, c30, _mm256_loadu_pd(row)));
+	_mm256_storeu_pd(row + 4, _mm256_fmadd_pd(scale, c31, _mm256_loadu_pd(row + 4)));
+}
+
+//Four rows share every load of x.
+__attribute__((target("avx2,fma")))
+static void gemvNAvx2(double alpha, MatrixView<const double> a, const double * x, double * y)
+{
+	int rows = a.rows(), cols = a.cols(), r = 0;
+	for (; r + 4 <= rows; r += 4)
+	{
+		const double * a0 = a[r], * a1 = a[r + 1], * a2 = a[r + 2], * a3 = a[r + 3];
+		__m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+		__m256d s2 = _mm256_setzero_pd(), s3 = _mm256_setzero_pd();
+		int c = 0;
+		for (; c + 4 <= cols; c += 4)
+		{
+			__m256d xv = _mm256_loadu_pd(x + c);
+			s0 = _mm256_fmadd_pd(_mm256_loadu_pd(a0 + c), xv, s0);
+			s1 = _mm256_fmadd_pd(_mm256_loadu_pd(a1 + c), xv, s1);
+			s2 = _mm256_fmadd_pd(_mm256_loadu_pd(a2 + c), xv, s2);
+			s3 = _mm256_fmadd_pd(_mm256_loadu_pd(a3 + c), xv, s3);
+		}
+		double t0 = sumAvx2(s0), t1 = sumAvx2(s1), t2 = sumAvx2(s2), t3 = sumAvx2(s3);
+		for (; c < cols; c++)
+		{
+			t0 += a0[c] * x[c];
+			t1 += a1[c] * x[c];
+			t2 += a2[c] * x[c];
+			t3 += a3[c] * x[c];
+		}
+		y[r] += alpha * t0;
+		y[r + 1] += alpha * t1;
+		y[r + 2] += alpha * t2;
+		y[r + 3] += alpha * t3;
+	}
+	for (; r < rows; r++)
+	{
+		const double * a0 = a[r];
+		__m256d s0 = _mm256_setzero_pd();
+		int c = 0;
+		for (; c + 4 <= cols; c += 4)
+			s0 = _mm256_fmadd_pd(_mm256_loadu_pd(a0 + c), _mm256_loadu_pd(x + c), s0);
+		double t0 = sumAvx2(s0);
+		for (; c < cols; c++)
+			t0 += a0[c] * x[c];
+		y[r] += alpha * t0;
+	}
+}
+
+//Four rows share every load and store of y.
+__attribute__((target("avx2,fma")))
+static void gemvTAvx2(double alpha, MatrixView<const double> a, const double * x, double * y)
+{
+	int rows = a.rows(), cols = a.cols(), r = 0;
+	for (; r + 4 <= rows; r += 4)
+	{
+		const double * a0 = a[r], * a1 = a[r + 1], * a2 = a[r + 2], * a3 = a[r + 3];
+		double x0 = alpha * x[r], x1 = alpha * x[r + 1], x2 = alpha * x[r + 2], x3 = alpha * x[r + 3];
+		__m256d v0 = _mm256_set1_pd(x0), v1 = _mm256_set1_pd(x1);
+		__m256d v2 = _mm256_set1_pd(x2), v3 = _mm256_set1_pd(x3);
+		int c = 0;
+		for (; c + 4 <= cols; c += 4)
+		{
+			__m256d yv = _mm256_loadu_pd(y + c);
+			yv = _mm256_fmadd_pd(v0, _mm256_loadu_pd(a0 + c), yv);
+			yv = _mm256_fmadd_pd(v1, _mm256_loadu_pd(a1 + c), yv);
+			yv = _mm256_fmadd_pd(v2, _mm256_loadu_pd(a2 + c), yv);
+			yv = _mm256_fmadd_pd(v3, _mm256_loadu_pd(a3 + c), yv);
+			_mm256_storeu_pd(y + c, yv);
+		}
+		for (; c < cols; c++)
+			y[c] += x0 * a0[c] + x1 * a1[c] + x2 * a2[c] + x3 * a3[c];
+	}
+	for (; r < rows; r++)
+	{
+		const double * a0 = a[r];
+		double x0 = alpha * x[r];
+		__m256d v0 = _mm256_set1_pd(x0);
+		int c = 0;
+		for (; c + 4 <= cols; c += 4)
+			_mm256_storeu_pd(y + c, _mm256_fmadd_pd(v0, _mm256_loadu_pd(a0 + c), _mm256_loadu_pd(y + c)));
+		for (; c < cols; c++)
+			y[c] += x0 * a0[c];
+	}
+}
+
+/*
+ * AVX-512 kernels. The micro kernel keeps an 8 x 16 tile of c in sixteen zmm registers,
+ * and tails are handled with masked loads instead of scalar loops.
+ */
+__attribute__((target("avx512f")))
+static inline double sumAvx512(__m512d v)
+{
+	alignas(64) double lanes[8];
+	_mm512_store_pd(lanes, v);
+	return ((lanes[0] + lanes[4]) + (lanes[1] + lanes[5])) + ((lanes[2] + lanes[6]) + (lanes[3] + lanes[7]));
+}
+
+__attribute__((target("avx512f")))
+static void microKernelAvx512(int kc, const double * a, const double * b, double * c, std::size_t ldc,
+		double alpha)
+{
+	__m512d acc[8][2];
+#pragma GCC unroll 8
+	for (int i = 0; i < 8; i++)
+		acc[i][0] = acc[i][1] = _mm512_setzero_pd();
+	for (int p = 0; p < kc; p++, a += 8, b += 16)
+	{
+		__m512d b0 = _mm512_load_pd(b), b1 = _mm512_load_pd(b + 8);
+#pragma GCC unroll 8
+		for (int i = 0; i < 8; i++)
+		{
+			__m512d ai = _mm512_set1_pd(a[i]);
+			acc[i][0] = _mm512_fmadd_pd(ai, b0, acc[i][0]);
+			acc[i][1] = _mm512_fmadd_pd(ai, b1, acc[i][1]);
+		}
+	}
+	__m512d scale = _mm512_set1_pd(alpha);
+#pragma GCC unroll 8
+	for (int i = 0; i < 8; i++)
+	{
+		double * row = c + i * ldc;
+		_mm512_storeu_pd(row, _mm512_fmadd_pd(scale, acc[i][0], _mm512_loadu_pd(row)));
+		_mm512_storeu_pd(row + 8, _mm512_fmadd_pd(scale, acc[i][1], _mm512_loadu_pd(row + 8)));
+	}
+}
+
+__attribute__((target("avx512f")))
+static void gemvNAvx512(double alpha, MatrixView<const double> a, const double * x, double * y)
+{
+	int rows = a.rows(), cols = a.cols(), r = 0;
+	__mmask8 tail = (__mmask8) ((1u << (cols % 8)) - 1);
+	int full = cols - cols % 8;
+	for (; r + 4 <= rows; r += 4)
+	{
+		const double * a0 = a[r], * a1 = a[r + 1], * a2 = a[r + 2], * a3 = a[r + 3];
+		__m512d s0 = _mm512_setzero_pd(), s1 = _mm512_setzero_pd();
+		__m512d s2 = _mm512_setzero_pd(), s3 = _mm512_setzero_pd();
+		for (int c = 0; c < full; c += 8)
+		{
+			__m512d xv = _mm512_loadu_pd(x + c);
+			s0 = _mm512_fmadd_pd(_mm512_loadu_pd(a0 + c), xv, s0);
+			s1 = _mm512_fmadd_pd(_mm512_loadu_pd(a1 + c), xv, s1);
+			s2 = _mm512_fmadd_pd(_mm512_loadu_pd(a2 + c), xv, s2);
+			s3 = _mm512_fmadd_pd(_mm512_loadu_pd(a3 + c), xv, s3);
+		}
+		if (tail)
+		{
+			__m512d xv = _mm512_maskz_loadu_pd(tail, x + full);
+			s0 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(tail, a0 + full), xv, s0);
+			s1 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(tail, a1 + full), xv, s1);
+			s2 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(tail, a2 + full), xv, s2);
+			s3 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(tail, a3 + full), xv, s3);
+		}
+		y[r] += alpha * sumAvx512(s0);
+		y[r + 1] += alpha * sumAvx512(s1);
+		y[r + 2] += alpha * sumAvx512(s2);
+		y[r + 3] += alpha * sumAvx512(s3);
+	}
+	for (; r < rows; r++)
+	{
+		const double * a0 = a[r];
+		__m512d s0 = _mm512_setzero_pd();
+		for (int c = 0; c < full; c += 8)
+			s0 = _mm512_fmadd_pd(_mm512_loadu_pd(a0 + c), _mm512_loadu_pd(x + c), s0);
+		if (tail)
+			s0 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(tail, a0 + full), _mm512_maskz_loadu_pd(tail, x + full), s0);
+		y[r] += alpha * sumAvx512(s0);
+	}
+}
+
+__attribute__((target("avx512f")))
+static void gemvTAvx512(double alpha, MatrixView<const double> a, const double * x, double * y)
+{
+	int rows = a.rows(), cols = a.cols(), r = 0;
+	__mmask8 tail = (__mmask8) ((1u << (cols % 8)) - 1);
+	int full = cols - cols % 8;
+	for (; r + 4 <= rows; r += 4)
+	{
+		const double * a0 = a[r], * a1 = a[r + 1], * a2 = a[r + 2], * a3 = a[r + 3];
+		__m512d v0 = _mm512_set1_pd(alpha * x[r]), v1 = _mm512_set1_pd(alpha * x[r + 1]);
+		__m512d v2 = _mm512_set1_pd(alpha * x[r + 2]), v3 = _mm512_set1_pd(alpha * x[r + 3]);
+		for (int c = 0; c < full; c += 8)
+		{
+			__m512d yv = _mm512_loadu_pd(y + c);
+			yv = _mm512_fmadd_pd(v0, _mm512_loadu_pd(a0 + c), yv);
+			yv = _mm512_fmadd_pd(v1, _mm512_loadu_pd(a1 + c), yv);
+			yv = _mm512_fmadd_pd(v2, _mm512_loadu_pd(a2 + c), yv);
+			yv = _mm512_fmadd_pd(v3, _mm512_loadu_pd(a3 + c), yv);
+			_mm512_storeu_pd(y + c, yv);
+		}
+		if (tail)
+		{
+			__m512d yv = _mm512_maskz_loadu_pd(tail, y + full);
+			yv = _mm512_fmadd_pd(v0, _mm512_maskz_loadu_pd(tail, a0 + full), yv);
+			yv = _mm512_fmadd_pd(v1, _mm512_maskz_loadu_pd(tail, a1 + full), yv);
+			yv = _mm512_fmadd_pd(v2, _mm512_maskz_loadu_pd(tail, a2 + full), yv);
+			yv = _mm512_fmadd_pd(v3, _mm512_maskz_loadu_pd(tail, a3 + full), yv);
+			_mm512_mask_storeu_pd(y + full, tail, yv);
+		}
+	}
+	for (; r < rows; r++)
+	{
+		const double * a0 = a[r];
+		__m512d v0 = _mm512_set1_pd(alpha * x[r]);
+		for (int c = 0; c < full; c += 8)
+			_mm512_storeu_pd(y + c, _mm512_fmadd_pd(v0, _mm512_loadu_pd(a0 + c), _mm512_loadu_pd(y + c)));
+		if (tail)
+			_mm512_mask_storeu_pd(y + full, tail,
+					_mm512_fmadd_pd(v0, _mm512_maskz_loadu_pd(tail, a0 + full), _mm512_maskz_loadu_pd(tail, y + full)));
+	}
+}
+
+/*
+ * Float versions of the kernels above. Each register holds twice as many lanes, so the micro tiles
+ * are twice as wide: 4 x 16 for AVX2 and 8 x 32 for AVX-512.
+ */
+__attribute__((target("avx2,fma")))
+static inline float sumAvx2(__m256 v)
+{
+	__m128 low = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+	low = _mm_add_ps(low, _mm_movehl_ps(low, low));
+	return _mm_cvtss_f32(_mm_add_ss(low, _mm_movehdup_ps(low)));
+}
+
+__attribute__((target("avx2,fma")))
+static void microKernelAvx2(int kc, const float * a, const float * b, float * c, std::size_t ldc, float alpha)
+{
+	__m256 acc[4][2];
+#pragma GCC unroll 4
+	for (int i = 0; i < 4; i++)
+		acc[i][0] = acc[i][1] = _mm256_setzero_ps();
+	for (int p = 0; p < kc; p++, a += 4, b += 16)
+	{
+		__m256 b0 = _mm256_load_ps(b), b1 = _mm256_load_ps(b + 8);
+#pragma GCC unroll 4
+		for (int i = 0; i < 4; i++)
+		{
+			__m256 ai = _mm256_broadcast_ss(a + i);
+			acc[i][0] = _mm256_fmadd_ps(ai, b0, acc[i][0]);
+			acc[i][1] = _mm256_fmadd_ps(ai, b1, acc[i][1]);
+		}
+	}
+	__m256 scale = _mm256_set1_ps(alpha);
+#pragma GCC unroll 4
+	for (int i = 0; i < 4; i++)
+	{
+		float * row = c + i * ldc;
+		_mm256_storeu_ps(row, _mm256_fmadd_ps(scale, acc[i][0], _mm256_loadu_ps(row)));
+		_mm256_storeu_ps(row + 8, _mm256_fmadd_ps(scale, acc[i][1], _mm256_loadu_ps(row + 8)));
+	}
+}
+
+__attribute__((target("avx2,fma")))
+static void gemvNAvx2(float alpha, MatrixView<const float> a, const float * x, float * y)
+{
+	int rows = a.rows(), cols = a.cols(), r = 0;
+	for (; r + 4 <= rows; r += 4)
+	{
+		const float * a0 = a[r], * a1 = a[r + 1], * a2 = a[r + 2], * a3 = a[r + 3];
+		__m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+		__m256 s2 = _mm256_setzero_ps(), s3 = _mm256_setzero_ps();
+		int c = 0;
+		for (; c + 8 <= cols; c += 8)
+		{
+			__m256 xv = _mm256_loadu_ps(x + c);
+			s0 = _mm256_fmadd_ps(_mm256_loadu_ps(a0 + c), xv, s0);
+			s1 = _mm256_fmadd_ps(_mm256_loadu_ps(a1 + c), xv, s1);
+			s2 = _mm256_fmadd_ps(_mm256_loadu_ps(a2 + c), xv, s2);
+			s3 = _mm256_fmadd_ps(_mm256_loadu_ps(a3 + c), xv, s3);
+		}
+		float t0 = sumAvx2(s0), t1 = sumAvx2(s1), t2 = sumAvx2(s2), t3 = sumAvx2(s3);
+		for (; c < cols; c++)
+		{
+			t0 += a0[c] * x[c];
+			t1 += a1[c] * x[c];
+			t2 += a2[c] * x[c];
+			t3 += a3[c] * x[c];
+		}
+		y[r] += alpha * t0;
+		y[r + 1] += alpha * t1;
+		y[r + 2] += alpha * t2;
+		y[r + 3] += alpha * t3;
+	}
+	for (; r < rows; r++)
+	{
+		const float * a0 = a[r];
+		__m256 s0 = _mm256_setzero_ps();
+		int c = 0;
+		for (; c + 8 <= cols; c += 8)
+			s0 = _mm256_fmadd_ps(_mm256_loadu_ps(a0 + c), _mm256_loadu_ps(x + c), s0);
+		float t0 = sumAvx2(s0);
+		for (; c < cols; c++)
+			t0 += a0[c] * x[c];
+		y[r] += alpha * t0;
+	}
+}
+
+__attribute__((target("avx2,fma")))
+static void gemvTAvx2(float alpha, MatrixView<const float> a, const float * x, float * y)
+{
+	int rows = a.rows(), cols = a.cols(), r = 0;
+	for (; r + 4 <= rows; r += 4)
+	{
+		const float * a0 = a[r], * a1 = a[r + 1], * a2 = a[r + 2], * a3 = a[r + 3];
+		float x0 = alpha * x[r], x1 = alpha * x[r + 1], x2 = alpha * x[r + 2], x3 = alpha * x[r + 3];
+		__m256 v0 = _mm256_set1_ps(x0), v1 = _mm256_set1_ps(x1);
+		__m256 v2 = _mm256_set1_ps(x2), v3 = _mm256_set1_ps(x3);
+		int c = 0;
+		for (; c + 8 <= cols; c += 8)
+		{
+			__m256 yv = _mm256_loadu_ps(y + c);
+			yv = _mm256_fmadd_ps(v0, _mm256_loadu_ps(a0 + c), yv);
+			yv = _mm256_fmadd_ps(v1, _mm256_loadu_ps(a1 + c), yv);
+			yv = _mm256_fmadd_ps(v2, _mm256_loadu_ps(a2 + c), yv);
+			yv = _mm256_fmadd_ps(v3, _mm256_loadu_ps(a3 + c), yv);
+			_mm256_storeu_ps(y + c, yv);
+		}
+		for (; c < cols; c++)
+			y[c] += x0 * a0[c] + x1 * a1[c] + x2 * a2[c] + x3 * a3[c];
+	}
+	for (; r < rows; r++)
+	{
+		const float * a0 = a[r];
+		float x0 = alpha * x[r];
+		__m256 v0 = _mm256_set1_ps(x0);
+		int c = 0;
+		for (; c + 8 <= cols; c += 8)
+			_mm256_storeu_ps(y + c, _mm256_fmadd_ps(v0, _mm256_loadu_ps(a0 + c), _mm256_loadu_ps(y + c)));
+		for (; c < cols; c++)
+			y[c] += x0 * a0[c];
+	}
+}
+
+__attribute__((target("avx512f")))
+static inline float sumAvx512(__m512 v)
+{
+	alignas(64) float lanes[16];
+	_mm512_store_ps(lanes, v);
+	float total = 0;
+	for (int i = 0; i < 8; i++)
+		total += lanes[i] + lanes[i + 8];
+	return total;
+}
+
+__attribute__((target("avx512f")))
+static void microKernelAvx512(int kc, const float * a, const float * b, float * c, std::size_t ldc, float alpha)
+{
+	__m512 acc[8][2];
+#pragma GCC unroll 8
+	for (int i = 0; i < 8; i++)
+		acc[i][0] = acc[i][1] = _mm512_setzero_ps();
+	for (int p = 0; p < kc; p++, a += 8, b += 32)
+	{
+		__m512 b0 = _mm512_load_ps(b), b1 = _mm512_load_ps(b + 16);
+#pragma GCC unroll 8
+		for (int i = 0; i < 8; i++)
+		{
+			__m512 ai = _mm512_set1_ps(a[i]);
+			acc[i][0] = _mm512_fmadd_ps(ai, b0, acc[i][0]);
+			acc[i][1] = _mm512_fmadd_ps(ai, b1, acc[i][1]);
+		}
+	}
+	__m512 scale = _mm512_set1_ps(alpha);
+#pragma GCC unroll 8
+	for (int i = 0; i < 8; i++)
+	{
+		float * row = c + i * ldc;
+		_mm512_storeu_ps(row, _mm512_fmadd_ps(scale, acc[i][0], _mm512_loadu_ps(row)));
+		_mm512_storeu_ps(row + 16, _mm512_fmadd_ps(scale, acc[i][1], _mm512_loadu_ps(row + 16)));
+	}
+}
+
+__attribute__((target("avx512f")))
+static void gemvNAvx512(float alpha, MatrixView<const float> a, const float * x, float * y)
+{
+	int rows = a.rows(), cols = a.cols(), r = 0;
+	__mmask16 tail = (__mmask16) ((1u << (cols % 16)) - 1);
+	int full = cols - cols % 16;
+	for (; r + 4 <= rows; r += 4)
+	{
+		const float * a0 = a[r], * a1 = a[r + 1], * a2 = a[r + 2], * a3 = a[r + 3];
+		__m512 s0 = _mm512_setzero_ps(), s1 = _mm512_setzero_ps();
+		__m512 s2 = _mm512_setzero_ps(), s3 = _mm512_setzero_ps();
+		for (int c = 0; c < full; c += 16)
+		{
+			__m512 xv = _mm512_loadu_ps(x + c);
+			s0 = _mm512_fmadd_ps(_mm512_loadu_ps(a0 + c), xv, s0);
+			s1 = _mm512_fmadd_ps(_mm512_loadu_ps(a1 + c), xv, s1);
+			s2 = _mm512_fmadd_ps(_mm512_loadu_ps(a2 + c), xv, s2);
+			s3 = _mm512_fmadd_ps(_mm512_loadu_ps(a3 + c), xv, s3);
+		}
+		if (tail)
+		{
+			__m512 xv = _mm512_maskz_loadu_ps(tail, x + full);
+			s0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(tail, a0 + full), xv, s0);
+			s1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(tail, a1 + full), xv, s1);
+			s2 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(tail, a2 + full), xv, s2);
+			s3 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(tail, a3 + full), xv, s3);
+		}
+		y[r] += alpha * sumAvx512(s0);
+		y[r + 1] += alpha * sumAvx512(s1);
+		y[r + 2] += alpha * sumAvx512(s2);
+		y[r + 3] += alpha * sumAvx512(s3);
+	}
+	for (; r < rows; r++)
+	{
+		const float * a0 = a[r];
+		__m512 s0 = _mm512_setzero_ps();
+		for (int c = 0; c < full; c += 16)
+			s0 = _mm512_fmadd_ps(_mm512_loadu_ps(a0 + c), _mm512_loadu_ps(x + c), s0);
+		if (tail)
+			s0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(tail, a0 + full), _mm512_maskz_loadu_ps(tail, x + full), s0);
+		y[r] += alpha * sumAvx512(s0);
+	}
+}
+
+__attribute__((target("avx512f")))
+static void gemvTAvx512(float alpha, MatrixView<const float> a, const float * x, float * y)
+{
+	int rows = a.rows(), cols = a.cols(), r = 0;
+	__mmask16 tail = (__mmask16) ((1u << (cols % 16)) - 1);
+	int full = cols - cols % 16;
+	for (; r + 4 <= rows; r += 4)
+	{
+		const float * a0 = a[r], * a1 = a[r + 1], * a2 = a[r + 2], * a3 = a[r + 3];
+		__m512 v0 = _mm512_set1_ps(alpha * x[r]), v1 = _mm512_set1_ps(alpha * x[r + 1]);
+		__m512 v2 = _mm512_set1_ps(alpha * x[r + 2]), v3 = _mm512_set1_ps(alpha * x[r + 3]);
+		for (int c = 0; c < full; c += 16)
+		{
+			__m512 yv = _mm512_loadu_ps(y + c);
+			yv = _mm512_fmadd_ps(v0, _mm512_loadu_ps(a0 + c), yv);
+			yv = _mm512_fmadd_ps(v1, _mm512_loadu_ps(a1 + c), yv);
+			yv = _mm512_fmadd_ps(v2, _mm512_loadu_ps(a2 + c), yv);
+			yv = _mm512_fmadd_ps(v3, _mm512_loadu_ps(a3 + c), yv);
+			_mm512_storeu_ps(y + c, yv);
+		}
+		if (tail)
+		{
+			__m512 yv = _mm512_maskz_loadu_ps(tail, y + full);
+			yv = _mm512_fmadd_ps(v0, _mm512_maskz_loadu_ps(tail, a0 + full), yv);
+			yv = _mm512_fmadd_ps(v1, _mm512_maskz_loadu_ps(tail, a1 + full), yv);
+			yv = _mm512_fmadd_ps(v2, _mm512_maskz_loadu_ps(tail, a2 + full), yv);
+			yv = _mm512_fmadd_ps(v3, _mm512_maskz_loadu_ps(tail, a3 + full), yv);
+			_mm512_mask_storeu_ps(y + full, tail, yv);
+		}
+	}
+	for (; r < rows; r++)
+	{
+		const float * a0 = a[r];
+		__m512 v0 = _mm512_set1_ps(alpha * x[r]);
+		for (int c = 0; c < full; c += 16)
+			_mm512_storeu_ps(y + c, _mm512_fmadd_ps(v0, _mm512_loadu_ps(a0 + c), _mm512_loadu_ps(y + c)));
+		if (tail)
+			_mm512_mask_storeu_ps(y + full, tail,
+					_mm512_fmadd_ps(v0, _mm512_maskz_loadu_ps(tail, a0 + full), _mm512_maskz_loadu_ps(tail, y + full)));
+	}
+}
+
+#endif /* KERNELS_X86 */
+
+static const KernelSet<double> SCALAR_KERNELS =
+{ KERNEL_SCALAR, 4, 4, microKernelScalar<double>, gemvNScalar<double>, gemvTScalar<double> };
+static const KernelSet<float> SCALAR_FLOAT_KERNELS =
+{ KERNEL_SCALAR, 4, 4, microKernelScalar<float>, gemvNScalar<float>, gemvTScalar<float> };
+#ifdef KERNELS_X86
+static const KernelSet<double> AVX2_KERNELS =
+{ KERNEL_AVX2, 4, 8, microKernelAvx2, gemvNAvx2, gemvTAvx2 };
+static const KernelSet<float> AVX2_FLOAT_KERNELS =
+{ KERNEL_AVX2, 4, 16, microKernelAvx2, gemvNAvx2, gemvTAvx2 };
+static const KernelSet<double> AVX512_KERNELS =
+{ KERNEL_AVX512, 8, 16, microKernelAvx512, gemvNAvx512, gemvTAvx512 };
+static const KernelSet<float> AVX512_FLOAT_KERNELS =
+{ KERNEL_AVX512, 8, 32, microKernelAvx512, gemvNAvx512, gemvTAvx512 };
+#endif
+
+KernelPath bestKernelPath()
+{
+#ifdef KERNELS_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+		return KERNEL_AVX512;
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+		return KERNEL_AVX2;
+#endif
+	return KERNEL_SCALAR;
+}
+
+//Chosen on first use so that nothing depends on static initialization order.
+static KernelPath & activePath()
+{
+	static KernelPath active = bestKernelPath();
+	return active;
+}
+
+KernelPath kernelPath()
+{
+	return activePath();
+}
+
+void setKernelPath(KernelPath path)
+{
+	activePath() = std::min(path, bestKernelPath());
+}
+
+template<typename T>
+static const KernelSet<T> & activeKernels();
+
+template<>
+const KernelSet<double> & activeKernels()
+{
+#ifdef KERNELS_X86
+	if (activePath() == KERNEL_AVX512)
+		return AVX512_KERNELS;
+	if (activePath() == KERNEL_AVX2)
+		return AVX2_KERNELS;
+#endif
+	return SCALAR_KERNELS;
+}
+
+template<>
+const KernelSet<float> & activeKernels()
+{
+#ifdef KERNELS_X86
+	if (activePath() == KERNEL_AVX512)
+		return AVX512_FLOAT_KERNELS;
+	if (activePath() == KERNEL_AVX2)
+		return AVX2_FLOAT_KERNELS;
+#endif
+	return SCALAR_FLOAT_KERNELS;
+}
+
+const char * kernelPathName(KernelPath path)
+{
+	switch (path)
+	{
+	case KERNEL_AVX512:
+		return "avx512";
+	case KERNEL_AVX2:
+		return "avx2";
+	default:
+		return "scalar";
+	}
+}
+
+/*
+ * Copies op(a)[row0, row0 + mc) x [col0, col0 + kc) into panels of mr rows.
+ * Within a panel the mr values of each column are contiguous, and short panels are padded with zeros.
+ */
+template<typename T>
+static void packA(MatrixView<const T> a, Transpose trans, int row0, int col0, int mc, int kc, int mr, T * out)
+{
+	for (int ir = 0; ir < mc; ir += mr, out += (std::size_t) mr * kc)
+	{
+		int rows = std::min(mr, mc - ir);
+		for (int i = 0; i < rows; i++)
+		{
+			int row = row0 + ir + i;
+			if (trans == TRANSPOSE)
+				for (int p = 0; p < kc; p++)
+					out[p * mr + i] = a[col0 + p][row];
+			else
+			{
+				const T * src = a[row] + col0;
+				for (int p = 0; p < kc; p++)
+					out[p * mr + i] = src[p];
+			}
+		}
+		for (int i = rows; i < mr; i++)
+			for (int p = 0; p < kc; p++)
+				out[p * mr + i] = 0;
+	}
+}
+
+/*
+ * Copies op(b)[row0, row0 + kc) x [col0, col0 + nc) into panels of nr columns,
+ * with the nr values of each row contiguous.
+ */
+template<typename T>
+static void packB(MatrixView<const T> b, Transpose trans, int row0, int col0, int kc, int nc, int nr, T * out)
+{
+	for (int jr = 0; jr < nc; jr += nr, out += (std::size_t) nr * kc)
+	{
+		int cols = std::min(nr, nc - jr);
+		if (trans == TRANSPOSE)
+		{
+			for (int j = 0; j < cols; j++)
+			{
+				const T * src = b[col0 + jr + j] + row0;
+				for (int p = 0; p < kc; p++)
+					out[p * nr + j] = src[p];
+			}
+		}
+		else
+		{
+			for (int p = 0; p < kc; p++)
+			{
+				const T * src = b[row0 + p] + col0 + jr;
+				for (int j = 0; j < cols; j++)
+					out[p * nr + j] = src[j];
+			}
+		}
+		for (int j = cols; j < nr; j++)
+			for (int p = 0; p < kc; p++)
+				out[p * nr + j] = 0;
+	}
+}
+
+//Packing buffers only ever grow, so steady state calls do not allocate.
+template<typename T>
+static T * scratch(AlignedBuffer<T> & buffer, std::size_t count)
+{
+	if (buffer.size() < count)
+		buffer.resize(count);
+	return buffer.data();
+}
+
+template<typename T>
+static void scaleMatrix(MatrixView<T> c, T beta)
+{
+	if (beta == 1)
+		return;
+	for (int r = 0; r < c.rows(); r++)
+	{
+		T * row = c[r];
+		if (beta == 0)
+			std::fill(row, row + c.cols(), T(0));
+		else
+			for (int j = 0; j < c.cols(); j++)
+				row[j] *= beta;
+	}
+}
+
+/*
+ * When sigmoidActs is not null, every block of rows of c is multiplied by the sigmoid derivative
+ * of the matching activations right after its last product is added.
+ */
+template<typename T>
+static void gemmImpl(Transpose transA, Transpose transB, T alpha, MatrixView<const T> a, MatrixView<const T> b,
+		T beta, MatrixView<T> c, const T * sigmoidActs = nullptr)
+{
+	int m = c.rows(), n = c.cols();
+	int k = transA == TRANSPOSE ? a.rows() : a.cols();
+	scaleMatrix(c, beta);
+	if (m == 0 || n == 0 || k == 0 || alpha == 0)
+	{
+		if (sigmoidActs)
+			scaleBySigmoidDerivative(sigmoidActs, c.data(), c.size());
+		return;
+	}
+
+	const KernelSet<T> & kernels = activeKernels<T>();
+	int mr = kernels.mr, nr = kernels.nr;
+	thread_local AlignedBuffer<T> packedA, packedB;
+	int roundedM = (std::min(m, MC) + mr - 1) / mr * mr;
+	int roundedN = (std::min(n, NC) + nr - 1) / nr * nr;
+	T * aPanels = scratch(packedA, (std::size_t) roundedM * std::min(k, KC));
+	T * bPanels = scratch(packedB, (std::size_t) roundedN * std::min(k, KC));
+	std::size_t ldc = c.cols();
+
+	for (int jc = 0; jc < n; jc += NC)
+	{
+		int nc = std::min(NC, n - jc);
+		for (int pc = 0; pc < k; pc += KC)
+		{
+			int kc = std::min(KC, k - pc);
+			packB(b, transB, pc, jc, kc, nc, nr, bPanels);
+			for (int ic = 0; ic < m; ic += MC)
+			{
+				int mc = std::min(MC, m - ic);
+				packA(a, transA, ic, pc, mc, kc, mr, aPanels);
+				for (int jr = 0; jr < nc; jr += nr)
+				{
+					int cols = std::min(nr, nc - jr);
+					const T * bPanel = bPanels + (std::size_t) jr * kc;
+					for (int ir = 0; ir < mc; ir += mr)
+					{
+						int rows = std::min(mr, mc - ir);
+						const T * aPanel = aPanels + (std::size_t) ir * kc;
+						T * tile = c[ic + ir] + jc + jr;
+						if (rows == mr && cols == nr)
+						{
+							kernels.micro(kc, aPanel, bPanel, tile, ldc, alpha);
+							continue;
+						}
+						//Edge tiles are computed in full and only the valid part is added to c.
+						alignas(64) T edge[MAX_TILE_BYTES / sizeof(T)] = {};
+						kernels.micro(kc, aPanel, bPanel, edge, nr, alpha);
+						for (int i = 0; i < rows; i++)
+							for (int j = 0; j < cols; j++)
+								tile[i * ldc + j] += edge[i * nr + j];
+					}
+				}
+				if (sigmoidActs && pc + kc == k)
+				{
+					//These mc x nc values of c are final and were just written. Full rows are contiguous.
+					if (nc == n)
+						scaleBySigmoidDerivative(sigmoidActs + ic * ldc, c[ic], (std::size_t) mc * n);
+					else
+						for (int i = ic; i < ic + mc; i++)
+							scaleBySigmoidDerivative(sigmoidActs + i * ldc + jc, c[i] + jc, nc);
+				}
+			}
+		}
+	}
+}
+
+template<typename T>
+static void gemvImpl(Transpose transA, T alpha, MatrixView<const T> a, const T * x, T beta, T * y)
+{
+	int n = transA == TRANSPOSE ? a.cols() : a.rows();
+	if (beta == 0)
+		std::fill(y, y + n, T(0));
+	else if (beta != 1)
+		for (int i = 0; i < n; i++)
+			y[i] *= beta;
+	if (alpha == 0 || a.size() == 0)
+		return;
+	const KernelSet<T> & kernels = activeKernels<T>();
+	if (transA == TRANSPOSE)
+		kernels.gemvT(alpha, a, x, y);
+	else
+		kernels.gemvN(alpha, a, x, y);
+}
+
+void gemm(Transpose transA, Transpose transB, double alpha, MatrixView<const double> a,
+		MatrixView<const double> b, double beta, MatrixView<double> c)
+{
+	gemmImpl(transA, transB, alpha, a, b, beta, c);
+}
+
+void gemm(Transpose transA, Transpose transB, float alpha, MatrixView<const float> a,
+		MatrixView<const float> b, float beta, MatrixView<float> c)
+{
+	gemmImpl(transA, transB, alpha, a, b, beta, c);
+}
+
+/*
+ * A single row is a gemv with the transposed weights, which the gemv kernel reads in place.
+ * The row is then small enough that the derivative pass reads it straight back out of L1.
+ */
+template<typename T>
+static void gemmSigmoidBackwardImpl(MatrixView<const T> a, MatrixView<const T> b, const T * acts, MatrixView<T> c)
+{
+	if (c.rows() == 1)
+	{
+		gemvImpl(TRANSPOSE, T(1), b, a.data(), T(0), c.data());
+		scaleBySigmoidDerivative(acts, c.data(), c.cols());
+		return;
+	}
+	gemmImpl(NO_TRANSPOSE, NO_TRANSPOSE, T(1), a, b, T(0), c, acts);
+}
+
+void gemmSigmoidBackward(MatrixView<const double> a, MatrixView<const double> b, const double * acts,
+		MatrixView<double> c)
+{
+	gemmSigmoidBackwardImpl(a, b, acts, c);
+}
+
+void gemmSigmoidBackward(MatrixView<const float> a, MatrixView<const float> b, const float * acts,
+		MatrixView<float> c)
+{
+	gemmSigmoidBackwardImpl(a, b, acts, c);
+}
+
+void gemv(Transpose transA, double alpha, MatrixView<const double> a, const double * x, double beta,
+		double * y)
+{
+	gemvImpl(transA, alpha, a, x, beta, y);
+}
+
+void gemv(Transpose transA, float alpha, MatrixView<const float> a, const float * x, float beta, float * y)
+{
+	gemvImpl(transA, alpha, a, x, beta, y);
+}
+
+/*
+ * Sparse dot products. Every row's nonzeros are multiplied by x gathered at their columns, 16 or 32 at
+ * a time in two accumulators on the SIMD paths, and the last few one at a time.
+ */
+template<typename T>
+static void csrGemvScalar(const CsrMatrix<T> & a, const T * x, T * y)
+{
+	const std::int32_t * columns = a.columns.data();
+	const T * values = a.values.data();
+	for (int r = 0; r < a.rows; r++)
+	{
+		T total = 0;
+		for (int k = a.rowStarts[r]; k < a.rowStarts[r + 1]; k++)
+			total += values[k] * x[columns[k]];
+		y[r] += total;
+	}
+}
+
+#ifdef KERNELS_X86
+
+/*
+ * x at the given columns. The masked gathers start from zero; the unmasked ones merge into an
+ * undefined register, which costs a false dependency and a spurious warning from GCC.
+ */
+__attribute__((target("avx2,fma")))
+static inline __m256d gatherAvx2(const double * x, __m128i columns)
+{
+	return _mm256_mask_i32gather_pd(_mm256_setzero_pd(), x, columns, _mm256_castsi256_pd(_mm256_set1_epi64x(-1)), 8);
+}
+
+__attribute__((target("avx2,fma")))
+static inline __m256 gatherAvx2(const float * x, __m256i columns)
+{
+	return _mm256_mask_i32gather_ps(_mm256_setzero_ps(), x, columns, _mm256_castsi256_ps(_mm256_set1_epi32(-1)), 4);
+}
+
+__attribute__((target("avx512f")))
+static inline __m512d gatherAvx512(const double * x, __m256i columns)
+{
+	return _mm512_mask_i32gather_pd(_mm512_setzero_pd(), 0xff, columns, x, 8);
+}
+
+__attribute__((target("avx512f")))
+static inline __m512 gatherAvx512(const float * x, __m512i columns)
+{
+	return _mm512_mask_i32gather_ps(_mm512_setzero_ps(), 0xffff, columns, x, 4);
+}
+
+__attribute__((target("avx2,fma")))
+static void csrGemvAvx2(const CsrMatrix<double> & a, const double * x, double * y)
+{
+	const std::int32_t * columns = a.columns.data();
+	const double * values = a.values.data();
+	for (int r = 0; r < a.rows; r++)
+	{
+		int k = a.rowStarts[r], end = a.rowStarts[r + 1];
+		__m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+		for (; k + 8 <= end; k += 8)
+		{
+			__m128i c0 = _mm_loadu_si128((const __m128i *) (columns + k));
+			__m128i c1 = _mm_loadu_si128((const __m128i *) (columns + k + 4));
+			s0 = _mm256_fmadd_pd(_mm256_loadu_pd(values + k), gatherAvx2(x, c0), s0);
+			s1 = _mm256_fmadd_pd(_mm256_loadu_pd(values + k + 4), gatherAvx2(x, c1), s1);
+		}
+		double total = sumAvx2(_mm256_add_pd(s0, s1));
+		for (; k < end; k++)
+			total += values[k] * x[columns[k]];
+		y[r] += total;
+	}
+}
+
+__attribute__((target("avx2,fma")))
+static void csrGemvAvx2(const CsrMatrix<float> & a, const float * x, float * y)
+{
+	const std::int32_t * columns = a.columns.data();
+	const float * values = a.values.data();
+	for (int r = 0; r < a.rows; r++)
+	{
+		int k = a.rowStarts[r], end = a.rowStarts[r + 1];
+		__m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+		for (; k + 16 <= end; k += 16)
+		{
+			__m256i c0 = _mm256_loadu_si256((const __m256i *) (columns + k));
+			__m256i c1 = _mm256_loadu_si256((const __m256i *) (columns + k + 8));
+			s0 = _mm256_fmadd_ps(_mm256_loadu_ps(values + k), gatherAvx2(x, c0), s0);
+			s1 = _mm256_fmadd_ps(_mm256_loadu_ps(values + k + 8), gatherAvx2(x, c1), s1);
+		}
+		float total = sumAvx2(_mm256_add_ps(s0, s1));
+		for (; k < end; k++)
+			total += values[k] * x[columns[k]];
+		y[r] += total;
+	}
+}
+
+__attribute__((target("avx512f")))
+static void csrGemvAvx512(const CsrMatrix<double> & a, const double * x, double * y)
+{
+	const std::int32_t * columns = a.columns.data();
+	const double * values = a.values.data();
+	for (int r = 0; r < a.rows; r++)
+	{
+		int k = a.rowStarts[r], end = a.rowStarts[r + 1];
+		__m512d s0 = _mm512_setzero_pd(), s1 = _mm512_setzero_pd();
+		for (; k + 16 <= end; k += 16)
+		{
+			__m256i c0 = _mm256_loadu_si256((const __m256i *) (columns + k));
+			__m256i c1 = _mm256_loadu_si256((const __m256i *) (columns + k + 8));
+			s0 = _mm512_fmadd_pd(_mm512_loadu_pd(values + k), gatherAvx512(x, c0), s0);
+			s1 = _mm512_fmadd_pd(_mm512_loadu_pd(values + k + 8), gatherAvx512(x, c1), s1);
+		}
+		double total = sumAvx512(_mm512_add_pd(s0, s1));
+		for (; k < end; k++)
+			total += values[k] * x[columns[k]];
+		y[r] += total;
+	}
+}
+
+__attribute__((target("avx512f")))
+static void csrGemvAvx512(const CsrMatrix<float> & a, const float * x, float * y)
+{
+	const std::int32_t * columns = a.columns.data();
+	const float * values = a.values.data();
+	for (int r = 0; r < a.rows; r++)
+	{
+		int k = a.rowStarts[r], end = a.rowStarts[r + 1];
+		__m512 s0 = _mm512_setzero_ps(), s1 = _mm512_setzero_ps();
+		for (; k + 32 <= end; k += 32)
+		{
+			__m512i c0 = _mm512_loadu_si512(columns + k);
+			__m512i c1 = _mm512_loadu_si512(columns + k + 16);
+			s0 = _mm512_fmadd_ps(_mm512_loadu_ps(values + k), gatherAvx512(x, c0), s0);
+			s1 = _mm512_fmadd_ps(_mm512_loadu_ps(values + k + 16), gatherAvx512(x, c1), s1);
+		}
+		float total = sumAvx512(_mm512_add_ps(s0, s1));
+		for (; k < end; k++)
+			total += values[k] * x[columns[k]];
+		y[r] += total;
+	}
+}
+
+#endif /* KERNELS_X86 */
+
+template<typename T>
+static void csrGemvImpl(const CsrMatrix<T> & a, const T * x, T * y)
+{
+#ifdef KERNELS_X86
+	if (activePath() == KERNEL_AVX512)
+		return csrGemvAvx512(a, x, y);
+	if (activePath() == KERNEL_AVX2)
+		return csrGemvAvx2(a, x, y);
+#endif
+	csrGemvScalar(a, x, y);
+}
+
+void csrGemv(const CsrMatrix<double> & a, const double * x, double * y)
+{
+	csrGemvImpl(a, x, y);
+}
+
+void csrGemv(const CsrMatrix<float> & a, const float * x, float * y)
+{
+	csrGemvImpl(a, x, y);
+}
+
+//Images csrGemm transposes at a time, so that the transposed block stays in L2.
+static const int CSR_BLOCK = 64;
+
+/*
+ * zt += a * xt, where xt holds one input per row and one image per column, and so does zt. Every
+ * nonzero adds a multiple of a contiguous row of xt to a row of zt, which needs no gathers and reads
+ * the nonzero once per block of images rather than once per image. The SIMD versions keep the sums of
+ * four registers of images in registers across all of a row's nonzeros, and finish the images left
+ * over with csrAxpyScalar.
+ */
+template<typename T>
+static void csrAxpyScalar(const CsrMatrix<T> & a, const T * xt, T * zt, int images, int first = 0)
+{
+	const std::int32_t * columns = a.columns.data();
+	const T * values = a.values.data();
+	for (int r = 0; r < a.rows; r++)
+	{
+		T * z = zt + (std::size_t) r * images;
+		for (int k = a.rowStarts[r]; k < a.rowStarts[r + 1]; k++)
+		{
+			const T * row = xt + (std::size_t) columns[k] * images;
+			for (int i = first; i < images; i++)
+				z[i] += values[k] * row[i];
+		}
+	}
+}
+
+#ifdef KERNELS_X86
+
+__attribute__((target("avx2,fma")))
+static void csrAxpyAvx2(const CsrMatrix<double> & a, const double * xt, double * zt, int images)
+{
+	int full = images - images % 16;
+	for (int r = 0; r < a.rows; r++)
+		for (int i = 0; i < full; i += 16)
+		{
+			__m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd(), s2 = _mm256_setzero_pd(), s3 = _mm256_setzero_pd();
+			for (int k = a.rowStarts[r]; k < a.rowStarts[r + 1]; k++)
+			{
+				const double * row = xt + (std::size_t) a.columns[k] * images + i;
+				__m256d v = _mm256_set1_pd(a.values[k]);
+				s0 = _mm256_fmadd_pd(v, _mm256_loadu_pd(row), s0);
+				s1 = _mm256_fmadd_pd(v, _mm256_loadu_pd(row + 4), s1);
+				s2 = _mm256_fmadd_pd(v, _mm256_loadu_pd(row + 8), s2);
+				s3 = _mm256_fmadd_pd(v, _mm256_loadu_pd(row + 12), s3);
+			}
+			double * z = zt + (std::size_t) r * images + i;
+			_mm256_storeu_pd(z, _mm256_add_pd(_mm256_loadu_pd(z), s0));
+			_mm256_storeu_pd(z + 4, _mm256_add_pd(_mm256_loadu_pd(z + 4), s1));
+			_mm256_storeu_pd(z + 8, _mm256_add_pd(_mm256_loadu_pd(z + 8), s2));
+			_mm256_storeu_pd(z + 12, _mm256_add_pd(_mm256_loadu_pd(z + 12), s3));
+		}
+	csrAxpyScalar(a, xt, zt, images, full);
+}
+
+__attribute__((target("avx2,fma")))
+static void csrAxpyAvx2(const CsrMatrix<float> & a, const float * xt, float * zt, int images)
+{
+	int full = images - images % 32;
+	for (int r = 0; r < a.rows; r++)
+		for (int i = 0; i < full; i += 32)
+		{
+			__m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps(), s2 = _mm256_setzero_ps(), s3 = _mm256_setzero_ps();
+			for (int k = a.rowStarts[r]; k < a.rowStarts[r + 1]; k++)
+			{
+				const float * row = xt + (std::size_t) a.columns[k] * images + i;
+				__m256 v = _mm256_set1_ps(a.values[k]);
+				s0 = _mm256_fmadd_ps(v, _mm256_loadu_ps(row), s0);
+				s1 = _mm256_fmadd_ps(v, _mm256_loadu_ps(row + 8), s1);
+				s2 = _mm256_fmadd_ps(v, _mm256_loadu_ps(row + 16), s2);
+				s3 = _mm256_fmadd_ps(v, _mm256_loadu_ps(row + 24), s3);
+			}
+			float * z = zt + (std::size_t) r * images + i;
+			_mm256_storeu_ps(z, _mm256_add_ps(_mm256_loadu_ps(z), s0));
+			_mm256_storeu_ps(z + 8, _mm256_add_ps(_mm256_loadu_ps(z + 8), s1));
+			_mm256_storeu_ps(z + 16, _mm256_add_ps(_mm256_loadu_ps(z + 16), s2));
+			_mm256_storeu_ps(z + 24, _mm256_add_ps(_mm256_loadu_ps(z + 24), s3));
+		}
+	csrAxpyScalar(a, xt, zt, images, full);
+}
+
+__attribute__((target("avx512f")))
+static void csrAxpyAvx512(const CsrMatrix<double> & a, const double * xt, double * zt, int images)
+{
+	int full = images - images % 32;
+	for (int r = 0; r < a.rows; r++)
+		for (int i = 0; i < full; i += 32)
+		{
+			__m512d s0 = _mm512_setzero_pd(), s1 = _mm512_setzero_pd(), s2 = _mm512_setzero_pd(), s3 = _mm512_setzero_pd();
+			for (int k = a.rowStarts[r]; k < a.rowStarts[r + 1]; k++)
+			{
+				const double * row = xt + (std::size_t) a.columns[k] * images + i;
+				__m512d v = _mm512_set1_pd(a.values[k]);
+				s0 = _mm512_fmadd_pd(v, _mm512_loadu_pd(row), s0);
+				s1 = _mm512_fmadd_pd(v, _mm512_loadu_pd(row + 8), s1);
+				s2 = _mm512_fmadd_pd(v, _mm512_loadu_pd(row + 16), s2);
+				s3 = _mm512_fmadd_pd(v, _mm512_loadu_pd(row + 24), s3);
+			}
+			double * z = zt + (std::size_t) r * images + i;
+			_mm512_storeu_pd(z, _mm512_add_pd(_mm512_loadu_pd(z), s0));
+			_mm512_storeu_pd(z + 8, _mm512_add_pd(_mm512_loadu_pd(z + 8), s1));
+			_mm512_storeu_pd(z + 16, _mm512_add_pd(_mm512_loadu_pd(z + 16), s2));
+			_mm512_storeu_pd(z + 24, _mm512_add_pd(_mm512_loadu_pd(z + 24), s3));
+		}
+	csrAxpyScalar(a, xt, zt, images, full);
+}
+
+__attribute__((target("avx512f")))
+static void csrAxpyAvx512(const CsrMatrix<float> & a, const float * xt, float * zt, int images)
+{
+	int full = images - images % 64;
+	for (int r = 0; r < a.rows; r++)
+		for (int i = 0; i < full; i += 64)
+		{
+			__m512 s0 = _mm512_setzero_ps(), s1 = _mm512_setzero_ps(), s2 = _mm512_setzero_ps(), s3 = _mm512_setzero_ps();
+			for (int k = a.rowStarts[r]; k < a.rowStarts[r + 1]; k++)
+			{
+				const float * row = xt + (std::size_t) a.columns[k] * images + i;
+				__m512 v = _mm512_set1_ps(a.values[k]);
+				s0 = _mm512_fmadd_ps(v, _mm512_loadu_ps(row), s0);
+				s1 = _mm512_fmadd_ps(v, _mm512_loadu_ps(row + 16), s1);
+				s2 = _mm512_fmadd_ps(v, _mm512_loadu_ps(row + 32), s2);
+				s3 = _mm512_fmadd_ps(v, _mm512_loadu_ps(row + 48), s3);
+			}
+			float * z = zt + (std::size_t) r * images + i;
+			_mm512_storeu_ps(z, _mm512_add_ps(_mm512_loadu_ps(z), s0));
+			_mm512_storeu_ps(z + 16, _mm512_add_ps(_mm512_loadu_ps(z + 16), s1));
+			_mm512_storeu_ps(z + 32, _mm512_add_ps(_mm512_loadu_ps(z + 32), s2));
+			_mm512_storeu_ps(z + 48, _mm512_add_ps(_mm512_loadu_ps(z + 48), s3));
+		}
+	csrAxpyScalar(a, xt, zt, images, full);
+}
+
+#endif /* KERNELS_X86 */
+
+/*
+ * A single image goes straight to csrGemv. Larger batches are transposed a block at a time and go
+ * through csrAxpy, and the transposed result is added back into c.
+ */
+template<typename T>
+static void csrGemmImpl(const CsrMatrix<T> & a, MatrixView<const T> x, MatrixView<T> c)
+{
+	if (x.rows() == 1)
+		return csrGemvImpl(a, x[0], c[0]);
+	thread_local AlignedBuffer<T> xBuffer, zBuffer;
+	for (int first = 0; first < x.rows(); first += CSR_BLOCK)
+	{
+		int images = std::min(CSR_BLOCK, x.rows() - first);
+		T * xt = scratch(xBuffer, (std::size_t) a.cols * images);
+		T * zt = scratch(zBuffer, (std::size_t) a.rows * images);
+		//Writing xt in order keeps each image's row of x in L1 for 8 columns in a row.
+		for (int col = 0; col < a.cols; col++)
+			for (int i = 0; i < images; i++)
+				xt[(std::size_t) col * images + i] = x[first + i][col];
+		std::fill(zt, zt + (std::size_t) a.rows * images, T(0));
+#ifdef KERNELS_X86
+		if (activePath() == KERNEL_AVX512)
+			csrAxpyAvx512(a, xt, zt, images);
+		else if (activePath() == KERNEL_AVX2)
+			csrAxpyAvx2(a, xt, zt, images);
+		else
+#endif
+			csrAxpyScalar(a, xt, zt, images);
+		for (int i = 0; i < images; i++)
+			for (int r = 0; r < a.rows; r++)
+				c[first + i][r] += zt[(std::size_t) r * images + i];
+	}
+}
+
+void csrGemm(const CsrMatrix<double> & a, MatrixView<const double> x, MatrixView<double> c)
+{
+	csrGemmImpl(a, x, c);
+}
+
+void csrGemm(const CsrMatrix<float> & a, MatrixView<const float> x, MatrixView<float> c)
+{
+	csrGemmImpl(a, x, c);
+}
+
+/*
+ * Quantized dot products. x is unsigned and a is signed, so every product fits in 16 bits but a pair
+ * of them does not; VPMADDUBSW would saturate. The AVX2 version widens to 16 bits and uses VPMADDWD,
+ * and the VNNI version accumulates straight into 32 bits with VPDPBUSD.
+ */
+static void gemvU8S8Scalar(const std::int8_t * a, int rows, int cols, std::size_t stride, const std::uint8_t * x,
+		std::int32_t * y)
+{
+	for (int r = 0; r < rows; r++, a += stride)
+	{
+		std::int32_t total = 0;
+		for (int c = 0; c < cols; c++)
+			total += a[c] * x[c];
+		y[r] = total;
+	}
+}
+
+#ifdef KERNELS_X86
+
+__attribute__((target("avx2")))
+static inline std::int32_t sumAvx2(__m256i v)
+{
+	__m128i low = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+	low = _mm_add_epi32(low, _mm_shuffle_epi32(low, 0x4e));
+	return _mm_cvtsi128_si32(_mm_add_epi32(low, _mm_shuffle_epi32(low, 0xb1)));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i maddU8S8(__m256i x16, const std::int8_t * a)
+{
+	return _mm256_madd_epi16(x16, _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *) a)));
+}
+
+//Two rows share every widened load of x.
+__attribute__((target("avx2")))
+static void gemvU8S8Avx2(const std::int8_t * a, int rows, int cols, std::size_t stride, const std::uint8_t * x,
+		std::int32_t * y)
+{
+	int full = cols - cols % 16, r = 0;
+	for (; r + 2 <= rows; r += 2)
+	{
+		const std::int8_t * a0 = a + r * stride, * a1 = a0 + stride;
+		__m256i s0 = _mm256_setzero_si256(), s1 = _mm256_setzero_si256();
+		for (int c = 0; c < full; c += 16)
+		{
+			__m256i x16 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (x + c)));
+			s0 = _mm256_add_epi32(s0, maddU8S8(x16, a0 + c));
+			s1 = _mm256_add_epi32(s1, maddU8S8(x16, a1 + c));
+		}
+		std::int32_t t0 = sumAvx2(s0), t1 = sumAvx2(s1);
+		for (int c = full; c < cols; c++)
+		{
+			t0 += a0[c] * x[c];
+			t1 += a1[c] * x[c];
+		}
+		y[r] = t0;
+		y[r + 1] = t1;
+	}
+	if (r < rows)
+		gemvU8S8Scalar(a + r * stride, rows - r, cols, stride, x, y + r);
+}
+
+__attribute__((target("avx512f")))
+static inline std::int32_t sumAvx512(__m512i v)
+{
+	alignas(64) std::int32_t lanes[16];
+	_mm512_store_si512(lanes, v);
+	std::int32_t total = 0;
+	for (int i = 0; i < 16; i++)
+		total += lanes[i];
+	return total;
+}
+
+__attribute__((target("avx512f,avx512bw,avx512vnni")))
+static void gemvU8S8Vnni(const std::int8_t * a, int rows, int cols, std::size_t stride, const std::uint8_t * x,
+		std::int32_t * y)
+{
+	__mmask64 tail = cols % 64 ? (~0ULL >> (64 - cols % 64)) : 0;
+	int full = cols - cols % 64, r = 0;
+	for (; r + 4 <= rows; r += 4)
+	{
+		const std::int8_t * a0 = a + r * stride, * a1 = a0 + stride, * a2 = a1 + stride, * a3 = a2 + stride;
+		__m512i s0 = _mm512_setzero_si512(), s1 = _mm512_setzero_si512();
+		__m512i s2 = _mm512_setzero_si512(), s3 = _mm512_setzero_si512();
+		for (int c = 0; c < full; c += 64)
+		{
+			__m512i xv = _mm512_loadu_si512(x + c);
+			s0 = _mm512_dpbusd_epi32(s0, xv, _mm512_loadu_si512(a0 + c));
+			s1 = _mm512_dpbusd_epi32(s1, xv, _mm512_loadu_si512(a1 + c));
+			s2 = _mm512_dpbusd_epi32(s2, xv, _mm512_loadu_si512(a2 + c));
+			s3 = _mm512_dpbusd_epi32(s3, xv, _mm512_loadu_si512(a3 + c));
+		}
+		if (tail)
+		{
+			__m512i xv = _mm512_maskz_loadu_epi8(tail, x + full);
+			s0 = _mm512_dpbusd_epi32(s0, xv, _mm512_maskz_loadu_epi8(tail, a0 + full));
+			s1 = _mm512_dpbusd_epi32(s1, xv, _mm512_maskz_loadu_epi8(tail, a1 + full));
+			s2 = _mm512_dpbusd_epi32(s2, xv, _mm512_maskz_loadu_epi8(tail, a2 + full));
+			s3 = _mm512_dpbusd_epi32(s3, xv, _mm512_maskz_loadu_epi8(tail, a3 + full));
+		}
+		y[r] = sumAvx512(s0);
+		y[r + 1] = sumAvx512(s1);
+		y[r + 2] = sumAvx512(s2);
+		y[r + 3] = sumAvx512(s3);
+	}
+	for (; r < rows; r++)
+	{
+		const std::int8_t * a0 = a + r * stride;
+		__m512i s0 = _mm512_setzero_si512();
+		for (int c = 0; c < full; c += 64)
+			s0 = _mm512_dpbusd_epi32(s0, _mm512_loadu_si512(x + c), _mm512_loadu_si512(a0 + c));
+		if (tail)
+			s0 = _mm512_dpbusd_epi32(s0, _mm512_maskz_loadu_epi8(tail, x + full), _mm512_maskz_loadu_epi8(tail, a0 + full));
+		y[r] = sumAvx512(s0);
+	}
+}
+
+#endif /* KERNELS_X86 */
+
+void gemvU8S8(const std::int8_t * a, int rows, int cols, std::size_t stride, const std::uint8_t * x,
+		std::int32_t * y)
+{
+#ifdef KERNELS_X86
+	static const bool vnni = __builtin_cpu_supports("avx512vnni") && __builtin_cpu_supports("avx512bw");
+	if (activePath() == KERNEL_AVX512 && vnni)
+		return gemvU8S8Vnni(a, rows, cols, stride, x, y);
+	if (activePath() >= KERNEL_AVX2)
+		return gemvU8S8Avx2(a, rows, cols, stride, x, y);
+#endif
+	gemvU8S8Scalar(a, rows, cols, stride, x, y);
+}
@@ -0,0 +1,91 @@
+/*
+ * Author: Shuhao Lai
+ * Date: 10/17/2026
+ * Kernels.h
+ */
+
+#ifndef KERNELS_H_
+#define KERNELS_H_
+
+#include <cstdint>
+#include "Matrix.h"
+
+/*
+ * Dense linear algebra used by the network. Operands are row major views and
+ * can be used transposed without ever materializing the transpose.
+ * Every kernel comes in double and float versions; float fits twice as many lanes in a register.
+ */
+
+enum Transpose
+{
+	NO_TRANSPOSE, TRANSPOSE
+};
+
+//Instruction sets a kernel can be run with. Higher values are faster when the CPU supports them.
+enum KernelPath
+{
+	KERNEL_SCALAR, KERNEL_AVX2, KERNEL_AVX512
+};
+
+/*
+ * c = alpha * op(a) * op(b) + beta * c where op(x) is x or transpose(x).
+ * c must be op(a).rows() by op(b).cols(). When beta is 0, c does not need to be initialized.
+ */
+void gemm(Transpose transA, Transpose transB, double alpha, MatrixView<const double> a,
+		MatrixView<const double> b, double beta, MatrixView<double> c);
+void gemm(Transpose transA, Transpose transB, float alpha, MatrixView<const float> a,
+		MatrixView<const float> b, float beta, MatrixView<float> c);
+
+/*
+ * c = (a * b) ⊙ acts ⊙ (1 - acts), the step of backpropagation through a sigmoid layer. a holds the
+ * errors of the next layer with one row per image, b is the weight matrix into that layer, so a * b
+ * is transpose(b) times each error without transposing b, and acts holds this layer's activations
+ * laid out like c. Each block of c is scaled by the derivative as soon as it is final, while it is
+ * still in cache, instead of in a second pass over c.
+ */
+void gemmSigmoidBackward(MatrixView<const double> a, MatrixView<const double> b, const double * acts,
+		MatrixView<double> c);
+void gemmSigmoidBackward(MatrixView<const float> a, MatrixView<const float> b, const float * acts,
+		MatrixView<float> c);
+
+/*
+ * y = alpha * op(a) * x + beta * y, where x and y are column vectors.
+ * When beta is 0, y does not need to be initialized.
+ */
+void gemv(Transpose transA, double alpha, MatrixView<const double> a, const double * x, double beta,
+		double * y);
+void gemv(Transpose transA, float alpha, MatrixView<const float> a, const float * x, float beta,
+		float * y);
+
+/*
+ * Sparse versions of gemv and gemm for pruned weights. csrGemv does y += a * x. csrGemm does the same
+ * for every row of x, c[i] += a * x[i], so with one image per row of x and c it is the sparse form of
+ * gemm(NO_TRANSPOSE, TRANSPOSE, 1, x, a, 1, c). csrGemv gathers an element of x for every nonzero and
+ * only beats gemv below about 20% density. csrGemm transposes x a block of images at a time so every
+ * nonzero scales a contiguous row, and beats gemm up to about 40%.
+ */
+void csrGemv(const CsrMatrix<double> & a, const double * x, double * y);
+void csrGemv(const CsrMatrix<float> & a, const float * x, float * y);
+void csrGemm(const CsrMatrix<double> & a, MatrixView<const double> x, MatrixView<double> c);
+void csrGemm(const CsrMatrix<float> & a, MatrixView<const float> x, MatrixView<float> c);
+
+/*
+ * y[r] = sum of a[r][c] * x[c] for a rows x cols int8 matrix whose rows start stride bytes apart and
+ * an unsigned 8 bit vector x. The sums are exact. Used by quantized inference, where the AVX-512
+ * path needs VNNI (VPDPBUSD) and otherwise falls back to the AVX2 version.
+ */
+void gemvU8S8(const std::int8_t * a, int rows, int cols, std::size_t stride, const std::uint8_t * x,
+		std::int32_t * y);
+
+//The path every kernel call currently uses. Picked from the CPU at startup.
+KernelPath kernelPath();
+
+//Forces a path, mostly for tests and benchmarks. Paths the CPU does not support fall back to the best one it does.
+void setKernelPath(KernelPath path);
+
+//Best path the CPU running the program supports.
+KernelPath bestKernelPath();
+
+const char * kernelPathName(KernelPath path);
+
+#endif /* KERNELS_H_ */
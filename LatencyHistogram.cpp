@@ -0,0 +1,70 @@
+/*
+ * Author: Shuhao Lai
+ * Date: 10/17/2026
+ * LatencyHistogram.cpp
+ */
+#include <cmath>
+#include "LatencyHistogram.h"
+
+//Buckets per power of two, and enough powers of two to cover over an hour in microseconds.
+static const int BUCKETS_PER_DOUBLING = 16;
+static const int DOUBLINGS = 32;
+
+//Bucket i holds latencies up to 2^((i + 1) / 16) - 1 microseconds.
+static int bucketOf(double micros)
+{
+	if (!(micros > 0))
+		return 0;
+	int bucket = (int) (std::log2(micros + 1) * BUCKETS_PER_DOUBLING);
+	return bucket < BUCKETS_PER_DOUBLING * DOUBLINGS ? bucket : BUCKETS_PER_DOUBLING * DOUBLINGS - 1;
+}
+
+static double upperEdge(int bucket)
+{
+	return std::exp2((double) (bucket + 1) / BUCKETS_PER_DOUBLING) - 1;
+}
+
+LatencyHistogram::LatencyHistogram() :
+		buckets(BUCKETS_PER_DOUBLING * DOUBLINGS, 0), total(0), sum(0)
+{
+}
+
+void LatencyHistogram::record(double micros)
+{
+	++buckets[bucketOf(micros)];
+	++total;
+	sum += micros;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram & other)
+{
+	for (std::size_t i = 0; i < buckets.size(); i++)
+		buckets[i] += other.buckets[i];
+	total += other.total;
+	sum += other.sum;
+}
+
+void LatencyHistogram::clear()
+{
+	buckets.assign(buckets.size(), 0);
+	total = 0;
+	sum = 0;
+}
+
+double LatencyHistogram::percentile(double percent) const
+{
+	if (total == 0)
+		return 0;
+	//The rank of the value we want, counting from 1.
+	long rank = (long) std::ceil(percent / 100 * total);
+	if (rank < 1)
+		rank = 1;
+	long seen = 0;
+	for (std::size_t i = 0; i < buckets.size(); i++)
+	{
+		seen += buckets[i];
+		if (seen >= rank)
+			return upperEdge(i);
+	}
+	return upperEdge(buckets.size() - 1);
+}
@@ -0,0 +1,47 @@
+/*
+ * Author: Shuhao Lai
+ * Date: 10/17/2026
+ * LatencyHistogram.h
+ */
+
+#ifndef LATENCYHISTOGRAM_H_
+#define LATENCYHISTOGRAM_H_
+
+#include <vector>
+
+/*
+ * Counts latencies in logarithmic buckets so percentiles can be read at any time in constant memory.
+ * Each power of two is split into 16 buckets, so a percentile is within about 4.5% of the true value.
+ * Not thread safe; keep one per thread and merge, or guard it with a lock.
+ */
+class LatencyHistogram
+{
+public:
+	LatencyHistogram();
+
+	void record(double micros);
+
+	void merge(const LatencyHistogram & other);
+
+	void clear();
+
+	long count() const
+	{
+		return total;
+	}
+
+	//Latency in microseconds that percent of the recorded values are at or below. 0 when empty.
+	double percentile(double percent) const;
+
+	double meanMicros() const
+	{
+		return total == 0 ? 0 : sum / total;
+	}
+
+private:
+	std::vector<long> buckets;
+	long total;
+	double sum;
+};
+
+#endif /* LATENCYHISTOGRAM_H_ */
@@ -0,0 +1,170 @@
+/*
+ * Author: Shuhao Lai
+ * Date: 10/17/2026
+ * LoadGenerator.cpp
+ *
+ * Benchmarks a running Server. Each connection keeps depth requests in flight for the given number of
+ * seconds, then the client's latency percentiles and throughput are printed next to the server's own.
+ * Images come from a dataset, which also gives an accuracy check, or are random when none is given.
+ *   LoadGenerator /tmp/digits.sock [connections] [depth] [seconds] [mnist_test.csv]
+ */
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include "Dataset.h"
+#include "InferenceServer.h"
+#include "LatencyHistogram.h"
+
+//Pixels in each random image when no dataset is given.
+static const int SYNTHETIC_PIXELS = 784;
+static const int SYNTHETIC_IMAGES = 1000;
+
+struct ClientResult
+{
+	LatencyHistogram latency;
+	long correct = 0;
+	long failed = 0;
+	bool ok = true;
+};
+
+/*
+ * Request ids are slot + generation * depth, so a response's slot is its id % depth no matter
+ * what order responses come back in.
+ */
+static void runClient(const std::string & address, const Dataset & images,
+		const std::vector<std::uint8_t> & synthetic, int depth, double seconds, int seed, ClientResult & result)
+{
+	int fd = connectToServer(address);
+	if (fd < 0)
+	{
+		result.ok = false;
+		return;
+	}
+	bool labelled = images.isOpen();
+	std::size_t count = labelled ? images.size() : SYNTHETIC_IMAGES;
+	int imageSize = labelled ? images.imageSize() : SYNTHETIC_PIXELS;
+	std::default_random_engine e(seed);
+	std::vector<std::chrono::steady_clock::time_point> sentAt(depth);
+	std::vector<std::size_t> imageOf(depth);
+	std::vector<std::uint8_t> message(sizeof(RequestHeader) + imageSize);
+
+	auto send = [&](std::uint32_t id)
+	{
+		std::size_t image = e() % count;
+		RequestHeader header = { REQUEST_CLASSIFY, id, (std::uint32_t) imageSize, 0 };
+		std::copy((const std::uint8_t *) &header, (const std::uint8_t *) (&header + 1), message.begin());
+		const std::uint8_t * pixels = labelled ? images.pixels(image) : synthetic.data() + image * imageSize;
+		std::copy(pixels, pixels + imageSize, message.begin() + sizeof(RequestHeader));
+		imageOf[id % depth] = image;
+		sentAt[id % depth] = std::chrono::steady_clock::now();
+		return writeFully(fd, message.data(), message.size());
+	};
+
+	auto end = std::chrono::steady_clock::now() + std::chrono::duration<double>(seconds);
+	int inFlight = 0;
+	for (int slot = 0; slot < depth; slot++, inFlight++)
+		if (!send(slot))
+			result.ok = false;
+	ResponseHeader response;
+	while (result.ok && inFlight > 0 && readFully(fd, &response, sizeof(response)))
+	{
+		auto now = std::chrono::steady_clock::now();
+		int slot = response.id % depth;
+		result.latency.record(std::chrono::duration<double, std::micro>(now - sentAt[slot]).count());
+		if (response.status != INFERENCE_OK)
+			++result.failed;
+		else if (labelled && response.label == images.label(imageOf[slot]))
+			++result.correct;
+		--inFlight;
+		if (now < end)
+		{
+			if (!send(response.id + depth))
+				break;
+			++inFlight;
+		}
+	}
+	if (inFlight > 0)
+		result.ok = false;
+	close(fd);
+}
+
+//Asks the server for its counters. False if it could not be reached.
+static bool fetchStats(const std::string & address, ServerStats & stats)
+{
+	int fd = connectToServer(address);
+	if (fd < 0)
+		return false;
+	RequestHeader header = { REQUEST_STATS, 0, 0, 0 };
+	ResponseHeader response;
+	bool ok = writeFully(fd, &header, sizeof(header)) && readFully(fd, &response, sizeof(response))
+			&& response.size == sizeof(stats) && readFully(fd, &stats, sizeof(stats));
+	close(fd);
+	return ok;
+}
+
+int main(int argc, char ** argv)
+{
+	if (argc < 2 || argc > 6)
+	{
+		std::cout << "Usage: " << argv[0] << " address [connections] [depth] [seconds] [dataset]" << std::endl;
+		return 1;
+	}
+	std::string address = argv[1];
+	int connections = argc > 2 ? std::max(std::atoi(argv[2]), 1) : 4;
+	int depth = argc > 3 ? std::max(std::atoi(argv[3]), 1) : 8;
+	double seconds = argc > 4 ? std::atof(argv[4]) : 5;
+	Dataset images;
+	if (argc > 5)
+	{
+		images = Dataset::load(argv[5]);
+		if (!images.isOpen() || images.size() == 0)
+			return 1;
+	}
+	std::vector<std::uint8_t> synthetic((std::size_t) SYNTHETIC_IMAGES * SYNTHETIC_PIXELS);
+	std::default_random_engine e(1);
+	for (std::uint8_t & pixel : synthetic)
+		pixel = e() % 256;
+
+	ServerStats before;
+	if (!fetchStats(address, before))
+		return 1;
+
+	std::vector<ClientResult> results(connections);
+	std::vector<std::thread> clients;
+	auto begin = std::chrono::steady_clock::now();
+	for (int c = 0; c < connections; c++)
+		clients.emplace_back(runClient, address, std::cref(images), std::cref(synthetic), depth, seconds, c + 1,
+				std::ref(results[c]));
+	for (std::thread & client : clients)
+		client.join();
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+	ClientResult total;
+	for (const ClientResult & result : results)
+	{
+		total.latency.merge(result.latency);
+		total.correct += result.correct;
+		total.failed += result.failed;
+		total.ok = total.ok && result.ok;
+	}
+	std::cout << "Client: " << total.latency.count() << " requests over " << connections << " connections x "
+			<< depth << " in flight, " << total.latency.count() / elapsed << " requests/s, p50 "
+			<< total.latency.percentile(50) << " us, p99 " << total.latency.percentile(99) << " us" << std::endl;
+	if (images.isOpen())
+		std::cout << "Accuracy: " << 100.0 * total.correct / std::max(total.latency.count(), 1L) << "%" << std::endl;
+	if (total.failed > 0)
+		std::cout << total.failed << " requests were rejected" << std::endl;
+
+	ServerStats after;
+	if (fetchStats(address, after))
+		std::cout << "Server: " << after.requests - before.requests << " requests in "
+				<< after.batches - before.batches << " batches (mean "
+				<< (double) (after.requests - before.requests) / std::max<std::uint64_t>(after.batches - before.batches, 1)
+				<< "), lifetime p50 " << after.p50Micros << " us, p99 " << after.p99Micros << " us" << std::endl;
+	return total.ok ? 0 : 1;
+}
@@ -5,29 +5,272 @@
  * Main.cpp
  */
 #include <iostream>
-#include <ctime>
+#include <chrono>
+#include <cstdlib>
+#include <csignal>
+#include <cstring>
 #include "DigitClassifier.h"
+#include "Checkpoint.h"
+#include "QuantizedClassifier.h"
+#include "RingTransport.h"
+#include "Metrics.h"
 
-int main()
+/*
+ * Trains one epoch with 1 to maxThreads threads, all from the same starting weights,
+ * and prints how the wall time scales. Run as: Main --scaling 32
+ */
+void reportScaling(int maxThreads)
+{
+	std::vector<int> conditions = {784, 30, 10};
+	DigitClassifier start(conditions);
+	DigitClassifier::labeledImages images = start.getImages("mnist_train.csv");
+	double oneThread = 0;
+	for (int threads = 1; threads <= maxThreads; threads++)
+	{
+		DigitClassifier test(start);
+		auto begin = std::chrono::steady_clock::now();
+		test.SGD(images, 1, 20, 3, threads);
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+		if (threads == 1)
+			oneThread = seconds;
+		std::cout << threads << " threads: " << seconds << " s/epoch, " << images.size() / seconds
+				<< " images/s, speedup " << oneThread / seconds << std::endl;
+	}
+}
+
+/*
+ * Trains synchronous and Hogwild SGD with the same thread count from the same starting weights,
+ * one epoch at a time, and prints the training time each needs to reach the target test accuracy.
+ * Evaluation time is not counted. Run as: Main --hogwild 32 95
+ */
+void reportTimeToAccuracy(int threads, double target)
+{
+	std::vector<int> conditions = {784, 30, 10};
+	DigitClassifier start(conditions);
+	DigitClassifier::labeledImages images = start.getImages("mnist_train.csv");
+	DigitClassifier::labeledImages tests = start.getImages("mnist_test.csv");
+	const char * names[] = {"synchronous", "hogwild"};
+	DigitClassifier::TrainingMode modes[] = {DigitClassifier::SYNCHRONOUS, DigitClassifier::HOGWILD};
+	for (int m = 0; m < 2; m++)
+	{
+		DigitClassifier test(start);
+		double seconds = 0, accuracy = 0;
+		int epochs = 0;
+		while (accuracy < target && epochs < 30)
+		{
+			auto begin = std::chrono::steady_clock::now();
+			test.SGD(images, 1, 20, 3, threads, modes[m]);
+			seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+			accuracy = test.evaluate(tests).accuracy();
+			++epochs;
+		}
+		std::cout << names[m] << ": " << accuracy << "% after " << epochs << " epochs, " << seconds
+				<< " s training, " << epochs * images.size() / seconds << " images/s" << std::endl;
+	}
+}
+
+/*
+ * Quantizes a saved model, calibrating on the training set, and prints how the int8 model compares
+ * with the double one on the test set. Run as: Main --quantize Trained.txt
+ */
+void reportQuantization(const std::string & modelPath)
+{
+	DigitClassifier model(modelPath);
+	Dataset training = Dataset::load("mnist_train.csv");
+	Dataset tests = Dataset::load("mnist_test.csv");
+	if (!training.isOpen() || !tests.isOpen())
+		return;
+	QuantizedClassifier quantized(model, training);
+	EvaluationReport full = model.evaluate(tests);
+	EvaluationReport reduced = quantized.evaluate(tests);
+	long agree = 0;
+	for (std::size_t i = 0; i < tests.size(); i++)
+	{
+		std::vector<double> pixels(tests.imageSize());
+		for (int p = 0; p < tests.imageSize(); p++)
+			pixels[p] = tests.pixels(i)[p] / 255.0;
+		agree += model.classify(pixels) == quantized.classify(tests.pixels(i));
+	}
+	std::cout << "double: " << full.accuracy() << "% accuracy, " << full.imagesPerSecond() << " images/s, "
+			<< model.parameterCount() * sizeof(double) << " bytes" << std::endl;
+	std::cout << "int8:   " << reduced.accuracy() << "% accuracy, " << reduced.imagesPerSecond() << " images/s, "
+			<< quantized.modelBytes() << " bytes" << std::endl;
+	std::cout << "Same answer on " << 100.0 * agree / tests.size() << "% of test images" << std::endl;
+}
+
+/*
+ * Keeps the largest k weights into each neuron of a saved model, where k leaves the given fraction
+ * of every layer's weights at zero, fine-tunes it for an epoch with the pruned weights held at zero
+ * and writes it to outPath. Prints the test accuracy before and after fine-tuning.
+ * Run as: Main --prune Trained.txt 0.9 Pruned.txt
+ */
+void pruneModel(const std::string & modelPath, double sparsity, const std::string & outPath)
+{
+	DigitClassifier model(modelPath);
+	Dataset training = Dataset::load("mnist_train.csv");
+	Dataset tests = Dataset::load("mnist_test.csv");
+	if (!training.isOpen() || !tests.isOpen())
+		return;
+	double dense = model.evaluate(tests).accuracy();
+	for (int layer = 0; layer + 1 < (int) model.getStructure().size(); layer++)
+	{
+		int inputs = model.getStructure()[layer];
+		model.pruneTopK(inputs - (int) (sparsity * inputs + 0.5), layer);
+	}
+	double pruned = model.evaluate(tests).accuracy();
+	model.SGD(training, 1, 20, 3);
+	double tuned = model.evaluate(tests).accuracy();
+	std::cout << "dense: " << dense << "%, pruned: " << pruned << "%, fine-tuned: " << tuned << "%" << std::endl;
+	for (int layer = 0; layer + 1 < (int) model.getStructure().size(); layer++)
+		std::cout << "Layer " << layer << ": " << 100 * model.density(layer) << "% of weights left, "
+				<< (model.isSparseLayer(layer, 1) ? "sparse" : "dense") << " for single images, "
+				<< (model.isSparseLayer(layer, 2) ? "sparse" : "dense") << " for batches" << std::endl;
+	model.toString(outPath);
+}
+
+static volatile std::sig_atomic_t stopSignal = 0;
+
+//Preemption sends SIGTERM. Training checkpoints after its current minibatch and returns.
+static void stopTraining(int)
+{
+	stopSignal = 1;
+	requestTrainingStop();
+}
+
+/*
+ * Routes SIGTERM and SIGINT to stopTraining while training, and back to their default of ending the
+ * process otherwise, since nothing but training checks for a stop.
+ */
+static void catchStopSignals(bool training)
+{
+	std::signal(SIGTERM, training ? stopTraining : SIG_DFL);
+	std::signal(SIGINT, training ? stopTraining : SIG_DFL);
+}
+
+/*
+ * Trains one rank of a data parallel run. Start one process per rank with the same arguments but the rank:
+ *   Main --distributed shm /digits-ring 0 4     (and ranks 1, 2 and 3)
+ *   Main --distributed tcp 5600 0 2 --fp16      (and rank 1)
+ * Every rank loads mnist_train.csv and trains on its share of it. Rank 0 writes Trained1.txt after
+ * every epoch and evaluates it at the end. SIGTERM or SIGINT to any rank stops them all.
+ */
+int trainRank(const std::string & kind, const std::string & address, int rank, int ranks, bool compress)
+{
+	RingTransport ring;
+	if (!ring.connect(kind == "tcp" ? TRANSPORT_TCP : TRANSPORT_SHARED_MEMORY, address, rank, ranks))
+		return 1;
+	std::vector<int> conditions = {784, 30, 10};
+	DigitClassifier test(conditions);
+	Dataset images = Dataset::load("mnist_train.csv");
+	catchStopSignals(true);
+	bool trained = images.isOpen() && test.trainDistributed(images, ring, 30, 20, 3, compress,
+			rank == 0 ? "Trained1.txt" : "");
+	catchStopSignals(false);
+	if (!trained)
+		return 1;
+	std::cout << "Rank " << rank << " sent " << ring.bytesSent() << " bytes over " << transportName(ring.kind())
+			<< std::endl;
+	if (rank == 0)
+		test.evaluate("mnist_test.csv").print(std::cout);
+	return 0;
+}
+
+//Where --metrics writes, if given.
+static std::string metricsPath;
+
+/*
+ * Writes every timer, counter and epoch recorded so far to metricsPath and finishes the trace.
+ * Called however main returns.
+ */
+static void finishMetrics()
+{
+	stopTrace();
+	if (!metricsPath.empty() && !writeMetricsJsonLines(metricsPath))
+		std::cout << "Could not write metrics to " << metricsPath << std::endl;
+}
+
+/*
+ * Any of the modes below can be preceded by
+ *   --metrics metrics.jsonl   to record timers, counters and per epoch telemetry as JSON lines
+ *   --trace trace.json        to write a Chrome trace of the timed sections
+ */
+int main(int argc, char ** argv)
 {
-	clock_t begin = clock();
+	while (argc >= 3 && (std::strcmp(argv[1], "--metrics") == 0 || std::strcmp(argv[1], "--trace") == 0))
+	{
+		setMetricsEnabled(true);
+		if (std::strcmp(argv[1], "--metrics") == 0)
+			metricsPath = argv[2];
+		else if (!startTrace(argv[2]))
+			std::cout << "Could not write a trace to " << argv[2] << std::endl;
+		argc -= 2;
+		argv += 2;
+	}
+	std::atexit(finishMetrics);
+
+	if (argc == 3 && std::strcmp(argv[1], "--scaling") == 0)
+	{
+		reportScaling(std::atoi(argv[2]));
+		return 0;
+	}
+	if (argc == 4 && std::strcmp(argv[1], "--hogwild") == 0)
+	{
+		reportTimeToAccuracy(std::atoi(argv[2]), std::atof(argv[3]));
+		return 0;
+	}
+	if (argc == 3 && std::strcmp(argv[1], "--quantize") == 0)
+	{
+		reportQuantization(argv[2]);
+		return 0;
+	}
+	if (argc == 5 && std::strcmp(argv[1], "--prune") == 0)
+	{
+		pruneModel(argv[2], std::atof(argv[3]), argv[4]);
+		return 0;
+	}
+	if ((argc == 6 || (argc == 7 && std::strcmp(argv[6], "--fp16") == 0))
+			&& std::strcmp(argv[1], "--distributed") == 0)
+		return trainRank(argv[2], argv[3], std::atoi(argv[4]), std::atoi(argv[5]), argc == 7);
+
+	//Wall time. clock() would add up the CPU time of every thread.
+	auto begin = std::chrono::steady_clock::now();
 
+	/*
+	 * Checkpoints every epoch to Trained.dckp. A run that was stopped is continued with
+	 * Main --resume Trained.dckp
+	 */
 	std::vector<int> conditions = {784, 30, 10};
 	DigitClassifier test(conditions);
 	std::cout << "Training the neural network." << std::endl;
-	test.train("mnist_train.csv", 30, 20, 3);
+	catchStopSignals(true);
+	if (argc == 3 && std::strcmp(argv[1], "--resume") == 0)
+	{
+		if (!test.resume(argv[2]))
+			return 1;
+	}
+	else
+	{
+		test.enableCheckpoints("Trained.dckp", 1);
+		test.train("mnist_train.csv", 30, 20, 3);
+	}
+	catchStopSignals(false);
+	if (stopSignal)
+	{
+		std::cout << "Stopped. Continue with --resume Trained.dckp" << std::endl;
+		return 0;
+	}
 	std::cout << "Training complete." << std::endl;
 	test.toString("Trained1.txt");
 
-	std::clock_t trained = clock();
+	auto trained = std::chrono::steady_clock::now();
 
-	test.evaluate("mnist_test.csv");
+	test.evaluate("mnist_test.csv").print(std::cout);
 	std::cout << "Evaluation complete." << std::endl;
 
-	std::clock_t done = clock();
+	auto done = std::chrono::steady_clock::now();
 
-	double timeToTrain = (double(trained-begin) / CLOCKS_PER_SEC)/60;
-	double timeToFinish = (double(done-begin) / CLOCKS_PER_SEC)/60;
+	double timeToTrain = std::chrono::duration<double>(trained - begin).count() / 60;
+	double timeToFinish = std::chrono::duration<double>(done - begin).count() / 60;
 
 	std::cout << "Time to train: " << timeToTrain << " minutes" << std::endl;
 	std::cout << "Time to finish everything: " << timeToFinish << " minutes" << std::endl;
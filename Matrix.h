@@ -0,0 +1,225 @@
+/*
+ * Author: Shuhao Lai
+ * Date: 10/17/2026
+ * Matrix.h
+ */
+
+#ifndef MATRIX_H_
+#define MATRIX_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <utility>
+#include <vector>
+
+//Every block of parameters starts on a cache line so rows can be streamed and loaded with aligned SIMD.
+const std::size_t MATRIX_ALIGNMENT = 64;
+
+//Rounds count up so that a block placed after count elements of T starts on a cache line.
+template<typename T>
+constexpr std::size_t alignedCount(std::size_t count)
+{
+	return (count + MATRIX_ALIGNMENT / sizeof(T) - 1) / (MATRIX_ALIGNMENT / sizeof(T)) * (MATRIX_ALIGNMENT / sizeof(T));
+}
+
+/*
+ * Owns a zero filled block of memory that starts on a 64 byte boundary.
+ * Copying makes a deep copy so it can be used as a value like std::vector.
+ */
+template<typename T>
+class AlignedBuffer
+{
+public:
+	AlignedBuffer() : ptr(nullptr), count(0), capacity(0) {}
+
+	explicit AlignedBuffer(std::size_t count) : ptr(nullptr), count(0), capacity(0)
+	{
+		resize(count);
+	}
+
+	AlignedBuffer(const AlignedBuffer & other) : ptr(nullptr), count(0), capacity(0)
+	{
+		resize(other.count);
+		if (count)
+			std::memcpy(ptr, other.ptr, count * sizeof(T));
+	}
+
+	AlignedBuffer(AlignedBuffer && other) noexcept : ptr(other.ptr), count(other.count), capacity(other.capacity)
+	{
+		other.ptr = nullptr;
+		other.count = 0;
+		other.capacity = 0;
+	}
+
+	AlignedBuffer & operator=(AlignedBuffer other) noexcept
+	{
+		std::swap(ptr, other.ptr);
+		std::swap(count, other.count);
+		std::swap(capacity, other.capacity);
+		return *this;
+	}
+
+	~AlignedBuffer()
+	{
+		std::free(ptr);
+	}
+
+	/*
+	 * Discards the old contents and leaves count zeroed elements. Like std::vector, the memory is
+	 * only reallocated when count is more than the buffer has ever held, so buffers that are
+	 * resized every minibatch stop allocating after the first one.
+	 */
+	void resize(std::size_t newCount)
+	{
+		count = newCount;
+		//aligned_alloc requires the size to be a multiple of the alignment.
+		std::size_t bytes = alignedCount<T>(count) * sizeof(T);
+		if (count > capacity)
+		{
+			std::free(ptr);
+			ptr = static_cast<T *>(std::aligned_alloc(MATRIX_ALIGNMENT, bytes));
+			if (ptr == nullptr)
+				throw std::bad_alloc();
+			capacity = alignedCount<T>(count);
+		}
+		if (bytes)
+			std::memset(ptr, 0, bytes);
+	}
+
+	void zero()
+	{
+		if (count)
+			std::memset(ptr, 0, count * sizeof(T));
+	}
+
+	T * data() { return ptr; }
+	const T * data() const { return ptr; }
+	std::size_t size() const { return count; }
+	T & operator[](std::size_t i) { return ptr[i]; }
+	const T & operator[](std::size_t i) const { return ptr[i]; }
+
+private:
+	T * ptr;
+	std::size_t count;
+	std::size_t capacity;
+};
+
+/*
+ * A non owning, row major view of a matrix stored contiguously in memory.
+ * view[r][c] gets the element in row r and column c, which mirrors indexing a twoDArray.
+ */
+template<typename T>
+class MatrixView
+{
+public:
+	MatrixView() : ptr(nullptr), numRows(0), numCols(0) {}
+
+	MatrixView(T * data, int rows, int cols) : ptr(data), numRows(rows), numCols(cols) {}
+
+	//Allows a mutable view to be passed where a read only view is expected.
+	operator MatrixView<const T>() const
+	{
+		return MatrixView<const T>(ptr, numRows, numCols);
+	}
+
+	T * operator[](int row) const { return ptr + (std::size_t) row * numCols; }
+	T & operator()(int row, int col) const { return ptr[(std::size_t) row * numCols + col]; }
+
+	//View of count rows starting at row first.
+	MatrixView<T> rowRange(int first, int count) const
+	{
+		return MatrixView<T>(ptr + (std::size_t) first * numCols, count, numCols);
+	}
+
+	T * data() const { return ptr; }
+	int rows() const { return numRows; }
+	int cols() const { return numCols; }
+	std::size_t size() const { return (std::size_t) numRows * numCols; }
+
+private:
+	T * ptr;
+	int numRows;
+	int numCols;
+};
+
+/*
+ * A row major matrix that owns its aligned storage. Used for batches, where each row is one image.
+ */
+template<typename T>
+class Matrix
+{
+public:
+	Matrix() : numRows(0), numCols(0) {}
+
+	Matrix(int rows, int cols) : buffer((std::size_t) rows * cols), numRows(rows), numCols(cols) {}
+
+	//Discards the old contents and leaves a zeroed rows x cols matrix.
+	void resize(int rows, int cols)
+	{
+		buffer.resize((std::size_t) rows * cols);
+		numRows = rows;
+		numCols = cols;
+	}
+
+	MatrixView<T> view() { return MatrixView<T>(buffer.data(), numRows, numCols); }
+	MatrixView<const T> view() const { return MatrixView<const T>(buffer.data(), numRows, numCols); }
+
+	T * operator[](int row) { return buffer.data() + (std::size_t) row * numCols; }
+	const T * operator[](int row) const { return buffer.data() + (std::size_t) row * numCols; }
+
+	T * data() { return buffer.data(); }
+	const T * data() const { return buffer.data(); }
+	int rows() const { return numRows; }
+	int cols() const { return numCols; }
+	std::size_t size() const { return (std::size_t) numRows * numCols; }
+
+private:
+	AlignedBuffer<T> buffer;
+	int numRows;
+	int numCols;
+};
+
+/*
+ * Compressed sparse row copy of a matrix that keeps only its nonzero values. Row r's values are
+ * values[rowStarts[r]] up to values[rowStarts[r + 1]], in order of their columns, which are stored
+ * alongside them. Used for pruned weight matrices, where most weights are zero.
+ */
+template<typename T>
+struct CsrMatrix
+{
+	int rows = 0;
+	int cols = 0;
+	std::vector<std::int32_t> rowStarts;
+	std::vector<std::int32_t> columns;
+	std::vector<T> values;
+
+	//Replaces the contents with the nonzero values of dense.
+	void assign(MatrixView<const T> dense)
+	{
+		rows = dense.rows();
+		cols = dense.cols();
+		rowStarts.assign(1, 0);
+		columns.clear();
+		values.clear();
+		for (int r = 0; r < rows; r++)
+		{
+			for (int c = 0; c < cols; c++)
+				if (dense[r][c] != 0)
+				{
+					columns.push_back(c);
+					values.push_back(dense[r][c]);
+				}
+			rowStarts.push_back(values.size());
+		}
+	}
+
+	std::size_t nonZeros() const
+	{
+		return values.size();
+	}
+};
+
+#endif /* MATRIX_H_ */
@@ -0,0 +1,317 @@
+/*
+ * Author: Shuhao Lai
+ * Date: 10/17/2026
+ * Metrics.cpp
+ */
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+#include "Metrics.h"
+
+//Trace events a thread keeps before writing them to the trace file.
+static const std::size_t TRACE_FLUSH_EVENTS = 4096;
+
+struct TraceEvent
+{
+	Timer timer;
+	long beginNanos;
+	long nanos;
+};
+
+/*
+ * One thread's totals. Only the thread that owns them writes them. They are relaxed atomics so that
+ * other threads can sum them at any time.
+ */
+struct ThreadMetrics
+{
+	std::atomic<long> timerCount[TIMER_COUNT] = {};
+	std::atomic<long> timerNanos[TIMER_COUNT] = {};
+	std::atomic<long> timerMaxNanos[TIMER_COUNT] = {};
+	std::atomic<long> counters[COUNTER_COUNT] = {};
+	std::atomic<double> loss{ 0 };
+	std::atomic<long> correct{ 0 };
+	std::atomic<long> images{ 0 };
+
+	//Thread id shown in the trace.
+	int id = 0;
+	std::mutex traceLock;
+	std::vector<TraceEvent> trace;
+};
+
+#ifdef DIGITS_INSTRUMENTATION
+std::atomic<bool> metricsOn(false);
+#endif
+
+//Lock order: registryLock, then a thread's traceLock, then traceFileLock.
+static std::mutex registryLock;
+static std::vector<ThreadMetrics *> liveThreads;
+//Totals of threads that have exited.
+static ThreadMetrics retired;
+static std::vector<EpochMetrics> epochs;
+static int nextThreadId = 1;
+
+static std::mutex traceFileLock;
+static std::atomic<bool> tracing(false);
+static std::FILE * traceFile = nullptr;
+static bool firstTraceEvent = true;
+static long traceStartNanos = 0;
+
+static long nanosSinceEpoch(std::chrono::steady_clock::time_point time)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+}
+
+//Single writer increment, so a load and a store are enough.
+template<typename V>
+static void add(std::atomic<V> & total, V amount)
+{
+	total.store(total.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+//Writes and clears a thread's buffered trace events. The caller holds metrics.traceLock.
+static void flushTrace(ThreadMetrics & metrics)
+{
+	std::lock_guard<std::mutex> guard(traceFileLock);
+	for (const TraceEvent & event : metrics.trace)
+	{
+		if (traceFile == nullptr)
+			break;
+		double begin = std::max(0L, event.beginNanos - traceStartNanos) / 1000.0;
+		std::fprintf(traceFile, "%s{\"name\":\"%s\",\"cat\":\"digits\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+				"\"ts\":%.3f,\"dur\":%.3f}", firstTraceEvent ? "\n" : ",\n", timerName(event.timer), metrics.id,
+				begin, event.nanos / 1000.0);
+		firstTraceEvent = false;
+	}
+	metrics.trace.clear();
+}
+
+//Adds from's totals to into. The caller holds registryLock.
+static void mergeInto(ThreadMetrics & into, const ThreadMetrics & from)
+{
+	for (int t = 0; t < TIMER_COUNT; t++)
+	{
+		add(into.timerCount[t], from.timerCount[t].load(std::memory_order_relaxed));
+		add(into.timerNanos[t], from.timerNanos[t].load(std::memory_order_relaxed));
+		into.timerMaxNanos[t].store(std::max(into.timerMaxNanos[t].load(std::memory_order_relaxed),
+				from.timerMaxNanos[t].load(std::memory_order_relaxed)), std::memory_order_relaxed);
+	}
+	for (int c = 0; c < COUNTER_COUNT; c++)
+		add(into.counters[c], from.counters[c].load(std::memory_order_relaxed));
+	add(into.loss, from.loss.load(std::memory_order_relaxed));
+	add(into.correct, from.correct.load(std::memory_order_relaxed));
+	add(into.images, from.images.load(std::memory_order_relaxed));
+}
+
+/*
+ * Registers a thread's metrics the first time it records anything, and folds them into the
+ * retired totals when the thread exits.
+ */
+class ThreadSlot
+{
+public:
+	ThreadSlot()
+	{
+		std::lock_guard<std::mutex> guard(registryLock);
+		metrics.id = nextThreadId++;
+		liveThreads.push_back(&metrics);
+	}
+
+	~ThreadSlot()
+	{
+		std::lock_guard<std::mutex> guard(registryLock);
+		{
+			std::lock_guard<std::mutex> traceGuard(metrics.traceLock);
+			flushTrace(metrics);
+		}
+		mergeInto(retired, metrics);
+		liveThreads.erase(std::find(liveThreads.begin(), liveThreads.end(), &metrics));
+	}
+
+	ThreadMetrics metrics;
+};
+
+static ThreadMetrics & localMetrics()
+{
+	thread_local ThreadSlot slot;
+	return slot.metrics;
+}
+
+const char * timerName(Timer timer)
+{
+	static const char * names[TIMER_COUNT] =
+	{ "dataLoading", "forward", "backpropagation", "gradients", "applyGradients", "evaluation", "allReduce" };
+	return names[timer];
+}
+
+const char * counterName(Counter counter)
+{
+	static const char * names[COUNTER_COUNT] = { "imagesTrained", "minibatches", "imagesEvaluated" };
+	return names[counter];
+}
+
+void setMetricsEnabled(bool enabled)
+{
+#ifdef DIGITS_INSTRUMENTATION
+	metricsOn.store(enabled);
+#else
+	(void) enabled;
+#endif
+}
+
+void recordTime(Timer timer, std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end)
+{
+	ThreadMetrics & metrics = localMetrics();
+	long nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+	add(metrics.timerCount[timer], 1L);
+	add(metrics.timerNanos[timer], nanos);
+	if (nanos > metrics.timerMaxNanos[timer].load(std::memory_order_relaxed))
+		metrics.timerMaxNanos[timer].store(nanos, std::memory_order_relaxed);
+	if (!tracing.load(std::memory_order_relaxed))
+		return;
+	std::lock_guard<std::mutex> guard(metrics.traceLock);
+	metrics.trace.push_back(TraceEvent{ timer, nanosSinceEpoch(begin), nanos });
+	if (metrics.trace.size() >= TRACE_FLUSH_EVENTS)
+		flushTrace(metrics);
+}
+
+void addCount(Counter counter, long amount)
+{
+	add(localMetrics().counters[counter], amount);
+}
+
+void addTrainingLoss(double loss, long correct, long images)
+{
+	ThreadMetrics & metrics = localMetrics();
+	add(metrics.loss, loss);
+	add(metrics.correct, correct);
+	add(metrics.images, images);
+}
+
+//Sums every live thread into the retired totals' shape. The caller holds registryLock.
+static void sumAll(ThreadMetrics & total)
+{
+	mergeInto(total, retired);
+	for (ThreadMetrics * metrics : liveThreads)
+		mergeInto(total, *metrics);
+}
+
+TimerStats timerStats(Timer timer)
+{
+	std::lock_guard<std::mutex> guard(registryLock);
+	ThreadMetrics total;
+	sumAll(total);
+	return TimerStats{ total.timerCount[timer].load(), total.timerNanos[timer].load() / 1e9,
+			total.timerMaxNanos[timer].load() / 1e9 };
+}
+
+long counterValue(Counter counter)
+{
+	std::lock_guard<std::mutex> guard(registryLock);
+	ThreadMetrics total;
+	sumAll(total);
+	return total.counters[counter].load();
+}
+
+TrainingLoss trainingLoss()
+{
+	std::lock_guard<std::mutex> guard(registryLock);
+	ThreadMetrics total;
+	sumAll(total);
+	return TrainingLoss{ total.loss.load(), total.correct.load(), total.images.load() };
+}
+
+void recordEpoch(const EpochMetrics & epoch)
+{
+	std::lock_guard<std::mutex> guard(registryLock);
+	epochs.push_back(epoch);
+}
+
+std::vector<EpochMetrics> epochMetrics()
+{
+	std::lock_guard<std::mutex> guard(registryLock);
+	return epochs;
+}
+
+/*
+ * Other threads may be recording while this runs, so each of their values is cleared on its own.
+ * An update that lands in between is lost, which only matters to a reset made mid training.
+ */
+static void clear(ThreadMetrics & metrics)
+{
+	for (int t = 0; t < TIMER_COUNT; t++)
+	{
+		metrics.timerCount[t] = 0;
+		metrics.timerNanos[t] = 0;
+		metrics.timerMaxNanos[t] = 0;
+	}
+	for (int c = 0; c < COUNTER_COUNT; c++)
+		metrics.counters[c] = 0;
+	metrics.loss = 0;
+	metrics.correct = 0;
+	metrics.images = 0;
+}
+
+void resetMetrics()
+{
+	std::lock_guard<std::mutex> guard(registryLock);
+	clear(retired);
+	for (ThreadMetrics * metrics : liveThreads)
+		clear(*metrics);
+	epochs.clear();
+}
+
+bool writeMetricsJsonLines(const std::string & path)
+{
+	std::FILE * out = std::fopen(path.c_str(), "a");
+	if (out == nullptr)
+		return false;
+	std::lock_guard<std::mutex> guard(registryLock);
+	for (const EpochMetrics & e : epochs)
+		std::fprintf(out, "{\"type\":\"epoch\",\"epoch\":%d,\"seconds\":%.6f,\"images\":%ld,\"imagesPerSecond\":%.1f,"
+				"\"loss\":%.9g,\"accuracy\":%.4f}\n", e.epoch, e.seconds, e.images, e.imagesPerSecond, e.loss,
+				e.accuracy);
+	ThreadMetrics total;
+	sumAll(total);
+	for (int t = 0; t < TIMER_COUNT; t++)
+	{
+		long count = total.timerCount[t].load();
+		double seconds = total.timerNanos[t].load() / 1e9;
+		std::fprintf(out, "{\"type\":\"timer\",\"name\":\"%s\",\"count\":%ld,\"totalSeconds\":%.6f,"
+				"\"meanMicros\":%.3f,\"maxMicros\":%.3f}\n", timerName((Timer) t), count, seconds,
+				count ? seconds * 1e6 / count : 0.0, total.timerMaxNanos[t].load() / 1e3);
+	}
+	for (int c = 0; c < COUNTER_COUNT; c++)
+		std::fprintf(out, "{\"type\":\"counter\",\"name\":\"%s\",\"value\":%ld}\n", counterName((Counter) c),
+				total.counters[c].load());
+	return std::fclose(out) == 0;
+}
+
+bool startTrace(const std::string & path)
+{
+	stopTrace();
+	std::lock_guard<std::mutex> guard(traceFileLock);
+	traceFile = std::fopen(path.c_str(), "w");
+	if (traceFile == nullptr)
+		return false;
+	std::fputc('[', traceFile);
+	firstTraceEvent = true;
+	traceStartNanos = nanosSinceEpoch(std::chrono::steady_clock::now());
+	tracing = true;
+	return true;
+}
+
+void stopTrace()
+{
+	if (!tracing.exchange(false))
+		return;
+	std::lock_guard<std::mutex> guard(registryLock);
+	for (ThreadMetrics * metrics : liveThreads)
+	{
+		std::lock_guard<std::mutex> traceGuard(metrics->traceLock);
+		flushTrace(*metrics);
+	}
+	std::lock_guard<std::mutex> fileGuard(traceFileLock);
+	std::fputs("\n]\n", traceFile);
+	std::fclose(traceFile);
+	traceFile = nullptr;
+}
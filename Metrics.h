@@ -0,0 +1,148 @@
+/*
+ * Author: Shuhao Lai
+ * Date: 10/17/2026
+ * Metrics.h
+ */
+
+#ifndef METRICS_H_
+#define METRICS_H_
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+/*
+ * Timers, counters and per epoch telemetry for training and evaluation. Every thread records into
+ * its own slot, so recording never takes a lock, and the slots are only summed when someone asks.
+ * Nothing is recorded until setMetricsEnabled(true). Building without DIGITS_INSTRUMENTATION defined
+ * compiles every timer and counter out of the hot paths, and the functions below do nothing.
+ */
+
+//Timed sections of the hot paths.
+enum Timer
+{
+	TIMER_DATA_LOADING, TIMER_FORWARD, TIMER_BACKPROPAGATION, TIMER_GRADIENTS, TIMER_APPLY_GRADIENTS,
+	TIMER_EVALUATION, TIMER_ALL_REDUCE, TIMER_COUNT
+};
+
+enum Counter
+{
+	COUNTER_IMAGES_TRAINED, COUNTER_MINIBATCHES, COUNTER_IMAGES_EVALUATED, COUNTER_COUNT
+};
+
+const char * timerName(Timer timer);
+const char * counterName(Counter counter);
+
+struct TimerStats
+{
+	long count;
+	double totalSeconds;
+	double maxSeconds;
+};
+
+//Loss and accuracy of the training images as they went through the network, before their update.
+struct TrainingLoss
+{
+	double loss;
+	long correct;
+	long images;
+};
+
+struct EpochMetrics
+{
+	int epoch;
+	double seconds;
+	long images;
+	double imagesPerSecond;
+	//Mean quadratic cost over the epoch's images.
+	double loss;
+	//Percent of the epoch's images classified correctly.
+	double accuracy;
+};
+
+#ifdef DIGITS_INSTRUMENTATION
+extern std::atomic<bool> metricsOn;
+
+inline bool metricsEnabled()
+{
+	return metricsOn.load(std::memory_order_relaxed);
+}
+#else
+constexpr bool metricsEnabled()
+{
+	return false;
+}
+#endif
+
+void setMetricsEnabled(bool enabled);
+
+//Called by the recording thread only.
+void recordTime(Timer timer, std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end);
+void addCount(Counter counter, long amount);
+void addTrainingLoss(double loss, long correct, long images);
+
+//Totals over every thread, including threads that have finished.
+TimerStats timerStats(Timer timer);
+long counterValue(Counter counter);
+TrainingLoss trainingLoss();
+
+//Adds one epoch's telemetry to the registry.
+void recordEpoch(const EpochMetrics & epoch);
+std::vector<EpochMetrics> epochMetrics();
+
+//Clears every timer, counter and epoch.
+void resetMetrics();
+
+/*
+ * Appends one JSON object per line to path: every recorded epoch, then every timer and counter.
+ * Returns false if the file could not be written.
+ */
+bool writeMetricsJsonLines(const std::string & path);
+
+/*
+ * Writes every timed section from now on to path in the Chrome trace event format, for viewing in
+ * chrome://tracing or Perfetto. Tracing needs metrics to be enabled. The file is complete once
+ * stopTrace returns.
+ */
+bool startTrace(const std::string & path);
+void stopTrace();
+
+//Times the enclosing scope. Does nothing unless metrics are enabled.
+class ScopedTimer
+{
+public:
+	explicit ScopedTimer(Timer timer) : timer(timer), running(metricsEnabled())
+	{
+		if (running)
+			begin = std::chrono::steady_clock::now();
+	}
+
+	~ScopedTimer()
+	{
+		if (running)
+			recordTime(timer, begin, std::chrono::steady_clock::now());
+	}
+
+	ScopedTimer(const ScopedTimer &) = delete;
+	ScopedTimer & operator=(const ScopedTimer &) = delete;
+
+private:
+	Timer timer;
+	bool running;
+	std::chrono::steady_clock::time_point begin;
+};
+
+#define METRICS_CONCAT_(a, b) a##b
+#define METRICS_CONCAT(a, b) METRICS_CONCAT_(a, b)
+
+#ifdef DIGITS_INSTRUMENTATION
+#define SCOPED_TIMER(timer) ScopedTimer METRICS_CONCAT(scopedTimer, __LINE__)(timer)
+#define COUNT_EVENTS(counter, amount) \
+	do { if (metricsEnabled()) addCount(counter, amount); } while (0)
+#else
+#define SCOPED_TIMER(timer) do {} while (0)
+#define COUNT_EVENTS(counter, amount) do {} while (0)
+#endif
+
+#endif /* METRICS_H_ */
@@ -0,0 +1,260 @@
+/*
+ * Author: Shuhao Lai
+ * Date: 10/17/2026
+ * ModelFile.cpp
+ */
+
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "ModelFile.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+
+static std::uint64_t roundUp64(std::uint64_t bytes)
+{
+	return (bytes + 63) / 64 * 64;
+}
+
+bool isModelFile(const string & path)
+{
+	std::ifstream in(path, std::ios::binary);
+	char magic[4];
+	return in.read(magic, 4) && std::memcmp(magic, MODEL_MAGIC, 4) == 0;
+}
+
+std::uint32_t modelScalarSize(const string & path)
+{
+	std::ifstream in(path, std::ios::binary);
+	ModelHeader header;
+	if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)) || std::memcmp(header.magic, MODEL_MAGIC, 4) != 0)
+		return 0;
+	return header.scalarSize;
+}
+
+std::uint32_t modelOutputLayer(const string & path)
+{
+	std::ifstream in(path, std::ios::binary);
+	ModelHeader header;
+	if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)) || std::memcmp(header.magic, MODEL_MAGIC, 4) != 0)
+		return 0;
+	return header.outputLayer;
+}
+
+std::uint64_t fnv1a(const void * bytes, std::size_t size, std::uint64_t hash)
+{
+	const unsigned char * p = static_cast<const unsigned char *>(bytes);
+	for (std::size_t i = 0; i < size; i++)
+	{
+		hash ^= p[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+template<typename T>
+ParameterStorage<T>::ParameterStorage(const ParameterStorage & other) : ParameterStorage()
+{
+	resize(other.size());
+	if (size())
+		std::memcpy(owned.data(), other.data(), size() * sizeof(T));
+}
+
+template<typename T>
+ParameterStorage<T>::ParameterStorage(ParameterStorage && other) noexcept :
+		owned(std::move(other.owned)), mapping(other.mapping), mappingSize(other.mappingSize), mapped(other.mapped),
+		count(other.count)
+{
+	other.mapping = nullptr;
+	other.mappingSize = 0;
+	other.mapped = nullptr;
+	other.count = 0;
+}
+
+template<typename T>
+ParameterStorage<T> & ParameterStorage<T>::operator=(ParameterStorage other) noexcept
+{
+	std::swap(owned, other.owned);
+	std::swap(mapping, other.mapping);
+	std::swap(mappingSize, other.mappingSize);
+	std::swap(mapped, other.mapped);
+	std::swap(count, other.count);
+	return *this;
+}
+
+template<typename T>
+ParameterStorage<T>::~ParameterStorage()
+{
+	unmap();
+}
+
+template<typename T>
+void ParameterStorage<T>::unmap()
+{
+	if (mapping != nullptr)
+		munmap(mapping, mappingSize);
+	mapping = nullptr;
+	mappingSize = 0;
+	mapped = nullptr;
+	count = 0;
+}
+
+template<typename T>
+void ParameterStorage<T>::resize(std::size_t newCount)
+{
+	unmap();
+	owned.resize(newCount);
+}
+
+template<typename T>
+void ParameterStorage<T>::zero()
+{
+	if (size())
+		std::memset(data(), 0, size() * sizeof(T));
+}
+
+template<typename T>
+bool ParameterStorage<T>::map(const string & path, std::vector<int> & structure)
+{
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		cout << "Model file could not be opened: " << path << endl;
+		return false;
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size < (off_t) sizeof(ModelHeader))
+	{
+		cout << "Model file is too small: " << path << endl;
+		close(fd);
+		return false;
+	}
+	//Private mapping: pages are shared with the page cache until something writes to them, such as training.
+	void * file = mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (file == MAP_FAILED)
+	{
+		cout << "Model file could not be mapped: " << path << endl;
+		return false;
+	}
+
+	const char * bytes = static_cast<const char *>(file);
+	ModelHeader header;
+	std::memcpy(&header, bytes, sizeof(header));
+	std::uint64_t structureBytes = (std::uint64_t) header.layers * sizeof(std::int32_t);
+	bool valid = std::memcmp(header.magic, MODEL_MAGIC, 4) == 0 && header.version == MODEL_VERSION
+			&& header.scalarSize == sizeof(T) && header.parameterOffset % MATRIX_ALIGNMENT == 0
+			&& sizeof(ModelHeader) + structureBytes <= header.parameterOffset
+			&& header.parameterOffset + header.parameterCount * sizeof(T) <= (std::uint64_t) info.st_size;
+	if (valid)
+	{
+		std::uint64_t hash = fnv1a(bytes + sizeof(ModelHeader), structureBytes);
+		hash = fnv1a(bytes + header.parameterOffset, header.parameterCount * sizeof(T), hash);
+		valid = hash == header.checksum;
+	}
+	if (!valid)
+	{
+		cout << "Not a valid model file: " << path << endl;
+		munmap(file, info.st_size);
+		return false;
+	}
+
+	structure.resize(header.layers);
+	for (std::uint32_t i = 0; i < header.layers; i++)
+	{
+		std::int32_t neurons;
+		std::memcpy(&neurons, bytes + sizeof(ModelHeader) + i * sizeof(neurons), sizeof(neurons));
+		structure[i] = neurons;
+	}
+
+	unmap();
+	//Releases the memory, which resize(0) would keep.
+	owned = AlignedBuffer<T>();
+	mapping = file;
+	mappingSize = info.st_size;
+	mapped = reinterpret_cast<T *>(static_cast<char *>(file) + header.parameterOffset);
+	count = header.parameterCount;
+	return true;
+}
+
+//Syncs the directory holding path, so that a rename into it survives a crash.
+static void syncDirectory(const string & path)
+{
+	string::size_type slash = path.rfind('/');
+	string directory = slash == string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+	int fd = ::open(directory.c_str(), O_RDONLY);
+	if (fd < 0)
+		return;
+	fsync(fd);
+	close(fd);
+}
+
+bool replaceFile(const string & temporary, const string & path)
+{
+	int fd = ::open(temporary.c_str(), O_RDONLY);
+	bool synced = fd >= 0 && fsync(fd) == 0;
+	if (fd >= 0)
+		close(fd);
+	if (!synced || std::rename(temporary.c_str(), path.c_str()) != 0)
+	{
+		unlink(temporary.c_str());
+		return false;
+	}
+	syncDirectory(path);
+	return true;
+}
+
+template<typename T>
+bool writeModelFile(const string & path, const std::vector<int> & structure, const T * parameters,
+		std::size_t count, std::uint32_t outputLayer)
+{
+	//A model loaded from path may be mapped from it, so the file is replaced rather than truncated.
+	string temporary = path + ".tmp";
+	std::ofstream out(temporary, std::ios::binary);
+	if (!out.is_open())
+	{
+		cout << "Model file could not be written: " << temporary << endl;
+		return false;
+	}
+
+	std::vector<std::int32_t> layers(structure.begin(), structure.end());
+	std::uint64_t structureBytes = layers.size() * sizeof(std::int32_t);
+	ModelHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, MODEL_MAGIC, 4);
+	header.version = MODEL_VERSION;
+	header.layers = layers.size();
+	header.scalarSize = sizeof(T);
+	header.parameterOffset = roundUp64(sizeof(ModelHeader) + structureBytes);
+	header.parameterCount = count;
+	header.outputLayer = outputLayer;
+	header.checksum = fnv1a(parameters, count * sizeof(T), fnv1a(layers.data(), structureBytes));
+
+	std::vector<char> padding(header.parameterOffset - sizeof(ModelHeader) - structureBytes, 0);
+	out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+	out.write(reinterpret_cast<const char *>(layers.data()), structureBytes);
+	out.write(padding.data(), padding.size());
+	out.write(reinterpret_cast<const char *>(parameters), count * sizeof(T));
+	out.close();
+	if (!out || !replaceFile(temporary, path))
+	{
+		cout << "Model file could not be written: " << path << endl;
+		unlink(temporary.c_str());
+		return false;
+	}
+	return true;
+}
+
+template class ParameterStorage<float>;
+template class ParameterStorage<double>;
+template bool writeModelFile(const string & path, const std::vector<int> & structure, const float * parameters,
+		std::size_t count, std::uint32_t outputLayer);
+template bool writeModelFile(const string & path, const std::vector<int> & structure, const double * parameters,
+		std::size_t count, std::uint32_t outputLayer);
@@ -0,0 +1,123 @@
+/*
+ * Author: Shuhao Lai
+ * Date: 10/17/2026
+ * ModelFile.h
+ */
+
+#ifndef MODELFILE_H_
+#define MODELFILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Matrix.h"
+
+/*
+ * Binary model file, all integers little endian:
+ *   bytes 0-63        ModelHeader
+ *   64                layers int32 layer sizes (the structure), zero padded to 64 bytes
+ *   parameterOffset   parameterCount scalars of scalarSize bytes (4 for float, 8 for double) laid out
+ *                     exactly like the parameters of a BasicDigitClassifier of that precision:
+ *                     for every layer its row major weight matrix and then its biases, each block
+ *                     zero padded so the next one starts on a 64 byte boundary
+ * Because the block matches the in memory layout, a mapped file can be used without copying.
+ */
+struct ModelHeader
+{
+	char magic[4];
+	std::uint32_t version;
+	std::uint32_t layers;
+	std::uint32_t scalarSize;
+	std::uint64_t parameterOffset;
+	std::uint64_t parameterCount;
+	//FNV-1a hash of the structure and the parameter block.
+	std::uint64_t checksum;
+	//0 for sigmoid outputs, 1 for softmax. Files from before softmax existed have 0 here.
+	std::uint32_t outputLayer;
+	std::uint8_t reserved[20];
+};
+
+static_assert(sizeof(ModelHeader) == 64, "ModelHeader must stay 64 bytes");
+
+const char MODEL_MAGIC[4] = { 'D', 'C', 'N', 'N' };
+const std::uint32_t MODEL_VERSION = 1;
+
+//True if the file at path starts with the binary model magic number.
+bool isModelFile(const std::string & path);
+
+//Size in bytes of the scalars stored in a binary model file, or 0 if the file is not one.
+std::uint32_t modelScalarSize(const std::string & path);
+
+//Output layer recorded in a binary model file's header, 0 for sigmoid and 1 for softmax.
+std::uint32_t modelOutputLayer(const std::string & path);
+
+//64 bit FNV-1a hash of bytes, continuing from hash.
+std::uint64_t fnv1a(const void * bytes, std::size_t size, std::uint64_t hash = 14695981039346656037ULL);
+
+/*
+ * The memory holding a network's parameters: either an owned AlignedBuffer or a region of a model
+ * file mapped copy-on-write. Inference on a mapped model reads the file's pages directly, and every
+ * process mapping the same file shares them. Copies are always owned buffers, so writing to a copy
+ * never affects the file or another network.
+ */
+template<typename T>
+class ParameterStorage
+{
+public:
+	ParameterStorage() : mapping(nullptr), mappingSize(0), mapped(nullptr), count(0) {}
+
+	ParameterStorage(const ParameterStorage & other);
+
+	ParameterStorage(ParameterStorage && other) noexcept;
+
+	ParameterStorage & operator=(ParameterStorage other) noexcept;
+
+	~ParameterStorage();
+
+	//Switches to an owned buffer of count zeroed elements.
+	void resize(std::size_t count);
+
+	/*
+	 * Maps the parameter block of a binary model file. Returns false, leaving the storage unchanged,
+	 * if the file is not a valid model with scalars of type T. On success the structure stored in the
+	 * file is written to structure.
+	 */
+	bool map(const std::string & path, std::vector<int> & structure);
+
+	bool isMapped() const
+	{
+		return mapping != nullptr;
+	}
+
+	void zero();
+
+	T * data() { return mapping ? mapped : owned.data(); }
+	const T * data() const { return mapping ? mapped : owned.data(); }
+	std::size_t size() const { return mapping ? count : owned.size(); }
+	T & operator[](std::size_t i) { return data()[i]; }
+	const T & operator[](std::size_t i) const { return data()[i]; }
+
+private:
+	void unmap();
+
+	AlignedBuffer<T> owned;
+	void * mapping;
+	std::size_t mappingSize;
+	T * mapped;
+	std::size_t count;
+};
+
+/*
+ * Syncs temporary, renames it over path and syncs the directory, so path is always either the old
+ * file or the whole new one. Processes that have the old file mapped keep reading it unchanged.
+ * Removes temporary and returns false if any step failed.
+ */
+bool replaceFile(const std::string & temporary, const std::string & path);
+
+//Writes a binary model file through replaceFile. Returns false if it could not be written.
+template<typename T>
+bool writeModelFile(const std::string & path, const std::vector<int> & structure, const T * parameters,
+		std::size_t count, std::uint32_t outputLayer = 0);
+
+#endif /* MODELFILE_H_ */
@@ -0,0 +1,157 @@
+/*
+ * Author: Shuhao Lai
+ * Date: 10/17/2026
+ * Optimizer.cpp
+ *
+ * Built with -fno-math-errno so that std::sqrt in Adam's loop can be vectorized.
+ */
+#include <algorithm>
+#include <cmath>
+#include "Optimizer.h"
+#include "Kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define OPTIMIZER_X86
+#endif
+
+const char * optimizerName(OptimizerKind kind)
+{
+	static const char * names[] = { "sgd", "momentum", "nesterov", "adam" };
+	return names[kind];
+}
+
+int optimizerBuffers(OptimizerKind kind)
+{
+	switch (kind)
+	{
+	case OPTIMIZER_MOMENTUM:
+	case OPTIMIZER_NESTEROV:
+		return 1;
+	case OPTIMIZER_ADAM:
+		return 2;
+	default:
+		return 0;
+	}
+}
+
+double scheduledEta(const Optimizer & optimizer, double eta, double progress, int epochs)
+{
+	if (optimizer.warmupEpochs > 0 && progress < optimizer.warmupEpochs)
+		return eta * progress / optimizer.warmupEpochs;
+	if (optimizer.schedule == SCHEDULE_STEP && optimizer.stepEpochs > 0)
+		return eta * std::pow(optimizer.stepFactor, (int) (progress / optimizer.stepEpochs));
+	if (optimizer.schedule == SCHEDULE_COSINE && epochs > optimizer.warmupEpochs)
+	{
+		//Measured from the end of the warmup, so the cosine starts at the full eta.
+		double fraction = std::min(1.0, (progress - optimizer.warmupEpochs) / (epochs - optimizer.warmupEpochs));
+		double low = eta * optimizer.minEtaFraction;
+		return low + (eta - low) * (1 + std::cos(M_PI * fraction)) / 2;
+	}
+	return eta;
+}
+
+/*
+ * Every optimizer reads each parameter, gradient and state value once and writes it once. The loops
+ * are plain so that the compiler vectorizes them for whichever instruction set the caller targets;
+ * restrict tells it the arrays never overlap.
+ */
+template<typename T>
+__attribute__((always_inline))
+static inline void sweep(const Optimizer & optimizer, double eta, int batchSize, long step, T * __restrict params,
+		const T * __restrict grads, T * __restrict state, std::size_t count)
+{
+	T rate = eta / batchSize;
+	T momentum = optimizer.momentum;
+	switch (optimizer.kind)
+	{
+	case OPTIMIZER_SGD:
+		for (std::size_t i = 0; i < count; i++)
+			params[i] -= rate * grads[i];
+		break;
+	case OPTIMIZER_MOMENTUM:
+		for (std::size_t i = 0; i < count; i++)
+		{
+			state[i] = momentum * state[i] - rate * grads[i];
+			params[i] += state[i];
+		}
+		break;
+	case OPTIMIZER_NESTEROV:
+		for (std::size_t i = 0; i < count; i++)
+		{
+			T change = rate * grads[i];
+			state[i] = momentum * state[i] - change;
+			params[i] += momentum * state[i] - change;
+		}
+		break;
+	case OPTIMIZER_ADAM:
+	{
+		T * __restrict first = state;
+		T * __restrict second = state + count;
+		T mean = (T) 1 / batchSize;
+		T beta1 = optimizer.beta1, beta2 = optimizer.beta2, epsilon = optimizer.epsilon;
+		//The bias corrections fold into the step size and one factor on the second moment.
+		T size = eta / (1 - std::pow(optimizer.beta1, (double) step));
+		T correction = 1 / (1 - std::pow(optimizer.beta2, (double) step));
+		for (std::size_t i = 0; i < count; i++)
+		{
+			T g = grads[i] * mean;
+			first[i] = beta1 * first[i] + (1 - beta1) * g;
+			second[i] = beta2 * second[i] + (1 - beta2) * g * g;
+			params[i] -= size * first[i] / (std::sqrt(second[i] * correction) + epsilon);
+		}
+		break;
+	}
+	}
+}
+
+template<typename T>
+static void sweepScalar(const Optimizer & optimizer, double eta, int batchSize, long step, T * params,
+		const T * grads, T * state, std::size_t count)
+{
+	sweep(optimizer, eta, batchSize, step, params, grads, state, count);
+}
+
+#ifdef OPTIMIZER_X86
+template<typename T>
+__attribute__((target("avx2,fma")))
+static void sweepAvx2(const Optimizer & optimizer, double eta, int batchSize, long step, T * params,
+		const T * grads, T * state, std::size_t count)
+{
+	sweep(optimizer, eta, batchSize, step, params, grads, state, count);
+}
+
+//Without prefer-vector-width the compiler would stop at 256 bit vectors.
+template<typename T>
+__attribute__((target("avx512f,prefer-vector-width=512")))
+static void sweepAvx512(const Optimizer & optimizer, double eta, int batchSize, long step, T * params,
+		const T * grads, T * state, std::size_t count)
+{
+	sweep(optimizer, eta, batchSize, step, params, grads, state, count);
+}
+#endif
+
+template<typename T>
+static void applyOptimizerImpl(const Optimizer & optimizer, double eta, int batchSize, long step, T * params,
+		const T * grads, T * state, std::size_t count)
+{
+#ifdef OPTIMIZER_X86
+	KernelPath path = kernelPath();
+	if (path == KERNEL_AVX512)
+		return sweepAvx512(optimizer, eta, batchSize, step, params, grads, state, count);
+	if (path == KERNEL_AVX2)
+		return sweepAvx2(optimizer, eta, batchSize, step, params, grads, state, count);
+#endif
+	sweepScalar(optimizer, eta, batchSize, step, params, grads, state, count);
+}
+
+void applyOptimizer(const Optimizer & optimizer, double eta, int batchSize, long step, double * params,
+		const double * grads, double * state, std::size_t count)
+{
+	applyOptimizerImpl(optimizer, eta, batchSize, step, params, grads, state, count);
+}
+
+void applyOptimizer(const Optimizer & optimizer, double eta, int batchSize, long step, float * params,
+		const float * grads, float * state, std::size_t count)
+{
+	applyOptimizerImpl(optimizer, eta, batchSize, step, params, grads, state, count);
+}
@@ -0,0 +1,70 @@
+/*
+ * Author: Shuhao Lai
+ * Date: 10/17/2026
+ * Optimizer.h
+ */
+
+#ifndef OPTIMIZER_H_
+#define OPTIMIZER_H_
+
+#include <cstddef>
+
+/*
+ * How a minibatch's gradient g, the mean over its images, moves the parameters p:
+ *   OPTIMIZER_SGD        p -= eta * g
+ *   OPTIMIZER_MOMENTUM   v = momentum * v - eta * g, p += v
+ *   OPTIMIZER_NESTEROV   v = momentum * v - eta * g, p += momentum * v - eta * g
+ *   OPTIMIZER_ADAM       m = beta1 * m + (1 - beta1) * g, s = beta2 * s + (1 - beta2) * g * g,
+ *                        p -= eta * m / (1 - beta1^t) / (sqrt(s / (1 - beta2^t)) + epsilon)
+ * where t counts the updates. v, m and s are buffers laid out like the parameters.
+ */
+enum OptimizerKind
+{
+	OPTIMIZER_SGD, OPTIMIZER_MOMENTUM, OPTIMIZER_NESTEROV, OPTIMIZER_ADAM
+};
+
+/*
+ * How eta changes over a run. SCHEDULE_STEP multiplies it by stepFactor every stepEpochs epochs.
+ * SCHEDULE_COSINE follows half a cosine from eta down to minEtaFraction * eta at the end of the run.
+ */
+enum ScheduleKind
+{
+	SCHEDULE_CONSTANT, SCHEDULE_STEP, SCHEDULE_COSINE
+};
+
+struct Optimizer
+{
+	OptimizerKind kind = OPTIMIZER_SGD;
+	double momentum = 0.9;
+	double beta1 = 0.9;
+	double beta2 = 0.999;
+	double epsilon = 1e-8;
+
+	ScheduleKind schedule = SCHEDULE_CONSTANT;
+	int stepEpochs = 10;
+	double stepFactor = 0.1;
+	double minEtaFraction = 0;
+	//eta rises linearly from 0 over this many epochs, which may be a fraction, before the schedule applies.
+	double warmupEpochs = 0;
+};
+
+const char * optimizerName(OptimizerKind kind);
+
+//Buffers laid out like the parameters that kind keeps between updates.
+int optimizerBuffers(OptimizerKind kind);
+
+//eta at the point progress epochs into a run of epochs epochs. progress counts partly done epochs as fractions.
+double scheduledEta(const Optimizer & optimizer, double eta, double progress, int epochs);
+
+/*
+ * Updates count parameters in one pass over params, grads and state, on the active kernel path.
+ * grads holds the gradients summed over batchSize images. state holds optimizerBuffers(kind) arrays
+ * of count values one after another, zero before the first update, and step is the number of this
+ * update counting from 1.
+ */
+void applyOptimizer(const Optimizer & optimizer, double eta, int batchSize, long step, double * params,
+		const double * grads, double * state, std::size_t count);
+void applyOptimizer(const Optimizer & optimizer, double eta, int batchSize, long step, float * params,
+		const float * grads, float * state, std::size_t count);
+
+#endif /* OPTIMIZER_H_ */
@@ -0,0 +1,172 @@
+/*
+ * Author: Shuhao Lai
+ * Date: 10/17/2026
+ * QuantizedClassifier.cpp
+ */
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include "QuantizedClassifier.h"
+#include "Kernels.h"
+#include "Activation.h"
+#include "ThreadPool.h"
+
+using std::cout;
+using std::endl;
+using std::vector;
+
+QuantizedClassifier::QuantizedClassifier(const DigitClassifier & network, const Dataset & calibration, int samples) :
+		structure(network.getStructure())
+{
+	int count = (int) structure.size() - 1;
+
+	//Runs the sample through the original network to find how far each hidden layer's activations reach.
+	vector<double> largest(count, 1.0);
+	int images = std::min<std::size_t>(samples, calibration.size());
+	if (images > 0 && calibration.imageSize() == structure[0])
+	{
+		Matrix<double> inputs(images, structure[0]);
+		for (int i = 0; i < images; i++)
+		{
+			const std::uint8_t * pixels = calibration.pixels((std::size_t) i * calibration.size() / images);
+			for (int p = 0; p < structure[0]; p++)
+				inputs[i][p] = pixels[p] / 255.0;
+		}
+		vector<Matrix<double>> zVals, acts;
+		network.feedForwardBatch(inputs.view(), zVals, acts);
+		for (int layer = 0; layer < count; layer++)
+			largest[layer] = std::max(*std::max_element(acts[layer].data(), acts[layer].data() + acts[layer].size()),
+					1e-6);
+	}
+
+	layers.resize(count);
+	float inputScale = 1.0f / 255;
+	for (int layer = 0; layer < count; layer++)
+	{
+		Layer & q = layers[layer];
+		MatrixView<const double> w = network.weights(layer);
+		q.rows = w.rows();
+		q.cols = w.cols();
+		q.stride = alignedCount<std::int8_t>(q.cols);
+		q.weights.resize(q.rows * q.stride);
+		q.scales.resize(q.rows);
+		q.biases.assign(network.biases(layer), network.biases(layer) + q.rows);
+		for (int r = 0; r < q.rows; r++)
+		{
+			double maxAbs = 0;
+			for (int c = 0; c < q.cols; c++)
+				maxAbs = std::max(maxAbs, std::fabs(w[r][c]));
+			double weightScale = maxAbs > 0 ? maxAbs / 127 : 1;
+			std::int8_t * row = q.weights.data() + r * q.stride;
+			for (int c = 0; c < q.cols; c++)
+				row[c] = (std::int8_t) std::max(-127.0, std::min(127.0, std::round(w[r][c] / weightScale)));
+			q.scales[r] = weightScale * inputScale;
+		}
+		q.outputScale = largest[layer] / 255;
+		inputScale = q.outputScale;
+	}
+}
+
+int QuantizedClassifier::classify(const std::uint8_t * pixels) const
+{
+	//Per thread scratch, so steady state classification does not allocate.
+	thread_local vector<std::uint8_t> buffers[2];
+	thread_local vector<std::int32_t> sums;
+	thread_local vector<float> activations;
+	const std::uint8_t * inputs = pixels;
+	for (int layer = 0; layer < (int) layers.size(); layer++)
+	{
+		const Layer & q = layers[layer];
+		sums.resize(q.rows);
+		gemvU8S8(q.weights.data(), q.rows, q.cols, q.stride, inputs, sums.data());
+		if (layer == (int) layers.size() - 1)
+		{
+			//Sigmoid is increasing, so the largest z is the largest activation.
+			int best = 0;
+			float bestZ = q.scales[0] * sums[0] + q.biases[0];
+			for (int r = 1; r < q.rows; r++)
+			{
+				float z = q.scales[r] * sums[r] + q.biases[r];
+				if (z > bestZ)
+				{
+					best = r;
+					bestZ = z;
+				}
+			}
+			return best;
+		}
+		vector<std::uint8_t> & outputs = buffers[layer % 2];
+		outputs.resize(q.rows);
+		activations.resize(q.rows);
+		for (int r = 0; r < q.rows; r++)
+			activations[r] = q.scales[r] * sums[r] + q.biases[r];
+		applySigmoid(activations.data(), activations.data(), q.rows);
+		float steps = 1 / q.outputScale;
+		for (int r = 0; r < q.rows; r++)
+			outputs[r] = (std::uint8_t) std::min(255.0f, activations[r] * steps + 0.5f);
+		inputs = outputs.data();
+	}
+	return 0;
+}
+
+int QuantizedClassifier::classify(const vector<double> & inputs) const
+{
+	if (structure[0] != (int) inputs.size())
+		cout << "Program will continue but training images' size and input image size are different." << endl;
+	vector<std::uint8_t> pixels(structure[0]);
+	for (int p = 0; p < structure[0] && p < (int) inputs.size(); p++)
+		pixels[p] = (std::uint8_t) std::max(0.0, std::min(255.0, std::round(inputs[p] * 255)));
+	return classify(pixels.data());
+}
+
+EvaluationReport QuantizedClassifier::evaluate(std::string path, int threads) const
+{
+	Dataset images = Dataset::load(path, structure.back());
+	if (!images.isOpen())
+		return EvaluationReport(structure.back());
+	return evaluate(images, threads);
+}
+
+/*
+ * Every image is timed on its own: the quantized model is meant for one request at a time.
+ */
+EvaluationReport QuantizedClassifier::evaluate(const Dataset & images, int threads) const
+{
+	//classify reads structure[0] pixels, so narrower images would be read past their end.
+	if (images.size() > 0 && images.imageSize() != structure[0])
+	{
+		cout << "Images have " << images.imageSize() << " pixels but the network takes " << structure[0] << endl;
+		return EvaluationReport(structure.back());
+	}
+	auto begin = std::chrono::steady_clock::now();
+	ThreadPool pool(threads);
+	int shards = pool.size();
+	vector<EvaluationReport> shardReports(shards, EvaluationReport(structure.back()));
+	pool.run(shards, [&](int shard)
+	{
+		std::size_t first = images.size() * shard / shards, last = images.size() * (shard + 1) / shards;
+		for (std::size_t i = first; i < last; i++)
+		{
+			auto imageBegin = std::chrono::steady_clock::now();
+			int result = classify(images.pixels(i));
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - imageBegin).count();
+			shardReports[shard].record(images.label(i), result, seconds);
+		}
+	});
+
+	EvaluationReport report(structure.back());
+	for (const EvaluationReport & shardReport : shardReports)
+		report.merge(shardReport);
+	report.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	cout << "Final Accuracy: " << report.accuracy() << "%" << endl;
+	return report;
+}
+
+std::size_t QuantizedClassifier::modelBytes() const
+{
+	std::size_t bytes = 0;
+	for (const Layer & q : layers)
+		bytes += q.weights.size() + (q.scales.size() + q.biases.size()) * sizeof(float);
+	return bytes;
+}
@@ -0,0 +1,70 @@
+/*
+ * Author: Shuhao Lai
+ * Date: 10/17/2026
+ * QuantizedClassifier.h
+ */
+
+#ifndef QUANTIZEDCLASSIFIER_H_
+#define QUANTIZEDCLASSIFIER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "DigitClassifier.h"
+#include "EvaluationReport.h"
+#include "Dataset.h"
+
+/*
+ * An 8 bit copy of a trained network for inference only. Every weight row is stored as int8 with
+ * its own scale, and activations travel between layers as uint8. The input layer takes the raw 0-255
+ * pixels as they are, so an image is classified without ever converting it to floating point, and
+ * every dot product is an exact integer sum computed by gemvU8S8.
+ *
+ * Hidden activations are sigmoid outputs in [0, 1]. Their uint8 scale is calibrated from the largest
+ * activation each layer produces on a sample of training images, so no code is wasted on values
+ * the layer never reaches.
+ */
+class QuantizedClassifier
+{
+public:
+	//Quantizes network, calibrating on up to samples images spread evenly over calibration.
+	QuantizedClassifier(const DigitClassifier & network, const Dataset & calibration, int samples = 1000);
+
+	//Classifies an image of raw 0-255 pixels.
+	int classify(const std::uint8_t * pixels) const;
+
+	//Classifies an image normalized to [0, 1] the way getImages returns it.
+	int classify(const std::vector<double> & inputs) const;
+
+	//Same report DigitClassifier::evaluate gives, so the two can be compared directly.
+	EvaluationReport evaluate(const Dataset & images, int threads = 1) const;
+	EvaluationReport evaluate(std::string path, int threads = 1) const;
+
+	//Bytes of weights, scales and biases, to compare with DigitClassifier::parameterCount() * sizeof(double).
+	std::size_t modelBytes() const;
+
+	const std::vector<int> & getStructure() const
+	{
+		return structure;
+	}
+
+private:
+	struct Layer
+	{
+		int rows;
+		int cols;
+		//Each row of weights starts on a cache line.
+		std::size_t stride;
+		AlignedBuffer<std::int8_t> weights;
+		//Converts a row's integer sum back to a z value: weight scale times input scale.
+		std::vector<float> scales;
+		std::vector<float> biases;
+		//Activation value of one uint8 step in this layer's output. Unused for the last layer.
+		float outputScale;
+	};
+
+	std::vector<int> structure;
+	std::vector<Layer> layers;
+};
+
+#endif /* QUANTIZEDCLASSIFIER_H_ */
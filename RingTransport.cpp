@@ -0,0 +1,414 @@
+/*
+ * Author: Shuhao Lai
+ * Date: 10/17/2026
+ * RingTransport.cpp
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "RingTransport.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+
+//Bytes in flight from one rank to the next. Anything longer streams through in pieces.
+static const std::size_t CHANNEL_BYTES = 1 << 20;
+
+/*
+ * The shared memory object is a SharedHeader followed by one Channel per rank. Rank r writes into
+ * channel r and rank r + 1 reads it. written and read count every byte that has gone through the
+ * channel, so written - read bytes are waiting and byte i sits at data[i % CHANNEL_BYTES]. Each
+ * counter has one writer and lives on its own cache line. ftruncate zero fills the object, which
+ * is every counter's starting value.
+ */
+struct alignas(64) SharedHeader
+{
+	std::atomic<std::uint32_t> joined;
+};
+
+struct Channel
+{
+	alignas(64) std::atomic<std::uint64_t> written;
+	alignas(64) std::atomic<std::uint64_t> read;
+	alignas(64) unsigned char data[CHANNEL_BYTES];
+};
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free && std::atomic<std::uint32_t>::is_always_lock_free,
+		"Counters shared between processes must be lock free");
+
+const char * transportName(TransportKind kind)
+{
+	static const char * names[] = { "sharedMemory", "tcp" };
+	return names[kind];
+}
+
+RingTransport::RingTransport() :
+		transportKind(TRANSPORT_SHARED_MEMORY), myRank(0), ringSize(1), timeoutSeconds(30), sent(0), shared(nullptr),
+		sharedSize(0), nextFd(-1), previousFd(-1)
+{
+}
+
+RingTransport::~RingTransport()
+{
+	close();
+}
+
+bool RingTransport::connect(TransportKind kind, const string & address, int rank, int size, int timeoutSeconds)
+{
+	close();
+	if (size < 1 || rank < 0 || rank >= size)
+	{
+		cout << "Rank " << rank << " does not fit in a ring of " << size << endl;
+		return false;
+	}
+	transportKind = kind;
+	myRank = rank;
+	ringSize = size;
+	this->timeoutSeconds = std::max(timeoutSeconds, 1);
+	sent = 0;
+	if (size == 1)
+		return true;
+	bool connected = kind == TRANSPORT_TCP ? connectTcp(address) : connectSharedMemory(address);
+	if (!connected)
+		close();
+	sent = 0;
+	return connected;
+}
+
+void RingTransport::close()
+{
+	if (shared != nullptr)
+		munmap(shared, sharedSize);
+	shared = nullptr;
+	if (nextFd >= 0)
+		::close(nextFd);
+	if (previousFd >= 0)
+		::close(previousFd);
+	nextFd = previousFd = -1;
+	myRank = 0;
+	ringSize = 1;
+}
+
+bool RingTransport::exchange(const void * out, std::size_t outSize, void * in, std::size_t inSize)
+{
+	const unsigned char * from = static_cast<const unsigned char *>(out);
+	unsigned char * to = static_cast<unsigned char *>(in);
+	if (ringSize == 1)
+	{
+		std::memcpy(to, from, std::min(outSize, inSize));
+		sent += outSize;
+		return true;
+	}
+	bool exchanged = transportKind == TRANSPORT_TCP ? exchangeTcp(from, outSize, to, inSize)
+			: exchangeSharedMemory(from, outSize, to, inSize);
+	if (exchanged)
+		sent += outSize;
+	return exchanged;
+}
+
+static Channel * channels(void * shared)
+{
+	return reinterpret_cast<Channel *>(static_cast<unsigned char *>(shared) + sizeof(SharedHeader));
+}
+
+/*
+ * Rank 0 creates the object and the others open it once it has its full size. Once every rank has
+ * joined, rank 0 unlinks the name, so nothing is left behind however the run ends. A rank that opens
+ * an object left by a run that crashed while joining waits in the wrong ring until it times out.
+ */
+bool RingTransport::connectSharedMemory(const string & address)
+{
+	sharedSize = sizeof(SharedHeader) + ringSize * sizeof(Channel);
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(timeoutSeconds);
+	int fd = -1;
+	if (myRank == 0)
+	{
+		shm_unlink(address.c_str());
+		fd = shm_open(address.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+		if (fd >= 0 && ftruncate(fd, sharedSize) != 0)
+		{
+			::close(fd);
+			fd = -1;
+		}
+		if (fd < 0)
+		{
+			cout << "Could not create shared memory " << address << ": " << std::strerror(errno) << endl;
+			shm_unlink(address.c_str());
+			return false;
+		}
+	}
+	while (fd < 0)
+	{
+		fd = shm_open(address.c_str(), O_RDWR, 0600);
+		struct stat status;
+		if (fd >= 0 && (fstat(fd, &status) != 0 || (std::size_t) status.st_size != sharedSize))
+		{
+			//Not truncated yet, or made for a ring of another size.
+			::close(fd);
+			fd = -1;
+		}
+		if (fd >= 0)
+			break;
+		if (std::chrono::steady_clock::now() > deadline)
+		{
+			cout << "Rank " << myRank << " timed out waiting for shared memory " << address << endl;
+			return false;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	shared = mmap(nullptr, sharedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (shared == MAP_FAILED)
+	{
+		shared = nullptr;
+		cout << "Could not map shared memory " << address << ": " << std::strerror(errno) << endl;
+		if (myRank == 0)
+			shm_unlink(address.c_str());
+		return false;
+	}
+
+	std::atomic<std::uint32_t> & joined = static_cast<SharedHeader *>(shared)->joined;
+	joined.fetch_add(1);
+	while (joined.load() < (std::uint32_t) ringSize)
+	{
+		if (std::chrono::steady_clock::now() > deadline)
+		{
+			cout << "Rank " << myRank << " timed out waiting for the ring at " << address << endl;
+			if (myRank == 0)
+				shm_unlink(address.c_str());
+			return false;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	if (myRank == 0)
+		shm_unlink(address.c_str());
+	return true;
+}
+
+//Copies count bytes into channel starting at byte position, wrapping around the end of its data.
+static void copyIntoChannel(Channel & channel, std::uint64_t position, const unsigned char * from, std::size_t count)
+{
+	std::size_t offset = position % CHANNEL_BYTES, first = std::min(count, CHANNEL_BYTES - offset);
+	std::memcpy(channel.data + offset, from, first);
+	std::memcpy(channel.data, from + first, count - first);
+}
+
+static void copyFromChannel(const Channel & channel, std::uint64_t position, unsigned char * to, std::size_t count)
+{
+	std::size_t offset = position % CHANNEL_BYTES, first = std::min(count, CHANNEL_BYTES - offset);
+	std::memcpy(to, channel.data + offset, first);
+	std::memcpy(to + first, channel.data, count - first);
+}
+
+/*
+ * Alternates between filling the next rank's channel and draining the previous rank's, yielding the
+ * core whenever neither can move. The release stores publish the bytes copied before them.
+ */
+bool RingTransport::exchangeSharedMemory(const unsigned char * out, std::size_t outSize, unsigned char * in,
+		std::size_t inSize)
+{
+	Channel & next = channels(shared)[myRank];
+	Channel & previous = channels(shared)[(myRank + ringSize - 1) % ringSize];
+	std::size_t done = 0, got = 0;
+	bool idle = false;
+	std::chrono::steady_clock::time_point idleSince;
+	while (done < outSize || got < inSize)
+	{
+		bool moved = false;
+		if (done < outSize)
+		{
+			std::uint64_t written = next.written.load(std::memory_order_relaxed);
+			std::uint64_t read = next.read.load(std::memory_order_acquire);
+			std::size_t count = std::min<std::size_t>(CHANNEL_BYTES - (written - read), outSize - done);
+			if (count > 0)
+			{
+				copyIntoChannel(next, written, out + done, count);
+				next.written.store(written + count, std::memory_order_release);
+				done += count;
+				moved = true;
+			}
+		}
+		if (got < inSize)
+		{
+			std::uint64_t written = previous.written.load(std::memory_order_acquire);
+			std::uint64_t read = previous.read.load(std::memory_order_relaxed);
+			std::size_t count = std::min<std::size_t>(written - read, inSize - got);
+			if (count > 0)
+			{
+				copyFromChannel(previous, read, in + got, count);
+				previous.read.store(read + count, std::memory_order_release);
+				got += count;
+				moved = true;
+			}
+		}
+		if (moved)
+		{
+			idle = false;
+			continue;
+		}
+		auto now = std::chrono::steady_clock::now();
+		if (!idle)
+		{
+			idle = true;
+			idleSince = now;
+		}
+		else if (now - idleSince > std::chrono::seconds(timeoutSeconds))
+		{
+			cout << "Rank " << myRank << " timed out waiting for its neighbours" << endl;
+			return false;
+		}
+		std::this_thread::yield();
+	}
+	return true;
+}
+
+static bool parsePort(const string & address, int ranks, int & port)
+{
+	char * end;
+	long value = std::strtol(address.c_str(), &end, 10);
+	if (address.empty() || *end != '\0' || value < 1 || value + ranks - 1 > 65535)
+		return false;
+	port = value;
+	return true;
+}
+
+static sockaddr_in loopback(int port)
+{
+	sockaddr_in inet;
+	std::memset(&inet, 0, sizeof(inet));
+	inet.sin_family = AF_INET;
+	inet.sin_port = htons(port);
+	inet.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	return inet;
+}
+
+/*
+ * Listens first, so that the previous rank's connect completes from the backlog whatever order the
+ * ranks start in, then connects to the next rank, retrying until it listens, and accepts the previous
+ * one. The ranks then swap their rank and size to check that the ring is wired as expected.
+ */
+bool RingTransport::connectTcp(const string & address)
+{
+	int port;
+	if (!parsePort(address, ringSize, port))
+	{
+		cout << "Not a port a ring of " << ringSize << " can start at: " << address << endl;
+		return false;
+	}
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(timeoutSeconds);
+	int listenFd = socket(AF_INET, SOCK_STREAM, 0);
+	int on = 1;
+	sockaddr_in own = loopback(port + myRank);
+	if (listenFd >= 0)
+		setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	if (listenFd < 0 || bind(listenFd, (sockaddr *) &own, sizeof(own)) != 0 || listen(listenFd, 1) != 0)
+	{
+		cout << "Rank " << myRank << " could not listen on port " << port + myRank << ": " << std::strerror(errno)
+				<< endl;
+		if (listenFd >= 0)
+			::close(listenFd);
+		return false;
+	}
+
+	sockaddr_in next = loopback(port + (myRank + 1) % ringSize);
+	while (nextFd < 0)
+	{
+		nextFd = socket(AF_INET, SOCK_STREAM, 0);
+		if (nextFd >= 0 && ::connect(nextFd, (sockaddr *) &next, sizeof(next)) == 0)
+			break;
+		if (nextFd >= 0)
+			::close(nextFd);
+		nextFd = -1;
+		if (std::chrono::steady_clock::now() > deadline)
+			break;
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	pollfd waiting = { listenFd, POLLIN, 0 };
+	long remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline
+			- std::chrono::steady_clock::now()).count();
+	if (nextFd >= 0 && poll(&waiting, 1, std::max(remaining, 0L)) == 1)
+		previousFd = accept(listenFd, nullptr, nullptr);
+	::close(listenFd);
+	if (nextFd < 0 || previousFd < 0)
+	{
+		cout << "Rank " << myRank << " timed out joining the ring at port " << port << endl;
+		return false;
+	}
+
+	//Minibatch sized messages would otherwise wait for acknowledgements.
+	setsockopt(nextFd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+	fcntl(nextFd, F_SETFL, fcntl(nextFd, F_GETFL) | O_NONBLOCK);
+	fcntl(previousFd, F_SETFL, fcntl(previousFd, F_GETFL) | O_NONBLOCK);
+
+	std::uint32_t hello[2] = { (std::uint32_t) myRank, (std::uint32_t) ringSize }, theirs[2];
+	if (!exchangeTcp(reinterpret_cast<unsigned char *>(hello), sizeof(hello),
+			reinterpret_cast<unsigned char *>(theirs), sizeof(theirs)))
+		return false;
+	if (theirs[0] != (std::uint32_t) ((myRank + ringSize - 1) % ringSize) || theirs[1] != (std::uint32_t) ringSize)
+	{
+		cout << "Rank " << myRank << " was connected to rank " << theirs[0] << " of " << theirs[1] << endl;
+		return false;
+	}
+	return true;
+}
+
+bool RingTransport::exchangeTcp(const unsigned char * out, std::size_t outSize, unsigned char * in,
+		std::size_t inSize)
+{
+	std::size_t done = 0, got = 0;
+	while (done < outSize || got < inSize)
+	{
+		pollfd fds[2];
+		int count = 0;
+		if (done < outSize)
+			fds[count++] = { nextFd, POLLOUT, 0 };
+		if (got < inSize)
+			fds[count++] = { previousFd, POLLIN, 0 };
+		int ready = poll(fds, count, timeoutSeconds * 1000);
+		if (ready < 0 && errno == EINTR)
+			continue;
+		if (ready <= 0)
+		{
+			cout << "Rank " << myRank << (ready == 0 ? " timed out waiting for its neighbours" : " could not poll")
+					<< endl;
+			return false;
+		}
+		for (int i = 0; i < count; i++)
+		{
+			if (fds[i].revents == 0)
+				continue;
+			ssize_t moved;
+			if (fds[i].fd == nextFd)
+			{
+				moved = send(nextFd, out + done, outSize - done, MSG_NOSIGNAL);
+				done += moved > 0 ? moved : 0;
+			}
+			else
+			{
+				moved = recv(previousFd, in + got, inSize - got, 0);
+				got += moved > 0 ? moved : 0;
+			}
+			if (moved == 0 || (moved < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+			{
+				cout << "Rank " << myRank << " lost its connection to the ring" << endl;
+				return false;
+			}
+		}
+	}
+	return true;
+}
@@ -0,0 +1,103 @@
+/*
+ * Author: Shuhao Lai
+ * Date: 10/17/2026
+ * RingTransport.h
+ */
+
+#ifndef RINGTRANSPORT_H_
+#define RINGTRANSPORT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+ * How the ranks of a ring reach each other. All of them stay on one machine.
+ *   TRANSPORT_SHARED_MEMORY  address names a POSIX shared memory object, such as "/digits-ring".
+ *                            Rank r writes into a ring buffer in it that rank r + 1 reads.
+ *   TRANSPORT_TCP            address is a port number, such as "5600". Rank r listens on loopback
+ *                            port address + r and connects to rank r + 1's.
+ */
+enum TransportKind
+{
+	TRANSPORT_SHARED_MEMORY, TRANSPORT_TCP
+};
+
+const char * transportName(TransportKind kind);
+
+/*
+ * Connects size processes, or threads, into a ring in which every rank streams bytes to the next
+ * rank and from the previous one, the last rank's next being rank 0. That is all a ring all-reduce
+ * needs; see AllReduce.h. Each rank only knows the ring's address, its own rank and the size.
+ */
+class RingTransport
+{
+public:
+	RingTransport();
+
+	//Leaves the ring if still in it.
+	~RingTransport();
+
+	RingTransport(const RingTransport &) = delete;
+	RingTransport & operator=(const RingTransport &) = delete;
+
+	/*
+	 * Joins the ring at address as rank of size ranks, waiting up to timeoutSeconds for the others
+	 * to start. The same timeout later limits how long exchange waits for a peer. A ring of one
+	 * needs no connection. Returns false after printing why it failed.
+	 */
+	bool connect(TransportKind kind, const std::string & address, int rank, int size, int timeoutSeconds = 30);
+
+	void close();
+
+	/*
+	 * Sends outSize bytes to the next rank while receiving inSize bytes from the previous one, so
+	 * that every rank can send at once without any of them blocking the ring. In a ring of one the
+	 * bytes sent are the ones received. Returns false after printing why if a peer went away or
+	 * nothing moved for the timeout.
+	 */
+	bool exchange(const void * out, std::size_t outSize, void * in, std::size_t inSize);
+
+	int rank() const
+	{
+		return myRank;
+	}
+
+	int size() const
+	{
+		return ringSize;
+	}
+
+	TransportKind kind() const
+	{
+		return transportKind;
+	}
+
+	//Bytes this rank has sent since it connected.
+	std::uint64_t bytesSent() const
+	{
+		return sent;
+	}
+
+private:
+	bool connectSharedMemory(const std::string & address);
+	bool connectTcp(const std::string & address);
+	bool exchangeSharedMemory(const unsigned char * out, std::size_t outSize, unsigned char * in, std::size_t inSize);
+	bool exchangeTcp(const unsigned char * out, std::size_t outSize, unsigned char * in, std::size_t inSize);
+
+	TransportKind transportKind;
+	int myRank;
+	int ringSize;
+	int timeoutSeconds;
+	std::uint64_t sent;
+
+	//TRANSPORT_SHARED_MEMORY: the mapped object, laid out as described in RingTransport.cpp.
+	void * shared;
+	std::size_t sharedSize;
+
+	//TRANSPORT_TCP: sockets to the next and from the previous rank.
+	int nextFd;
+	int previousFd;
+};
+
+#endif /* RINGTRANSPORT_H_ */
@@ -0,0 +1,59 @@
+/*
+ * Author: Shuhao Lai
+ * Date: 10/17/2026
+ * Server.cpp
+ *
+ * Serves a trained model over a Unix socket or loopback TCP port until interrupted, then prints its counters.
+ *   Server Trained.txt /tmp/digits.sock [workers] [maxBatch] [maxWaitMicros]
+ *   Server Trained.txt 5555 2 64 200
+ */
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <pthread.h>
+#include "InferenceServer.h"
+
+int main(int argc, char ** argv)
+{
+	if (argc < 3 || argc > 6)
+	{
+		std::cout << "Usage: " << argv[0] << " model address [workers] [maxBatch] [maxWaitMicros]" << std::endl;
+		std::cout << "       address is a socket path or a loopback port number" << std::endl;
+		return 1;
+	}
+	int workers = argc > 3 ? std::atoi(argv[3]) : 1;
+	int maxBatch = argc > 4 ? std::atoi(argv[4]) : 64;
+	int maxWaitMicros = argc > 5 ? std::atoi(argv[5]) : 200;
+
+	//Every thread started from here on inherits the mask, so only sigwait below sees SIGINT and SIGTERM.
+	sigset_t signals;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+	DigitClassifier network(argv[1]);
+	if (network.getStructure().size() < 2)
+	{
+		std::cout << "Model could not be loaded: " << argv[1] << std::endl;
+		return 1;
+	}
+	InferenceServer server(network, workers, maxBatch, maxWaitMicros);
+	if (!server.listen(argv[2]))
+		return 1;
+	std::cout << "Serving " << argv[1] << " on " << argv[2] << " with " << workers << " workers, batches of up to "
+			<< maxBatch << ", waiting at most " << maxWaitMicros << " us" << std::endl;
+	std::thread acceptor(&InferenceServer::serve, &server);
+
+	int received;
+	sigwait(&signals, &received);
+	server.stop();
+	acceptor.join();
+
+	ServerStats stats = server.stats();
+	std::cout << stats.requests << " requests in " << stats.batches << " batches (mean " << stats.meanBatch
+			<< "), p50 " << stats.p50Micros << " us, p99 " << stats.p99Micros << " us, "
+			<< stats.requestsPerSecond << " requests/s" << std::endl;
+	return 0;
+}
@@ -0,0 +1,65 @@
+/*
+ * Author: Shuhao Lai
+ * Date: 10/17/2026
+ * SyntheticData.cpp
+ */
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include "SyntheticData.h"
+#include "Dataset.h"
+
+//Seeds the templates, so every call draws the same ten digits.
+static const unsigned TEMPLATE_SEED = 1;
+
+SyntheticImages makeSyntheticImages(std::size_t count, unsigned seed, double noise)
+{
+	const int pixelsPerImage = SyntheticImages::ROWS * SyntheticImages::COLS;
+	std::mt19937 templateEngine(TEMPLATE_SEED);
+	std::uniform_real_distribution<double> unit(0, 1);
+	std::vector<double> background(pixelsPerImage);
+	for (double & value : background)
+		value = unit(templateEngine) * 150;
+	std::vector<std::vector<double>> templates(10, std::vector<double>(pixelsPerImage));
+	for (std::vector<double> & digit : templates)
+		for (double & value : digit)
+			value = unit(templateEngine) * 60;
+
+	SyntheticImages images;
+	images.pixels.resize(count * pixelsPerImage);
+	images.labels.resize(count);
+	std::mt19937 e(seed);
+	std::normal_distribution<double> gaussian(0, noise);
+	for (std::size_t i = 0; i < count; i++)
+	{
+		int label = e() % 10;
+		images.labels[i] = label;
+		std::uint8_t * pixels = images.pixels.data() + i * pixelsPerImage;
+		for (int p = 0; p < pixelsPerImage; p++)
+			pixels[p] = std::min(255.0, std::max(0.0, background[p] + templates[label][p] + gaussian(e)));
+	}
+	return images;
+}
+
+bool writeSyntheticCsv(const std::string & path, const SyntheticImages & images)
+{
+	std::FILE * out = std::fopen(path.c_str(), "w");
+	if (out == nullptr)
+		return false;
+	const int pixelsPerImage = SyntheticImages::ROWS * SyntheticImages::COLS;
+	for (std::size_t i = 0; i < images.size(); i++)
+	{
+		std::fprintf(out, "%d", images.labels[i]);
+		const std::uint8_t * pixels = images.pixels.data() + i * pixelsPerImage;
+		for (int p = 0; p < pixelsPerImage; p++)
+			std::fprintf(out, ",%d", pixels[p]);
+		std::fputc('\n', out);
+	}
+	return std::fclose(out) == 0;
+}
+
+bool writeSyntheticDataset(const std::string & path, const SyntheticImages & images)
+{
+	return Dataset::write(path, images.size(), SyntheticImages::ROWS, SyntheticImages::COLS, images.pixels.data(),
+			images.labels.data());
+}
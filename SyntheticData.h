@@ -0,0 +1,45 @@
+/*
+ * Author: Shuhao Lai
+ * Date: 10/17/2026
+ * SyntheticData.h
+ */
+
+#ifndef SYNTHETICDATA_H_
+#define SYNTHETICDATA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * MNIST shaped images for benchmarks that have to run without downloading MNIST. Every digit has a
+ * fixed random template, the same for every seed, and each image is a background shared by all
+ * digits plus its digit's template plus Gaussian noise, clamped to 0-255. With the default noise a
+ * 784-30-10 network reaches about 99% within a few epochs; more noise makes it harder.
+ */
+struct SyntheticImages
+{
+	static const int ROWS = 28;
+	static const int COLS = 28;
+
+	//Image i is pixels[i * ROWS * COLS] onwards.
+	std::vector<std::uint8_t> pixels;
+	std::vector<std::uint8_t> labels;
+
+	std::size_t size() const
+	{
+		return labels.size();
+	}
+};
+
+//Generates count images. Different seeds give different images of the same digits.
+SyntheticImages makeSyntheticImages(std::size_t count, unsigned seed, double noise = 90);
+
+//Writes label,pixel,pixel,... rows like mnist_train.csv. Returns false if the file could not be written.
+bool writeSyntheticCsv(const std::string & path, const SyntheticImages & images);
+
+//Writes the binary dataset format described in Dataset.h.
+bool writeSyntheticDataset(const std::string & path, const SyntheticImages & images);
+
+#endif /* SYNTHETICDATA_H_ */
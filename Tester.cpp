@@ -9,7 +9,25 @@
 #include <cstdlib>
 #include <ctime>
 #include <cassert>
+#include <cmath>
 #include "DigitClassifier.h"
+#include "Kernels.h"
+#include "ThreadPool.h"
+#include "BatchStream.h"
+#include "QuantizedClassifier.h"
+#include "FixedNetwork.h"
+#include "InferenceServer.h"
+#include "Activation.h"
+#include "Metrics.h"
+#include "Checkpoint.h"
+#include "Optimizer.h"
+#include "RingTransport.h"
+#include "AllReduce.h"
+#include <atomic>
+#include <numeric>
+#include <new>
+#include <thread>
+#include <unistd.h>
 
 using std::ifstream;
 using std::string;
@@ -23,6 +41,45 @@ using std::make_pair;
 typedef vector<pair<int, vector<double>>> labeledImages;
 typedef vector<vector<double>> twoDArray;
 
+/*
+ * Counts heap allocations made by any thread while countingAllocations is set. Both operator new
+ * and aligned_alloc, which AlignedBuffer uses, are replaced for the whole test program.
+ */
+static std::atomic<bool> countingAllocations(false);
+static std::atomic<long> allocations(0);
+
+void * operator new(std::size_t size)
+{
+	if (countingAllocations)
+		++allocations;
+	void * p = std::malloc(size ? size : 1);
+	if (p == nullptr)
+		throw std::bad_alloc();
+	return p;
+}
+
+//GCC cannot tell that free is the right way to release memory from the operator new above.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void operator delete(void * p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void * p, std::size_t) noexcept
+{
+	std::free(p);
+}
+#pragma GCC diagnostic pop
+
+extern "C" void * aligned_alloc(std::size_t alignment, std::size_t size) noexcept
+{
+	if (countingAllocations)
+		++allocations;
+	void * p = nullptr;
+	return posix_memalign(&p, alignment, size) == 0 ? p : nullptr;
+}
+
 std::ostream& operator<<(std::ostream & o, const vector<double> & vec)
 {
 	for (double a : vec)
@@ -97,6 +154,56 @@ void testTranspose(DigitClassifier & obj)
 
 }
 
+//Every kernel path and transpose combination must match a plain triple loop, including edge tiles.
+void testGemmAndGemv()
+{
+	int sizes[][3] = { { 1, 1, 1 }, { 3, 5, 7 }, { 20, 30, 784 }, { 17, 33, 300 }, { 130, 9, 260 } };
+	for (int path = KERNEL_SCALAR; path <= KERNEL_AVX512; path++)
+	{
+		setKernelPath((KernelPath) path);
+		for (auto & size : sizes)
+		{
+			int m = size[0], n = size[1], k = size[2];
+			Matrix<double> a(m, k), aT(k, m), b(k, n), bT(n, k), expected(m, n), c(m, n);
+			for (int i = 0; i < m; i++)
+				for (int p = 0; p < k; p++)
+					a[i][p] = aT[p][i] = std::sin(i * 7 + p * 3);
+			for (int p = 0; p < k; p++)
+				for (int j = 0; j < n; j++)
+					b[p][j] = bT[j][p] = std::cos(p * 5 + j);
+			for (int i = 0; i < m; i++)
+				for (int j = 0; j < n; j++)
+				{
+					expected[i][j] = 0.5;
+					for (int p = 0; p < k; p++)
+						expected[i][j] += 2 * a[i][p] * b[p][j];
+				}
+			for (int transA = 0; transA < 2; transA++)
+				for (int transB = 0; transB < 2; transB++)
+				{
+					for (int i = 0; i < m; i++)
+						std::fill(c[i], c[i] + n, 1.0);
+					gemm((Transpose) transA, (Transpose) transB, 2, transA ? aT.view() : a.view(),
+							transB ? bT.view() : b.view(), 0.5, c.view());
+					for (int i = 0; i < m; i++)
+						for (int j = 0; j < n; j++)
+							assert(fabs(c[i][j] - expected[i][j]) < 1e-9 * k);
+				}
+			vector<double> x(k), y(m, 1.0), yT(m, 1.0);
+			for (int p = 0; p < k; p++)
+				x[p] = b[p][0];
+			gemv(NO_TRANSPOSE, 2, a.view(), x.data(), 0.5, y.data());
+			gemv(TRANSPOSE, 2, aT.view(), x.data(), 0.5, yT.data());
+			for (int i = 0; i < m; i++)
+			{
+				assert(fabs(y[i] - expected[i][0]) < 1e-9 * k);
+				assert(fabs(yT[i] - expected[i][0]) < 1e-9 * k);
+			}
+		}
+	}
+	setKernelPath(bestKernelPath());
+}
+
 void testExtractDoubles(DigitClassifier & obj)
 {
 	string line = "1 2 3 5.0 5.4 0 0 0 0 0 0 1.2";
@@ -226,8 +333,1258 @@ void testUpdateSystem()
 	test.updateSystem(a, 2);
 }
 
+//The batched errors must match running lastLayerError and backpropagate one image at a time.
+void testBackpropagateBatch()
+{
+	vector<int> conditions{ 4, 6, 5, 3 };
+	DigitClassifier test(conditions);
+	Matrix<double> inputs(3, 4);
+	int labels[] = { 0, 2, 1 };
+	for (int r = 0; r < inputs.rows(); r++)
+		for (int c = 0; c < inputs.cols(); c++)
+			inputs[r][c] = 0.1 * (r + 1) * (c + 1);
+	vector<Matrix<double>> zVals, acts, errors;
+	test.feedForwardBatch(inputs.view(), zVals, acts);
+	test.backpropagateBatch(zVals, acts, labels, errors);
+	for (int img = 0; img < inputs.rows(); img++)
+	{
+		twoDArray imgZVals;
+		vector<double> act(inputs[img], inputs[img] + inputs.cols());
+		for (int layer = 1; layer < (int) conditions.size(); layer++)
+		{
+			imgZVals.push_back(test.feedForwardOnce(act, layer));
+			act = test.activations(imgZVals.back());
+		}
+		vector<int> y(conditions.back(), 0);
+		y[labels[img]] = 1;
+		twoDArray totalError;
+		totalError.push_back(test.lastLayerError(imgZVals.back(), y));
+		test.backpropagate(conditions.size() - 3, totalError[0], imgZVals, totalError);
+		for (int layer = 0; layer < (int) errors.size(); layer++)
+			for (int neuron = 0; neuron < errors[layer].cols(); neuron++)
+				assert(fabs(errors[layer][img][neuron] - totalError[totalError.size() - 1 - layer][neuron]) < 1e-12);
+	}
+}
+
+//Splitting a minibatch across threads must be repeatable and agree with the single threaded update.
+/*
+ * Gradients of a deep network against central differences of the quadratic cost, and the per image
+ * backpropagate against the batch version on the same network.
+ */
+void testBackpropagateDeep()
+{
+	vector<int> conditions{ 784, 100, 100, 10 };
+	DigitClassifier test(conditions);
+	Matrix<double> inputs(3, 784);
+	int labels[] = { 3, 7, 0 };
+	for (int r = 0; r < inputs.rows(); r++)
+		for (int c = 0; c < inputs.cols(); c++)
+			inputs[r][c] = ((r * 37 + c * 11) % 255) / 255.0;
+	AlignedBuffer<double> gradients(test.parameterCount());
+	test.addGradients(inputs.view(), labels, gradients);
+
+	DigitClassifier::Workspace workspace;
+	vector<double> outputs(10);
+	auto cost = [&]()
+	{
+		double total = 0;
+		for (int r = 0; r < inputs.rows(); r++)
+		{
+			test.classify(inputs[r], inputs.cols(), workspace, outputs.data());
+			for (int n = 0; n < 10; n++)
+				total += (outputs[n] - (n == labels[r])) * (outputs[n] - (n == labels[r])) / 2;
+		}
+		return total;
+	};
+	//Weights start at offset 0 of the parameters, and gradients share their layout.
+	const double * base = test.weights(0).data();
+	auto check = [&](double * parameter)
+	{
+		double saved = *parameter, h = 1e-5;
+		*parameter = saved + h;
+		double above = cost();
+		*parameter = saved - h;
+		double below = cost();
+		*parameter = saved;
+		double analytic = gradients.data()[parameter - base];
+		assert(fabs((above - below) / (2 * h) - analytic) < 1e-8 + 1e-5 * fabs(analytic));
+	};
+	for (int layer = 0; layer < 3; layer++)
+		for (int i = 0; i < 5; i++)
+		{
+			MatrixView<double> w = test.weights(layer);
+			check(&w[(i * 17) % w.rows()][(i * 131 + 400) % w.cols()]);
+			check(test.biases(layer) + (i * 7) % w.rows());
+		}
+
+	vector<Matrix<double>> zVals, acts, errors;
+	test.feedForwardBatch(inputs.view(), zVals, acts);
+	test.backpropagateBatch(zVals, acts, labels, errors);
+	twoDArray imgZVals;
+	for (int layer = 0; layer < 3; layer++)
+		imgZVals.push_back(vector<double>(zVals[layer][1], zVals[layer][1] + conditions[layer + 1]));
+	vector<int> y(10, 0);
+	y[labels[1]] = 1;
+	twoDArray totalErrors{ test.lastLayerError(imgZVals.back(), y) };
+	test.backpropagate(1, totalErrors[0], imgZVals, totalErrors);
+	assert(totalErrors.size() == 3);
+	for (int layer = 0; layer < 3; layer++)
+		for (int neuron = 0; neuron < conditions[layer + 1]; neuron++)
+			assert(fabs(errors[layer][1][neuron] - totalErrors[2 - layer][neuron]) < 1e-12);
+}
+void testUpdateSystemParallel()
+{
+	vector<int> conditions{ 20, 12, 10 };
+	DigitClassifier serial(conditions);
+	DigitClassifier first(serial), second(serial);
+	Matrix<double> inputs(17, 20);
+	vector<int> labels(17);
+	for (int r = 0; r < inputs.rows(); r++)
+	{
+		labels[r] = r % 10;
+		for (int c = 0; c < inputs.cols(); c++)
+			inputs[r][c] = ((r * 31 + c * 7) % 255) / 255.0;
+	}
+	ThreadPool pool(3);
+	vector<DigitClassifier::TrainingWorkspace> workspaces;
+	serial.updateSystemBatch(inputs.view(), labels.data(), 3);
+	first.updateSystemParallel(inputs.view(), labels.data(), 3, pool, workspaces);
+	second.updateSystemParallel(inputs.view(), labels.data(), 3, pool, workspaces);
+	for (int layer = 0; layer < (int) conditions.size() - 1; layer++)
+	{
+		MatrixView<const double> s = serial.weights(layer), a = first.weights(layer), b = second.weights(layer);
+		for (std::size_t i = 0; i < s.size(); i++)
+		{
+			assert(a.data()[i] == b.data()[i]);
+			assert(fabs(a.data()[i] - s.data()[i]) < 1e-12);
+		}
+	}
+}
+
+//Hogwild updates race by design, so only check that every image was used and nothing blew up.
+void testHogwildEpoch()
+{
+	vector<int> conditions{ 4, 5, 3 };
+	DigitClassifier test(conditions);
+	DigitClassifier before(test);
+	labeledImages a;
+	vector<int> order;
+	for (int i = 0; i < 15; i++)
+	{
+		a.push_back(make_pair(i % 3, vector<double>{ 0.1 * i, 0.2, 0.3, 0.4 }));
+		order.push_back(14 - i);
+	}
+	ThreadPool pool(2);
+	vector<DigitClassifier::TrainingWorkspace> workspaces;
+	test.hogwildEpoch(a, order, 4, 3, pool, workspaces);
+	bool changed = false;
+	for (int layer = 0; layer < 2; layer++)
+		for (std::size_t i = 0; i < test.weights(layer).size(); i++)
+		{
+			assert(std::isfinite(test.weights(layer).data()[i]));
+			changed = changed || test.weights(layer).data()[i] != before.weights(layer).data()[i];
+		}
+	assert(changed);
+}
+
+void testEvaluationReport()
+{
+	EvaluationReport first(3), second(3);
+	first.record(0, 0, 1);
+	first.record(0, 1, 1);
+	first.record(1, 1, 1);
+	second.record(2, 1, 1);
+	second.record(2, 2, 3);
+	first.merge(second);
+	assert(first.total() == 5 && first.correct() == 3);
+	assert(first.accuracy() == 60);
+	assert(first.precision(1) == 1.0 / 3 && first.recall(1) == 1);
+	assert(first.recall(0) == 0.5 && first.meanLatency(2) == 2);
+	assert(first.confusionMatrix()[2][1] == 1);
+}
+
+//Writes a tiny binary dataset and maps it back.
+void testDataset()
+{
+	std::uint8_t pixels[] = { 0, 255, 10, 20, 30, 40 };
+	std::uint8_t labels[] = { 7, 3 };
+	assert(Dataset::write("DatasetTest.dcds", 2, 1, 3, pixels, labels));
+	assert(Dataset::isDatasetFile("DatasetTest.dcds"));
+	Dataset data("DatasetTest.dcds");
+	assert(data.isOpen() && data.size() == 2 && data.imageSize() == 3);
+	assert(data[1].label == 3 && data[1].pixels[2] == 40 && data.pixels(0)[1] == 255);
+
+	//A label past the last class rejects the file unless the loader is told there are more classes.
+	labels[1] = 10;
+	assert(Dataset::write("DatasetTest.dcds", 2, 1, 3, pixels, labels));
+	assert(!Dataset("DatasetTest.dcds").isOpen());
+	assert(Dataset("DatasetTest.dcds", 11).isOpen());
+}
+
+//Malformed rows must be reported with their line numbers and left out, not misread.
+void testFromCsv()
+{
+	std::ofstream out("FromCsvTest.csv");
+	out << "1,0,128,255\n" << "2,3,4\n" << "\n" << "3,1,2,256\n" << "4,5,6,7\r\n" << "5,8,9,10\n" << "10,1,2,3";
+	out.close();
+	Dataset data = Dataset::fromCsv("FromCsvTest.csv", 2);
+	assert(data.isOpen() && data.size() == 3 && data.imageSize() == 3);
+	assert(data.label(0) == 1 && data.pixels(0)[2] == 255);
+	assert(data.label(1) == 4 && data.pixels(1)[2] == 7);
+	assert(data.label(2) == 5 && data.pixels(2)[0] == 8);
+	assert(data.errors().size() == 3);
+	assert(data.errors()[0].find("line 2") == 0 && data.errors()[1].find("line 4") == 0);
+	assert(data.errors()[2].find("line 7: label 10") == 0);
+	assert(Dataset::fromCsv("FromCsvTest.csv", 2, 11).size() == 4);
+}
+
+//Every image must come out exactly once per epoch, whatever the window and batch sizes.
+void testBatchStream()
+{
+	std::uint8_t pixels[10 * 2], labels[10];
+	for (int i = 0; i < 10; i++)
+	{
+		labels[i] = i;
+		pixels[2 * i] = pixels[2 * i + 1] = i * 10;
+	}
+	assert(Dataset::write("BatchStreamTest.dcds", 10, 1, 2, pixels, labels));
+	BatchStream stream("BatchStreamTest.dcds", 4, 2, 3);
+	assert(stream.isOpen() && stream.imageSize() == 2);
+	for (int epoch = 0; epoch < 2; epoch++)
+	{
+		MatrixView<const double> inputs;
+		const int * batchLabels;
+		vector<int> seen(10, 0);
+		while (stream.next(inputs, batchLabels))
+		{
+			assert(inputs.rows() <= 4);
+			for (int r = 0; r < inputs.rows(); r++)
+			{
+				++seen[batchLabels[r]];
+				assert(inputs[r][1] == batchLabels[r] * 10 / 255.0);
+			}
+		}
+		assert(seen == vector<int>(10, 1));
+	}
+
+	//Labels from classes up are left out of both formats, and the rest still come through.
+	std::ofstream csv("BatchStreamTest.csv");
+	for (int i = 0; i < 10; i++)
+		csv << i << ",0,0\n";
+	csv.close();
+	for (const char * path : { "BatchStreamTest.dcds", "BatchStreamTest.csv" })
+	{
+		BatchStream fewer(path, 4, 1, 3, 3, 5);
+		MatrixView<const double> inputs;
+		const int * batchLabels;
+		vector<int> seen(10, 0);
+		while (fewer.next(inputs, batchLabels))
+			for (int r = 0; r < inputs.rows(); r++)
+				++seen[batchLabels[r]];
+		assert(seen == vector<int>({ 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 }));
+	}
+}
+
+//Images of the wrong width must be turned away rather than multiplied past the first layer's weights.
+void testMismatchedImages()
+{
+	std::uint8_t pixels[] = { 10, 20, 30, 40 };
+	std::uint8_t labels[] = { 0, 1 };
+	assert(Dataset::write("MismatchTest.dcds", 2, 1, 2, pixels, labels));
+	Dataset data("MismatchTest.dcds");
+	vector<int> structure{3, 2, 2};
+	DigitClassifier network(structure);
+	double before = network.weights(0)[1][2];
+	network.train("MismatchTest.dcds", 1, 2, 1);
+	network.SGD(data, 1, 2, 1);
+	network.trainStreaming("MismatchTest.dcds", 1, 2, 1);
+	assert(network.weights(0)[1][2] == before);
+	assert(network.evaluate("MismatchTest.dcds").total() == 0);
+	assert(network.evaluate(data).total() == 0);
+	DigitClassifier::labeledImages images{ {0, {0.1, 0.2}}, {1, {0.3, 0.4}} };
+	assert(network.evaluate(images).total() == 0);
+	QuantizedClassifier quantized(network, data);
+	assert(quantized.evaluate(data).total() == 0);
+}
+
+void testSaveAndMap()
+{
+	vector<int> structure{5, 4, 3};
+	DigitClassifier original(structure);
+	assert(original.save("SaveTest.dcnn"));
+	DigitClassifier mapped("SaveTest.dcnn");
+	assert(mapped.isMapped() && mapped.getStructure() == structure);
+	assert(mapped.parameterCount() == original.parameterCount());
+	for (int layer = 0; layer < 2; layer++)
+		for (int r = 0; r < structure[layer + 1]; r++)
+		{
+			assert(mapped.biases(layer)[r] == original.biases(layer)[r]);
+			for (int c = 0; c < structure[layer]; c++)
+				assert(mapped.weights(layer)[r][c] == original.weights(layer)[r][c]);
+		}
+	vector<double> image{0.1, 0.2, 0.3, 0.4, 0.5};
+	assert(mapped.classify(image) == original.classify(image));
+
+	//Text export keeps every digit.
+	original.toString("SaveTest.txt");
+	DigitClassifier text("SaveTest.txt");
+	assert(!text.isMapped() && text.weights(1)[2][3] == original.weights(1)[2][3]);
+
+	//Saving over the file a model is mapped from replaces it, and the mappings keep the old weights.
+	DigitClassifier resaved("SaveTest.dcnn");
+	resaved.weights(0)[0][0] += 1;
+	assert(resaved.save("SaveTest.dcnn"));
+	assert(mapped.weights(0)[0][0] == original.weights(0)[0][0] && mapped.classify(image) == original.classify(image));
+	DigitClassifier reloaded("SaveTest.dcnn");
+	assert(reloaded.isMapped() && reloaded.weights(0)[0][0] == original.weights(0)[0][0] + 1);
+	reloaded.toString("SaveTest.dcnn");
+	DigitClassifier fromText("SaveTest.dcnn");
+	assert(!fromText.isMapped() && fromText.weights(0)[0][0] == reloaded.weights(0)[0][0]);
+	assert(reloaded.classify(image) == fromText.classify(image));
+	assert(original.save("SaveTest.dcnn"));
+
+	//A flipped byte fails the checksum.
+	std::fstream file("SaveTest.dcnn", std::ios::in | std::ios::out | std::ios::binary);
+	file.seekp(-1, std::ios::end);
+	file.put('x');
+	file.close();
+	DigitClassifier corrupt("SaveTest.dcnn");
+	assert(!corrupt.isMapped() && corrupt.getStructure().empty());
+}
+
+void testFloatPrecision()
+{
+	//Float kernels agree with the double ones to float precision on every path.
+	int m = 37, n = 19, k = 261;
+	Matrix<double> a(m, k), b(n, k), expected(m, n);
+	Matrix<float> aF(m, k), bF(n, k), c(m, n);
+	for (int i = 0; i < m; i++)
+		for (int p = 0; p < k; p++)
+			aF[i][p] = a[i][p] = std::sin(i * 7 + p * 3);
+	for (int j = 0; j < n; j++)
+		for (int p = 0; p < k; p++)
+			bF[j][p] = b[j][p] = std::cos(p * 5 + j);
+	gemm(NO_TRANSPOSE, TRANSPOSE, 1, a.view(), b.view(), 0, expected.view());
+	for (int path = KERNEL_SCALAR; path <= KERNEL_AVX512; path++)
+	{
+		setKernelPath((KernelPath) path);
+		gemm(NO_TRANSPOSE, TRANSPOSE, 1.0f, aF.view(), bF.view(), 0.0f, c.view());
+		for (int i = 0; i < m; i++)
+			for (int j = 0; j < n; j++)
+				assert(fabs(c[i][j] - expected[i][j]) < 1e-5 * k);
+		vector<float> y(m);
+		gemv(NO_TRANSPOSE, 1.0f, aF.view(), bF[0], 0.0f, y.data());
+		for (int i = 0; i < m; i++)
+			assert(fabs(y[i] - expected[i][0]) < 1e-5 * k);
+	}
+	setKernelPath(bestKernelPath());
+
+	//Models move between precisions through the constructor and through files of either precision.
+	vector<int> structure{5, 4, 3};
+	DigitClassifier original(structure);
+	FloatDigitClassifier single(original);
+	assert(single.weights(1)[2][3] == (float) original.weights(1)[2][3]);
+	assert(single.save("FloatTest.dcnn") && original.save("DoubleTest.dcnn"));
+	FloatDigitClassifier mapped("FloatTest.dcnn"), fromDouble("DoubleTest.dcnn");
+	DigitClassifier fromFloat("FloatTest.dcnn");
+	assert(mapped.isMapped() && !fromDouble.isMapped() && !fromFloat.isMapped());
+	assert(fromDouble.weights(0)[1][2] == single.weights(0)[1][2]);
+	assert(fromFloat.weights(0)[1][2] == (double) single.weights(0)[1][2]);
+	vector<float> image{0.1f, 0.2f, 0.3f, 0.4f, 0.5f};
+	assert(mapped.classify(image) == single.classify(image));
+}
+
+void testQuantizedClassifier()
+{
+	//Every path gives the exact integer sums, including rows shorter than one register.
+	int rows = 7, cols = 150;
+	std::size_t stride = alignedCount<std::int8_t>(cols);
+	AlignedBuffer<std::int8_t> a(rows * stride);
+	vector<std::uint8_t> x(cols);
+	for (int c = 0; c < cols; c++)
+	{
+		x[c] = (c * 37) % 256;
+		for (int r = 0; r < rows; r++)
+			a[r * stride + c] = (std::int8_t) ((r * 91 + c * 13) % 255 - 127);
+	}
+	for (int path = KERNEL_SCALAR; path <= KERNEL_AVX512; path++)
+	{
+		setKernelPath((KernelPath) path);
+		for (int n : {cols, 70, 5})
+		{
+			vector<std::int32_t> y(rows);
+			gemvU8S8(a.data(), rows, n, stride, x.data(), y.data());
+			for (int r = 0; r < rows; r++)
+			{
+				std::int32_t expected = 0;
+				for (int c = 0; c < n; c++)
+					expected += a[r * stride + c] * x[c];
+				assert(y[r] == expected);
+			}
+		}
+	}
+	setKernelPath(bestKernelPath());
+
+	//The quantized model almost always agrees with the network it came from.
+	const int images = 200, size = 64;
+	vector<std::uint8_t> pixels(images * size), labels(images, 0);
+	for (int i = 0; i < images * size; i++)
+		pixels[i] = (i * 7919) % 256;
+	assert(Dataset::write("QuantizedTest.dcds", images, 8, 8, pixels.data(), labels.data()));
+	Dataset data("QuantizedTest.dcds");
+	vector<int> structure{size, 16, 4};
+	DigitClassifier network(structure);
+	//Fixed weights in fillSystemRandomly's range. A few of its clock seeds leave outputs so close that
+	//rounding to int8 flips a quarter of the answers.
+	for (int layer = 0; layer < 2; layer++)
+	{
+		MatrixView<double> w = network.weights(layer);
+		for (std::size_t i = 0; i < w.size(); i++)
+			w.data()[i] = 1.2 * std::sin(i * 2.3 + layer);
+	}
+	QuantizedClassifier quantized(network, data);
+	assert(quantized.modelBytes() < network.parameterCount() * sizeof(double) / 4);
+	int agree = 0;
+	for (int i = 0; i < images; i++)
+	{
+		vector<double> image(data.pixels(i), data.pixels(i) + size);
+		for (double & pixel : image)
+			pixel /= 255;
+		agree += network.classify(image) == quantized.classify(data.pixels(i));
+		assert(quantized.classify(image) == quantized.classify(data.pixels(i)));
+	}
+	assert(agree >= images * 95 / 100);
+}
+
+void testFixedNetwork()
+{
+	vector<int> structure{37, 11, 5};
+	DigitClassifier network(structure);
+	FixedNetwork<37, 11, 5> fixed;
+	FixedNetwork<37, 12, 5> wrongSize;
+	assert(fixed.fromClassifier(network));
+	assert(!wrongSize.fromClassifier(network));
+	for (int path = KERNEL_SCALAR; path <= KERNEL_AVX512; path++)
+	{
+		setKernelPath((KernelPath) path);
+		for (int i = 0; i < 20; i++)
+		{
+			vector<double> image(37);
+			for (int p = 0; p < 37; p++)
+				image[p] = std::fabs(std::sin(i * 37 + p));
+			vector<double> expected = image, outputs(5);
+			for (int layer = 1; layer < 3; layer++)
+				expected = network.activations(network.feedForwardOnce(expected, layer));
+			assert(fixed.feedForward(image.data(), outputs.data()) == network.classify(image));
+			for (int j = 0; j < 5; j++)
+				assert(fabs(outputs[j] - expected[j]) < 1e-12);
+		}
+	}
+	setKernelPath(bestKernelPath());
+
+	network.save("FixedTest.dcnn");
+	FixedNetwork<37, 11, 5> loaded;
+	assert(loaded.readIn("FixedTest.dcnn"));
+	vector<double> image(37, 0.5);
+	assert(loaded.classify(image.data()) == network.classify(image));
+}
+
+void testClassifyWorkspace()
+{
+	vector<int> structure{6, 5, 4};
+	DigitClassifier network(structure);
+	InferenceWorkspace workspace;
+	Matrix<double> images(300, 6);
+	for (int r = 0; r < images.rows(); r++)
+		for (int c = 0; c < images.cols(); c++)
+			images[r][c] = std::fabs(std::sin(r * 6 + c));
+
+	vector<int> labels(images.rows()), top(images.rows() * 4);
+	Matrix<double> outputs(images.rows(), 4);
+	vector<double> scores(images.rows() * 4);
+	assert(network.classifyMany(images.view(), workspace, labels.data()) == INFERENCE_OK);
+	assert(network.classifyMany(images.view(), workspace, outputs.view()) == INFERENCE_OK);
+	assert(network.classifyManyTopK(images.view(), 4, workspace, top.data(), scores.data()) == INFERENCE_OK);
+	for (int r = 0; r < images.rows(); r++)
+	{
+		vector<double> image(images[r], images[r] + 6), expected = image;
+		for (int layer = 1; layer < 3; layer++)
+			expected = network.activations(network.feedForwardOnce(expected, layer));
+		assert(labels[r] == network.classify(image));
+		for (int j = 0; j < 4; j++)
+		{
+			assert(fabs(outputs[r][j] - expected[j]) < 1e-12);
+			assert(scores[r * 4 + j] == outputs[r][top[r * 4 + j]]);
+			assert(j == 0 || scores[r * 4 + j] <= scores[r * 4 + j - 1]);
+		}
+		assert(top[r * 4] == labels[r]);
+
+		int label = -1, best[2];
+		double single[4];
+		assert(network.classify(images[r], 6, workspace, label) == INFERENCE_OK && label == labels[r]);
+		assert(network.classify(images[r], 6, workspace, single) == INFERENCE_OK);
+		assert(network.classifyTopK(images[r], 6, 2, workspace, best) == INFERENCE_OK);
+		assert(best[0] == top[r * 4] && best[1] == top[r * 4 + 1]);
+		for (int j = 0; j < 4; j++)
+			assert(fabs(single[j] - outputs[r][j]) < 1e-12);
+	}
+
+	int label;
+	assert(network.classify(images[0], 5, workspace, label) == INFERENCE_SIZE_MISMATCH);
+	assert(network.classifyTopK(images[0], 6, 5, workspace, top.data()) == INFERENCE_BAD_ARGUMENT);
+	assert(network.classifyTopK(images[0], 6, 0, workspace, top.data()) == INFERENCE_BAD_ARGUMENT);
+	assert(network.classifyMany(images.view(), workspace, outputs.view().rowRange(0, 10)) == INFERENCE_SIZE_MISMATCH);
+	assert(network.classifyMany(images.view(), workspace, (int *) nullptr) == INFERENCE_BAD_ARGUMENT);
+}
+
+void testLatencyHistogram()
+{
+	LatencyHistogram histogram;
+	assert(histogram.percentile(50) == 0);
+	for (int micros = 1; micros <= 1000; micros++)
+		histogram.record(micros);
+	assert(histogram.count() == 1000);
+	assert(fabs(histogram.meanMicros() - 500.5) < 1e-9);
+	//Buckets are 2^(1/16) wide, so percentiles are within 4.5%.
+	assert(fabs(histogram.percentile(50) - 500) < 500 * 0.045);
+	assert(fabs(histogram.percentile(99) - 990) < 990 * 0.045);
+	LatencyHistogram other;
+	other.record(1e6);
+	histogram.merge(other);
+	assert(histogram.count() == 1001 && histogram.percentile(100) >= 1e6);
+}
+
+void testInferenceServer()
+{
+	vector<int> structure{16, 8, 4};
+	DigitClassifier network(structure);
+	InferenceServer server(network, 2, 8, 1000);
+	assert(server.listen("TestServer.sock"));
+	std::thread acceptor(&InferenceServer::serve, &server);
+
+	int fd = connectToServer("TestServer.sock");
+	assert(fd >= 0);
+	//Every request is sent before any response is read, so the server gets to batch them.
+	const int requests = 50;
+	vector<std::uint8_t> message(requests * (sizeof(RequestHeader) + 16));
+	vector<int> expected(requests);
+	for (int i = 0; i < requests; i++)
+	{
+		RequestHeader header = { REQUEST_CLASSIFY, (std::uint32_t) i, 16, 0 };
+		std::uint8_t * at = message.data() + i * (sizeof(RequestHeader) + 16);
+		std::memcpy(at, &header, sizeof(header));
+		vector<double> image(16);
+		for (int p = 0; p < 16; p++)
+		{
+			at[sizeof(header) + p] = (i * 37 + p * 11) % 256;
+			image[p] = at[sizeof(header) + p] / 255.0;
+		}
+		expected[i] = network.classify(image);
+	}
+	assert(writeFully(fd, message.data(), message.size()));
+	vector<bool> answered(requests, false);
+	for (int i = 0; i < requests; i++)
+	{
+		ResponseHeader response;
+		assert(readFully(fd, &response, sizeof(response)));
+		assert(response.id < (std::uint32_t) requests && !answered[response.id]);
+		assert(response.status == INFERENCE_OK && response.label == expected[response.id]);
+		answered[response.id] = true;
+	}
+
+	RequestHeader wrongSize = { REQUEST_CLASSIFY, 99, 3, 0 };
+	std::uint8_t pixels[3] = { 1, 2, 3 };
+	ResponseHeader response;
+	assert(writeFully(fd, &wrongSize, sizeof(wrongSize)) && writeFully(fd, pixels, 3));
+	assert(readFully(fd, &response, sizeof(response)));
+	assert(response.id == 99 && response.status == INFERENCE_SIZE_MISMATCH);
+
+	RequestHeader statsRequest = { REQUEST_STATS, 7, 0, 0 };
+	ServerStats stats;
+	assert(writeFully(fd, &statsRequest, sizeof(statsRequest)));
+	assert(readFully(fd, &response, sizeof(response)) && response.size == sizeof(stats));
+	assert(readFully(fd, &stats, sizeof(stats)));
+	assert(stats.requests == requests + 1 && stats.batches <= stats.requests && stats.p99Micros >= stats.p50Micros);
+	close(fd);
+
+	//Short lived clients do not leave their readers behind.
+	std::size_t readers = 0;
+	for (int client = 0; client < 40; client++)
+	{
+		int shortLived = connectToServer("TestServer.sock");
+		assert(shortLived >= 0);
+		statsRequest.id = client;
+		assert(writeFully(shortLived, &statsRequest, sizeof(statsRequest)));
+		assert(readFully(shortLived, &response, sizeof(response)) && readFully(shortLived, &stats, sizeof(stats)));
+		close(shortLived);
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		readers = server.readerCount();
+	}
+	assert(readers <= 3);
+
+	server.stop();
+	acceptor.join();
+	assert(access("TestServer.sock", F_OK) != 0);
+}
+
+void testActivation()
+{
+	//Odd sizes exercise the partial vector at the end of every path.
+	const int count = 1001;
+	vector<double> z(count), fast(count), derivative(count);
+	vector<float> zFloat(count), fastFloat(count);
+	for (int i = 0; i < count; i++)
+	{
+		z[i] = -50 + 100.0 * i / (count - 1);
+		zFloat[i] = z[i];
+	}
+	for (int path = KERNEL_SCALAR; path <= KERNEL_AVX512; path++)
+	{
+		setKernelPath((KernelPath) path);
+		vectorExp(z.data(), fast.data(), count);
+		vectorExp(zFloat.data(), fastFloat.data(), count);
+		for (int i = 0; i < count; i++)
+		{
+			assert(fabs(fast[i] - std::exp(z[i])) <= 4e-16 * std::exp(z[i]));
+			//Compared with the exact exp of the rounded float input.
+			assert(fabs(fastFloat[i] - std::exp(zFloat[i])) <= 3e-7 * std::exp(zFloat[i]));
+		}
+		applySigmoid(z.data(), fast.data(), count);
+		applySigmoid(zFloat.data(), fastFloat.data(), count);
+		for (int i = 0; i < count; i++)
+		{
+			double exact = 1 / (1 + std::exp(-z[i])), exactFloat = 1 / (1 + std::exp(-(double) zFloat[i]));
+			assert(fabs(fast[i] - exact) <= 4e-16 * exact);
+			assert(fabs(fastFloat[i] - exactFloat) <= 3e-7 * exactFloat);
+		}
+
+		//NaN must come out as NaN rather than be clamped to a finite value.
+		double nan[5] = {1, std::nan(""), -1, 2, 3}, nanOut[5];
+		float nanFloat[9] = {1, std::nanf(""), -1, 2, 3, 4, 5, 6, 7}, nanOutFloat[9];
+		vectorExp(nan, nanOut, 5);
+		vectorExp(nanFloat, nanOutFloat, 9);
+		assert(std::isnan(nanOut[1]) && std::isnan(nanOutFloat[1]) && fabs(nanOut[0] - std::exp(1.0)) < 1e-15);
+		applySigmoid(nan, nanOut, 5);
+		applySigmoid(nanFloat, nanOutFloat, 9);
+		assert(std::isnan(nanOut[1]) && std::isnan(nanOutFloat[1]));
+	}
+	setKernelPath(bestKernelPath());
+
+	setSigmoidMode(SIGMOID_TABLE);
+	applySigmoid(z.data(), fast.data(), count);
+	for (int i = 0; i < count; i++)
+		assert(fabs(fast[i] - 1 / (1 + std::exp(-z[i]))) < 3.2e-6);
+	double nan[3] = {-1, std::nan(""), 1}, nanOut[3];
+	applySigmoid(nan, nanOut, 3);
+	assert(std::isnan(nanOut[1]) && fabs(nanOut[2] - 1 / (1 + std::exp(-1.0))) < 3.2e-6);
+	setSigmoidMode(SIGMOID_FAST);
+
+	applySigmoid(z.data(), fast.data(), count);
+	sigmoidDerivative(fast.data(), derivative.data(), count);
+	vector<double> error(count, 2);
+	scaleBySigmoidDerivative(fast.data(), error.data(), count);
+	for (int i = 0; i < count; i++)
+	{
+		double e = std::exp(z[i]);
+		assert(fabs(derivative[i] - e / ((e + 1) * (e + 1))) < 1e-15);
+		assert(error[i] == 2 * derivative[i]);
+	}
+}
+
+/*
+ * After one warm up epoch has sized the workspaces, another epoch must not allocate at all,
+ * in every training mode. The last minibatch of each epoch is smaller than the others.
+ */
+void testTrainingWorkspaceAllocations()
+{
+	vector<int> conditions{ 30, 16, 10 };
+	labeledImages images;
+	vector<int> order;
+	for (int i = 0; i < 50; i++)
+	{
+		vector<double> pixels(30);
+		for (int p = 0; p < 30; p++)
+			pixels[p] = ((i * 13 + p * 7) % 255) / 255.0;
+		images.push_back(make_pair(i % 10, pixels));
+		order.push_back((i * 7) % 50);
+	}
+	for (int threads = 1; threads <= 2; threads++)
+	{
+		ThreadPool pool(threads);
+		DigitClassifier synchronous(conditions), hogwild(synchronous);
+		vector<DigitClassifier::TrainingWorkspace> workspaces, hogwildWorkspaces;
+		synchronous.synchronousEpoch(images, order, 8, 3, pool, workspaces);
+		hogwild.hogwildEpoch(images, order, 8, 3, pool, hogwildWorkspaces);
+
+		allocations = 0;
+		countingAllocations = true;
+		synchronous.synchronousEpoch(images, order, 8, 3, pool, workspaces);
+		hogwild.hogwildEpoch(images, order, 8, 3, pool, hogwildWorkspaces);
+		countingAllocations = false;
+		assert(allocations == 0);
+	}
+	//The counter itself must work.
+	countingAllocations = true;
+	vector<int> * counted = new vector<int>(100);
+	countingAllocations = false;
+	delete counted;
+	assert(allocations == 2);
+}
+
+/*
+ * Two epochs on two threads and an evaluation, with metrics on and a trace being written.
+ * Built without DIGITS_INSTRUMENTATION, nothing may be recorded at all.
+ */
+void testMetrics()
+{
+	vector<int> conditions{ 20, 8, 10 };
+	DigitClassifier test(conditions);
+	labeledImages images;
+	for (int i = 0; i < 30; i++)
+	{
+		vector<double> pixels(20);
+		for (int p = 0; p < 20; p++)
+			pixels[p] = ((i * 17 + p * 5) % 255) / 255.0;
+		images.push_back(make_pair(i % 10, pixels));
+	}
+	resetMetrics();
+	setMetricsEnabled(true);
+	startTrace("MetricsTest.json");
+	test.SGD(images, 2, 4, 3, 2);
+	test.evaluate(images);
+	stopTrace();
+	setMetricsEnabled(false);
+#ifdef DIGITS_INSTRUMENTATION
+	vector<EpochMetrics> epochs = epochMetrics();
+	assert(epochs.size() == 2);
+	for (const EpochMetrics & epoch : epochs)
+	{
+		assert(epoch.images == 30);
+		assert(epoch.loss > 0 && epoch.loss < 5);
+		assert(epoch.accuracy >= 0 && epoch.accuracy <= 100);
+		assert(epoch.seconds > 0 && epoch.imagesPerSecond > 0);
+	}
+	assert(epochs[1].epoch == 2);
+	assert(counterValue(COUNTER_IMAGES_TRAINED) == 60);
+	assert(counterValue(COUNTER_MINIBATCHES) == 16);
+	assert(counterValue(COUNTER_IMAGES_EVALUATED) == 30);
+	//SGD in one process never all-reduces.
+	for (int t = 0; t < TIMER_COUNT; t++)
+		assert(timerStats((Timer) t).count > 0 || t == TIMER_ALL_REDUCE);
+	assert(trainingLoss().images == 60);
+
+	std::remove("MetricsTest.jsonl");
+	assert(writeMetricsJsonLines("MetricsTest.jsonl"));
+	ifstream lines("MetricsTest.jsonl");
+	string line;
+	int count = 0;
+	while (getline(lines, line))
+	{
+		assert(line.front() == '{' && line.back() == '}');
+		count++;
+	}
+	assert(count == 2 + TIMER_COUNT + COUNTER_COUNT);
+
+	ifstream trace("MetricsTest.json");
+	string events((std::istreambuf_iterator<char>(trace)), std::istreambuf_iterator<char>());
+	assert(events.front() == '[' && events.substr(events.size() - 2) == "]\n");
+	assert(events.find("\"name\":\"forward\"") != string::npos);
+	assert(events.find("\"name\":\"evaluation\"") != string::npos);
+#else
+	assert(epochMetrics().empty());
+	assert(counterValue(COUNTER_IMAGES_TRAINED) == 0);
+#endif
+	resetMetrics();
+}
+
 //Must manually check output for correctness.
 
+
+
+//Softmax outputs trained on the cross-entropy: stable activations, gradients, probabilities and saving.
+void testSoftmaxOutput()
+{
+	double huge[] = { 1000, 1001, 1002 }, probabilities[3];
+	applySoftmax(huge, probabilities, 1, 3);
+	double sum = 1 + std::exp(-1.0) + std::exp(-2.0);
+	for (int i = 0; i < 3; i++)
+		assert(fabs(probabilities[i] - std::exp(i - 2.0) / sum) < 1e-15);
+	assert(fabs(logSumExp(huge, 3) - (1002 + std::log(sum))) < 1e-12);
+	float tiny[] = { -1000, -1000 };
+	assert(fabs(logSumExp(tiny, 2) - (-1000 + std::log(2.0))) < 1e-3);
+
+	vector<int> conditions{ 12, 7, 5 };
+	DigitClassifier test(conditions);
+	test.setOutputLayer(DigitClassifier::SOFTMAX_OUTPUT);
+	Matrix<double> inputs(3, 12);
+	int labels[] = { 4, 0, 2 };
+	for (int r = 0; r < inputs.rows(); r++)
+		for (int c = 0; c < inputs.cols(); c++)
+			inputs[r][c] = ((r * 37 + c * 11) % 255) / 255.0;
+	AlignedBuffer<double> gradients(test.parameterCount());
+	test.addGradients(inputs.view(), labels, gradients);
+
+	DigitClassifier::Workspace workspace;
+	vector<double> outputs(5), calibrated(5);
+	auto cost = [&]()
+	{
+		double total = 0;
+		for (int r = 0; r < inputs.rows(); r++)
+		{
+			test.classify(inputs[r], inputs.cols(), workspace, outputs.data());
+			total -= std::log(outputs[labels[r]]);
+		}
+		return total;
+	};
+	const double * base = test.weights(0).data();
+	auto check = [&](double * parameter)
+	{
+		double saved = *parameter, h = 1e-5;
+		*parameter = saved + h;
+		double above = cost();
+		*parameter = saved - h;
+		double below = cost();
+		*parameter = saved;
+		double analytic = gradients.data()[parameter - base];
+		assert(fabs((above - below) / (2 * h) - analytic) < 1e-8 + 1e-5 * fabs(analytic));
+	};
+	for (int layer = 0; layer < 2; layer++)
+		for (int i = 0; i < 5; i++)
+		{
+			MatrixView<double> w = test.weights(layer);
+			check(&w[(i * 3) % w.rows()][(i * 5 + 1) % w.cols()]);
+			check(test.biases(layer) + (i * 2) % w.rows());
+		}
+
+	//The per image path has the same a - y output error.
+	vector<double> image(inputs[1], inputs[1] + 12);
+	vector<double> z = test.feedForwardOnce(test.activations(test.feedForwardOnce(image, 1)), 2);
+	vector<int> y(5, 0);
+	y[labels[1]] = 1;
+	vector<double> error = test.lastLayerError(z, y);
+	test.classify(inputs[1], 12, workspace, outputs.data());
+	for (int i = 0; i < 5; i++)
+		assert(fabs(error[i] - (outputs[i] - y[i])) < 1e-14);
+
+	//Softmax outputs are the probabilities. Sigmoid outputs are only normalized.
+	assert(test.classifyProbabilities(inputs[0], 12, workspace, calibrated.data()) == INFERENCE_OK);
+	test.classify(inputs[0], 12, workspace, outputs.data());
+	assert(std::equal(outputs.begin(), outputs.end(), calibrated.begin()));
+	assert(fabs(std::accumulate(calibrated.begin(), calibrated.end(), 0.0) - 1) < 1e-14);
+	DigitClassifier sigmoid(test);
+	sigmoid.setOutputLayer(DigitClassifier::SIGMOID_OUTPUT);
+	assert(sigmoid.classifyProbabilities(inputs[0], 12, workspace, calibrated.data()) == INFERENCE_OK);
+	assert(fabs(std::accumulate(calibrated.begin(), calibrated.end(), 0.0) - 1) < 1e-14);
+	assert(sigmoid.classify(image) == test.classify(image));
+
+	//The output layer is saved in both formats and carried into FixedNetwork.
+	test.save("SoftmaxTest.dcnn");
+	test.toString("SoftmaxTest.txt");
+	DigitClassifier binary("SoftmaxTest.dcnn"), text("SoftmaxTest.txt");
+	assert(binary.getOutputLayer() == DigitClassifier::SOFTMAX_OUTPUT);
+	assert(text.getOutputLayer() == DigitClassifier::SOFTMAX_OUTPUT);
+	sigmoid.toString("SoftmaxTest.txt");
+	assert(DigitClassifier("SoftmaxTest.txt").getOutputLayer() == DigitClassifier::SIGMOID_OUTPUT);
+	FixedNetwork<12, 7, 5> fixed;
+	assert(fixed.fromClassifier(test));
+	vector<double> fixedOutputs(5);
+	int label;
+	test.classify(inputs[0], 12, workspace, label);
+	assert(fixed.feedForward(inputs[0], fixedOutputs.data()) == label);
+	for (int i = 0; i < 5; i++)
+		assert(fabs(fixedOutputs[i] - outputs[i]) < 1e-12);
+	std::remove("SoftmaxTest.dcnn");
+	std::remove("SoftmaxTest.txt");
+}
+//Every optimizer on every kernel path against a plain loop written from the formulas in Optimizer.h.
+void testOptimizers()
+{
+	const std::size_t count = 37;
+	const int batch = 5;
+	KernelPath saved = kernelPath();
+	for (int kind = OPTIMIZER_SGD; kind <= OPTIMIZER_ADAM; kind++)
+		for (int path = KERNEL_SCALAR; path <= bestKernelPath(); path++)
+		{
+			setKernelPath((KernelPath) path);
+			Optimizer optimizer;
+			optimizer.kind = (OptimizerKind) kind;
+			vector<double> params(count), grads(count), state(optimizerBuffers(optimizer.kind) * count);
+			vector<double> expected(count), v(count), m(count), s(count);
+			for (std::size_t i = 0; i < count; i++)
+				params[i] = expected[i] = std::sin(i + 1.0);
+			for (long step = 1; step <= 3; step++)
+			{
+				for (std::size_t i = 0; i < count; i++)
+					grads[i] = std::cos(i * 0.7 + step) * batch;
+				applyOptimizer(optimizer, 0.1, batch, step, params.data(), grads.data(), state.data(), count);
+				for (std::size_t i = 0; i < count; i++)
+				{
+					double g = grads[i] / batch;
+					if (kind == OPTIMIZER_SGD)
+						expected[i] -= 0.1 * g;
+					else if (kind == OPTIMIZER_MOMENTUM)
+						expected[i] += v[i] = 0.9 * v[i] - 0.1 * g;
+					else if (kind == OPTIMIZER_NESTEROV)
+					{
+						v[i] = 0.9 * v[i] - 0.1 * g;
+						expected[i] += 0.9 * v[i] - 0.1 * g;
+					}
+					else
+					{
+						m[i] = 0.9 * m[i] + 0.1 * g;
+						s[i] = 0.999 * s[i] + 0.001 * g * g;
+						double mHat = m[i] / (1 - std::pow(0.9, step)), sHat = s[i] / (1 - std::pow(0.999, step));
+						expected[i] -= 0.1 * mHat / (std::sqrt(sHat) + 1e-8);
+					}
+				}
+			}
+			for (std::size_t i = 0; i < count; i++)
+				assert(std::abs(params[i] - expected[i]) < 1e-12);
+		}
+	setKernelPath(saved);
+
+	Optimizer schedule;
+	assert(scheduledEta(schedule, 3, 7.5, 10) == 3);
+	schedule.schedule = SCHEDULE_STEP;
+	schedule.stepEpochs = 2;
+	schedule.stepFactor = 0.5;
+	assert(std::abs(scheduledEta(schedule, 4, 4.5, 10) - 1) < 1e-15);
+	schedule.schedule = SCHEDULE_COSINE;
+	schedule.warmupEpochs = 2;
+	assert(std::abs(scheduledEta(schedule, 4, 1, 10) - 2) < 1e-15);
+	assert(std::abs(scheduledEta(schedule, 4, 2, 10) - 4) < 1e-15);
+	assert(std::abs(scheduledEta(schedule, 4, 6, 10) - 2) < 1e-12);
+	assert(std::abs(scheduledEta(schedule, 4, 10, 10)) < 1e-12);
+
+	//Momentum on a network, and a new kind of optimizer starts from fresh state.
+	vector<int> conditions{ 6, 4, 3 };
+	DigitClassifier network(conditions);
+	Optimizer momentum;
+	momentum.kind = OPTIMIZER_MOMENTUM;
+	network.setOptimizer(momentum);
+	labeledImages images;
+	for (int i = 0; i < 12; i++)
+		images.push_back(make_pair(i % 3, vector<double>{ 0.1 * i, 0.2, 0.9 - 0.05 * i, 0.4, 0.5, 0.3 * (i % 3) }));
+	network.SGD(images, 3, 4, 0.5);
+	for (std::size_t i = 0; i < network.weights(0).size(); i++)
+		assert(std::isfinite(network.weights(0).data()[i]));
+	network.setOptimizer(Optimizer());
+	assert(network.getOptimizer().kind == OPTIMIZER_SGD);
+}
+/*
+ * Stops a run after every minibatch and resumes it from its checkpoint, and checks that it ends bit
+ * for bit where a run resumed once from the first checkpoint does.
+ */
+void testCheckpointResume()
+{
+	vector<int> conditions{ 20, 8, 10 };
+	labeledImages images;
+	for (int i = 0; i < 30; i++)
+	{
+		vector<double> pixels(20);
+		for (int p = 0; p < 20; p++)
+			pixels[p] = ((i * 13 + p * 7) % 255) / 255.0;
+		images.push_back(make_pair(i % 10, pixels));
+	}
+	std::remove("CheckpointTest.dckp");
+	std::remove("CheckpointCopy.dckp");
+	DigitClassifier stopped(conditions);
+	stopped.enableCheckpoints("CheckpointTest.dckp", 1);
+	//Adam's moments and a schedule that depends on the position in the epoch must survive too.
+	Optimizer adam;
+	adam.kind = OPTIMIZER_ADAM;
+	adam.schedule = SCHEDULE_COSINE;
+	adam.warmupEpochs = 0.5;
+	stopped.setOptimizer(adam);
+	//30 images in minibatches of 4 is 8 minibatches an epoch, 16 in all.
+	requestTrainingStop();
+	stopped.SGD(images, 2, 4, 0.01, 2);
+	Checkpoint checkpoint;
+	assert(readCheckpoint("CheckpointTest.dckp", checkpoint));
+	assert(checkpoint.header.epoch == 0 && checkpoint.header.nextImage == 4 && checkpoint.header.epochs == 2);
+	assert(checkpoint.minibatches == 1);
+	assert(checkpoint.order.size() == images.size() && !checkpoint.optimizerState.empty());
+	{
+		ifstream in("CheckpointTest.dckp", std::ios::binary);
+		std::ofstream out("CheckpointCopy.dckp", std::ios::binary);
+		out << in.rdbuf();
+	}
+
+	DigitClassifier uninterrupted(vector<int>{ 3, 3 });
+	assert(uninterrupted.resume("CheckpointCopy.dckp", images));
+	assert(uninterrupted.getStructure() == conditions && uninterrupted.getOptimizer().kind == OPTIMIZER_ADAM);
+	for (int i = 0; i < 15; i++)
+	{
+		requestTrainingStop();
+		assert(stopped.resume("CheckpointTest.dckp", images));
+	}
+	assert(readCheckpoint("CheckpointTest.dckp", checkpoint));
+	//The minibatch count carries over every resume, so minibatch checkpoints keep their cadence.
+	assert(checkpoint.header.epoch == 2 && checkpoint.header.nextImage == 0 && checkpoint.minibatches == 16);
+	for (int layer = 0; layer < 2; layer++)
+	{
+		MatrixView<const double> a = stopped.weights(layer), b = uninterrupted.weights(layer);
+		assert(std::equal(a.data(), a.data() + a.size(), b.data()));
+		assert(std::equal(stopped.biases(layer), stopped.biases(layer) + conditions[layer + 1],
+				uninterrupted.biases(layer)));
+	}
+
+	//A finished run has nothing left to do, and a checkpoint only fits the images it was made for.
+	assert(stopped.resume("CheckpointTest.dckp", images));
+	labeledImages fewer(images.begin(), images.begin() + 10);
+	assert(!stopped.resume("CheckpointTest.dckp", fewer));
+	assert(!stopped.resume("CheckpointTest.dckp"));
+	{
+		std::fstream corrupt("CheckpointTest.dckp", std::ios::binary | std::ios::in | std::ios::out);
+		corrupt.seekp(200);
+		corrupt.put('x');
+	}
+	assert(!readCheckpoint("CheckpointTest.dckp", checkpoint));
+	assert(!readCheckpoint("NoSuchCheckpoint.dckp", checkpoint));
+	std::remove("CheckpointTest.dckp");
+	std::remove("CheckpointCopy.dckp");
+}
+
+
+/*
+ * Runs body(rank, ring) on one thread per rank of a ring joined over kind at address, as separate
+ * processes would.
+ */
+template<typename Body>
+void runRing(TransportKind kind, const string & address, int size, Body body)
+{
+	vector<std::thread> ranks;
+	for (int rank = 0; rank < size; rank++)
+		ranks.emplace_back([&, rank]
+		{
+			RingTransport ring;
+			assert(ring.connect(kind, address, rank, size, 10));
+			body(rank, ring);
+		});
+	for (std::thread & rank : ranks)
+		rank.join();
+}
+
+void testDistributedTraining()
+{
+	//Every half that is not a NaN survives the round trip, and floats round to the nearest half.
+	for (int bits = 0; bits < 0x10000; bits++)
+		if ((bits & 0x7c00) != 0x7c00 || (bits & 0x3ff) == 0)
+			assert(toHalf(fromHalf(bits)) == bits);
+	assert(toHalf(1) == 0x3c00 && toHalf(-2) == 0xc000 && toHalf(65504) == 0x7bff && toHalf(65520) == 0x7c00);
+	assert(toHalf(1 + 1.0f / 2048) == 0x3c00 && toHalf(1 + 3.0f / 2048) == 0x3c02);
+	assert(toHalf(1e-8f) == 0 && fromHalf(1) == std::ldexp(1.0f, -24));
+
+	//Below Linux's ephemeral ports, which the ranks' own connects could otherwise take first.
+	string port = std::to_string(20000 + getpid() % 1500 * 8);
+	TransportKind kinds[] = { TRANSPORT_SHARED_MEMORY, TRANSPORT_TCP };
+	string addresses[] = { "/digits-test-" + std::to_string(getpid()), port };
+	const std::size_t count = 1003;
+	for (int k = 0; k < 2; k++)
+		for (int size = 1; size <= 4; size++)
+			for (int compress = 0; compress < 2; compress++)
+			{
+				vector<vector<double>> results(size, vector<double>(count));
+				vector<std::uint64_t> bytes(size);
+				runRing(kinds[k], addresses[k], size, [&](int rank, RingTransport & ring)
+				{
+					vector<double> & values = results[rank];
+					for (std::size_t i = 0; i < count; i++)
+						values[i] = rank + i * 0.25;
+					vector<unsigned char> scratch;
+					assert(ringAllReduce(ring, values.data(), count, compress, scratch));
+					bytes[rank] = ring.bytesSent();
+				});
+				for (std::size_t i = 0; i < count; i++)
+				{
+					double sum = size * (size - 1) / 2.0 + size * i * 0.25;
+					assert(compress ? std::fabs(results[0][i] - sum) <= sum * 2e-3 : results[0][i] == sum);
+					for (int rank = 1; rank < size; rank++)
+						assert(results[rank][i] == results[0][i]);
+				}
+				//Each rank sends 2 (size - 1) chunks of about count / size values.
+				double expected = 2.0 * (size - 1) * count / size * (compress ? 2 : sizeof(double));
+				assert(std::fabs(bytes[0] - expected) <= 2 * (size - 1) * sizeof(double));
+			}
+
+	//Two ranks from different starting weights end up with the same trained network. The weights are
+	//seeded from the clock, and 30 epochs at eta 5 clear 80% from every one of 200 seeds tried.
+	vector<int> conditions{ 20, 8, 10 };
+	labeledImages images;
+	for (int i = 0; i < 200; i++)
+	{
+		vector<double> pixels(20);
+		for (int p = 0; p < 20; p++)
+			pixels[p] = (p % 10 == i % 10 ? 0.8 : 0.1) + ((i * 13 + p * 7) % 17) / 100.0;
+		images.push_back(make_pair(i % 10, pixels));
+	}
+	std::remove("DistributedTest.txt");
+	for (int compress = 0; compress < 2; compress++)
+	{
+		vector<DigitClassifier> networks(2, DigitClassifier(conditions));
+		networks[1].fillSystemRandomly();
+		runRing(kinds[compress], addresses[compress], 2, [&](int rank, RingTransport & ring)
+		{
+			assert(networks[rank].trainDistributed(images, ring, 30, 10, 5, compress, "DistributedTest.txt"));
+		});
+		for (int layer = 0; layer < 2; layer++)
+		{
+			MatrixView<const double> a = networks[0].weights(layer), b = networks[1].weights(layer);
+			assert(std::equal(a.data(), a.data() + a.size(), b.data()));
+		}
+		assert(networks[0].evaluate(images).accuracy() > 80);
+		DigitClassifier saved("DistributedTest.txt");
+		assert(saved.evaluate(images).accuracy() == networks[0].evaluate(images).accuracy());
+	}
+
+	//A stop asked of either rank stops both after the same minibatch.
+	vector<DigitClassifier> networks(3, DigitClassifier(conditions));
+	requestTrainingStop();
+	runRing(TRANSPORT_SHARED_MEMORY, addresses[0], 3, [&](int rank, RingTransport & ring)
+	{
+		assert(networks[rank].trainDistributed(images, ring, 1000, 9, 3));
+	});
+	for (int rank = 1; rank < 3; rank++)
+		assert(std::equal(networks[0].biases(0), networks[0].biases(0) + 8, networks[rank].biases(0)));
+	std::remove("DistributedTest.txt");
+}
+
+/*
+ * The CSR kernels against the dense ones on every kernel path, at batch sizes around the SIMD widths
+ * and the transpose block, then pruning a network, fine-tuning it with the mask and classifying sparse.
+ */
+void testPruning()
+{
+	Matrix<double> dense(13, 70);
+	for (int r = 0; r < dense.rows(); r++)
+		for (int c = 0; c < dense.cols(); c++)
+			dense[r][c] = (r * 7 + c * 3) % 5 == 0 ? std::sin(r + c * 0.3) : 0;
+	CsrMatrix<double> csr;
+	csr.assign(dense.view());
+	std::size_t nonZeros = 0;
+	for (int r = 0; r < dense.rows(); r++)
+		nonZeros += std::count_if(dense[r], dense[r] + dense.cols(), [](double v) { return v != 0; });
+	assert(csr.rows == 13 && csr.cols == 70 && csr.nonZeros() == nonZeros && csr.rowStarts.back() == (int) nonZeros);
+	Matrix<float> denseFloat(dense.rows(), dense.cols());
+	for (int r = 0; r < dense.rows(); r++)
+		std::copy(dense[r], dense[r] + dense.cols(), denseFloat[r]);
+	CsrMatrix<float> csrFloat;
+	csrFloat.assign(denseFloat.view());
+
+	KernelPath saved = kernelPath();
+	for (int path = KERNEL_SCALAR; path <= bestKernelPath(); path++)
+	{
+		setKernelPath((KernelPath) path);
+		for (int images : { 1, 3, 17, 33, 64, 130 })
+		{
+			Matrix<double> x(images, dense.cols()), expected(images, dense.rows()), c(images, dense.rows());
+			Matrix<float> xFloat(images, dense.cols()), cFloat(images, dense.rows());
+			for (int i = 0; i < images; i++)
+			{
+				for (int p = 0; p < dense.cols(); p++)
+					xFloat[i][p] = x[i][p] = std::cos(i * 5 + p);
+				std::fill(expected[i], expected[i] + dense.rows(), 0.5);
+				std::fill(c[i], c[i] + dense.rows(), 0.5);
+				std::fill(cFloat[i], cFloat[i] + dense.rows(), 0.5f);
+			}
+			gemm(NO_TRANSPOSE, TRANSPOSE, 1, x.view(), dense.view(), 1, expected.view());
+			csrGemm(csr, x.view(), c.view());
+			csrGemm(csrFloat, xFloat.view(), cFloat.view());
+			for (int i = 0; i < images; i++)
+				for (int r = 0; r < dense.rows(); r++)
+				{
+					assert(fabs(c[i][r] - expected[i][r]) < 1e-12);
+					assert(fabs(cFloat[i][r] - expected[i][r]) < 1e-4);
+				}
+		}
+		vector<double> x(dense.cols()), y(dense.rows(), 1), expected(dense.rows(), 1);
+		vector<float> xFloat(dense.cols()), yFloat(dense.rows(), 1);
+		for (int p = 0; p < dense.cols(); p++)
+			xFloat[p] = x[p] = std::sin(p * 0.7);
+		gemv(NO_TRANSPOSE, 1, dense.view(), x.data(), 1, expected.data());
+		csrGemv(csr, x.data(), y.data());
+		csrGemv(csrFloat, xFloat.data(), yFloat.data());
+		for (int r = 0; r < dense.rows(); r++)
+			assert(fabs(y[r] - expected[r]) < 1e-12 && fabs(yFloat[r] - expected[r]) < 1e-4);
+	}
+	setKernelPath(saved);
+
+	vector<int> conditions{ 40, 12, 3 };
+	DigitClassifier network(conditions);
+	assert(!network.isPruned() && !network.isSparseLayer(0, 1) && !network.isSparseLayer(0, 2));
+	//Every weight starts nonzero, so the top 4 of 40 inputs leave 36 of 40 zero, and 2 of 12 leave 10.
+	double sparsity = network.pruneTopK(4, 0);
+	assert(fabs(sparsity - 12 * 36.0 / (40 * 12 + 12 * 3)) < 1e-12);
+	assert(network.isPruned() && fabs(network.density(0) - 0.1) < 1e-12);
+	assert(network.isSparseLayer(0, 1) && network.isSparseLayer(0, 30) && !network.isSparseLayer(1, 1));
+	network.pruneTopK(2, 1);
+	assert(network.isSparseLayer(1, 1) && network.isSparseLayer(1, 30));
+	for (int r = 0; r < 12; r++)
+		assert(std::count(network.weights(0)[r], network.weights(0)[r] + 40, 0.0) == 36);
+	assert(network.pruneBelow(1e9) == 1 && network.density(1) == 0);
+	network.fillSystemRandomly();
+	assert(!network.isPruned() && !network.isSparseLayer(0, 1));
+	assert(network.pruneBelow(0) == 0 && network.isPruned() && !network.isSparseLayer(0, 30));
+	network.clearPruneMask();
+	//At 30% density single images are faster dense but batches are faster sparse.
+	network.pruneTopK(12, 0);
+	assert(!network.isSparseLayer(0, 1) && network.isSparseLayer(0, 2));
+	network.fillSystemRandomly();
+	network.pruneTopK(4, 0);
+	network.toString("PruningTest.txt");
+	DigitClassifier reloaded("PruningTest.txt");
+	std::remove("PruningTest.txt");
+	assert(!reloaded.isPruned() && reloaded.pruneBelow(0) == network.pruneBelow(0) && reloaded.isSparseLayer(0, 1));
+
+	//Fine-tuning moves the kept weights but none of the pruned ones, and leaves the layer sparse.
+	labeledImages images;
+	for (int i = 0; i < 30; i++)
+	{
+		vector<double> pixels(40);
+		for (int p = 0; p < 40; p++)
+			pixels[p] = std::fabs(std::sin(i * 3 + p * (i % 3 + 1)));
+		images.push_back(make_pair(i % 3, pixels));
+	}
+	Matrix<double> before(12, 40);
+	for (int r = 0; r < 12; r++)
+		std::copy(network.weights(0)[r], network.weights(0)[r] + 40, before[r]);
+	network.SGD(images, 2, 5, 1);
+	bool moved = false;
+	for (int r = 0; r < 12; r++)
+		for (int p = 0; p < 40; p++)
+		{
+			assert(before[r][p] != 0 || network.weights(0)[r][p] == 0);
+			moved = moved || before[r][p] != network.weights(0)[r][p];
+		}
+	assert(moved && network.isSparseLayer(0, 1) && fabs(network.density(0) - 0.1) < 1e-12);
+
+	//Sparse and dense inference agree.
+	DigitClassifier denseCopy(network);
+	denseCopy.clearSparseLayers();
+	network.updateSparseLayers(1, 1);
+	assert(network.isSparseLayer(0, 1) && network.isSparseLayer(1, 2) && !denseCopy.isSparseLayer(0, 2));
+	DigitClassifier::Workspace workspace;
+	Matrix<double> batch(images.size(), 40), outputs(images.size(), 3), denseOutputs(images.size(), 3);
+	for (std::size_t i = 0; i < images.size(); i++)
+	{
+		std::copy(images[i].second.begin(), images[i].second.end(), batch[i]);
+		assert(network.classify(images[i].second) == denseCopy.classify(images[i].second));
+		vector<double> sparseOut = network.feedForwardOnce(images[i].second, 2);
+		vector<double> denseOut = denseCopy.feedForwardOnce(images[i].second, 2);
+		for (int o = 0; o < 3; o++)
+			assert(fabs(sparseOut[o] - denseOut[o]) < 1e-12);
+	}
+	network.classifyMany(batch.view(), workspace, outputs.view());
+	denseCopy.classifyMany(batch.view(), workspace, denseOutputs.view());
+	for (std::size_t i = 0; i < images.size(); i++)
+		for (int o = 0; o < 3; o++)
+			assert(fabs(outputs[i][o] - denseOutputs[i][o]) < 1e-12);
+
+	//Training with the mask cleared may change any weight again.
+	network.clearPruneMask();
+	network.SGD(images, 1, 5, 1);
+	assert(!network.isPruned() && network.density(0) == 1);
+}
 void testShuffleImagesImporved()
 {
 	vector<int> conditions{1,2,3};
@@ -255,27 +1612,56 @@ void testActivations(DigitClassifier & obj)
 }
 
 
-/*int main()
+/*
+ * Runs every test that needs no files besides the ones it writes itself. The commented out tests
+ * read MNIST files or trained models that are not in the repository, or must be checked by hand.
+ */
+int main()
 {
 	std::vector<int> conditions =
 	{ 28 * 28, 15, 10 };
-	DigitClassifier obj("train3.txt");
+	DigitClassifier obj(conditions);
 	//getImages works and has been tested separately.
-	//testHadamard(obj); //Passed
-	//testMultiplyMatrices(obj); //Passed
-	//testTranspose(obj); //Passed
-	//testExtractDoubles(obj); //Passed
+	testHadamard(obj); //Passed
+	testMultiplyMatrices(obj); //Passed
+	testGemmAndGemv(); //Passed
+	testTranspose(obj); //Passed
+	testExtractDoubles(obj); //Passed
 	//testToStringAndReadIn(obj); //Passed
 	//testFeedForwardOnce(); //Passed
-	//testFillSystemRandomly(); //Passed
+	testFillSystemRandomly(); //Passed
 	//testLastLayerError(); //Passed
 	//testBackpropagate(); //Passed
-	//testShuffleImages(obj); //Passed
+	testShuffleImages(obj); //Passed
 	//testSGD(obj); //Passed, though the updateSystem function was not tested yet.
 	//testUpdateSystem();
+	testBackpropagateBatch(); //Passed
+	testBackpropagateDeep(); //Passed
+	testUpdateSystemParallel(); //Passed
+	testHogwildEpoch(); //Passed
+	testEvaluationReport(); //Passed
+	testDataset(); //Passed
+	testFromCsv(); //Passed
+	testBatchStream(); //Passed
+	testMismatchedImages(); //Passed
+	testSaveAndMap(); //Passed
+	testFloatPrecision(); //Passed
+	testQuantizedClassifier(); //Passed
+	testFixedNetwork(); //Passed
+	testClassifyWorkspace(); //Passed
+	testLatencyHistogram(); //Passed
+	testInferenceServer(); //Passed
+	testActivation(); //Passed
+	testTrainingWorkspaceAllocations(); //Passed
+	testMetrics(); //Passed
+	testCheckpointResume(); //Passed
+	testOptimizers(); //Passed
+	testSoftmaxOutput(); //Passed
+	testDistributedTraining(); //Passed
+	testPruning(); //Passed
 	//testShuffleImagesImporved(); //Passed.
 	//testActivations(obj);
-	obj.updateSystem(obj.getImages("mnist_train_very_short.csv"), 3);
+	//obj.updateSystem(obj.getImages("mnist_train_very_short.csv"), 3);
 
 	cout << "tests passed" << endl;
-}*/
+}
@@ -0,0 +1,78 @@
+/*
+ * Author: Shuhao Lai
+ * Date: 10/17/2026
+ * ThreadPool.cpp
+ */
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(int threads) :
+		numThreads(threads < 1 ? 1 : threads), jobContext(nullptr), jobInvoke(nullptr), jobTasks(0), generation(0), busy(0), stopping(false)
+{
+	//Thread 0 is the caller of run(), so only the others need to be started.
+	for (int id = 1; id < numThreads; id++)
+		workers.emplace_back(&ThreadPool::work, this, id);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread & worker : workers)
+		worker.join();
+}
+
+void ThreadPool::runTasks(int tasks, const void * context, Invoker invoke)
+{
+	if (numThreads == 1 || tasks <= 1)
+	{
+		for (int i = 0; i < tasks; i++)
+			invoke(context, i);
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		jobContext = context;
+		jobInvoke = invoke;
+		jobTasks = tasks;
+		busy = numThreads - 1;
+		++generation;
+	}
+	wake.notify_all();
+	for (int i = 0; i < tasks; i += numThreads)
+		invoke(context, i);
+	std::unique_lock<std::mutex> guard(lock);
+	finished.wait(guard, [this] { return busy == 0; });
+	jobContext = nullptr;
+	jobInvoke = nullptr;
+}
+
+void ThreadPool::work(int id)
+{
+	unsigned long seen = 0;
+	while (true)
+	{
+		const void * context;
+		Invoker invoke;
+		int tasks;
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			wake.wait(guard, [this, seen] { return stopping || generation != seen; });
+			if (stopping)
+				return;
+			seen = generation;
+			context = jobContext;
+			invoke = jobInvoke;
+			tasks = jobTasks;
+		}
+		for (int i = id; i < tasks; i += numThreads)
+			invoke(context, i);
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			--busy;
+		}
+		finished.notify_one();
+	}
+}
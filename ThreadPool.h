@@ -0,0 +1,68 @@
+/*
+ * Author: Shuhao Lai
+ * Date: 10/17/2026
+ * ThreadPool.h
+ */
+
+#ifndef THREADPOOL_H_
+#define THREADPOOL_H_
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * A fixed set of worker threads for fork-join parallelism. run() hands out task indices
+ * and returns once every task is done, so callers never see a partially finished step.
+ * Task i always runs on thread i % size(), which keeps per-thread buffers stable between calls.
+ */
+class ThreadPool
+{
+public:
+	//A pool of size 1 runs every task on the calling thread.
+	explicit ThreadPool(int threads);
+
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool & operator=(const ThreadPool &) = delete;
+
+	/*
+	 * Runs task(0) ... task(tasks - 1) and waits for all of them. The calling thread runs its share too.
+	 * task is any callable taking an int. It is called through a plain function pointer rather than a
+	 * std::function, so a lambda with many captures does not allocate on every call.
+	 */
+	template<typename Task>
+	void run(int tasks, const Task & task)
+	{
+		runTasks(tasks, &task, [](const void * context, int i) { (*static_cast<const Task *>(context))(i); });
+	}
+
+	int size() const
+	{
+		return numThreads;
+	}
+
+private:
+	typedef void (*Invoker)(const void * context, int task);
+
+	void runTasks(int tasks, const void * context, Invoker invoke);
+	void work(int id);
+
+	int numThreads;
+	std::vector<std::thread> workers;
+	std::mutex lock;
+	std::condition_variable wake;
+	std::condition_variable finished;
+
+	//Current job: invoke(context, i) runs task i. generation changes every time run() hands out new work.
+	const void * jobContext;
+	Invoker jobInvoke;
+	int jobTasks;
+	unsigned long generation;
+	int busy;
+	bool stopping;
+};
+
+#endif /* THREADPOOL_H_ */
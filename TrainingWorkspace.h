@@ -0,0 +1,59 @@
+/*
+ * Author: Shuhao Lai
+ * Date: 10/17/2026
+ * TrainingWorkspace.h
+ */
+
+#ifndef TRAININGWORKSPACE_H_
+#define TRAININGWORKSPACE_H_
+
+#include <vector>
+#include "Matrix.h"
+
+/*
+ * Every buffer one thread needs to train on a minibatch. The buffers are sized by the first
+ * minibatch and only grow after that, so an epoch that reuses the same workspaces never touches
+ * the heap. A workspace belongs to one thread at a time.
+ */
+template<typename T>
+struct BasicTrainingWorkspace
+{
+	//The minibatch with one image per row, and its labels.
+	Matrix<T> inputs;
+	std::vector<int> labels;
+
+	//zVals[i], acts[i] and errors[i] belong to layer i + 1, with one row per image.
+	std::vector<Matrix<T>> zVals;
+	std::vector<Matrix<T>> acts;
+	std::vector<Matrix<T>> errors;
+
+	//Summed gradients, laid out like the parameters.
+	AlignedBuffer<T> gradients;
+
+	//Hogwild's private copy of the shared parameters for the minibatch it is working on.
+	AlignedBuffer<T> snapshot;
+
+	/*
+	 * Sizes every buffer for minibatches of up to rows images through a network with the given
+	 * structure, so that even a thread that has not trained yet will not allocate later.
+	 */
+	void reserve(const std::vector<int> & structure, int rows)
+	{
+		int layers = structure.size() - 1;
+		if (inputs.rows() < rows || inputs.cols() != structure[0])
+			inputs.resize(rows, structure[0]);
+		labels.reserve(rows);
+		zVals.resize(layers);
+		acts.resize(layers);
+		errors.resize(layers);
+		for (int layer = 0; layer < layers; layer++)
+			if (zVals[layer].rows() < rows || zVals[layer].cols() != structure[layer + 1])
+			{
+				zVals[layer].resize(rows, structure[layer + 1]);
+				acts[layer].resize(rows, structure[layer + 1]);
+				errors[layer].resize(rows, structure[layer + 1]);
+			}
+	}
+};
+
+#endif /* TRAININGWORKSPACE_H_ */